@@ -259,6 +259,7 @@ static int output_userspace(struct datapath *dp, struct sk_buff *skb, u64 arg)
 	upcall.sample_pool = 0;
 	upcall.actions = NULL;
 	upcall.actions_len = 0;
+	upcall.trunc_len = 0;
 	return dp_upcall(dp, skb, &upcall);
 }
 
@@ -380,6 +381,7 @@ static void sflow_sample(struct datapath *dp, struct sk_buff *skb,
 	upcall.sample_pool = atomic_read(&p->sflow_pool);
 	upcall.actions = acts->actions;
 	upcall.actions_len = acts->actions_len;
+	upcall.trunc_len = dp->sflow_sample_len;
 	dp_upcall(dp, nskb, &upcall);
 }
 
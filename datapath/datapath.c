@@ -297,6 +297,7 @@ void dp_process_received_packet(struct vport *p, struct sk_buff *skb)
 			upcall.sample_pool = 0;
 			upcall.actions = NULL;
 			upcall.actions_len = 0;
+			upcall.trunc_len = 0;
 			dp_upcall(dp, skb, &upcall);
 			stats_counter_off = offsetof(struct dp_stats_percpu, n_missed);
 			goto out;
@@ -390,11 +391,24 @@ int dp_upcall(struct datapath *dp, struct sk_buff *skb, const struct dp_upcall_i
 
 	WARN_ON_ONCE(skb_shared(skb));
 
+	/* Protect userspace from a flood of misses on a single port. */
+	if (upcall_info->cmd == OVS_PACKET_CMD_MISS &&
+	    !vport_upcall_admit(OVS_CB(skb)->vport, upcall_info->key)) {
+		kfree_skb(skb);
+		err = -ENOBUFS;
+		goto err;
+	}
+
 	forward_ip_summed(skb, true);
 
 	/* Break apart GSO packets into their component pieces.  Otherwise
-	 * userspace may try to stuff a 64kB packet into a 1500-byte MTU. */
-	if (skb_is_gso(skb)) {
+	 * userspace may try to stuff a 64kB packet into a 1500-byte MTU.
+	 *
+	 * A truncated upcall only carries the headers, which are the same in
+	 * the first segment as in the GSO packet, so it is cheaper to skip
+	 * segmentation and send the GSO packet's headers along with its full
+	 * length. */
+	if (skb_is_gso(skb) && !upcall_info->trunc_len) {
 		struct sk_buff *nskb = skb_gso_segment(skb, NETIF_F_SG | NETIF_F_HW_CSUM);
 		
 		if (IS_ERR(nskb)) {
@@ -425,22 +439,92 @@ err:
 	return err;
 }
 
+/* Upcalls for the segments of a GSO packet are packed into shared Netlink
+ * datagrams of up to this many bytes, so that userspace can receive several of
+ * them with a single system call. */
+#define UPCALL_BATCH_SIZE 16384
+
+/* Returns the number of bytes of Netlink message needed to pass 'len' bytes of
+ * 'skb' to userspace as directed by 'upcall_info'. */
+static size_t upcall_msg_size(const struct dp_upcall_info *upcall_info,
+			      const struct sk_buff *skb, unsigned int len)
+{
+	size_t size = sizeof(struct ovs_header);
+
+	size += nla_total_size(len);
+	size += nla_total_size(FLOW_BUFSIZE);
+	if (upcall_info->userdata)
+		size += nla_total_size(8);
+	if (upcall_info->sample_pool)
+		size += nla_total_size(4);
+	if (upcall_info->actions_len)
+		size += nla_total_size(upcall_info->actions_len);
+	if (len < skb->len)
+		size += nla_total_size(4);
+
+	return nlmsg_total_size(genlmsg_total_size(size));
+}
+
+/* Appends to 'user_skb' a Netlink message that passes the first 'len' bytes of
+ * 'skb' to userspace for 'dp' as directed by 'upcall_info'.  The caller must
+ * have ensured that 'user_skb' has room, using upcall_msg_size(). */
+static void put_upcall(struct sk_buff *user_skb, struct datapath *dp,
+		       struct sk_buff *skb, unsigned int len,
+		       const struct dp_upcall_info *upcall_info)
+{
+	struct ovs_header *upcall;
+	struct nlattr *nla;
+
+	upcall = genlmsg_put(user_skb, 0, 0, &dp_packet_genl_family, 0, upcall_info->cmd);
+	upcall->dp_ifindex = dp->dp_ifindex;
+
+	nla = nla_nest_start(user_skb, OVS_PACKET_ATTR_KEY);
+	flow_to_nlattrs(upcall_info->key, user_skb);
+	nla_nest_end(user_skb, nla);
+
+	if (upcall_info->userdata)
+		nla_put_u64(user_skb, OVS_PACKET_ATTR_USERDATA, upcall_info->userdata);
+	if (upcall_info->sample_pool)
+		nla_put_u32(user_skb, OVS_PACKET_ATTR_SAMPLE_POOL, upcall_info->sample_pool);
+	if (upcall_info->actions_len) {
+		const struct nlattr *actions = upcall_info->actions;
+		u32 actions_len = upcall_info->actions_len;
+
+		nla = nla_nest_start(user_skb, OVS_PACKET_ATTR_ACTIONS);
+		memcpy(__skb_put(user_skb, actions_len), actions, actions_len);
+		nla_nest_end(user_skb, nla);
+	}
+
+	nla = __nla_reserve(user_skb, OVS_PACKET_ATTR_PACKET, len);
+	if (len < skb->len) {
+		/* Truncated sample: only the headers matter, so don't bother
+		 * to complete a partial checksum. */
+		skb_copy_bits(skb, 0, nla_data(nla), len);
+		nla_put_u32(user_skb, OVS_PACKET_ATTR_LEN, skb->len);
+	} else if (skb->ip_summed == CHECKSUM_PARTIAL)
+		copy_and_csum_skb(skb, nla_data(nla));
+	else
+		skb_copy_bits(skb, 0, nla_data(nla), skb->len);
+
+	genlmsg_end(user_skb, upcall);
+}
+
 /* Send each packet in the 'skb' list to userspace for 'dp' as directed by
  * 'upcall_info'.  There will be only one packet unless we broke up a GSO
- * packet.
+ * packet, in which case the upcalls are batched into as few Netlink datagrams
+ * as UPCALL_BATCH_SIZE allows.
  */
 static int queue_userspace_packets(struct datapath *dp, struct sk_buff *skb,
 				 const struct dp_upcall_info *upcall_info)
 {
 	u32 group = packet_mc_group(dp, upcall_info->cmd);
+	struct sk_buff *user_skb = NULL; /* to be queued to userspace */
 	struct sk_buff *nskb;
 	int err;
 
 	do {
-		struct ovs_header *upcall;
-		struct sk_buff *user_skb; /* to be queued to userspace */
-		struct nlattr *nla;
 		unsigned int len;
+		size_t size;
 
 		nskb = skb->next;
 		skb->next = NULL;
@@ -449,61 +533,48 @@ static int queue_userspace_packets(struct datapath *dp, struct sk_buff *skb,
 		if (unlikely(err))
 			goto err_kfree_skbs;
 
-		if (nla_attr_size(skb->len) > USHRT_MAX)
-			goto err_kfree_skbs;
+		len = skb->len;
+		if (upcall_info->trunc_len && len > upcall_info->trunc_len)
+			len = upcall_info->trunc_len;
 
-		len = sizeof(struct ovs_header);
-		len += nla_total_size(skb->len);
-		len += nla_total_size(FLOW_BUFSIZE);
-		if (upcall_info->userdata)
-			len += nla_total_size(8);
-		if (upcall_info->sample_pool)
-			len += nla_total_size(4);
-		if (upcall_info->actions_len)
-			len += nla_total_size(upcall_info->actions_len);
-
-		user_skb = genlmsg_new(len, GFP_ATOMIC);
-		if (!user_skb) {
-			netlink_set_err(INIT_NET_GENL_SOCK, 0, group, -ENOBUFS);
+		if (nla_attr_size(len) > USHRT_MAX)
 			goto err_kfree_skbs;
-		}
-
-		upcall = genlmsg_put(user_skb, 0, 0, &dp_packet_genl_family, 0, upcall_info->cmd);
-		upcall->dp_ifindex = dp->dp_ifindex;
-
-		nla = nla_nest_start(user_skb, OVS_PACKET_ATTR_KEY);
-		flow_to_nlattrs(upcall_info->key, user_skb);
-		nla_nest_end(user_skb, nla);
 
-		if (upcall_info->userdata)
-			nla_put_u64(user_skb, OVS_PACKET_ATTR_USERDATA, upcall_info->userdata);
-		if (upcall_info->sample_pool)
-			nla_put_u32(user_skb, OVS_PACKET_ATTR_SAMPLE_POOL, upcall_info->sample_pool);
-		if (upcall_info->actions_len) {
-			const struct nlattr *actions = upcall_info->actions;
-			u32 actions_len = upcall_info->actions_len;
-
-			nla = nla_nest_start(user_skb, OVS_PACKET_ATTR_ACTIONS);
-			memcpy(__skb_put(user_skb, actions_len), actions, actions_len);
-			nla_nest_end(user_skb, nla);
+		size = upcall_msg_size(upcall_info, skb, len);
+		if (user_skb && skb_tailroom(user_skb) < size) {
+			err = genlmsg_multicast(user_skb, 0, group, GFP_ATOMIC);
+			user_skb = NULL;
+			if (err)
+				goto err_kfree_skbs;
 		}
 
-		nla = __nla_reserve(user_skb, OVS_PACKET_ATTR_PACKET, skb->len);
-		if (skb->ip_summed == CHECKSUM_PARTIAL)
-			copy_and_csum_skb(skb, nla_data(nla));
-		else
-			skb_copy_bits(skb, 0, nla_data(nla), skb->len);
+		if (!user_skb) {
+			size_t alloc = size;
+			struct sk_buff *iter;
+
+			/* Make room for the following segments too, assuming
+			 * that they are about the same size as this one. */
+			for (iter = nskb; iter && alloc + size <= UPCALL_BATCH_SIZE;
+			     iter = iter->next)
+				alloc += size;
+
+			user_skb = alloc_skb(alloc, GFP_ATOMIC);
+			if (!user_skb) {
+				netlink_set_err(INIT_NET_GENL_SOCK, 0, group, -ENOBUFS);
+				goto err_kfree_skbs;
+			}
+		}
 
-		err = genlmsg_multicast(user_skb, 0, group, GFP_ATOMIC);
-		if (err)
-			goto err_kfree_skbs;
+		put_upcall(user_skb, dp, skb, len, upcall_info);
 
 		consume_skb(skb);
 		skb = nskb;
 	} while (skb);
-	return 0;
+
+	return genlmsg_multicast(user_skb, 0, group, GFP_ATOMIC);
 
 err_kfree_skbs:
+	kfree_skb(user_skb);
 	kfree_skb(skb);
 	while ((skb = nskb) != NULL) {
 		nskb = skb->next;
@@ -534,6 +605,39 @@ static int flush_flows(int dp_ifindex)
 	return 0;
 }
 
+/* Makes progress on resizing 'dp''s flow table, starting a resize first if
+ * the table has become too crowded or too sparse.  Each call moves only a
+ * few buckets, so that no single flow table update has to rehash every flow
+ * in a large table.  A table that just replaced another one waits for an RCU
+ * grace period before it starts resizing, without blocking.
+ *
+ * Called with genl_mutex. */
+static void rehash_flow_table(struct datapath *dp)
+{
+	struct flow_table *table = get_table_protected(dp);
+	struct flow_table *new_table;
+
+	if (!table->rehash) {
+		if (flow_tbl_need_to_expand(table)) {
+			if (flow_tbl_rehash_start(table, table->n_buckets * 2))
+				return;
+			dp->n_table_expands++;
+		} else if (flow_tbl_need_to_shrink(table)) {
+			if (flow_tbl_rehash_start(table, table->n_buckets / 2))
+				return;
+			dp->n_table_shrinks++;
+		} else
+			return;
+	}
+
+	new_table = flow_tbl_rehash_step(table, TBL_REHASH_STEP);
+	if (new_table) {
+		rcu_assign_pointer(dp->table, new_table);
+		flow_tbl_wait_nodes(new_table);
+		flow_tbl_deferred_destroy(table);
+	}
+}
+
 static int validate_actions(const struct nlattr *attr)
 {
 	const struct nlattr *a;
@@ -604,14 +708,6 @@ static int validate_actions(const struct nlattr *attr)
 
 	return 0;
 }
-static void clear_stats(struct sw_flow *flow)
-{
-	flow->used = 0;
-	flow->tcp_flags = 0;
-	flow->packet_count = 0;
-	flow->byte_count = 0;
-}
-
 static int ovs_packet_cmd_execute(struct sk_buff *skb, struct genl_info *info)
 {
 	struct ovs_header *ovs_header = info->userhdr;
@@ -672,8 +768,6 @@ static int ovs_packet_cmd_execute(struct sk_buff *skb, struct genl_info *info)
 	if (err)
 		goto err_flow_put;
 
-	flow->hash = flow_hash(&flow->key, key_len);
-
 	acts = flow_actions_alloc(a[OVS_PACKET_ATTR_ACTIONS]);
 	err = PTR_ERR(acts);
 	if (IS_ERR(acts))
@@ -722,6 +816,16 @@ static struct genl_ops dp_packet_genl_ops[] = {
 	}
 };
 
+static void get_dp_table_stats(struct datapath *dp,
+			       struct ovs_dp_table_stats *stats)
+{
+	struct flow_table *table = get_table_protected(dp);
+
+	stats->n_buckets = table->n_buckets;
+	stats->n_expands = dp->n_table_expands;
+	stats->n_shrinks = dp->n_table_shrinks;
+}
+
 static void get_dp_stats(struct datapath *dp, struct ovs_dp_stats *stats)
 {
 	int i;
@@ -797,12 +901,7 @@ static int ovs_flow_cmd_fill_info(struct sw_flow *flow, struct datapath *dp,
 		goto error;
 	nla_nest_end(skb, nla);
 
-	spin_lock_bh(&flow->lock);
-	used = flow->used;
-	stats.n_packets = flow->packet_count;
-	stats.n_bytes = flow->byte_count;
-	tcp_flags = flow->tcp_flags;
-	spin_unlock_bh(&flow->lock);
+	flow_stats_get(flow, &stats, &used, &tcp_flags);
 
 	if (used)
 		NLA_PUT_U64(skb, OVS_FLOW_ATTR_USED, flow_used_time(used));
@@ -913,18 +1012,6 @@ static int ovs_flow_cmd_new_or_set(struct sk_buff *skb, struct genl_info *info)
 		if (info->genlhdr->cmd == OVS_FLOW_CMD_SET)
 			goto error;
 
-		/* Expand table, if necessary, to make room. */
-		if (flow_tbl_need_to_expand(table)) {
-			struct flow_table *new_table;
-
-			new_table = flow_tbl_expand(table);
-			if (!IS_ERR(new_table)) {
-				rcu_assign_pointer(dp->table, new_table);
-				flow_tbl_deferred_destroy(table);
-				table = get_table_protected(dp);
-			}
-		}
-
 		/* Allocate flow. */
 		flow = flow_alloc();
 		if (IS_ERR(flow)) {
@@ -932,7 +1019,11 @@ static int ovs_flow_cmd_new_or_set(struct sk_buff *skb, struct genl_info *info)
 			goto error;
 		}
 		flow->key = key;
-		clear_stats(flow);
+		flow->key_len = key_len;
+
+		error = flow_alloc_stats(flow);
+		if (error)
+			goto error_free_flow;
 
 		/* Obtain actions. */
 		acts = flow_actions_alloc(a[OVS_FLOW_ATTR_ACTIONS]);
@@ -941,9 +1032,9 @@ static int ovs_flow_cmd_new_or_set(struct sk_buff *skb, struct genl_info *info)
 			goto error_free_flow;
 		rcu_assign_pointer(flow->sf_acts, acts);
 
-		/* Put flow in bucket. */
-		flow->hash = flow_hash(&key, key_len);
+		/* Put flow in bucket, then grow the table if it's crowded. */
 		flow_tbl_insert(table, flow);
+		rehash_flow_table(dp);
 
 		reply = ovs_flow_cmd_build_info(flow, dp, info->snd_pid,
 						info->snd_seq, OVS_FLOW_CMD_NEW);
@@ -984,11 +1075,8 @@ static int ovs_flow_cmd_new_or_set(struct sk_buff *skb, struct genl_info *info)
 						info->snd_seq, OVS_FLOW_CMD_NEW);
 
 		/* Clear stats. */
-		if (a[OVS_FLOW_ATTR_CLEAR]) {
-			spin_lock_bh(&flow->lock);
-			clear_stats(flow);
-			spin_unlock_bh(&flow->lock);
-		}
+		if (a[OVS_FLOW_ATTR_CLEAR])
+			flow_stats_clear(flow);
 	}
 
 	if (!IS_ERR(reply))
@@ -1071,6 +1159,7 @@ static int ovs_flow_cmd_del(struct sk_buff *skb, struct genl_info *info)
 		return -ENOMEM;
 
 	flow_tbl_remove(table, flow);
+	rehash_flow_table(dp);
 
 	err = ovs_flow_cmd_fill_info(flow, dp, reply, info->snd_pid,
 				     info->snd_seq, 0, OVS_FLOW_CMD_DEL);
@@ -1143,6 +1232,7 @@ static const struct nla_policy datapath_policy[OVS_DP_ATTR_MAX + 1] = {
 #endif
 	[OVS_DP_ATTR_IPV4_FRAGS] = { .type = NLA_U32 },
 	[OVS_DP_ATTR_SAMPLING] = { .type = NLA_U32 },
+	[OVS_DP_ATTR_SAMPLE_LEN] = { .type = NLA_U32 },
 };
 
 static struct genl_family dp_datapath_genl_family = {
@@ -1182,11 +1272,19 @@ static int ovs_dp_cmd_fill_info(struct datapath *dp, struct sk_buff *skb,
 		goto nla_put_failure;
 	get_dp_stats(dp, nla_data(nla));
 
+	nla = nla_reserve(skb, OVS_DP_ATTR_TABLE_STATS,
+			  sizeof(struct ovs_dp_table_stats));
+	if (!nla)
+		goto nla_put_failure;
+	get_dp_table_stats(dp, nla_data(nla));
+
 	NLA_PUT_U32(skb, OVS_DP_ATTR_IPV4_FRAGS,
 		    dp->drop_frags ? OVS_DP_FRAG_DROP : OVS_DP_FRAG_ZERO);
 
 	if (dp->sflow_probability)
 		NLA_PUT_U32(skb, OVS_DP_ATTR_SAMPLING, dp->sflow_probability);
+	if (dp->sflow_sample_len)
+		NLA_PUT_U32(skb, OVS_DP_ATTR_SAMPLE_LEN, dp->sflow_sample_len);
 
 	nla = nla_nest_start(skb, OVS_DP_ATTR_MCGROUPS);
 	if (!nla)
@@ -1259,6 +1357,8 @@ static void change_datapath(struct datapath *dp, struct nlattr *a[OVS_DP_ATTR_MA
 		dp->drop_frags = nla_get_u32(a[OVS_DP_ATTR_IPV4_FRAGS]) == OVS_DP_FRAG_DROP;
 	if (a[OVS_DP_ATTR_SAMPLING])
 		dp->sflow_probability = nla_get_u32(a[OVS_DP_ATTR_SAMPLING]);
+	if (a[OVS_DP_ATTR_SAMPLE_LEN])
+		dp->sflow_sample_len = nla_get_u32(a[OVS_DP_ATTR_SAMPLE_LEN]);
 }
 
 static int ovs_dp_cmd_new(struct sk_buff *skb, struct genl_info *info)
@@ -1511,6 +1611,8 @@ static const struct nla_policy vport_policy[OVS_VPORT_ATTR_MAX + 1] = {
 	[OVS_VPORT_ATTR_ADDRESS] = { .minlen = ETH_ALEN },
 #endif
 	[OVS_VPORT_ATTR_OPTIONS] = { .type = NLA_NESTED },
+	[OVS_VPORT_ATTR_UPCALL_RATE] = { .type = NLA_U32 },
+	[OVS_VPORT_ATTR_UPCALL_BURST] = { .type = NLA_U32 },
 };
 
 static struct genl_family dp_vport_genl_family = {
@@ -1530,6 +1632,8 @@ static int ovs_vport_cmd_fill_info(struct vport *vport, struct sk_buff *skb,
 				   u32 pid, u32 seq, u32 flags, u8 cmd)
 {
 	struct ovs_header *ovs_header;
+	u32 upcall_rate, upcall_burst;
+	u64 upcall_drops;
 	struct nlattr *nla;
 	int ifindex;
 	int err;
@@ -1561,6 +1665,13 @@ static int ovs_vport_cmd_fill_info(struct vport *vport, struct sk_buff *skb,
 	if (ifindex > 0)
 		NLA_PUT_U32(skb, OVS_VPORT_ATTR_IFINDEX, ifindex);
 
+	vport_get_upcall_limit(vport, &upcall_rate, &upcall_burst, &upcall_drops);
+	if (upcall_rate) {
+		NLA_PUT_U32(skb, OVS_VPORT_ATTR_UPCALL_RATE, upcall_rate);
+		NLA_PUT_U32(skb, OVS_VPORT_ATTR_UPCALL_BURST, upcall_burst);
+	}
+	NLA_PUT_U64(skb, OVS_VPORT_ATTR_UPCALL_DROPS, upcall_drops);
+
 	return genlmsg_end(skb, ovs_header);
 
 nla_put_failure:
@@ -1632,6 +1743,16 @@ static int change_vport(struct vport *vport, struct nlattr *a[OVS_VPORT_ATTR_MAX
 	if (a[OVS_VPORT_ATTR_STATS])
 		vport_set_stats(vport, nla_data(a[OVS_VPORT_ATTR_STATS]));
 
+	if (a[OVS_VPORT_ATTR_UPCALL_RATE]) {
+		u32 burst = 0;
+
+		if (a[OVS_VPORT_ATTR_UPCALL_BURST])
+			burst = nla_get_u32(a[OVS_VPORT_ATTR_UPCALL_BURST]);
+		vport_set_upcall_limit(vport,
+				       nla_get_u32(a[OVS_VPORT_ATTR_UPCALL_RATE]),
+				       burst);
+	}
+
 	if (a[OVS_VPORT_ATTR_ADDRESS])
 		err = vport_set_addr(vport, nla_data(a[OVS_VPORT_ATTR_ADDRESS]));
 
@@ -45,7 +45,7 @@ struct vport;
  * been received by the datapath.
  * @n_lost: Number of received packets that had no matching flow in the flow
  * table that could not be sent to userspace (normally due to an overflow in
- * one of the datapath's queues).
+ * one of the datapath's queues or the receiving port's upcall rate limit).
  */
 struct dp_stats_percpu {
 	u64 n_frags;
@@ -64,6 +64,10 @@ struct dp_stats_percpu {
  * @drop_frags: Drop all IP fragments if nonzero.
  * @n_flows: Number of flows currently in flow table.
  * @table: Current flow table.  Protected by genl_lock and RCU.
+ * @n_table_expands: Number of times @table has been replaced by a larger
+ * table.  Protected by genl_lock.
+ * @n_table_shrinks: Number of times @table has been replaced by a smaller
+ * table.  Protected by genl_lock.
  * @ports: Map from port number to &struct vport.  %OVSP_LOCAL port
  * always exists, other ports may be %NULL.  Protected by RTNL and RCU.
  * @port_list: List of all ports in @ports in arbitrary order.  RTNL required
@@ -72,6 +76,8 @@ struct dp_stats_percpu {
  * @sflow_probability: Number of packets out of UINT_MAX to sample to the
  * %OVS_PACKET_CMD_SAMPLE multicast group, e.g. (@sflow_probability/UINT_MAX)
  * is the probability of sampling a given packet.
+ * @sflow_sample_len: Maximum number of bytes of each sampled packet to send
+ * to userspace, or 0 to send entire packets.
  *
  * Context: See the comment on locking at the top of datapath.c for additional
  * locking information.
@@ -86,6 +92,8 @@ struct datapath {
 
 	/* Flow table. */
 	struct flow_table __rcu *table;
+	u64 n_table_expands;
+	u64 n_table_shrinks;
 
 	/* Switch ports. */
 	struct vport __rcu *ports[DP_MAX_PORTS];
@@ -96,6 +104,7 @@ struct datapath {
 
 	/* sFlow Sampling */
 	unsigned int sflow_probability;
+	u32 sflow_sample_len;
 };
 
 /**
@@ -133,6 +142,8 @@ struct ovs_skb_cb {
  * @sample_pool: Becomes %OVS_PACKET_ATTR_SAMPLE_POOL if nonzero.
  * @actions: Becomes %OVS_PACKET_ATTR_ACTIONS if nonnull.
  * @actions_len: Number of bytes in @actions.
+ * @trunc_len: If nonzero, at most this many bytes of packet data are sent to
+ * userspace, and a longer packet's full length becomes %OVS_PACKET_ATTR_LEN.
 */
 struct dp_upcall_info {
 	u8 cmd;
@@ -141,6 +152,7 @@ struct dp_upcall_info {
 	u32 sample_pool;
 	const struct nlattr *actions;
 	u32 actions_len;
+	u32 trunc_len;
 };
 
 extern struct notifier_block dp_device_notifier;
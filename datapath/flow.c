@@ -19,6 +19,7 @@
 #include <linux/jiffies.h>
 #include <linux/llc.h>
 #include <linux/module.h>
+#include <linux/percpu.h>
 #include <linux/in.h>
 #include <linux/rcupdate.h>
 #include <linux/if_arp.h>
@@ -38,7 +39,6 @@
 #include "vlan.h"
 
 static struct kmem_cache *flow_cache;
-static unsigned int hash_seed __read_mostly;
 
 static int check_header(struct sk_buff *skb, int len)
 {
@@ -165,6 +165,7 @@ static bool icmp6hdr_ok(struct sk_buff *skb)
 
 void flow_used(struct sw_flow *flow, struct sk_buff *skb)
 {
+	struct flow_stats_percpu *stats;
 	u8 tcp_flags = 0;
 
 	if (flow->key.eth.type == htons(ETH_P_IP) &&
@@ -173,12 +174,65 @@ void flow_used(struct sw_flow *flow, struct sk_buff *skb)
 		tcp_flags = *(tcp + TCP_FLAGS_OFFSET) & TCP_FLAG_MASK;
 	}
 
-	spin_lock_bh(&flow->lock);
-	flow->used = jiffies;
-	flow->packet_count++;
-	flow->byte_count += skb->len;
-	flow->tcp_flags |= tcp_flags;
-	spin_unlock_bh(&flow->lock);
+	local_bh_disable();
+	stats = per_cpu_ptr(flow->stats, smp_processor_id());
+
+	spin_lock(&stats->lock);
+	stats->used = jiffies;
+	stats->packet_count++;
+	stats->byte_count += skb->len;
+	stats->tcp_flags |= tcp_flags;
+	spin_unlock(&stats->lock);
+
+	local_bh_enable();
+}
+
+/* Sums up the per-CPU statistics for 'flow' into '*stats', '*used' (the most
+ * recent time used, in jiffies, or 0 if never used), and '*tcp_flags'. */
+void flow_stats_get(const struct sw_flow *flow, struct ovs_flow_stats *stats,
+		    unsigned long *used, u8 *tcp_flags)
+{
+	int i;
+
+	stats->n_packets = stats->n_bytes = 0;
+	*used = 0;
+	*tcp_flags = 0;
+	for_each_possible_cpu(i) {
+		struct flow_stats_percpu *percpu_stats;
+		struct flow_stats_percpu local_stats;
+
+		percpu_stats = per_cpu_ptr(flow->stats, i);
+
+		spin_lock_bh(&percpu_stats->lock);
+		local_stats = *percpu_stats;
+		spin_unlock_bh(&percpu_stats->lock);
+
+		if (!local_stats.packet_count)
+			continue;
+		stats->n_packets += local_stats.packet_count;
+		stats->n_bytes += local_stats.byte_count;
+		if (!*used || time_after(local_stats.used, *used))
+			*used = local_stats.used;
+		*tcp_flags |= local_stats.tcp_flags;
+	}
+}
+
+/* Resets the statistics for 'flow' to zero.  A packet that arrives on another
+ * CPU during the reset may or may not be counted. */
+void flow_stats_clear(struct sw_flow *flow)
+{
+	int i;
+
+	for_each_possible_cpu(i) {
+		struct flow_stats_percpu *stats = per_cpu_ptr(flow->stats, i);
+
+		spin_lock_bh(&stats->lock);
+		stats->used = 0;
+		stats->packet_count = 0;
+		stats->byte_count = 0;
+		stats->tcp_flags = 0;
+		spin_unlock_bh(&stats->lock);
+	}
 }
 
 struct sw_flow_actions *flow_actions_alloc(const struct nlattr *actions)
@@ -209,18 +263,41 @@ struct sw_flow *flow_alloc(void)
 	if (!flow)
 		return ERR_PTR(-ENOMEM);
 
-	spin_lock_init(&flow->lock);
+	flow->stats = NULL;
 	atomic_set(&flow->refcnt, 1);
 	flow->sf_acts = NULL;
 	flow->dead = false;
+	INIT_HLIST_NODE(&flow->hash_node[0]);
+	INIT_HLIST_NODE(&flow->hash_node[1]);
 
 	return flow;
 }
 
+/* Allocates the per-CPU statistics for 'flow', which is required before
+ * 'flow' goes into a flow table.  A flow built only to execute a single packet
+ * never needs them. */
+int flow_alloc_stats(struct sw_flow *flow)
+{
+	int i;
+
+	flow->stats = alloc_percpu(struct flow_stats_percpu);
+	if (!flow->stats)
+		return -ENOMEM;
+
+	for_each_possible_cpu(i)
+		spin_lock_init(&per_cpu_ptr(flow->stats, i)->lock);
+
+	return 0;
+}
+
+static unsigned int bucket_index(const struct flow_table *table, u32 hash)
+{
+	return hash & (table->n_buckets - 1);
+}
+
 static struct hlist_head __rcu *find_bucket(struct flow_table * table, u32 hash)
 {
-	return flex_array_get(table->buckets,
-				(hash & (table->n_buckets - 1)));
+	return flex_array_get(table->buckets, bucket_index(table, hash));
 }
 
 static struct flex_array  __rcu *alloc_buckets(unsigned int n_buckets)
@@ -266,6 +343,12 @@ struct flow_table *flow_tbl_alloc(int new_size)
 	}
 	table->n_buckets = new_size;
 	table->count = 0;
+	table->node_ver = 0;
+	get_random_bytes(&table->hash_seed, sizeof(table->hash_seed));
+	table->rehash = NULL;
+	table->rehash_pos = 0;
+	table->keep_flows = false;
+	atomic_set(&table->nodes_state, TBL_NODES_FREE);
 
 	return table;
 }
@@ -276,20 +359,26 @@ static void flow_free(struct sw_flow *flow)
 	flow_put(flow);
 }
 
-void flow_tbl_destroy(struct flow_table *table)
+static void __flow_tbl_destroy(struct flow_table *table)
 {
+	int ver;
 	int i;
 
-	if (!table)
-		return;
+	/* A partially filled replacement table was never visible to readers
+	 * and shares its flows with 'table'. */
+	if (table->rehash) {
+		table->rehash->keep_flows = true;
+		flow_tbl_destroy(table->rehash);
+	}
 
-	for (i = 0; i < table->n_buckets; i++) {
+	ver = table->node_ver;
+	for (i = 0; !table->keep_flows && i < table->n_buckets; i++) {
 		struct sw_flow *flow;
 		struct hlist_head *head = flex_array_get(table->buckets, i);
 		struct hlist_node *node, *n;
 
-		hlist_for_each_entry_safe(flow, node, n, head, hash_node) {
-			hlist_del_init_rcu(&flow->hash_node);
+		hlist_for_each_entry_safe(flow, node, n, head, hash_node[ver]) {
+			hlist_del_init_rcu(&flow->hash_node[ver]);
 			flow_free(flow);
 		}
 	}
@@ -298,6 +387,21 @@ void flow_tbl_destroy(struct flow_table *table)
 	kfree(table);
 }
 
+/* Frees 'table', which readers must no longer be able to see.  If the RCU
+ * callback queued by flow_tbl_wait_nodes() is still pending, it frees 'table'
+ * instead. */
+void flow_tbl_destroy(struct flow_table *table)
+{
+	if (!table)
+		return;
+
+	if (atomic_cmpxchg(&table->nodes_state, TBL_NODES_BUSY,
+			   TBL_NODES_DEAD) == TBL_NODES_BUSY)
+		return;
+
+	__flow_tbl_destroy(table);
+}
+
 static void flow_tbl_destroy_rcu_cb(struct rcu_head *rcu)
 {
 	struct flow_table *table = container_of(rcu, struct flow_table, rcu);
@@ -305,6 +409,27 @@ static void flow_tbl_destroy_rcu_cb(struct rcu_head *rcu)
 	flow_tbl_destroy(table);
 }
 
+static void flow_tbl_nodes_rcu_cb(struct rcu_head *rcu)
+{
+	struct flow_table *table = container_of(rcu, struct flow_table,
+						nodes_rcu);
+
+	if (atomic_cmpxchg(&table->nodes_state, TBL_NODES_BUSY,
+			   TBL_NODES_FREE) == TBL_NODES_DEAD)
+		__flow_tbl_destroy(table);
+}
+
+/* Called just after 'table' replaces the table that it was rehashed from.
+ * Until RCU readers of the replaced table are done, the flows' nodes with the
+ * other 'node_ver' are still in use, so 'table' may not start a resize of its
+ * own.  Rather than waiting for them here, we postpone that resize until an
+ * RCU callback marks those nodes free. */
+void flow_tbl_wait_nodes(struct flow_table *table)
+{
+	atomic_set(&table->nodes_state, TBL_NODES_BUSY);
+	call_rcu(&table->nodes_rcu, flow_tbl_nodes_rcu_cb);
+}
+
 void flow_tbl_deferred_destroy(struct flow_table *table)
 {
         if (!table)
@@ -318,12 +443,14 @@ struct sw_flow *flow_tbl_next(struct flow_table *table, u32 *bucket, u32 *last)
 	struct sw_flow *flow;
 	struct hlist_head *head;
 	struct hlist_node *n;
+	int ver;
 	int i;
 
+	ver = table->node_ver;
 	while (*bucket < table->n_buckets) {
 		i = 0;
 		head = flex_array_get(table->buckets, *bucket);
-		hlist_for_each_entry_rcu(flow, n, head, hash_node) {
+		hlist_for_each_entry_rcu(flow, n, head, hash_node[ver]) {
 			if (i < *last) {
 				i++;
 				continue;
@@ -338,32 +465,6 @@ struct sw_flow *flow_tbl_next(struct flow_table *table, u32 *bucket, u32 *last)
 	return NULL;
 }
 
-struct flow_table *flow_tbl_expand(struct flow_table *table)
-{
-	struct flow_table *new_table;
-	int n_buckets = table->n_buckets * 2;
-	int i;
-
-	new_table = flow_tbl_alloc(n_buckets);
-	if (!new_table)
-		return ERR_PTR(-ENOMEM);
-
-	for (i = 0; i < table->n_buckets; i++) {
-		struct sw_flow *flow;
-		struct hlist_head *head;
-		struct hlist_node *n, *pos;
-
-		head = flex_array_get(table->buckets, i);
-
-		hlist_for_each_entry_safe(flow, n, pos, head, hash_node) {
-			hlist_del_init_rcu(&flow->hash_node);
-			flow_tbl_insert(new_table, flow);
-		}
-	}
-
-	return new_table;
-}
-
 /* RCU callback used by flow_deferred_free. */
 static void rcu_free_flow_callback(struct rcu_head *rcu)
 {
@@ -392,6 +493,7 @@ void flow_put(struct sw_flow *flow)
 
 	if (atomic_dec_and_test(&flow->refcnt)) {
 		kfree((struct sf_flow_acts __force *)flow->sf_acts);
+		free_percpu(flow->stats);
 		kmem_cache_free(flow_cache, flow);
 	}
 }
@@ -724,9 +826,9 @@ out:
 	return error;
 }
 
-u32 flow_hash(const struct sw_flow_key *key, int key_len)
+static u32 flow_hash(const struct sw_flow_key *key, int key_len, u32 seed)
 {
-	return jhash2((u32*)key, DIV_ROUND_UP(key_len, sizeof(u32)), hash_seed);
+	return jhash2((u32*)key, DIV_ROUND_UP(key_len, sizeof(u32)), seed);
 }
 
 struct sw_flow * flow_tbl_lookup(struct flow_table *table,
@@ -735,14 +837,16 @@ struct sw_flow * flow_tbl_lookup(struct flow_table *table,
 	struct sw_flow *flow;
 	struct hlist_node *n;
 	struct hlist_head *head;
+	int ver;
 	u32 hash;
 
-	hash = flow_hash(key, key_len);
+	hash = flow_hash(key, key_len, table->hash_seed);
 
+	ver = table->node_ver;
 	head = find_bucket(table, hash);
-	hlist_for_each_entry_rcu(flow, n, head, hash_node) {
+	hlist_for_each_entry_rcu(flow, n, head, hash_node[ver]) {
 
-		if (flow->hash == hash &&
+		if (flow->hash[ver] == hash &&
 		    !memcmp(&flow->key, key, key_len)) {
 			return flow;
 		}
@@ -750,24 +854,114 @@ struct sw_flow * flow_tbl_lookup(struct flow_table *table,
 	return NULL;
 }
 
-void flow_tbl_insert(struct flow_table *table, struct sw_flow *flow)
+static void __flow_tbl_insert(struct flow_table *table, struct sw_flow *flow)
 {
+	int ver = table->node_ver;
 	struct hlist_head *head;
 
-	head = find_bucket(table, flow->hash);
-	hlist_add_head_rcu(&flow->hash_node, head);
+	flow->hash[ver] = flow_hash(&flow->key, flow->key_len, table->hash_seed);
+	head = find_bucket(table, flow->hash[ver]);
+	hlist_add_head_rcu(&flow->hash_node[ver], head);
 	table->count++;
 }
 
+/* Returns true if 'flow', which must be in 'table', has also been added to the
+ * table that is replacing 'table'. */
+static bool flow_tbl_rehashed(const struct flow_table *table,
+			      const struct sw_flow *flow)
+{
+	return (table->rehash &&
+		bucket_index(table, flow->hash[table->node_ver]) < table->rehash_pos);
+}
+
+/* Inserts 'flow', whose 'key' and 'key_len' must be initialized, into
+ * 'table'.  Must be called with genl_mutex. */
+void flow_tbl_insert(struct flow_table *table, struct sw_flow *flow)
+{
+	__flow_tbl_insert(table, flow);
+	if (flow_tbl_rehashed(table, flow))
+		__flow_tbl_insert(table->rehash, flow);
+}
+
+/* Removes 'flow' from 'table'.  Must be called with genl_mutex. */
 void flow_tbl_remove(struct flow_table *table, struct sw_flow *flow)
 {
-	if (!hlist_unhashed(&flow->hash_node)) {
-		hlist_del_init_rcu(&flow->hash_node);
+	int ver = table->node_ver;
+
+	if (!hlist_unhashed(&flow->hash_node[ver])) {
+		if (flow_tbl_rehashed(table, flow)) {
+			hlist_del_rcu(&flow->hash_node[!ver]);
+			table->rehash->count--;
+		}
+		hlist_del_init_rcu(&flow->hash_node[ver]);
 		table->count--;
 		BUG_ON(table->count < 0);
 	}
 }
 
+/* Starts resizing 'table' to 'new_size' buckets.  Returns 0 if successful,
+ * -EBUSY if 'table' cannot be resized until an RCU grace period has passed
+ * (see flow_tbl_wait_nodes()), otherwise a negative error code.
+ *
+ * Resizing happens incrementally: each call to flow_tbl_rehash_step() copies
+ * a few more buckets' worth of flows into the new table.  Meanwhile, readers
+ * keep using 'table', and flow_tbl_insert() and flow_tbl_remove() keep both
+ * tables up to date.
+ *
+ * Must be called with genl_mutex, and not while 'table' is being resized. */
+int flow_tbl_rehash_start(struct flow_table *table, int new_size)
+{
+	struct flow_table *new_table;
+
+	BUG_ON(table->rehash);
+
+	if (atomic_read(&table->nodes_state) != TBL_NODES_FREE)
+		return -EBUSY;
+
+	new_table = flow_tbl_alloc(new_size);
+	if (!new_table)
+		return -ENOMEM;
+	new_table->node_ver = !table->node_ver;
+
+	table->rehash = new_table;
+	table->rehash_pos = 0;
+	return 0;
+}
+
+/* Copies the flows in up to 'n_buckets' more buckets of 'table', which must be
+ * being resized, into its replacement.  If that completes the resize, returns
+ * the replacement table, which the caller must publish in place of 'table'
+ * and then destroy 'table' after an RCU grace period.  Otherwise, returns
+ * NULL.
+ *
+ * Must be called with genl_mutex. */
+struct flow_table *flow_tbl_rehash_step(struct flow_table *table,
+					unsigned int n_buckets)
+{
+	struct flow_table *new_table = table->rehash;
+	unsigned int end;
+	int ver;
+
+	end = min(table->rehash_pos + n_buckets, table->n_buckets);
+	ver = table->node_ver;
+	for (; table->rehash_pos < end; table->rehash_pos++) {
+		struct hlist_head *head;
+		struct hlist_node *n;
+		struct sw_flow *flow;
+
+		head = flex_array_get(table->buckets, table->rehash_pos);
+		hlist_for_each_entry(flow, n, head, hash_node[ver])
+			__flow_tbl_insert(new_table, flow);
+	}
+
+	if (table->rehash_pos < table->n_buckets)
+		return NULL;
+
+	table->rehash = NULL;
+	table->keep_flows = true;
+	return new_table;
+}
+
 /* The size of the argument for each %OVS_KEY_ATTR_* Netlink attribute.  */
 static const u32 key_lens[OVS_KEY_ATTR_MAX + 1] = {
 	[OVS_KEY_ATTR_TUN_ID] = 8,
@@ -1256,8 +1450,6 @@ int flow_init(void)
 	if (flow_cache == NULL)
 		return -ENOMEM;
 
-	get_random_bytes(&hash_seed, sizeof(hash_seed));
-
 	return 0;
 }
 
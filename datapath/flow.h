@@ -11,6 +11,7 @@
 
 #include <linux/kernel.h>
 #include <linux/netlink.h>
+#include <linux/percpu.h>
 #include <linux/spinlock.h>
 #include <linux/types.h>
 #include <linux/rcupdate.h>
@@ -77,22 +78,30 @@ struct sw_flow_key {
 	};
 };
 
+/* Statistics for a flow on a single CPU.  A flow with heavy traffic that is
+ * spread across CPUs, e.g. by RSS, would otherwise bounce a single set of
+ * counters (and the lock protecting them) between the CPUs' caches. */
+struct flow_stats_percpu {
+	unsigned long used;	/* Last used time (in jiffies). */
+	u64 packet_count;	/* Number of packets matched. */
+	u64 byte_count;		/* Number of bytes matched. */
+	u8 tcp_flags;		/* Union of seen TCP flags. */
+	spinlock_t lock;	/* Taken remotely only by get and clear. */
+};
+
 struct sw_flow {
 	struct rcu_head rcu;
-	struct hlist_node  hash_node;
-	u32 hash;
+	struct hlist_node hash_node[2];	/* Indexed by flow_table 'node_ver'. */
+	u32 hash[2];			/* Indexed by flow_table 'node_ver'. */
 
 	struct sw_flow_key key;
+	int key_len;			/* Significant bytes in 'key'. */
 	struct sw_flow_actions __rcu *sf_acts;
 
 	atomic_t refcnt;
 	bool dead;
 
-	spinlock_t lock;	/* Lock for values below. */
-	unsigned long used;	/* Last used time (in jiffies). */
-	u64 packet_count;	/* Number of packets matched. */
-	u64 byte_count;		/* Number of bytes matched. */
-	u8 tcp_flags;		/* Union of seen TCP flags. */
+	struct flow_stats_percpu __percpu *stats; /* NULL if not in a table. */
 };
 
 struct arp_eth_header
@@ -114,6 +123,7 @@ int flow_init(void);
 void flow_exit(void);
 
 struct sw_flow *flow_alloc(void);
+int flow_alloc_stats(struct sw_flow *);
 void flow_deferred_free(struct sw_flow *);
 
 struct sw_flow_actions *flow_actions_alloc(const struct nlattr *);
@@ -125,6 +135,9 @@ void flow_put(struct sw_flow *);
 int flow_extract(struct sk_buff *, u16 in_port, struct sw_flow_key *,
 		 int *key_lenp, bool *is_frag);
 void flow_used(struct sw_flow *, struct sk_buff *);
+void flow_stats_get(const struct sw_flow *, struct ovs_flow_stats *,
+		    unsigned long *used, u8 *tcp_flags);
+void flow_stats_clear(struct sw_flow *);
 u64 flow_used_time(unsigned long flow_jiffies);
 
 /* Upper bound on the length of a nlattr-formatted flow key.  The longest
@@ -153,10 +166,53 @@ int flow_metadata_from_nlattrs(u16 *in_port, __be64 *tun_id,
 
 #define TBL_MIN_BUCKETS		1024
 
+/* Number of buckets that each call to flow_tbl_rehash_step() moves from a
+ * flow table into the table that will replace it. */
+#define TBL_REHASH_STEP		16
+
+/* Whether the flows' nodes that a flow table does not use, that is, those
+ * with the other 'node_ver', might still be in use by RCU readers of the table
+ * that it replaced. */
+enum {
+	TBL_NODES_FREE,		/* No, the table may be resized. */
+	TBL_NODES_BUSY,		/* Yes, RCU callback pending. */
+	TBL_NODES_DEAD		/* Yes, and the RCU callback frees the table. */
+};
+
+/**
+ * struct flow_table - hash table of &struct sw_flow.
+ * @buckets: Array of @n_buckets hlist_heads.
+ * @count: Number of flows in the table.
+ * @n_buckets: Number of buckets, a power of 2.
+ * @rcu: RCU callback head for deferred destruction.
+ * @node_ver: Index into each flow's @hash_node and @hash used by this table.
+ * A table and the table that replaces it when it is resized use different
+ * indexes, so that a flow can be in both at once.
+ * @hash_seed: Seed for hashing flow keys, chosen at random for each table, so
+ * that keys crafted to collide in one table do not also collide in the table
+ * that replaces it.
+ * @rehash: While the table is being resized, the table that will replace it.
+ * Readers only see the old table until the resize is complete.
+ * @rehash_pos: While the table is being resized, the number of its buckets
+ * whose flows have been added to @rehash.
+ * @keep_flows: If true, destroying the table does not free its flows, because
+ * they have moved to another table.
+ * @nodes_rcu: RCU callback head for flow_tbl_wait_nodes().
+ * @nodes_state: One of the TBL_NODES_* values.
+ *
+ * @rehash and @rehash_pos are protected by genl_mutex.
+ */
 struct flow_table {
         struct flex_array *buckets;
         unsigned int count, n_buckets;
         struct rcu_head rcu;
+	int node_ver;
+	u32 hash_seed;
+	struct flow_table *rehash;
+	unsigned int rehash_pos;
+	bool keep_flows;
+	struct rcu_head nodes_rcu;
+	atomic_t nodes_state;
 };
 
 static inline int flow_tbl_count(struct flow_table *table)
@@ -169,15 +225,23 @@ static inline int flow_tbl_need_to_expand(struct flow_table *table)
 	return (table->count > table->n_buckets);
 }
 
+static inline int flow_tbl_need_to_shrink(struct flow_table *table)
+{
+	return (table->n_buckets > TBL_MIN_BUCKETS &&
+		table->count < table->n_buckets / 4);
+}
+
 struct sw_flow *flow_tbl_lookup(struct flow_table *table,
 				struct sw_flow_key *key,    int len);
 void flow_tbl_destroy(struct flow_table *table);
 void flow_tbl_deferred_destroy(struct flow_table *table);
+void flow_tbl_wait_nodes(struct flow_table *table);
 struct flow_table *flow_tbl_alloc(int new_size);
-struct flow_table *flow_tbl_expand(struct flow_table *table);
+int flow_tbl_rehash_start(struct flow_table *table, int new_size);
+struct flow_table *flow_tbl_rehash_step(struct flow_table *table,
+					unsigned int n_buckets);
 void flow_tbl_insert(struct flow_table *table, struct sw_flow *flow);
 void flow_tbl_remove(struct flow_table *table, struct sw_flow *flow);
-u32 flow_hash(const struct sw_flow_key *key, int key_len);
 
 struct sw_flow *flow_tbl_next(struct flow_table *table, u32 *bucket, u32 *idx);
 
@@ -16,4 +16,8 @@
 
 #endif /* linux kernel < 2.6.30 */
 
+#ifndef ETH_P_SLOW
+#define ETH_P_SLOW	0x8809          /* Slow Protocol. See 802.3ad 43B */
+#endif
+
 #endif
@@ -1009,11 +1009,72 @@ static inline bool need_linearize(const struct sk_buff *skb)
 	return false;
 }
 
+/* Computes 'skb''s partial checksum in software. */
+static int tnl_checksum_help(struct sk_buff *skb)
+{
+	int err;
+
+	/* Pages aren't locked and could change at any time.  If this happens
+	 * after we compute the checksum, the checksum will be wrong.  We
+	 * linearize now to avoid this problem.
+	 */
+	if (unlikely(need_linearize(skb))) {
+		err = __skb_linearize(skb);
+		if (unlikely(err))
+			return err;
+	}
+
+	return skb_checksum_help(skb);
+}
+
+/*
+ * Returns the features of the device that 'rt' transmits on that may be used
+ * to segment and checksum packets encapsulated according to 'mutable', or 0
+ * if both must be done in software before encapsulation.
+ *
+ * The kernels we support can't segment a packet inside a tunnel header, so
+ * GSO packets are always segmented before encapsulation.  However, a device
+ * that checksums from csum_start and csum_offset, rather than by parsing
+ * headers, still computes the inner checksum correctly after we push the
+ * tunnel header.  That lets segmentation share pages with the original skb
+ * rather than copying and checksumming each segment, and lets other packets
+ * skip linearization.  Tunnels that checksum their own payload need the
+ * inner checksum to be final first, and so does a route through an OVS
+ * internal device, since we cannot tell which device will transmit it.
+ */
+static u32 tnl_offload_features(const struct tnl_mutable_config *mutable,
+				const struct rtable *rt)
+{
+#ifdef NEED_CSUM_NORMALIZE
+	return 0;
+#else
+	struct net_device *dev = rt_dst(rt).dev;
+	u32 features = dev->features;
+
+	/*
+	 * An OVS internal device advertises every offload, but the packet
+	 * is really transmitted by whatever port the bridge forwards it to,
+	 * which might not checksum at all.
+	 */
+	if (internal_dev_get_vport(dev))
+		return 0;
+
+	if (mutable->flags & TNL_F_CSUM ||
+	    !(features & (NETIF_F_HW_CSUM | NETIF_F_NO_CSUM)))
+		return 0;
+
+	return features & (NETIF_F_SG | NETIF_F_HW_CSUM | NETIF_F_NO_CSUM);
+#endif
+}
+
 static struct sk_buff *handle_offloads(struct sk_buff *skb,
 				       const struct tnl_mutable_config *mutable,
 				       const struct rtable *rt)
 {
+	struct sk_buff *nskb;
 	int min_headroom;
+	u32 features;
+	int mtu;
 	int err;
 
 	min_headroom = LL_RESERVED_SPACE(rt_dst(rt).dev) + rt_dst(rt).header_len
@@ -1032,10 +1093,9 @@ static struct sk_buff *handle_offloads(struct sk_buff *skb,
 
 	forward_ip_summed(skb, true);
 
+	features = tnl_offload_features(mutable, rt);
 	if (skb_is_gso(skb)) {
-		struct sk_buff *nskb;
-
-		nskb = skb_gso_segment(skb, 0);
+		nskb = skb_gso_segment(skb, features);
 		if (IS_ERR(nskb)) {
 			kfree_skb(skb);
 			err = PTR_ERR(nskb);
@@ -1044,29 +1104,30 @@ static struct sk_buff *handle_offloads(struct sk_buff *skb,
 
 		consume_skb(skb);
 		skb = nskb;
-	} else if (get_ip_summed(skb) == OVS_CSUM_PARTIAL) {
-		/* Pages aren't locked and could change at any time.
-		 * If this happens after we compute the checksum, the
-		 * checksum will be wrong.  We linearize now to avoid
-		 * this problem.
-		 */
-		if (unlikely(need_linearize(skb))) {
-			err = __skb_linearize(skb);
+	}
+
+	/*
+	 * Packets that the device will checksum keep their partial checksums,
+	 * unless they will be fragmented after encapsulation, since
+	 * fragmentation needs the final checksum.
+	 */
+	mtu = dst_mtu(&rt_dst(rt));
+	for (nskb = skb; nskb; nskb = nskb->next) {
+		if (get_ip_summed(nskb) == OVS_CSUM_PARTIAL) {
+			if (features && nskb->len + mutable->tunnel_hlen <= mtu)
+				continue;
+
+			err = tnl_checksum_help(nskb);
 			if (unlikely(err))
 				goto error_free;
 		}
-
-		err = skb_checksum_help(skb);
-		if (unlikely(err))
-			goto error_free;
+		set_ip_summed(nskb, OVS_CSUM_NONE);
 	}
 
-	set_ip_summed(skb, OVS_CSUM_NONE);
-
 	return skb;
 
 error_free:
-	kfree_skb(skb);
+	tnl_free_linked_skbs(skb);
 error:
 	return ERR_PTR(err);
 }
@@ -189,6 +189,7 @@ struct vport *vport_alloc(int priv_size, const struct vport_ops *ops, const stru
 		return ERR_PTR(-ENOMEM);
 
 	spin_lock_init(&vport->stats_lock);
+	spin_lock_init(&vport->upcall_limit.lock);
 
 	return vport;
 }
@@ -326,6 +327,38 @@ void vport_set_stats(struct vport *vport, struct ovs_vport_stats *stats)
 	spin_unlock_bh(&vport->stats_lock);
 }
 
+/**
+ *	vport_set_upcall_limit - limit rate of flow miss upcalls
+ *
+ * @vport: vport on which to limit upcalls
+ * @rate: sustained number of upcalls per second, or 0 for no limit
+ * @burst: number of upcalls allowed in a burst, or 0 to allow one second's
+ * worth
+ *
+ * Limits the rate at which packets received on @vport that do not match any
+ * flow are sent to userspace.  Packets that exceed the limit are dropped,
+ * except for control protocol frames (see vport_upcall_admit()).  The bucket
+ * starts out full.
+ *
+ * Must be called with RTNL lock.
+ */
+void vport_set_upcall_limit(struct vport *vport, u32 rate, u32 burst)
+{
+	struct vport_upcall_limit *limit = &vport->upcall_limit;
+
+	ASSERT_RTNL();
+
+	if (!burst)
+		burst = rate;
+
+	spin_lock_bh(&limit->lock);
+	limit->rate = rate;
+	limit->burst = burst;
+	limit->tokens = (u64)burst * HZ;
+	limit->last = jiffies;
+	spin_unlock_bh(&limit->lock);
+}
+
 /**
  *	vport_get_name - retrieve device name
  *
@@ -436,6 +469,28 @@ void vport_get_stats(struct vport *vport, struct ovs_vport_stats *stats)
 	}
 }
 
+/**
+ *	vport_get_upcall_limit - retrieve upcall limit and drop count
+ *
+ * @vport: vport from which to retrieve the limit
+ * @rate: location to store the upcall rate limit, 0 if unlimited
+ * @burst: location to store the upcall burst size
+ * @n_dropped: location to store the number of upcalls dropped by the limit
+ *
+ * Must be called with RTNL lock or rcu_read_lock.
+ */
+void vport_get_upcall_limit(struct vport *vport, u32 *rate, u32 *burst,
+			    u64 *n_dropped)
+{
+	struct vport_upcall_limit *limit = &vport->upcall_limit;
+
+	spin_lock_bh(&limit->lock);
+	*rate = limit->rate;
+	*burst = limit->burst;
+	*n_dropped = limit->n_dropped;
+	spin_unlock_bh(&limit->lock);
+}
+
 /**
  *	vport_get_flags - retrieve device flags
  *
@@ -609,6 +664,76 @@ int vport_send(struct vport *vport, struct sk_buff *skb)
 	return sent;
 }
 
+#ifndef ETH_P_CFM
+#define ETH_P_CFM	0x8902		/* 802.1ag Connectivity Fault Mgmt */
+#endif
+
+/* Returns true if 'key' is for a link-layer control protocol frame, which
+ * userspace needs to keep links and bonds up however busy the port is: frames
+ * sent to an IEEE 802.1D reserved group address (STP BPDUs, LACP and other
+ * slow protocols, LLDP), or 802.1ag CFM frames, which Open vSwitch may send
+ * to a non-reserved address. */
+static bool is_control_frame(const struct sw_flow_key *key)
+{
+	static const u8 reserved_addr[ETH_ALEN - 1] = {
+		0x01, 0x80, 0xc2, 0x00, 0x00
+	};
+
+	return ((!memcmp(key->eth.dst, reserved_addr, sizeof(reserved_addr)) &&
+		 !(key->eth.dst[ETH_ALEN - 1] & 0xf0)) ||
+		key->eth.type == htons(ETH_P_SLOW) ||
+		key->eth.type == htons(ETH_P_CFM));
+}
+
+/**
+ *	vport_upcall_admit - apply upcall rate limit to a flow miss
+ *
+ * @vport: vport on which the packet was received
+ * @key: flow key extracted from the packet
+ *
+ * Returns true if the packet with the given @key, received on @vport, that
+ * did not match any flow may be sent to userspace.  Returns false, and counts
+ * the packet as dropped, if it would exceed @vport's upcall rate limit.
+ * Control protocol frames are always admitted and do not consume tokens.
+ */
+bool vport_upcall_admit(struct vport *vport, const struct sw_flow_key *key)
+{
+	struct vport_upcall_limit *limit = &vport->upcall_limit;
+	unsigned long now;
+	bool admit;
+
+	if (likely(!limit->rate) || is_control_frame(key))
+		return true;
+
+	spin_lock_bh(&limit->lock);
+
+	now = jiffies;
+	if (now != limit->last) {
+		u64 max_tokens = (u64)limit->burst * HZ;
+		u64 refill;
+
+		refill = (u64)min_t(unsigned long, now - limit->last, UINT_MAX)
+			 * limit->rate;
+		if (refill >= max_tokens - limit->tokens)
+			limit->tokens = max_tokens;
+		else
+			limit->tokens += refill;
+		limit->last = now;
+	}
+
+	admit = limit->tokens >= HZ;
+	if (admit)
+		limit->tokens -= HZ;
+	else
+		limit->n_dropped++;
+
+	spin_unlock_bh(&limit->lock);
+
+	if (!admit)
+		vport_record_error(vport, VPORT_E_RX_DROPPED);
+	return admit;
+}
+
 /**
  *	vport_record_error - indicate device error to generic stats layer
  *
@@ -32,6 +32,7 @@ struct vport *vport_locate(const char *name);
 
 int vport_set_addr(struct vport *, const unsigned char *);
 void vport_set_stats(struct vport *, struct ovs_vport_stats *);
+void vport_set_upcall_limit(struct vport *, u32 rate, u32 burst);
 
 const char *vport_get_name(const struct vport *);
 enum ovs_vport_type vport_get_type(const struct vport *);
@@ -39,6 +40,8 @@ const unsigned char *vport_get_addr(const struct vport *);
 
 struct kobject *vport_get_kobj(const struct vport *);
 void vport_get_stats(struct vport *, struct ovs_vport_stats *);
+void vport_get_upcall_limit(struct vport *, u32 *rate, u32 *burst,
+			    u64 *n_dropped);
 
 unsigned vport_get_flags(const struct vport *);
 int vport_is_running(const struct vport *);
@@ -53,6 +56,8 @@ int vport_get_options(const struct vport *, struct sk_buff *);
 
 int vport_send(struct vport *, struct sk_buff *);
 
+bool vport_upcall_admit(struct vport *, const struct sw_flow_key *);
+
 /* The following definitions are for implementers of vport devices: */
 
 struct vport_percpu_stats {
@@ -70,6 +75,25 @@ struct vport_err_stats {
 	u64 tx_errors;
 };
 
+/**
+ * struct vport_upcall_limit - token bucket limiting a vport's flow miss upcalls
+ * @lock: Protects all of the members.
+ * @rate: Sustained number of upcalls allowed per second, or 0 for no limit.
+ * @burst: Number of upcalls allowed in a burst.
+ * @tokens: Upcalls currently allowed, in units of 1/HZ upcall, so that each
+ * jiffy adds exactly @rate units.  At most @burst * HZ.
+ * @last: Time, in jiffies, at which @tokens was last refilled.
+ * @n_dropped: Number of upcalls dropped because the bucket was empty.
+ */
+struct vport_upcall_limit {
+	spinlock_t lock;
+	u32 rate;
+	u32 burst;
+	u64 tokens;
+	unsigned long last;
+	u64 n_dropped;
+};
+
 /**
  * struct vport - one port within a datapath
  * @rcu: RCU callback head for deferred destruction.
@@ -87,6 +111,8 @@ struct vport_err_stats {
  * @percpu_stats: Points to per-CPU statistics used and maintained by vport
  * @stats_lock: Protects @err_stats and @offset_stats.
  * @err_stats: Points to error statistics used and maintained by vport
+ * @upcall_limit: Limits the rate at which packets received on this port that
+ * miss in the flow table are sent to userspace.
  * @offset_stats: Added to actual statistics as a sop to compatibility with
  * XAPI for Citrix XenServer.  Deprecated.
  */
@@ -107,6 +133,8 @@ struct vport {
 	spinlock_t stats_lock;
 	struct vport_err_stats err_stats;
 	struct ovs_vport_stats offset_stats;
+
+	struct vport_upcall_limit upcall_limit;
 };
 
 #define VPORT_F_REQUIRED	(1 << 0) /* If init fails, module loading fails. */
@@ -99,7 +99,13 @@ enum nx_bad_request_code {
     NXBRC_NXM_BAD_PREREQ = 0x104,
 
     /* A given nxm_type was specified more than once. */
-    NXBRC_NXM_DUP_TYPE = 0x105
+    NXBRC_NXM_DUP_TYPE = 0x105,
+
+/* Flow table digest errors. */
+
+    /* The 'n_buckets' in an NXST_FLOW_DIGEST or NXST_FLOW_BUCKETS request is
+     * not a power of 2 between 1 and NX_FLOW_DIGEST_MAX_BUCKETS. */
+    NXBRC_BAD_N_BUCKETS = 0x200
 };
 
 /* Additional "code" values for OFPET_FLOW_MOD_FAILED. */
@@ -164,7 +170,12 @@ OFP_ASSERT(sizeof(struct nicira_stats_msg) == 24);
 enum nicira_stats_type {
     /* Flexible flow specification (aka NXM = Nicira Extended Match). */
     NXST_FLOW,                  /* Analogous to OFPST_FLOW. */
-    NXST_AGGREGATE              /* Analogous to OFPST_AGGREGATE. */
+    NXST_AGGREGATE,             /* Analogous to OFPST_AGGREGATE. */
+
+    /* Flow table digests.  See the big comment on struct
+     * nx_flow_digest_request for more information. */
+    NXST_FLOW_DIGEST,           /* Per-bucket digests of flow tables. */
+    NXST_FLOW_BUCKETS           /* Flows in selected digest buckets. */
 };
 
 /* Fields to use when hashing flows. */
@@ -1674,4 +1685,85 @@ struct nx_aggregate_stats_reply {
 };
 OFP_ASSERT(sizeof(struct nx_aggregate_stats_reply) == 48);
 
+/* Flow table digests.
+ *
+ * A controller that wants to bring a switch's flow table into sync with a
+ * desired set of flows, e.g. "ovs-ofctl replace-flows", would otherwise have
+ * to dump the entire flow table with NXST_FLOW and compare it flow by flow.
+ * That is expensive for both sides when the table is large and has barely
+ * changed.  The NXST_FLOW_DIGEST and NXST_FLOW_BUCKETS extensions allow the
+ * controller to compare compact digests first and then to dump only the
+ * parts of the flow table that actually differ.
+ *
+ * The switch divides the flows in the requested tables into 'n_buckets'
+ * buckets, where 'n_buckets' is a power of 2, according to a hash of each
+ * flow's match.  Each flow has a 64-bit digest, and a bucket's digest is the
+ * sum, modulo 2**64, of the digests of the flows that it contains, so that it
+ * does not depend on the order in which the flows were added.  In particular,
+ * a request for a single bucket yields a digest of the flow table as a whole.
+ *
+ * A flow's bucket and digest are defined in terms of SHA-1 over the flow's
+ * wire format, so that both sides compute the same values regardless of host
+ * byte order.  All integers are big-endian:
+ *
+ *   - Let M be SHA-1 over the flow's nx_match, exactly as it would be encoded
+ *     in an NXST_FLOW reply but without padding, followed by the flow's 16-bit
+ *     priority.  The flow's bucket is the first 4 bytes of M, as a 32-bit
+ *     integer, modulo 'n_buckets'.
+ *
+ *   - The flow's digest is the first 8 bytes, as a 64-bit integer, of SHA-1
+ *     over M followed by the flow's 64-bit cookie, 16-bit idle timeout,
+ *     16-bit hard timeout, and its actions as they would be encoded in an
+ *     NXST_FLOW reply.
+ *
+ * Flow flags are not part of the digest, since there is no way to retrieve
+ * them from a switch.  Flows that would be omitted from an NXST_FLOW reply
+ * are also omitted from digests.
+ *
+ * A typical controller first requests a single bucket and compares it against
+ * its own digest, then if they differ requests a larger number of buckets and
+ * fetches the flows in the buckets that differ with NXST_FLOW_BUCKETS. */
+
+/* Maximum value of 'n_buckets' in NXST_FLOW_DIGEST and NXST_FLOW_BUCKETS
+ * requests.  This keeps a NXST_FLOW_DIGEST reply within a single message. */
+#define NX_FLOW_DIGEST_MAX_BUCKETS 4096
+
+/* Nicira vendor stats request of type NXST_FLOW_DIGEST. */
+struct nx_flow_digest_request {
+    struct nicira_stats_msg nsm;
+    ovs_be16 n_buckets;       /* Number of buckets, a power of 2 between 1 and
+                                 NX_FLOW_DIGEST_MAX_BUCKETS. */
+    uint8_t table_id;         /* ID of table to digest (from ofp_table_stats)
+                                 or 0xff for all tables. */
+    uint8_t pad[5];           /* Align to 64 bits. */
+};
+OFP_ASSERT(sizeof(struct nx_flow_digest_request) == 32);
+
+/* Body for Nicira vendor stats reply of type NXST_FLOW_DIGEST. */
+struct nx_flow_digest_reply {
+    struct nicira_stats_msg nsm;
+    ovs_be32 flow_count;      /* Number of flows digested. */
+    ovs_be16 n_buckets;       /* Number of buckets, as in the request. */
+    uint8_t pad[2];           /* Align to 64 bits. */
+    /* Followed by exactly 'n_buckets' 64-bit digests ("ovs_be64"s), one for
+     * each bucket in order. */
+};
+OFP_ASSERT(sizeof(struct nx_flow_digest_reply) == 32);
+
+/* Nicira vendor stats request of type NXST_FLOW_BUCKETS.  The reply has the
+ * same body as an NXST_FLOW reply and contains the flows in the selected
+ * buckets. */
+struct nx_flow_buckets_request {
+    struct nicira_stats_msg nsm;
+    ovs_be16 n_buckets;       /* Number of buckets, a power of 2 between 1 and
+                                 NX_FLOW_DIGEST_MAX_BUCKETS. */
+    uint8_t table_id;         /* ID of table to read (from ofp_table_stats)
+                                 or 0xff for all tables. */
+    uint8_t pad[5];           /* Align to 64 bits. */
+    /* Followed by a bitmap of 'n_buckets' bits, padded with 0-bits to a
+     * multiple of 64 bits, in which bucket 'i' is selected if bit (i % 8) of
+     * byte (i / 8) is 1. */
+};
+OFP_ASSERT(sizeof(struct nx_flow_buckets_request) == 32);
+
 #endif /* openflow/nicira-ext.h */
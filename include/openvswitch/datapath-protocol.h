@@ -94,10 +94,17 @@ struct ovs_header {
  * @OVS_PACKET_CMD_SAMPLE.  A value of 0 samples no packets, a value of
  * %UINT32_MAX samples all packets, and intermediate values sample intermediate
  * fractions of packets.
+ * @OVS_DP_ATTR_SAMPLE_LEN: Maximum number of bytes of packet data to include
+ * in %OVS_PACKET_CMD_SAMPLE messages.  A value of 0 (the default) includes
+ * entire packets.  Since sFlow only reports packet headers, setting a limit
+ * saves the cost of copying each sampled packet in full.
  * @OVS_DP_ATTR_MCGROUPS: Nested attributes with multicast groups.  Each nested
  * attribute has a %OVS_PACKET_CMD_* type with a 32-bit value giving the
  * Generic Netlink multicast group number used for sending this datapath's
  * messages with that command type up to userspace.
+ * @OVS_DP_ATTR_TABLE_STATS: Statistics about the datapath's flow table, as a
+ * &struct ovs_dp_table_stats.  Ignored in requests.  Older kernels do not
+ * report it.
  *
  * These attributes follow the &struct ovs_header within the Generic Netlink
  * payload for %OVS_DP_* commands.
@@ -109,6 +116,8 @@ enum ovs_datapath_attr {
 	OVS_DP_ATTR_IPV4_FRAGS,	/* 32-bit enum ovs_frag_handling */
 	OVS_DP_ATTR_SAMPLING,   /* 32-bit fraction of packets to sample. */
 	OVS_DP_ATTR_MCGROUPS,   /* Nested attributes with multicast groups. */
+	OVS_DP_ATTR_SAMPLE_LEN, /* u32 max bytes of data per sampled packet. */
+	OVS_DP_ATTR_TABLE_STATS, /* struct ovs_dp_table_stats */
 	__OVS_DP_ATTR_MAX
 };
 
@@ -135,6 +144,12 @@ struct ovs_dp_stats {
     uint64_t n_flows;           /* Number of flows present */
 };
 
+struct ovs_dp_table_stats {
+    uint64_t n_buckets;         /* Number of flow table hash buckets. */
+    uint64_t n_expands;         /* Number of times flow table grew. */
+    uint64_t n_shrinks;         /* Number of times flow table shrank. */
+};
+
 struct ovs_vport_stats {
 	uint64_t   rx_packets;		/* total packets received       */
 	uint64_t   tx_packets;		/* total packets transmitted    */
@@ -182,9 +197,15 @@ enum ovs_packet_cmd {
  * @OVS_PACKET_ATTR_ACTIONS: Present for %OVS_PACKET_CMD_SAMPLE.  Contains a
  * copy of the actions applied to the packet, as nested %OVS_ACTION_ATTR_*
  * attributes.
+ * @OVS_PACKET_ATTR_LEN: Present only if %OVS_PACKET_ATTR_PACKET was truncated
+ * (see %OVS_DP_ATTR_SAMPLE_LEN).  Contains the length of the whole packet.
  *
  * These attributes follow the &struct ovs_header within the Generic Netlink
  * payload for %OVS_PACKET_* commands.
+ *
+ * The kernel may pack several notifications into a single Netlink datagram,
+ * e.g. one for each segment of a GSO packet.  Userspace must use nlmsg_len to
+ * find each message within the datagram.
  */
 enum ovs_packet_attr {
 	OVS_PACKET_ATTR_UNSPEC,
@@ -193,6 +214,7 @@ enum ovs_packet_attr {
 	OVS_PACKET_ATTR_USERDATA,    /* u64 OVS_ACTION_ATTR_USERSPACE arg. */
 	OVS_PACKET_ATTR_SAMPLE_POOL, /* # sampling candidate packets so far. */
 	OVS_PACKET_ATTR_ACTIONS,     /* Nested OVS_ACTION_ATTR_* attributes. */
+	OVS_PACKET_ATTR_LEN,         /* u32 length of untruncated packet. */
 	__OVS_PACKET_ATTR_MAX
 };
 
@@ -233,6 +255,17 @@ enum ovs_vport_cmd {
  * packets sent or received through the vport.
  * @OVS_VPORT_ATTR_ADDRESS: A 6-byte Ethernet address for the vport.
  * @OVS_VPORT_ATTR_IFINDEX: ifindex of the underlying network device, if any.
+ * @OVS_VPORT_ATTR_UPCALL_RATE: 32-bit maximum sustained rate, in packets per
+ * second, at which packets received on the vport that miss in the flow table
+ * are sent to userspace, or 0 for no limit.  Misses beyond the limit are
+ * dropped, except for link-layer control protocol frames such as STP BPDUs,
+ * LACP, and CFM, which are always sent.
+ * @OVS_VPORT_ATTR_UPCALL_BURST: 32-bit number of misses that may be sent to
+ * userspace in a burst above %OVS_VPORT_ATTR_UPCALL_RATE.  If 0 or omitted
+ * when %OVS_VPORT_ATTR_UPCALL_RATE is set, it defaults to the rate.
+ * @OVS_VPORT_ATTR_UPCALL_DROPS: 64-bit number of misses dropped because they
+ * exceeded %OVS_VPORT_ATTR_UPCALL_RATE.  These are also counted in the
+ * @rx_dropped member of %OVS_VPORT_ATTR_STATS.  Ignored in requests.
  *
  * These attributes follow the &struct ovs_header within the Generic Netlink
  * payload for %OVS_VPORT_* commands.
@@ -245,7 +278,8 @@ enum ovs_vport_cmd {
  * %OVS_VPORT_ATTR_NAME attributes are required.  %OVS_VPORT_ATTR_PORT_NO is
  * optional; if not specified a free port number is automatically selected.
  * Whether %OVS_VPORT_ATTR_OPTIONS is required or optional depends on the type
- * of vport.  %OVS_VPORT_ATTR_STATS and %OVS_VPORT_ATTR_ADDRESS are optional,
+ * of vport.  %OVS_VPORT_ATTR_STATS, %OVS_VPORT_ATTR_ADDRESS,
+ * %OVS_VPORT_ATTR_UPCALL_RATE, and %OVS_VPORT_ATTR_UPCALL_BURST are optional,
  * and other attributes are ignored.
  *
  * For other requests, if %OVS_VPORT_ATTR_NAME is specified then it is used to
@@ -261,6 +295,9 @@ enum ovs_vport_attr {
 	OVS_VPORT_ATTR_ADDRESS, /* hardware address */
 	OVS_VPORT_ATTR_OPTIONS, /* nested attributes, varies by vport type */
 	OVS_VPORT_ATTR_IFINDEX, /* 32-bit ifindex of backing netdev */
+	OVS_VPORT_ATTR_UPCALL_RATE,  /* 32-bit max misses/s to userspace */
+	OVS_VPORT_ATTR_UPCALL_BURST, /* 32-bit max burst of misses */
+	OVS_VPORT_ATTR_UPCALL_DROPS, /* 64-bit misses dropped by rate limit */
 	__OVS_VPORT_ATTR_MAX
 };
 
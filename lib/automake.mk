@@ -55,6 +55,8 @@ lib_libopenvswitch_a_SOURCES = \
 	lib/flow.h \
 	lib/hash.c \
 	lib/hash.h \
+	lib/histogram.c \
+	lib/histogram.h \
 	lib/hmap.c \
 	lib/hmap.h \
 	lib/hmapx.c \
@@ -77,6 +79,8 @@ lib_libopenvswitch_a_SOURCES = \
 	lib/lockfile.h \
 	lib/mac-learning.c \
 	lib/mac-learning.h \
+	lib/memory.c \
+	lib/memory.h \
 	lib/meta-flow.c \
 	lib/meta-flow.h \
 	lib/multipath.c \
@@ -103,6 +107,8 @@ lib_libopenvswitch_a_SOURCES = \
 	lib/ofp-util.h \
 	lib/ofpbuf.c \
 	lib/ofpbuf.h \
+	lib/ohmap.c \
+	lib/ohmap.h \
 	lib/ovsdb-data.c \
 	lib/ovsdb-data.h \
 	lib/ovsdb-error.c \
@@ -116,12 +122,16 @@ lib_libopenvswitch_a_SOURCES = \
 	lib/ovsdb-types.h \
 	lib/packets.c \
 	lib/packets.h \
+	lib/phase.c \
+	lib/phase.h \
 	lib/pcap.c \
 	lib/pcap.h \
 	lib/poll-loop.c \
 	lib/poll-loop.h \
 	lib/process.c \
 	lib/process.h \
+	lib/profiler.c \
+	lib/profiler.h \
 	lib/random.c \
 	lib/random.h \
 	lib/rconn.c \
@@ -244,9 +254,13 @@ EXTRA_DIST += \
 MAN_FRAGMENTS += \
 	lib/common.man \
 	lib/common-syn.man \
+	lib/coverage-unixctl.man \
 	lib/daemon.man \
 	lib/daemon-syn.man \
 	lib/leak-checker.man \
+	lib/memory-unixctl.man \
+	lib/phase-unixctl.man \
+	lib/profiler-unixctl.man \
 	lib/ssl-bootstrap.man \
 	lib/ssl-bootstrap-syn.man \
 	lib/ssl-peer-ca-cert.man \
@@ -23,10 +23,14 @@
 #include "dynamic-string.h"
 #include "flow.h"
 #include "hash.h"
+#include "memory.h"
 #include "odp-util.h"
 #include "ofp-util.h"
 #include "packets.h"
 
+MEMORY_DEFINE(cls_rule);
+MEMORY_DEFINE(cls_table);
+
 static struct cls_table *find_table(const struct classifier *,
                                     const struct flow_wildcards *);
 static struct cls_table *insert_table(struct classifier *,
@@ -672,8 +676,14 @@ classifier_destroy(struct classifier *cls)
         struct cls_table *table, *next_table;
 
         HMAP_FOR_EACH_SAFE (table, next_table, hmap_node, &cls->tables) {
-            hmap_destroy(&table->rules);
+            int i;
+
+            for (i = 0; i < table->n_table_rules; i++) {
+                memory_dec(&memory_cls_rule, sizeof(struct cls_rule));
+            }
+            ohmap_destroy(&table->rules);
             hmap_remove(&cls->tables, &table->hmap_node);
+            memory_dec(&memory_cls_table, sizeof *table);
             free(table);
         }
         hmap_destroy(&cls->tables);
@@ -721,6 +731,7 @@ classifier_replace(struct classifier *cls, struct cls_rule *rule)
     if (!old_rule) {
         table->n_table_rules++;
         cls->n_rules++;
+        memory_inc(&memory_cls_rule, sizeof *rule);
     }
     return old_rule;
 }
@@ -747,17 +758,17 @@ classifier_remove(struct classifier *cls, struct cls_rule *rule)
     struct cls_table *table;
 
     table = find_table(cls, &rule->wc);
-    head = find_equal(table, &rule->flow, rule->hmap_node.hash);
+    head = find_equal(table, &rule->flow, rule->ohmap_node.hash);
     if (head != rule) {
         list_remove(&rule->list);
     } else if (list_is_empty(&rule->list)) {
-        hmap_remove(&table->rules, &rule->hmap_node);
+        ohmap_remove(&table->rules, &rule->ohmap_node);
     } else {
         struct cls_rule *next = CONTAINER_OF(rule->list.next,
                                              struct cls_rule, list);
 
         list_remove(&rule->list);
-        hmap_replace(&table->rules, &rule->hmap_node, &next->hmap_node);
+        ohmap_replace(&table->rules, &rule->ohmap_node, &next->ohmap_node);
     }
 
     if (--table->n_table_rules == 0) {
@@ -765,6 +776,7 @@ classifier_remove(struct classifier *cls, struct cls_rule *rule)
     }
 
     cls->n_rules--;
+    memory_dec(&memory_cls_rule, sizeof *rule);
 }
 
 /* Finds and returns the highest-priority rule in 'cls' that matches 'flow'.
@@ -824,7 +836,7 @@ classifier_rule_overlaps(const struct classifier *cls,
         struct cls_rule *head;
 
         flow_wildcards_combine(&wc, &target->wc, &table->wc);
-        HMAP_FOR_EACH (head, hmap_node, &table->rules) {
+        OHMAP_FOR_EACH (head, ohmap_node, &table->rules) {
             struct cls_rule *rule;
 
             FOR_EACH_RULE_IN_LIST (rule, head) {
@@ -854,7 +866,7 @@ search_table(const struct cls_table *table, const struct cls_rule *target)
     if (!target || !flow_wildcards_has_extra(&table->wc, &target->wc)) {
         struct cls_rule *rule;
 
-        HMAP_FOR_EACH (rule, hmap_node, &table->rules) {
+        OHMAP_FOR_EACH (rule, ohmap_node, &table->rules) {
             if (rule_matches(rule, target)) {
                 return rule;
             }
@@ -938,10 +950,10 @@ cls_cursor_next(struct cls_cursor *cursor, struct cls_rule *rule)
     }
 
     /* 'next' is the head of the list, that is, the rule that is included in
-     * the table's hmap.  (This is important when the classifier contains rules
-     * that differ only in priority.) */
+     * the table's ohmap.  (This is important when the classifier contains
+     * rules that differ only in priority.) */
     rule = next;
-    HMAP_FOR_EACH_CONTINUE (rule, hmap_node, &cursor->table->rules) {
+    OHMAP_FOR_EACH_CONTINUE (rule, ohmap_node, &cursor->table->rules) {
         if (rule_matches(rule, cursor->target)) {
             return rule;
         }
@@ -979,7 +991,8 @@ insert_table(struct classifier *cls, const struct flow_wildcards *wc)
     struct cls_table *table;
 
     table = xzalloc(sizeof *table);
-    hmap_init(&table->rules);
+    memory_inc(&memory_cls_table, sizeof *table);
+    ohmap_init(&table->rules);
     table->wc = *wc;
     hmap_insert(&cls->tables, &table->hmap_node, flow_wildcards_hash(wc, 0));
 
@@ -1004,7 +1017,8 @@ static void
 destroy_table(struct classifier *cls, struct cls_table *table)
 {
     hmap_remove(&cls->tables, &table->hmap_node);
-    hmap_destroy(&table->rules);
+    ohmap_destroy(&table->rules);
+    memory_dec(&memory_cls_table, sizeof *table);
     free(table);
 }
 
@@ -1016,8 +1030,8 @@ find_match(const struct cls_table *table, const struct flow *flow)
 
     f = *flow;
     flow_zero_wildcards(&f, &table->wc);
-    HMAP_FOR_EACH_WITH_HASH (rule, hmap_node, flow_hash(&f, 0),
-                             &table->rules) {
+    OHMAP_FOR_EACH_WITH_HASH (rule, ohmap_node, flow_hash(&f, 0),
+                              &table->rules) {
         if (flow_equal(&f, &rule->flow)) {
             return rule;
         }
@@ -1030,7 +1044,7 @@ find_equal(struct cls_table *table, const struct flow *flow, uint32_t hash)
 {
     struct cls_rule *head;
 
-    HMAP_FOR_EACH_WITH_HASH (head, hmap_node, hash, &table->rules) {
+    OHMAP_FOR_EACH_WITH_HASH (head, ohmap_node, hash, &table->rules) {
         if (flow_equal(&head->flow, flow)) {
             return head;
         }
@@ -1043,11 +1057,11 @@ insert_rule(struct cls_table *table, struct cls_rule *new)
 {
     struct cls_rule *head;
 
-    new->hmap_node.hash = flow_hash(&new->flow, 0);
+    new->ohmap_node.hash = flow_hash(&new->flow, 0);
 
-    head = find_equal(table, &new->flow, new->hmap_node.hash);
+    head = find_equal(table, &new->flow, new->ohmap_node.hash);
     if (!head) {
-        hmap_insert(&table->rules, &new->hmap_node, new->hmap_node.hash);
+        ohmap_insert(&table->rules, &new->ohmap_node, new->ohmap_node.hash);
         list_init(&new->list);
         return NULL;
     } else {
@@ -1058,8 +1072,8 @@ insert_rule(struct cls_table *table, struct cls_rule *new)
             if (new->priority >= rule->priority) {
                 if (rule == head) {
                     /* 'new' is the new highest-priority flow in the list. */
-                    hmap_replace(&table->rules,
-                                 &rule->hmap_node, &new->hmap_node);
+                    ohmap_replace(&table->rules,
+                                  &rule->ohmap_node, &new->ohmap_node);
                 }
 
                 if (new->priority == rule->priority) {
@@ -21,7 +21,8 @@
  *
  * A classifier is a "struct classifier",
  *      a hash map from a set of wildcards to a "struct cls_table",
- *              a hash map from fixed field values to "struct cls_rule",
+ *              an open-addressing hash map from fixed field values to
+ *              "struct cls_rule",
  *                      which can contain a list of otherwise identical rules
  *                      with lower priorities.
  */
@@ -29,6 +30,7 @@
 #include "flow.h"
 #include "hmap.h"
 #include "list.h"
+#include "ohmap.h"
 #include "openflow/nicira-ext.h"
 #include "openflow/openflow.h"
 
@@ -45,7 +47,7 @@ struct classifier {
 /* A set of rules that all have the same fields wildcarded. */
 struct cls_table {
     struct hmap_node hmap_node; /* Within struct classifier 'tables' hmap. */
-    struct hmap rules;          /* Contains "struct cls_rule"s. */
+    struct ohmap rules;         /* Contains "struct cls_rule"s. */
     struct flow_wildcards wc;   /* Wildcards for fields. */
     int n_table_rules;          /* Number of rules, including duplicates. */
 };
@@ -55,10 +57,10 @@ struct cls_table {
 static inline bool
 cls_table_is_catchall(const struct cls_table *table)
 {
-    /* A catch-all table can only have one rule, so use hmap_count() as a cheap
+    /* A catch-all table can only have one rule, so use ohmap_count() as a cheap
      * check to rule out other kinds of match before doing the full check with
      * flow_wildcards_is_catchall(). */
-    return (hmap_count(&table->rules) == 1
+    return (ohmap_count(&table->rules) == 1
             && flow_wildcards_is_catchall(&table->wc));
 }
 
@@ -75,7 +77,7 @@ cls_table_is_catchall(const struct cls_table *table)
  *     invariant after adding wildcards.)
  */
 struct cls_rule {
-    struct hmap_node hmap_node; /* Within struct cls_table 'rules'. */
+    struct ohmap_node ohmap_node; /* Within struct cls_table 'rules'. */
     struct list list;           /* List of identical, lower-priority rules. */
     struct flow flow;           /* All field values. */
     struct flow_wildcards wc;   /* Wildcards for fields. */
@@ -17,9 +17,13 @@
 #include <config.h>
 #include "coverage.h"
 #include <inttypes.h>
+#include <limits.h>
 #include <stdlib.h>
+#include <string.h>
 #include "dynamic-string.h"
 #include "hash.h"
+#include "json.h"
+#include "timeval.h"
 #include "unixctl.h"
 #include "util.h"
 #include "vlog.h"
@@ -47,6 +51,23 @@ struct coverage_counter *coverage_counters[] = {
 
 static unsigned int epoch;
 
+/* Rate history: the number of samples taken so far, the time at which the
+ * most recent one was taken (0 if none), and the time at which to take the
+ * next.
+ *
+ * Samples are taken from coverage_clear(), so they are not exactly
+ * COVERAGE_RUN_INTERVAL ms apart, and after an idle period one sample can
+ * cover much longer.  'min_msec' and 'hr_msec' record the time that each slot
+ * in the counters' 'min' and 'hr' rings actually covers. */
+static unsigned int n_samples;
+static long long int last_sample;
+static long long int next_sample;
+static long long int min_msec[COVERAGE_MIN_SAMPLES];
+static long long int hr_msec[COVERAGE_HR_SAMPLES];
+
+static void coverage_format_text(struct ds *);
+static char *coverage_format_json(void);
+
 static void
 coverage_unixctl_log(struct unixctl_conn *conn, const char *args OVS_UNUSED,
                      void *aux OVS_UNUSED)
@@ -55,10 +76,30 @@ coverage_unixctl_log(struct unixctl_conn *conn, const char *args OVS_UNUSED,
     unixctl_command_reply(conn, 200, NULL);
 }
 
+static void
+coverage_unixctl_show(struct unixctl_conn *conn, const char *args,
+                      void *aux OVS_UNUSED)
+{
+    if (!args[0]) {
+        struct ds s = DS_EMPTY_INITIALIZER;
+
+        coverage_format_text(&s);
+        unixctl_command_reply(conn, 200, ds_cstr(&s));
+        ds_destroy(&s);
+    } else if (!strcmp(args, "json")) {
+        char *s = coverage_format_json();
+        unixctl_command_reply(conn, 200, s);
+        free(s);
+    } else {
+        unixctl_command_reply(conn, 501, "usage: coverage/show [json]");
+    }
+}
+
 void
 coverage_init(void)
 {
     unixctl_command_register("coverage/log", coverage_unixctl_log, NULL);
+    unixctl_command_register("coverage/show", coverage_unixctl_show, NULL);
 }
 
 /* Sorts coverage counters in descending order by count, within equal counts
@@ -187,10 +228,56 @@ coverage_log(enum vlog_level level, bool suppress_dups)
     VLOG(level, "%zu events never hit", n_never_hit);
 }
 
-/* Advances to the next epoch of coverage, resetting all the counters to 0. */
+/* Saves each counter's count since the previous sample, which was taken
+ * 'elapsed' ms before, into its rate history. */
+static void
+coverage_sample(long long int elapsed)
+{
+    unsigned int min_idx = n_samples % COVERAGE_MIN_SAMPLES;
+    size_t i;
+
+    min_msec[min_idx] = elapsed;
+    if (min_idx == COVERAGE_MIN_SAMPLES - 1) {
+        unsigned int hr_idx;
+        long long int sum;
+        int j;
+
+        sum = 0;
+        for (j = 0; j < COVERAGE_MIN_SAMPLES; j++) {
+            sum += min_msec[j];
+        }
+        hr_idx = (n_samples / COVERAGE_MIN_SAMPLES) % COVERAGE_HR_SAMPLES;
+        hr_msec[hr_idx] = sum;
+    }
+
+    for (i = 0; i < n_coverage_counters; i++) {
+        struct coverage_counter *c = coverage_counters[i];
+
+        c->min[min_idx] = MIN(c->total - c->sampled, UINT_MAX);
+        c->sampled = c->total;
+        if (min_idx == COVERAGE_MIN_SAMPLES - 1) {
+            unsigned int hr_idx;
+            unsigned long long int sum;
+            int j;
+
+            sum = 0;
+            for (j = 0; j < COVERAGE_MIN_SAMPLES; j++) {
+                sum += c->min[j];
+            }
+            hr_idx = (n_samples / COVERAGE_MIN_SAMPLES) % COVERAGE_HR_SAMPLES;
+            c->hr[hr_idx] = MIN(sum, UINT_MAX);
+        }
+    }
+    n_samples++;
+}
+
+/* Advances to the next epoch of coverage, resetting all the counters to 0.
+ * Also samples the counters' rates, if COVERAGE_RUN_INTERVAL ms have passed
+ * since the last sample. */
 void
 coverage_clear(void)
 {
+    long long int now;
     size_t i;
 
     epoch++;
@@ -199,4 +286,131 @@ coverage_clear(void)
         c->total += c->count;
         c->count = 0;
     }
+
+    now = time_msec();
+    if (!last_sample) {
+        /* Start the rate history from here. */
+        for (i = 0; i < n_coverage_counters; i++) {
+            coverage_counters[i]->sampled = coverage_counters[i]->total;
+        }
+        last_sample = now;
+        next_sample = now + COVERAGE_RUN_INTERVAL;
+    } else if (now >= next_sample) {
+        coverage_sample(now - last_sample);
+        last_sample = now;
+        next_sample = now + COVERAGE_RUN_INTERVAL;
+    }
+}
+
+/* Returns 'n' events over 'msec' ms as a rate per second, or 0 if 'msec' is
+ * not positive. */
+static double
+per_second(unsigned long long int n, long long int msec)
+{
+    return msec > 0 ? n * 1000.0 / msec : 0.0;
+}
+
+/* Returns the average rate per second of 'c' over the last sample interval,
+ * minute, and hour, in 'rates[0]', 'rates[1]', and 'rates[2]'.  Each rate is
+ * taken over the time that the samples behind it actually cover, which is
+ * less than a minute or an hour early on. */
+static void
+coverage_rates(const struct coverage_counter *c, double rates[3])
+{
+    unsigned long long int min_sum, hr_sum;
+    long long int min_time, hr_time;
+    int n_partial;
+    int i;
+
+    if (!n_samples) {
+        rates[0] = rates[1] = rates[2] = 0.0;
+        return;
+    }
+
+    /* Slots not yet filled hold 0 events over 0 ms, so summing every slot
+     * gives the right totals. */
+    min_sum = min_time = 0;
+    for (i = 0; i < COVERAGE_MIN_SAMPLES; i++) {
+        min_sum += c->min[i];
+        min_time += min_msec[i];
+    }
+    hr_sum = hr_time = 0;
+    for (i = 0; i < COVERAGE_HR_SAMPLES; i++) {
+        hr_sum += c->hr[i];
+        hr_time += hr_msec[i];
+    }
+
+    /* The hour also includes the samples taken since the last of them were
+     * rolled up into 'hr'. */
+    n_partial = n_samples % COVERAGE_MIN_SAMPLES;
+    for (i = 0; i < n_partial; i++) {
+        hr_sum += c->min[i];
+        hr_time += min_msec[i];
+    }
+
+    i = (n_samples - 1) % COVERAGE_MIN_SAMPLES;
+    rates[0] = per_second(c->min[i], min_msec[i]);
+    rates[1] = per_second(min_sum, min_time);
+    rates[2] = per_second(hr_sum, hr_time);
+}
+
+static void
+coverage_format_text(struct ds *s)
+{
+    size_t n_never_hit;
+    size_t i;
+
+    ds_put_format(s, "Event coverage, avg rate over last: %d seconds, "
+                  "last minute, last hour:\n", COVERAGE_RUN_INTERVAL / 1000);
+    n_never_hit = 0;
+    for (i = 0; i < n_coverage_counters; i++) {
+        const struct coverage_counter *c = coverage_counters[i];
+        unsigned long long int total = c->total + c->count;
+        double rates[3];
+
+        if (!total) {
+            n_never_hit++;
+            continue;
+        }
+        coverage_rates(c, rates);
+        ds_put_format(s, "%-24s %5.1f/sec %9.3f/sec %13.4f/sec   "
+                      "total: %llu\n", c->name, rates[0], rates[1], rates[2],
+                      total);
+    }
+    ds_put_format(s, "%zu events never hit\n", n_never_hit);
+}
+
+/* Returns a malloc()'d JSON object that maps from each counter's name to an
+ * object with its total count and average rates, e.g.:
+ *
+ *     {"poll_fd_wait": {"total": 1234, "rate_5s": 2.4, "rate_1m": 2.55,
+ *                       "rate_1h": 1.9}, ...}
+ *
+ * Unlike the text format, this includes counters that have never been hit,
+ * so that the set of members is the same every time. */
+static char *
+coverage_format_json(void)
+{
+    struct json *counters;
+    char *s;
+    size_t i;
+
+    counters = json_object_create();
+    for (i = 0; i < n_coverage_counters; i++) {
+        const struct coverage_counter *c = coverage_counters[i];
+        struct json *counter;
+        double rates[3];
+
+        coverage_rates(c, rates);
+        counter = json_object_create();
+        json_object_put(counter, "total",
+                        json_integer_create(c->total + c->count));
+        json_object_put(counter, "rate_5s", json_real_create(rates[0]));
+        json_object_put(counter, "rate_1m", json_real_create(rates[1]));
+        json_object_put(counter, "rate_1h", json_real_create(rates[2]));
+        json_object_put(counters, c->name, counter);
+    }
+    s = json_to_string(counters, JSSF_SORT);
+    json_destroy(counters);
+    return s;
 }
@@ -20,7 +20,9 @@
 /* This file implements a simple form of coverage instrumentation.  Points in
  * source code that are of interest must be explicitly annotated with
  * COVERAGE_INC.  The coverage counters may be logged at any time with
- * coverage_log().
+ * coverage_log().  About every COVERAGE_RUN_INTERVAL ms, each counter's count
+ * for the interval is also saved, so that "coverage/show" can report average
+ * rates over the last 5 seconds, minute, and hour.
  *
  * This form of coverage instrumentation is intended to be so lightweight that
  * it can be enabled in production builds.  It is obviously not a substitute
@@ -29,11 +31,24 @@
 
 #include "vlog.h"
 
+/* Interval between samples of the coverage counters, in ms. */
+#define COVERAGE_RUN_INTERVAL 5000
+
+/* Number of COVERAGE_RUN_INTERVAL samples in a minute, and of minutes in an
+ * hour. */
+#define COVERAGE_MIN_SAMPLES (60 * 1000 / COVERAGE_RUN_INTERVAL)
+#define COVERAGE_HR_SAMPLES 60
+
 /* A coverage counter. */
 struct coverage_counter {
     const char *name;           /* Textual name. */
     unsigned int count;         /* Count within the current epoch. */
     unsigned long long int total; /* Total count over all epochs. */
+
+    /* Rate history. */
+    unsigned long long int sampled; /* 'total' at the most recent sample. */
+    unsigned int min[COVERAGE_MIN_SAMPLES]; /* Counts per recent interval. */
+    unsigned int hr[COVERAGE_HR_SAMPLES];   /* Counts per recent minute. */
 };
 
 /* Defines COUNTER.  There must be exactly one such definition at file scope
@@ -60,8 +75,9 @@ void coverage_log(enum vlog_level, bool suppress_dups);
 void coverage_clear(void);
 
 /* Implementation detail. */
-#define COVERAGE_DEFINE__(COUNTER)                              \
-        extern struct coverage_counter counter_##COUNTER;       \
-        struct coverage_counter counter_##COUNTER = { #COUNTER, 0, 0 }
+#define COVERAGE_DEFINE__(COUNTER)                                      \
+        extern struct coverage_counter counter_##COUNTER;               \
+        struct coverage_counter counter_##COUNTER                       \
+            = { #COUNTER, 0, 0, 0, { 0 }, { 0 } }
 
 #endif /* coverage.h */
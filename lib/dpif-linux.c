@@ -33,6 +33,7 @@
 #include <unistd.h>
 
 #include "bitmap.h"
+#include "coverage.h"
 #include "dpif-provider.h"
 #include "dynamic-string.h"
 #include "flow.h"
@@ -49,12 +50,15 @@
 #include "poll-loop.h"
 #include "shash.h"
 #include "sset.h"
+#include "timeval.h"
 #include "unaligned.h"
 #include "util.h"
 #include "vlog.h"
 
 VLOG_DEFINE_THIS_MODULE(dpif_linux);
 
+COVERAGE_DEFINE(dpif_linux_recv_batched);
+
 enum { LRU_MAX_PORTS = 1024 };
 enum { LRU_MASK = LRU_MAX_PORTS - 1};
 BUILD_ASSERT_DECL(IS_POW2(LRU_MAX_PORTS));
@@ -75,7 +79,9 @@ struct dpif_linux_dp {
     struct ovs_dp_stats stats;         /* OVS_DP_ATTR_STATS. */
     enum ovs_frag_handling ipv4_frags; /* OVS_DP_ATTR_IPV4_FRAGS. */
     const uint32_t *sampling;          /* OVS_DP_ATTR_SAMPLING. */
+    const uint32_t *sample_len;        /* OVS_DP_ATTR_SAMPLE_LEN. */
     uint32_t mcgroups[DPIF_N_UC_TYPES]; /* OVS_DP_ATTR_MCGROUPS. */
+    struct ovs_dp_table_stats table_stats; /* OVS_DP_ATTR_TABLE_STATS. */
 };
 
 static void dpif_linux_dp_init(struct dpif_linux_dp *);
@@ -135,6 +141,11 @@ struct dpif_linux {
     uint32_t mcgroups[DPIF_N_UC_TYPES];
     unsigned int listen_mask;
 
+    /* The kernel can pack several upcalls into one datagram.  This holds the
+     * rest of the most recently received datagram, if any upcalls in it have
+     * not yet been passed to dpif_linux_recv()'s caller. */
+    struct ofpbuf *recv_buf;
+
     /* Change notification. */
     struct sset changed_ports;  /* Ports that have changed. */
     struct nln_notifier port_notifier;
@@ -267,6 +278,7 @@ open_dpif(const struct dpif_linux_dp *dp, struct dpif **dpifp)
               dp->dp_ifindex, dp->dp_ifindex);
 
     dpif->mc_sock = NULL;
+    dpif->recv_buf = NULL;
     for (i = 0; i < DPIF_N_UC_TYPES; i++) {
         dpif->mcgroups[i] = dp->mcgroups[i];
     }
@@ -299,6 +311,7 @@ dpif_linux_close(struct dpif *dpif_)
     }
 
     nl_sock_destroy(dpif->mc_sock);
+    ofpbuf_delete(dpif->recv_buf);
     sset_destroy(&dpif->changed_ports);
     free(dpif->lru_bitmap);
     free(dpif);
@@ -347,6 +360,22 @@ dpif_linux_get_stats(const struct dpif *dpif_, struct ovs_dp_stats *stats)
     return error;
 }
 
+static int
+dpif_linux_get_table_stats(const struct dpif *dpif_,
+                           struct ovs_dp_table_stats *stats)
+{
+    struct dpif_linux_dp dp;
+    struct ofpbuf *buf;
+    int error;
+
+    error = dpif_linux_dp_get(dpif_, &dp, &buf);
+    if (!error) {
+        *stats = dp.table_stats;
+        ofpbuf_delete(buf);
+    }
+    return error;
+}
+
 static int
 dpif_linux_get_drop_frags(const struct dpif *dpif_, bool *drop_fragsp)
 {
@@ -443,6 +472,48 @@ dpif_linux_port_del(struct dpif *dpif_, uint16_t port_no)
     return error;
 }
 
+static int
+dpif_linux_port_set_upcall_limit(struct dpif *dpif_, uint16_t port_no,
+                                 uint32_t rate, uint32_t burst)
+{
+    struct dpif_linux *dpif = dpif_linux_cast(dpif_);
+    struct dpif_linux_vport vport;
+
+    dpif_linux_vport_init(&vport);
+    vport.cmd = OVS_VPORT_CMD_SET;
+    vport.dp_ifindex = dpif->dp_ifindex;
+    vport.port_no = port_no;
+    vport.upcall_rate = &rate;
+    vport.upcall_burst = &burst;
+    return dpif_linux_vport_transact(&vport, NULL, NULL);
+}
+
+static int
+dpif_linux_port_get_upcall_limit(const struct dpif *dpif_, uint16_t port_no,
+                                 uint32_t *rate, uint32_t *burst,
+                                 uint64_t *n_dropped)
+{
+    struct dpif_linux *dpif = dpif_linux_cast(dpif_);
+    struct dpif_linux_vport request;
+    struct dpif_linux_vport reply;
+    struct ofpbuf *buf;
+    int error;
+
+    dpif_linux_vport_init(&request);
+    request.cmd = OVS_VPORT_CMD_GET;
+    request.dp_ifindex = dpif->dp_ifindex;
+    request.port_no = port_no;
+
+    error = dpif_linux_vport_transact(&request, &reply, &buf);
+    if (!error) {
+        *rate = reply.upcall_rate ? *reply.upcall_rate : 0;
+        *burst = reply.upcall_burst ? *reply.upcall_burst : 0;
+        *n_dropped = reply.upcall_drops;
+        ofpbuf_delete(buf);
+    }
+    return error;
+}
+
 static int
 dpif_linux_port_query__(const struct dpif *dpif, uint32_t port_no,
                         const char *port_name, struct dpif_port *dpif_port)
@@ -859,6 +930,8 @@ dpif_linux_recv_set_mask(struct dpif *dpif_, int listen_mask)
     } else if (!listen_mask) {
         nl_sock_destroy(dpif->mc_sock);
         dpif->mc_sock = NULL;
+        ofpbuf_delete(dpif->recv_buf);
+        dpif->recv_buf = NULL;
         dpif->listen_mask = 0;
         return 0;
     } else if (!dpif->mc_sock) {
@@ -922,6 +995,19 @@ dpif_linux_set_sflow_probability(struct dpif *dpif_, uint32_t probability)
     return dpif_linux_dp_transact(&dp, NULL, NULL);
 }
 
+static int
+dpif_linux_set_sflow_sample_len(struct dpif *dpif_, uint32_t len)
+{
+    struct dpif_linux *dpif = dpif_linux_cast(dpif_);
+    struct dpif_linux_dp dp;
+
+    dpif_linux_dp_init(&dp);
+    dp.cmd = OVS_DP_CMD_SET;
+    dp.dp_ifindex = dpif->dp_ifindex;
+    dp.sample_len = &len;
+    return dpif_linux_dp_transact(&dp, NULL, NULL);
+}
+
 static int
 dpif_linux_queue_to_priority(const struct dpif *dpif OVS_UNUSED,
                              uint32_t queue_id, uint32_t *priority)
@@ -950,6 +1036,7 @@ parse_odp_packet(struct ofpbuf *buf, struct dpif_upcall *upcall,
         /* OVS_PACKET_CMD_SAMPLE only. */
         [OVS_PACKET_ATTR_SAMPLE_POOL] = { .type = NL_A_U32, .optional = true },
         [OVS_PACKET_ATTR_ACTIONS] = { .type = NL_A_NESTED, .optional = true },
+        [OVS_PACKET_ATTR_LEN] = { .type = NL_A_U32, .optional = true },
     };
 
     struct ovs_header *ovs_header;
@@ -996,12 +1083,58 @@ parse_odp_packet(struct ofpbuf *buf, struct dpif_upcall *upcall,
         upcall->actions = (void *) nl_attr_get(a[OVS_PACKET_ATTR_ACTIONS]);
         upcall->actions_len = nl_attr_get_size(a[OVS_PACKET_ATTR_ACTIONS]);
     }
+    upcall->orig_len = (a[OVS_PACKET_ATTR_LEN]
+                        ? nl_attr_get_u32(a[OVS_PACKET_ATTR_LEN])
+                        : 0);
 
     *dp_ifindex = ovs_header->dp_ifindex;
 
     return 0;
 }
 
+/* Returns the next upcall message to process for 'dpif', receiving a new
+ * datagram from the kernel if the previous one is used up.  On success, stores
+ * the message in '*bufp', which the caller must free, and returns 0.  On
+ * failure, returns a positive errno value. */
+static int
+dpif_linux_recv_msg(struct dpif_linux *dpif, struct ofpbuf **bufp)
+{
+    struct ofpbuf *buf = dpif->recv_buf;
+    const struct nlmsghdr *nlmsg;
+    size_t len;
+
+    if (!buf) {
+        int error = nl_sock_recv(dpif->mc_sock, &buf, false);
+        if (error) {
+            *bufp = NULL;
+            return error;
+        }
+    }
+    dpif->recv_buf = NULL;
+
+    nlmsg = buf->data;
+    len = NLMSG_ALIGN(nlmsg->nlmsg_len);
+    if (len + NLMSG_HDRLEN > buf->size
+        || nlmsg->nlmsg_len < NLMSG_HDRLEN) {
+        /* The common case: one message per datagram. */
+        *bufp = buf;
+    } else {
+        /* Split off the first message and keep the rest for later. */
+        const struct nlmsghdr *next;
+
+        *bufp = ofpbuf_clone_data(buf->data, nlmsg->nlmsg_len);
+        ofpbuf_pull(buf, len);
+        next = buf->data;
+        if (next->nlmsg_len >= NLMSG_HDRLEN && next->nlmsg_len <= buf->size) {
+            COVERAGE_INC(dpif_linux_recv_batched);
+            dpif->recv_buf = buf;
+        } else {
+            ofpbuf_delete(buf);
+        }
+    }
+    return 0;
+}
+
 static int
 dpif_linux_recv(struct dpif *dpif_, struct dpif_upcall *upcall)
 {
@@ -1017,7 +1150,7 @@ dpif_linux_recv(struct dpif *dpif_, struct dpif_upcall *upcall)
     for (i = 0; i < 50; i++) {
         int dp_ifindex;
 
-        error = nl_sock_recv(dpif->mc_sock, &buf, false);
+        error = dpif_linux_recv_msg(dpif, &buf);
         if (error) {
             return error;
         }
@@ -1026,6 +1159,9 @@ dpif_linux_recv(struct dpif *dpif_, struct dpif_upcall *upcall)
         if (!error
             && dp_ifindex == dpif->dp_ifindex
             && dpif->listen_mask & (1u << upcall->type)) {
+            /* The kernel doesn't timestamp upcalls, so this is the best we
+             * can do. */
+            upcall->queued = time_usec();
             return 0;
         }
 
@@ -1042,7 +1178,9 @@ static void
 dpif_linux_recv_wait(struct dpif *dpif_)
 {
     struct dpif_linux *dpif = dpif_linux_cast(dpif_);
-    if (dpif->mc_sock) {
+    if (dpif->recv_buf) {
+        poll_immediate_wake();
+    } else if (dpif->mc_sock) {
         nl_sock_wait(dpif->mc_sock, POLLIN);
     }
 }
@@ -1052,6 +1190,8 @@ dpif_linux_recv_purge(struct dpif *dpif_)
 {
     struct dpif_linux *dpif = dpif_linux_cast(dpif_);
 
+    ofpbuf_delete(dpif->recv_buf);
+    dpif->recv_buf = NULL;
     if (dpif->mc_sock) {
         nl_sock_drain(dpif->mc_sock);
     }
@@ -1066,10 +1206,13 @@ const struct dpif_class dpif_linux_class = {
     dpif_linux_run,
     dpif_linux_wait,
     dpif_linux_get_stats,
+    dpif_linux_get_table_stats,
     dpif_linux_get_drop_frags,
     dpif_linux_set_drop_frags,
     dpif_linux_port_add,
     dpif_linux_port_del,
+    dpif_linux_port_set_upcall_limit,
+    dpif_linux_port_get_upcall_limit,
     dpif_linux_port_query_by_number,
     dpif_linux_port_query_by_name,
     dpif_linux_get_max_ports,
@@ -1090,6 +1233,7 @@ const struct dpif_class dpif_linux_class = {
     dpif_linux_recv_set_mask,
     dpif_linux_get_sflow_probability,
     dpif_linux_set_sflow_probability,
+    dpif_linux_set_sflow_sample_len,
     dpif_linux_queue_to_priority,
     dpif_linux_recv,
     dpif_linux_recv_wait,
@@ -1229,6 +1373,9 @@ dpif_linux_vport_from_ofpbuf(struct dpif_linux_vport *vport,
                                      .optional = true },
         [OVS_VPORT_ATTR_OPTIONS] = { .type = NL_A_NESTED, .optional = true },
         [OVS_VPORT_ATTR_IFINDEX] = { .type = NL_A_U32, .optional = true },
+        [OVS_VPORT_ATTR_UPCALL_RATE] = { .type = NL_A_U32, .optional = true },
+        [OVS_VPORT_ATTR_UPCALL_BURST] = { .type = NL_A_U32, .optional = true },
+        [OVS_VPORT_ATTR_UPCALL_DROPS] = { .type = NL_A_U64, .optional = true },
     };
 
     struct nlattr *a[ARRAY_SIZE(ovs_vport_policy)];
@@ -1268,6 +1415,15 @@ dpif_linux_vport_from_ofpbuf(struct dpif_linux_vport *vport,
     if (a[OVS_VPORT_ATTR_IFINDEX]) {
         vport->ifindex = nl_attr_get_u32(a[OVS_VPORT_ATTR_IFINDEX]);
     }
+    if (a[OVS_VPORT_ATTR_UPCALL_RATE]) {
+        vport->upcall_rate = nl_attr_get(a[OVS_VPORT_ATTR_UPCALL_RATE]);
+    }
+    if (a[OVS_VPORT_ATTR_UPCALL_BURST]) {
+        vport->upcall_burst = nl_attr_get(a[OVS_VPORT_ATTR_UPCALL_BURST]);
+    }
+    if (a[OVS_VPORT_ATTR_UPCALL_DROPS]) {
+        vport->upcall_drops = nl_attr_get_u64(a[OVS_VPORT_ATTR_UPCALL_DROPS]);
+    }
     return 0;
 }
 
@@ -1315,6 +1471,15 @@ dpif_linux_vport_to_ofpbuf(const struct dpif_linux_vport *vport,
     if (vport->ifindex) {
         nl_msg_put_u32(buf, OVS_VPORT_ATTR_IFINDEX, vport->ifindex);
     }
+
+    if (vport->upcall_rate) {
+        nl_msg_put_u32(buf, OVS_VPORT_ATTR_UPCALL_RATE, *vport->upcall_rate);
+    }
+
+    if (vport->upcall_burst) {
+        nl_msg_put_u32(buf, OVS_VPORT_ATTR_UPCALL_BURST,
+                       *vport->upcall_burst);
+    }
 }
 
 /* Clears 'vport' to "empty" values. */
@@ -1402,6 +1567,12 @@ dpif_linux_dp_from_ofpbuf(struct dpif_linux_dp *dp, const struct ofpbuf *buf)
         [OVS_DP_ATTR_IPV4_FRAGS] = { .type = NL_A_U32, .optional = true },
         [OVS_DP_ATTR_SAMPLING] = { .type = NL_A_U32, .optional = true },
         [OVS_DP_ATTR_MCGROUPS] = { .type = NL_A_NESTED, .optional = true },
+        [OVS_DP_ATTR_SAMPLE_LEN] = { .type = NL_A_U32, .optional = true },
+        [OVS_DP_ATTR_TABLE_STATS] = {
+            .type = NL_A_UNSPEC,
+            .min_len = sizeof(struct ovs_dp_table_stats),
+            .max_len = sizeof(struct ovs_dp_table_stats),
+            .optional = true },
     };
 
     struct nlattr *a[ARRAY_SIZE(ovs_datapath_policy)];
@@ -1438,6 +1609,9 @@ dpif_linux_dp_from_ofpbuf(struct dpif_linux_dp *dp, const struct ofpbuf *buf)
     if (a[OVS_DP_ATTR_SAMPLING]) {
         dp->sampling = nl_attr_get(a[OVS_DP_ATTR_SAMPLING]);
     }
+    if (a[OVS_DP_ATTR_SAMPLE_LEN]) {
+        dp->sample_len = nl_attr_get(a[OVS_DP_ATTR_SAMPLE_LEN]);
+    }
 
     if (a[OVS_DP_ATTR_MCGROUPS]) {
         static const struct nl_policy ovs_mcgroup_policy[] = {
@@ -1466,6 +1640,10 @@ dpif_linux_dp_from_ofpbuf(struct dpif_linux_dp *dp, const struct ofpbuf *buf)
                 = nl_attr_get_u32(mcgroups[OVS_PACKET_CMD_SAMPLE]);
         }
     }
+    if (a[OVS_DP_ATTR_TABLE_STATS]) {
+        memcpy(&dp->table_stats, nl_attr_get(a[OVS_DP_ATTR_TABLE_STATS]),
+               sizeof dp->table_stats);
+    }
 
     return 0;
 }
@@ -1495,6 +1673,10 @@ dpif_linux_dp_to_ofpbuf(const struct dpif_linux_dp *dp, struct ofpbuf *buf)
     if (dp->sampling) {
         nl_msg_put_u32(buf, OVS_DP_ATTR_SAMPLING, *dp->sampling);
     }
+
+    if (dp->sample_len) {
+        nl_msg_put_u32(buf, OVS_DP_ATTR_SAMPLE_LEN, *dp->sample_len);
+    }
 }
 
 /* Clears 'dp' to "empty" values. */
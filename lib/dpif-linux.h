@@ -39,6 +39,9 @@ struct dpif_linux_vport {
     const struct nlattr *options;          /* OVS_VPORT_ATTR_OPTIONS. */
     size_t options_len;
     int ifindex;                           /* OVS_VPORT_ATTR_IFINDEX. */
+    const uint32_t *upcall_rate;           /* OVS_VPORT_ATTR_UPCALL_RATE. */
+    const uint32_t *upcall_burst;          /* OVS_VPORT_ATTR_UPCALL_BURST. */
+    uint64_t upcall_drops;                 /* OVS_VPORT_ATTR_UPCALL_DROPS. */
 };
 
 void dpif_linux_vport_init(struct dpif_linux_vport *);
@@ -38,13 +38,13 @@
 #include "dummy.h"
 #include "dynamic-string.h"
 #include "flow.h"
-#include "hmap.h"
 #include "list.h"
 #include "netdev.h"
 #include "netlink.h"
 #include "odp-util.h"
 #include "ofp-print.h"
 #include "ofpbuf.h"
+#include "ohmap.h"
 #include "packets.h"
 #include "poll-loop.h"
 #include "shash.h"
@@ -65,6 +65,7 @@ enum { DP_NETDEV_HEADROOM = 2 + VLAN_HEADER_LEN };
 /* Queues. */
 enum { N_QUEUES = 2 };          /* Number of queues for dpif_recv(). */
 enum { MAX_QUEUE_LEN = 128 };   /* Maximum number of packets per queue. */
+enum { DP_NETDEV_RECV_BATCH = 50 }; /* Max packets per port per run. */
 enum { QUEUE_MASK = MAX_QUEUE_LEN - 1 };
 BUILD_ASSERT_DECL(IS_POW2(MAX_QUEUE_LEN));
 
@@ -82,7 +83,7 @@ struct dp_netdev {
 
     bool drop_frags;            /* Drop all IP fragments, if true. */
     struct dp_netdev_queue queues[N_QUEUES];
-    struct hmap flow_table;     /* Flow table. */
+    struct ohmap flow_table;    /* Flow table. */
 
     /* Statistics. */
     long long int n_frags;      /* Number of dropped IP fragments. */
@@ -106,7 +107,7 @@ struct dp_netdev_port {
 
 /* A flow in dp_netdev's 'flow_table'. */
 struct dp_netdev_flow {
-    struct hmap_node node;      /* Element in dp_netdev's 'flow_table'. */
+    struct ohmap_node node;     /* Element in dp_netdev's 'flow_table'. */
     struct flow key;
 
     /* Statistics. */
@@ -201,7 +202,7 @@ create_dp_netdev(const char *name, const struct dpif_class *class,
     for (i = 0; i < N_QUEUES; i++) {
         dp->queues[i].head = dp->queues[i].tail = 0;
     }
-    hmap_init(&dp->flow_table);
+    ohmap_init(&dp->flow_table);
     list_init(&dp->port_list);
     error = do_add_port(dp, name, "internal", OVSP_LOCAL);
     if (error) {
@@ -271,7 +272,7 @@ dp_netdev_free(struct dp_netdev *dp)
         do_del_port(dp, port->port_no);
     }
     dp_netdev_purge_queues(dp);
-    hmap_destroy(&dp->flow_table);
+    ohmap_destroy(&dp->flow_table);
     free(dp->name);
     free(dp);
 }
@@ -301,7 +302,7 @@ dpif_netdev_get_stats(const struct dpif *dpif, struct ovs_dp_stats *stats)
 {
     struct dp_netdev *dp = get_dp_netdev(dpif);
     memset(stats, 0, sizeof *stats);
-    stats->n_flows = hmap_count(&dp->flow_table);
+    stats->n_flows = ohmap_count(&dp->flow_table);
     stats->n_frags = dp->n_frags;
     stats->n_hit = dp->n_hit;
     stats->n_missed = dp->n_missed;
@@ -521,7 +522,7 @@ dpif_netdev_get_max_ports(const struct dpif *dpif OVS_UNUSED)
 static void
 dp_netdev_free_flow(struct dp_netdev *dp, struct dp_netdev_flow *flow)
 {
-    hmap_remove(&dp->flow_table, &flow->node);
+    ohmap_remove(&dp->flow_table, &flow->node);
     free(flow->actions);
     free(flow);
 }
@@ -531,7 +532,7 @@ dp_netdev_flow_flush(struct dp_netdev *dp)
 {
     struct dp_netdev_flow *flow, *next;
 
-    HMAP_FOR_EACH_SAFE (flow, next, node, &dp->flow_table) {
+    OHMAP_FOR_EACH_SAFE (flow, next, node, &dp->flow_table) {
         dp_netdev_free_flow(dp, flow);
     }
 }
@@ -614,7 +615,8 @@ dp_netdev_lookup_flow(const struct dp_netdev *dp, const struct flow *key)
 {
     struct dp_netdev_flow *flow;
 
-    HMAP_FOR_EACH_WITH_HASH (flow, node, flow_hash(key, 0), &dp->flow_table) {
+    OHMAP_FOR_EACH_WITH_HASH (flow, node, flow_hash(key, 0),
+                              &dp->flow_table) {
         if (flow_equal(&flow->key, key)) {
             return flow;
         }
@@ -787,7 +789,7 @@ add_flow(struct dpif *dpif, const struct flow *key,
         return error;
     }
 
-    hmap_insert(&dp->flow_table, &flow->node, flow_hash(&flow->key, 0));
+    ohmap_insert(&dp->flow_table, &flow->node, flow_hash(&flow->key, 0));
     return 0;
 }
 
@@ -819,7 +821,7 @@ dpif_netdev_flow_put(struct dpif *dpif, enum dpif_flow_put_flags flags,
     flow = dp_netdev_lookup_flow(dp, &key);
     if (!flow) {
         if (flags & DPIF_FP_CREATE) {
-            if (hmap_count(&dp->flow_table) < MAX_FLOWS) {
+            if (ohmap_count(&dp->flow_table) < MAX_FLOWS) {
                 if (stats) {
                     memset(stats, 0, sizeof *stats);
                 }
@@ -904,9 +906,9 @@ dpif_netdev_flow_dump_next(const struct dpif *dpif, void *state_,
     struct dp_netdev_flow_state *state = state_;
     struct dp_netdev *dp = get_dp_netdev(dpif);
     struct dp_netdev_flow *flow;
-    struct hmap_node *node;
+    struct ohmap_node *node;
 
-    node = hmap_at_position(&dp->flow_table, &state->bucket, &state->offset);
+    node = ohmap_at_position(&dp->flow_table, &state->bucket, &state->offset);
     if (!node) {
         return EOF;
     }
@@ -1112,19 +1114,28 @@ dpif_netdev_run(struct dpif *dpif)
     ofpbuf_init(&packet, DP_NETDEV_HEADROOM + VLAN_ETH_HEADER_LEN + max_mtu);
 
     LIST_FOR_EACH (port, node, &dp->port_list) {
-        int error;
-
-        /* Reset packet contents. */
-        ofpbuf_clear(&packet);
-        ofpbuf_reserve(&packet, DP_NETDEV_HEADROOM);
-
-        error = netdev_recv(port->netdev, &packet);
-        if (!error) {
-            dp_netdev_port_input(dp, port, &packet);
-        } else if (error != EAGAIN && error != EOPNOTSUPP) {
-            static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
-            VLOG_ERR_RL(&rl, "error receiving data from %s: %s",
-                        netdev_get_name(port->netdev), strerror(error));
+        int i;
+
+        for (i = 0; i < DP_NETDEV_RECV_BATCH; i++) {
+            int error;
+
+            /* Reset packet contents. */
+            ofpbuf_clear(&packet);
+            ofpbuf_reserve(&packet, DP_NETDEV_HEADROOM);
+
+            error = netdev_recv(port->netdev, &packet);
+            if (!error) {
+                dp_netdev_port_input(dp, port, &packet);
+            } else {
+                if (error != EAGAIN && error != EOPNOTSUPP) {
+                    static struct vlog_rate_limit rl
+                        = VLOG_RATE_LIMIT_INIT(1, 5);
+                    VLOG_ERR_RL(&rl, "error receiving data from %s: %s",
+                                netdev_get_name(port->netdev),
+                                strerror(error));
+                }
+                break;
+            }
         }
     }
     ofpbuf_uninit(&packet);
@@ -1287,6 +1298,7 @@ dp_netdev_output_userspace(struct dp_netdev *dp, const struct ofpbuf *packet,
     upcall->packet = buf;
     upcall->key = buf->base;
     upcall->key_len = key_len;
+    upcall->queued = time_usec();
     upcall->userdata = arg;
 
     q->upcalls[q->head++ & QUEUE_MASK] = upcall;
@@ -1357,10 +1369,13 @@ const struct dpif_class dpif_netdev_class = {
     dpif_netdev_run,
     dpif_netdev_wait,
     dpif_netdev_get_stats,
+    NULL,                       /* get_table_stats */
     dpif_netdev_get_drop_frags,
     dpif_netdev_set_drop_frags,
     dpif_netdev_port_add,
     dpif_netdev_port_del,
+    NULL,                       /* port_set_upcall_limit */
+    NULL,                       /* port_get_upcall_limit */
     dpif_netdev_port_query_by_number,
     dpif_netdev_port_query_by_name,
     dpif_netdev_get_max_ports,
@@ -1381,6 +1396,7 @@ const struct dpif_class dpif_netdev_class = {
     dpif_netdev_recv_set_mask,
     NULL,                       /* get_sflow_probability */
     NULL,                       /* set_sflow_probability */
+    NULL,                       /* set_sflow_sample_len */
     NULL,                       /* queue_to_priority */
     dpif_netdev_recv,
     dpif_netdev_recv_wait,
@@ -110,6 +110,12 @@ struct dpif_class {
     /* Retrieves statistics for 'dpif' into 'stats'. */
     int (*get_stats)(const struct dpif *dpif, struct ovs_dp_stats *stats);
 
+    /* Retrieves statistics for 'dpif''s flow table into 'stats'.  A datapath
+     * that does not track them may set 'stats' to all-zeros or leave this
+     * member function null. */
+    int (*get_table_stats)(const struct dpif *dpif,
+                           struct ovs_dp_table_stats *stats);
+
     /* Retrieves 'dpif''s current treatment of IP fragments into '*drop_frags':
      * true indicates that fragments are dropped, false indicates that
      * fragments are treated in the same way as other IP packets (except that
@@ -128,6 +134,29 @@ struct dpif_class {
     /* Removes port numbered 'port_no' from 'dpif'. */
     int (*port_del)(struct dpif *dpif, uint16_t port_no);
 
+    /* Limits the packets received on port 'port_no' that miss in the flow
+     * table, and thus would be passed up as DPIF_UC_MISS upcalls, to 'rate'
+     * per second on average with bursts of up to 'burst', or removes the
+     * limit if 'rate' is 0.  A 'burst' of 0 requests a default burst size.
+     * Misses over the limit are dropped, except that link-layer control
+     * protocol frames (e.g. STP, LACP, CFM) must always be passed up.
+     *
+     * EOPNOTSUPP as a return value indicates that the datapath does not
+     * support limiting upcalls, as does a null pointer. */
+    int (*port_set_upcall_limit)(struct dpif *dpif, uint16_t port_no,
+                                 uint32_t rate, uint32_t burst);
+
+    /* Retrieves the upcall limit currently in effect on 'port_no' in 'dpif'
+     * into '*rate' and '*burst' (both 0 if the port is not limited) and the
+     * number of misses dropped on 'port_no' because of the limit into
+     * '*n_dropped'.
+     *
+     * EOPNOTSUPP as a return value indicates that the datapath does not
+     * support limiting upcalls, as does a null pointer. */
+    int (*port_get_upcall_limit)(const struct dpif *dpif, uint16_t port_no,
+                                 uint32_t *rate, uint32_t *burst,
+                                 uint64_t *n_dropped);
+
     /* Queries 'dpif' for a port with the given 'port_no' or 'devname'.  Stores
      * information about the port into '*port' if successful.
      *
@@ -322,6 +351,15 @@ struct dpif_class {
      * packet. */
     int (*set_sflow_probability)(struct dpif *dpif, uint32_t probability);
 
+    /* Limits the packets that 'dpif' passes up in DPIF_UC_SAMPLE upcalls to
+     * their first 'len' bytes, or removes the limit if 'len' is 0.  Return
+     * value is 0 or a positive errno value.  EOPNOTSUPP indicates that the
+     * datapath does not support truncating samples, as does a null pointer.
+     *
+     * A datapath that truncates a sampled packet must report the packet's
+     * original length in the upcall's 'orig_len' member. */
+    int (*set_sflow_sample_len)(struct dpif *dpif, uint32_t len);
+
     /* Translates OpenFlow queue ID 'queue_id' (in host byte order) into a
      * priority value for use in the OVS_ACTION_ATTR_SET_PRIORITY action in
      * '*priority'. */
@@ -341,6 +379,10 @@ struct dpif_class {
      * For greatest efficiency, 'upcall->packet' should have at least
      * offsetof(struct ofp_packet_in, data) bytes of headroom.
      *
+     * 'upcall->queued' should be the value of time_usec() when the datapath
+     * queued the upcall or, if that is not known, when it was received, so
+     * that clients can measure upcall latency.
+     *
      * This function must not block.  If no upcall is pending when it is
      * called, it should return EAGAIN without blocking. */
     int (*recv)(struct dpif *dpif, struct dpif_upcall *upcall);
@@ -388,6 +388,24 @@ dpif_get_dp_stats(const struct dpif *dpif, struct ovs_dp_stats *stats)
     return error;
 }
 
+/* Retrieves statistics for 'dpif''s flow table into 'stats'.  Returns 0 if
+ * successful, otherwise a positive errno value.  Returns EOPNOTSUPP if 'dpif'
+ * does not track these statistics. */
+int
+dpif_get_table_stats(const struct dpif *dpif, struct ovs_dp_table_stats *stats)
+{
+    int error = (dpif->dpif_class->get_table_stats
+                 ? dpif->dpif_class->get_table_stats(dpif, stats)
+                 : EOPNOTSUPP);
+    if (error) {
+        memset(stats, 0, sizeof *stats);
+    }
+    if (error != EOPNOTSUPP) {
+        log_operation(dpif, "get_table_stats", error);
+    }
+    return error;
+}
+
 /* Retrieves the current IP fragment handling policy for 'dpif' into
  * '*drop_frags': true indicates that fragments are dropped, false indicates
  * that fragments are treated in the same way as other IP packets (except that
@@ -462,6 +480,53 @@ dpif_port_del(struct dpif *dpif, uint16_t port_no)
     return error;
 }
 
+/* Limits the rate at which packets received on 'dpif''s port number 'port_no'
+ * that miss in the flow table are passed up to 'rate' per second, with bursts
+ * of up to 'burst' packets, or removes the limit if 'rate' is 0.  If 'burst'
+ * is 0, the datapath picks a default.  Link-layer control protocol frames are
+ * never limited.
+ *
+ * Returns 0 if successful, otherwise a positive errno value.  EOPNOTSUPP
+ * indicates that 'dpif' does not support upcall limits. */
+int
+dpif_port_set_upcall_limit(struct dpif *dpif, uint16_t port_no,
+                           uint32_t rate, uint32_t burst)
+{
+    int error = (dpif->dpif_class->port_set_upcall_limit
+                 ? dpif->dpif_class->port_set_upcall_limit(dpif, port_no,
+                                                           rate, burst)
+                 : EOPNOTSUPP);
+    log_operation(dpif, "port_set_upcall_limit", error);
+    return error;
+}
+
+/* Retrieves the upcall limit on 'port_no' in 'dpif' into '*rate' and '*burst'
+ * (both 0 if the port is not limited) and the number of misses on 'port_no'
+ * that the datapath has dropped because of the limit into '*n_dropped'.
+ *
+ * Returns 0 if successful, otherwise a positive errno value, in which case
+ * '*rate', '*burst', and '*n_dropped' are set to 0.  EOPNOTSUPP indicates
+ * that 'dpif' does not support upcall limits. */
+int
+dpif_port_get_upcall_limit(const struct dpif *dpif, uint16_t port_no,
+                           uint32_t *rate, uint32_t *burst,
+                           uint64_t *n_dropped)
+{
+    int error = (dpif->dpif_class->port_get_upcall_limit
+                 ? dpif->dpif_class->port_get_upcall_limit(dpif, port_no,
+                                                           rate, burst,
+                                                           n_dropped)
+                 : EOPNOTSUPP);
+    if (error) {
+        *rate = *burst = 0;
+        *n_dropped = 0;
+    }
+    if (error != EOPNOTSUPP) {
+        log_operation(dpif, "port_get_upcall_limit", error);
+    }
+    return error;
+}
+
 /* Makes a deep copy of 'src' into 'dst'. */
 void
 dpif_port_clone(struct dpif_port *dst, const struct dpif_port *src)
@@ -1038,6 +1103,22 @@ dpif_set_sflow_probability(struct dpif *dpif, uint32_t probability)
     return error;
 }
 
+/* Asks 'dpif' to pass up only the first 'len' bytes of each packet that it
+ * samples for sFlow, or the whole packet if 'len' is 0.  Truncated upcalls
+ * report the packet's original length in their 'orig_len' member.
+ *
+ * Returns 0 if successful, otherwise a positive errno value.  EOPNOTSUPP
+ * indicates that 'dpif' always passes up whole packets. */
+int
+dpif_set_sflow_sample_len(struct dpif *dpif, uint32_t len)
+{
+    int error = (dpif->dpif_class->set_sflow_sample_len
+                 ? dpif->dpif_class->set_sflow_sample_len(dpif, len)
+                 : EOPNOTSUPP);
+    log_operation(dpif, "set_sflow_sample_len", error);
+    return error;
+}
+
 /* Polls for an upcall from 'dpif'.  If successful, stores the upcall into
  * '*upcall'.  Only upcalls of the types selected with dpif_recv_set_mask()
  * member function will ordinarily be received (but if a message type is
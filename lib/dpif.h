@@ -59,11 +59,17 @@ const char *dpif_base_name(const struct dpif *);
 int dpif_delete(struct dpif *);
 
 int dpif_get_dp_stats(const struct dpif *, struct ovs_dp_stats *);
+int dpif_get_table_stats(const struct dpif *, struct ovs_dp_table_stats *);
 int dpif_get_drop_frags(const struct dpif *, bool *drop_frags);
 int dpif_set_drop_frags(struct dpif *, bool drop_frags);
 
 int dpif_port_add(struct dpif *, struct netdev *, uint16_t *port_nop);
 int dpif_port_del(struct dpif *, uint16_t port_no);
+int dpif_port_set_upcall_limit(struct dpif *, uint16_t port_no,
+                               uint32_t rate, uint32_t burst);
+int dpif_port_get_upcall_limit(const struct dpif *, uint16_t port_no,
+                               uint32_t *rate, uint32_t *burst,
+                               uint64_t *n_dropped);
 
 /* A port within a datapath.
  *
@@ -174,6 +180,7 @@ struct dpif_upcall {
     struct ofpbuf *packet;      /* Packet data. */
     struct nlattr *key;         /* Flow key. */
     size_t key_len;             /* Length of 'key' in bytes. */
+    long long int queued;       /* time_usec() when queued or received. */
 
     /* DPIF_UC_ACTION only. */
     uint64_t userdata;          /* Argument to OVS_ACTION_ATTR_USERSPACE. */
@@ -182,12 +189,14 @@ struct dpif_upcall {
     uint32_t sample_pool;       /* # of sampling candidate packets so far. */
     struct nlattr *actions;     /* Associated flow actions. */
     size_t actions_len;
+    uint32_t orig_len;          /* Length before truncation, 0 if intact. */
 };
 
 int dpif_recv_get_mask(const struct dpif *, int *listen_mask);
 int dpif_recv_set_mask(struct dpif *, int listen_mask);
 int dpif_get_sflow_probability(const struct dpif *, uint32_t *probability);
 int dpif_set_sflow_probability(struct dpif *, uint32_t probability);
+int dpif_set_sflow_sample_len(struct dpif *, uint32_t len);
 int dpif_recv(struct dpif *, struct dpif_upcall *);
 void dpif_recv_purge(struct dpif *);
 void dpif_recv_wait(struct dpif *);
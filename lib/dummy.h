@@ -17,9 +17,18 @@
 #ifndef DUMMY_H
 #define DUMMY_H 1
 
+struct ofpbuf;
+
 /* For client programs to call directly to enable dummy support. */
 void dummy_enable(void);
 
+/* Injecting traffic into dummy network devices and capturing it. */
+int netdev_dummy_queue_packet(const char *name, const struct ofpbuf *);
+int netdev_dummy_inject_pcap(const char *name, const char *file_name);
+int netdev_dummy_generate(const char *name, unsigned long long int n_packets,
+                          unsigned int n_flows);
+int netdev_dummy_capture(const char *name, const char *file_name);
+
 /* Implementation details. */
 void dpif_dummy_register(void);
 void netdev_dummy_register(void);
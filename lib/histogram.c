@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2011 Nicira Networks.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <config.h>
+#include "histogram.h"
+#include <stdint.h>
+#include <string.h>
+#include "dynamic-string.h"
+#include "util.h"
+
+static int
+bucket_from_value(unsigned long long int value)
+{
+    int log;
+
+    if (value < 4) {
+        return value;
+    }
+    value = MIN(value, UINT32_MAX);
+    log = log_2_floor(value);
+    return 4 + (log - 2) * 4 + ((value >> (log - 2)) & 3);
+}
+
+/* Returns the largest value that falls into 'bucket'. */
+static unsigned long long int
+bucket_max_value(int bucket)
+{
+    int log, sub;
+
+    if (bucket < 4) {
+        return bucket;
+    }
+    log = (bucket - 4) / 4 + 2;
+    sub = (bucket - 4) % 4;
+    return ((4ULL + sub + 1) << (log - 2)) - 1;
+}
+
+void
+histogram_clear(struct histogram *h)
+{
+    memset(h, 0, sizeof *h);
+}
+
+void
+histogram_add(struct histogram *h, unsigned long long int value)
+{
+    h->n++;
+    h->total += value;
+    if (value > h->max) {
+        h->max = value;
+    }
+    h->buckets[bucket_from_value(value)]++;
+}
+
+/* Returns an upper bound on the smallest value that is at least as large as
+ * 'percent' percent of the values in 'h', or 0 if 'h' is empty. */
+unsigned long long int
+histogram_percentile(const struct histogram *h, int percent)
+{
+    return histogram_permille(h, percent * 10);
+}
+
+/* Like histogram_percentile(), but 'permille' is in tenths of a percent, so
+ * that e.g. 999 yields the 99.9th percentile. */
+unsigned long long int
+histogram_permille(const struct histogram *h, int permille)
+{
+    unsigned long long int sum;
+    int i;
+
+    sum = 0;
+    for (i = 0; i < HISTOGRAM_N_BUCKETS; i++) {
+        sum += h->buckets[i];
+        if (sum && sum * 1000 >= h->n * permille) {
+            return MIN(bucket_max_value(i), h->max);
+        }
+    }
+    return h->max;
+}
+
+static void
+put_msec(struct ds *s, unsigned long long int usec)
+{
+    ds_put_format(s, " %6llu.%03llu", usec / 1000, usec % 1000);
+}
+
+/* Appends to 's' the p50, p99, max, and total of 'h', whose values must be in
+ * microseconds, as milliseconds in four 11-column fields. */
+void
+histogram_format_msec(const struct histogram *h, struct ds *s)
+{
+    put_msec(s, histogram_percentile(h, 50));
+    put_msec(s, histogram_percentile(h, 99));
+    put_msec(s, h->max);
+    put_msec(s, h->total);
+}
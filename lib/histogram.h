@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2011 Nicira Networks.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H 1
+
+/* Fixed-bucket histogram of nonnegative integer values, typically durations in
+ * microseconds.
+ *
+ * Values 0 through 3 each have their own bucket.  Beyond that, each power of 2
+ * is divided into 4 buckets, so that a value's bucket bounds it within 25%.
+ * Values are capped at UINT32_MAX.  Adding a value is O(1) and a histogram
+ * takes about 500 bytes, so histograms are cheap enough to keep on hot
+ * paths. */
+
+struct ds;
+
+#define HISTOGRAM_N_BUCKETS 124
+
+struct histogram {
+    unsigned long long int n;           /* Number of values. */
+    unsigned long long int total;       /* Sum of values. */
+    unsigned long long int max;         /* Largest value. */
+    unsigned int buckets[HISTOGRAM_N_BUCKETS];
+};
+
+void histogram_clear(struct histogram *);
+void histogram_add(struct histogram *, unsigned long long int value);
+unsigned long long int histogram_percentile(const struct histogram *,
+                                            int percent);
+unsigned long long int histogram_permille(const struct histogram *,
+                                          int permille);
+
+void histogram_format_msec(const struct histogram *, struct ds *);
+
+#endif /* histogram.h */
@@ -27,6 +27,12 @@ COVERAGE_DEFINE(hmap_pathological);
 COVERAGE_DEFINE(hmap_expand);
 COVERAGE_DEFINE(hmap_shrink);
 COVERAGE_DEFINE(hmap_reserve);
+COVERAGE_DEFINE(hmap_rehash_finish);
+
+/* Number of old buckets that hmap_rehash_step() migrates. */
+#define HMAP_MIGRATE_BUCKETS 4
+
+static void hmap_rehash_finish(struct hmap *);
 
 /* Initializes 'hmap' as an empty hash table. */
 void
@@ -36,6 +42,10 @@ hmap_init(struct hmap *hmap)
     hmap->one = NULL;
     hmap->mask = 0;
     hmap->n = 0;
+    hmap->old_buckets = NULL;
+    hmap->old_mask = 0;
+    hmap->migrated = 0;
+    hmap->incremental = false;
 }
 
 /* Frees memory reserved by 'hmap'.  It is the client's responsibility to free
@@ -46,6 +56,9 @@ hmap_destroy(struct hmap *hmap)
     if (hmap && hmap->buckets != &hmap->one) {
         free(hmap->buckets);
     }
+    if (hmap) {
+        free(hmap->old_buckets);
+    }
 }
 
 /* Removes all node from 'hmap', leaving it ready to accept more nodes.  Does
@@ -58,6 +71,12 @@ hmap_destroy(struct hmap *hmap)
 void
 hmap_clear(struct hmap *hmap)
 {
+    if (hmap->old_buckets) {
+        free(hmap->old_buckets);
+        hmap->old_buckets = NULL;
+        hmap->old_mask = 0;
+        hmap->migrated = 0;
+    }
     if (hmap->n > 0) {
         hmap->n = 0;
         memset(hmap->buckets, 0, (hmap->mask + 1) * sizeof *hmap->buckets);
@@ -94,7 +113,9 @@ resize(struct hmap *hmap, size_t new_mask)
     assert(!(new_mask & (new_mask + 1)));
     assert(new_mask != SIZE_MAX);
 
+    hmap_rehash_finish(hmap);
     hmap_init(&tmp);
+    tmp.incremental = hmap->incremental;
     if (new_mask) {
         tmp.buckets = xmalloc(sizeof *tmp.buckets * (new_mask + 1));
         tmp.mask = new_mask;
@@ -138,6 +159,26 @@ calc_mask(size_t capacity)
     return mask;
 }
 
+/* Replaces the buckets in 'hmap' by a new array with 'new_mask' + 1 buckets,
+ * without moving any nodes.  hmap_rehash_step() then moves the nodes from the
+ * old buckets into the new ones a few buckets at a time. */
+static void
+begin_rehash(struct hmap *hmap, size_t new_mask)
+{
+    assert(!(new_mask & (new_mask + 1)));
+    assert(new_mask > hmap->mask && hmap->mask);
+
+    hmap_rehash_finish(hmap);
+    hmap->old_buckets = hmap->buckets;
+    hmap->old_mask = hmap->mask;
+    hmap->migrated = 0;
+
+    /* xcalloc() rather than a loop, because large zeroed allocations are
+     * often nearly free. */
+    hmap->buckets = xcalloc(new_mask + 1, sizeof *hmap->buckets);
+    hmap->mask = new_mask;
+}
+
 /* Expands 'hmap', if necessary, to optimize the performance of searches. */
 void
 hmap_expand(struct hmap *hmap)
@@ -145,7 +186,11 @@ hmap_expand(struct hmap *hmap)
     size_t new_mask = calc_mask(hmap->n);
     if (new_mask > hmap->mask) {
         COVERAGE_INC(hmap_expand);
-        resize(hmap, new_mask);
+        if (hmap->incremental && hmap->mask) {
+            begin_rehash(hmap, new_mask);
+        } else {
+            resize(hmap, new_mask);
+        }
     }
 }
 
@@ -173,13 +218,113 @@ hmap_reserve(struct hmap *hmap, size_t n)
     }
 }
 
+/* Configures whether 'hmap' expands incrementally.  By default, when an hmap
+ * expands, it rehashes all of its nodes at once, which takes time
+ * proportional to the number of nodes.  When 'incremental' is true, expanding
+ * 'hmap' only allocates its new buckets, and each later call to hmap_insert()
+ * moves a few of the nodes from the old buckets into the new ones, so that no
+ * single insertion takes very long.  Searching and iterating remain correct
+ * throughout, at the cost of searching in two bucket arrays until the nodes
+ * have all been moved.
+ *
+ * Only hmap_insert() moves nodes, because searches and iteration take a const
+ * hmap and because removing nodes must be possible during iteration.
+ * hmap_shrink(), hmap_reserve(), and a second expansion finish any pending
+ * migration first. */
+void
+hmap_set_incremental(struct hmap *hmap, bool incremental)
+{
+    hmap->incremental = incremental;
+    if (!incremental) {
+        hmap_rehash_finish(hmap);
+    }
+}
+
+/* Moves the nodes in a few of the old buckets in 'hmap' into its new buckets,
+ * if 'hmap' is being rehashed incrementally. */
+void
+hmap_rehash_step(struct hmap *hmap)
+{
+    size_t i;
+
+    for (i = 0; i < HMAP_MIGRATE_BUCKETS && hmap->old_buckets; i++) {
+        struct hmap_node **old_bucket = &hmap->old_buckets[hmap->migrated];
+        struct hmap_node *node, *next;
+
+        for (node = *old_bucket; node; node = next) {
+            struct hmap_node **bucket = &hmap->buckets[node->hash
+                                                       & hmap->mask];
+
+            next = node->next;
+            node->next = *bucket;
+            *bucket = node;
+        }
+        *old_bucket = NULL;
+
+        if (++hmap->migrated > hmap->old_mask) {
+            free(hmap->old_buckets);
+            hmap->old_buckets = NULL;
+            hmap->old_mask = 0;
+            hmap->migrated = 0;
+        }
+    }
+}
+
+/* Moves all of the nodes remaining in the old buckets in 'hmap', if any, into
+ * its new buckets. */
+static void
+hmap_rehash_finish(struct hmap *hmap)
+{
+    if (hmap->old_buckets) {
+        COVERAGE_INC(hmap_rehash_finish);
+        while (hmap->old_buckets) {
+            hmap_rehash_step(hmap);
+        }
+    }
+}
+
+/* Returns the first node in an old bucket of 'hmap' whose index is 'start' or
+ * greater, or a null pointer if there is no such node.  For use by
+ * hmap_next__() only. */
+struct hmap_node *
+hmap_next_old__(const struct hmap *hmap, size_t start)
+{
+    size_t i;
+
+    for (i = MAX(start, hmap->migrated); i <= hmap->old_mask; i++) {
+        struct hmap_node *node = hmap->old_buckets[i];
+        if (node) {
+            return node;
+        }
+    }
+    return NULL;
+}
+
+/* Returns the first node in the bucket at 'position' in iteration order in
+ * 'hmap' (see hmap_position__()), where 'position' must be less than
+ * hmap_n_positions(hmap). */
+static struct hmap_node *
+hmap_at_bucket(const struct hmap *hmap, size_t position)
+{
+    return (position <= hmap->mask
+            ? hmap->buckets[position]
+            : hmap->old_buckets[position - (hmap->mask + 1)]);
+}
+
+/* Returns the number of buckets in 'hmap', old and new together. */
+static size_t
+hmap_n_positions(const struct hmap *hmap)
+{
+    return hmap->mask + 1 + (hmap->old_buckets ? hmap->old_mask + 1 : 0);
+}
+
 /* Adjusts 'hmap' to compensate for 'old_node' having moved position in memory
  * to 'node' (e.g. due to realloc()). */
 void
 hmap_node_moved(struct hmap *hmap,
                 struct hmap_node *old_node, struct hmap_node *node)
 {
-    struct hmap_node **bucket = &hmap->buckets[node->hash & hmap->mask];
+    struct hmap_node **bucket = hmap_bucket__(hmap, node->hash);
     while (*bucket != old_node) {
         bucket = &(*bucket)->next;
     }
@@ -194,12 +339,13 @@ hmap_node_moved(struct hmap *hmap,
 struct hmap_node *
 hmap_random_node(const struct hmap *hmap)
 {
+    size_t n_positions = hmap_n_positions(hmap);
     struct hmap_node *bucket, *node;
     size_t n, i;
 
     /* Choose a random non-empty bucket. */
     for (i = random_uint32(); ; i++) {
-        bucket = hmap->buckets[i & hmap->mask];
+        bucket = hmap_at_bucket(hmap, i % n_positions);
         if (bucket) {
             break;
         }
@@ -237,18 +383,19 @@ hmap_at_position(const struct hmap *hmap,
     size_t b_idx;
 
     offset = *offsetp;
-    for (b_idx = *bucketp; b_idx <= hmap->mask; b_idx++) {
+    for (b_idx = *bucketp; b_idx < hmap_n_positions(hmap); b_idx++) {
         struct hmap_node *node;
         size_t n_idx;
 
-        for (n_idx = 0, node = hmap->buckets[b_idx]; node != NULL;
+        for (n_idx = 0, node = hmap_at_bucket(hmap, b_idx); node != NULL;
              n_idx++, node = node->next) {
             if (n_idx == offset) {
+                size_t position = hmap_position__(hmap, node->hash);
                 if (node->next) {
-                    *bucketp = node->hash & hmap->mask;
+                    *bucketp = position;
                     *offsetp = offset + 1;
                 } else {
-                    *bucketp = (node->hash & hmap->mask) + 1;
+                    *bucketp = position + 1;
                     *offsetp = 0;
                 }
                 return node;
@@ -56,16 +56,29 @@ hmap_node_nullify(struct hmap_node *node)
     node->next = HMAP_NODE_NULL;
 }
 
-/* A hash map. */
+/* A hash map.
+ *
+ * An hmap normally rehashes all of its nodes at once when it expands.  An hmap
+ * on which hmap_set_incremental() has been called instead keeps its old bucket
+ * array around after expanding and moves a few old buckets into the new array
+ * on each hmap_insert().  While this migration is in progress, a node with a
+ * given hash is in 'old_buckets' if its old bucket has not been migrated yet,
+ * that is, if (hash & old_mask) >= migrated, and in 'buckets' otherwise. */
 struct hmap {
     struct hmap_node **buckets; /* Must point to 'one' iff 'mask' == 0. */
     struct hmap_node *one;
     size_t mask;
     size_t n;
+
+    /* Incremental rehashing. */
+    struct hmap_node **old_buckets; /* Buckets being migrated, or NULL. */
+    size_t old_mask;            /* Mask for 'old_buckets'. */
+    size_t migrated;            /* Old buckets below this index are empty. */
+    bool incremental;           /* Expand incrementally? */
 };
 
 /* Initializer for an empty hash map. */
-#define HMAP_INITIALIZER(HMAP) { &(HMAP)->one, NULL, 0, 0 }
+#define HMAP_INITIALIZER(HMAP) { &(HMAP)->one, NULL, 0, 0, NULL, 0, 0, false }
 
 /* Initialization. */
 void hmap_init(struct hmap *);
@@ -80,6 +93,8 @@ static inline bool hmap_is_empty(const struct hmap *);
 void hmap_expand(struct hmap *);
 void hmap_shrink(struct hmap *);
 void hmap_reserve(struct hmap *, size_t capacity);
+void hmap_set_incremental(struct hmap *, bool incremental);
+void hmap_rehash_step(struct hmap *);
 
 /* Insertion and deletion. */
 static inline void hmap_insert_fast(struct hmap *,
@@ -159,6 +174,29 @@ static inline struct hmap_node *hmap_next(const struct hmap *,
 
 struct hmap_node *hmap_at_position(const struct hmap *,
                                    uint32_t *bucket, uint32_t *offset);
+struct hmap_node *hmap_next_old__(const struct hmap *, size_t start);
+
+/* Returns the bucket in 'hmap' that holds nodes with the given 'hash'. */
+static inline struct hmap_node **
+hmap_bucket__(const struct hmap *hmap, size_t hash)
+{
+    if (hmap->old_buckets && (hash & hmap->old_mask) >= hmap->migrated) {
+        return &hmap->old_buckets[hash & hmap->old_mask];
+    }
+    return &hmap->buckets[hash & hmap->mask];
+}
+
+/* Returns the position of the bucket in 'hmap' that holds nodes with the given
+ * 'hash', in iteration order: positions 0 through 'mask' are in 'buckets',
+ * and positions after those are in 'old_buckets'. */
+static inline size_t
+hmap_position__(const struct hmap *hmap, size_t hash)
+{
+    if (hmap->old_buckets && (hash & hmap->old_mask) >= hmap->migrated) {
+        return hmap->mask + 1 + (hash & hmap->old_mask);
+    }
+    return hash & hmap->mask;
+}
 
 /* Returns the number of nodes currently in 'hmap'. */
 static inline size_t
@@ -188,7 +226,7 @@ hmap_is_empty(const struct hmap *hmap)
 static inline void
 hmap_insert_fast(struct hmap *hmap, struct hmap_node *node, size_t hash)
 {
-    struct hmap_node **bucket = &hmap->buckets[hash & hmap->mask];
+    struct hmap_node **bucket = hmap_bucket__(hmap, hash);
     node->hash = hash;
     node->next = *bucket;
     *bucket = node;
@@ -196,12 +234,15 @@ hmap_insert_fast(struct hmap *hmap, struct hmap_node *node, size_t hash)
 }
 
 /* Inserts 'node', with the given 'hash', into 'hmap', and expands 'hmap' if
- * necessary to optimize search performance. */
+ * necessary to optimize search performance.  If 'hmap' is being rehashed
+ * incrementally, also moves a few more nodes into its new buckets. */
 static inline void
 hmap_insert(struct hmap *hmap, struct hmap_node *node, size_t hash)
 {
     hmap_insert_fast(hmap, node, hash);
-    if (hmap->n / 2 > hmap->mask) {
+    if (hmap->old_buckets) {
+        hmap_rehash_step(hmap);
+    } else if (hmap->n / 2 > hmap->mask) {
         hmap_expand(hmap);
     }
 }
@@ -211,7 +252,7 @@ hmap_insert(struct hmap *hmap, struct hmap_node *node, size_t hash)
 static inline void
 hmap_remove(struct hmap *hmap, struct hmap_node *node)
 {
-    struct hmap_node **bucket = &hmap->buckets[node->hash & hmap->mask];
+    struct hmap_node **bucket = hmap_bucket__(hmap, node->hash);
     while (*bucket != node) {
         bucket = &(*bucket)->next;
     }
@@ -230,7 +271,7 @@ static inline void
 hmap_replace(struct hmap *hmap,
              const struct hmap_node *old_node, struct hmap_node *new_node)
 {
-    struct hmap_node **bucket = &hmap->buckets[old_node->hash & hmap->mask];
+    struct hmap_node **bucket = hmap_bucket__(hmap, old_node->hash);
     while (*bucket != old_node) {
         bucket = &(*bucket)->next;
     }
@@ -253,7 +294,7 @@ hmap_next_with_hash__(const struct hmap_node *node, size_t hash)
 static inline struct hmap_node *
 hmap_first_with_hash(const struct hmap *hmap, size_t hash)
 {
-    return hmap_next_with_hash__(hmap->buckets[hash & hmap->mask], hash);
+    return hmap_next_with_hash__(*hmap_bucket__(hmap, hash), hash);
 }
 
 /* Returns the first node in 'hmap' in the bucket in which the given 'hash'
@@ -261,7 +302,7 @@ hmap_first_with_hash(const struct hmap *hmap, size_t hash)
 static inline struct hmap_node *
 hmap_first_in_bucket(const struct hmap *hmap, size_t hash)
 {
-    return hmap->buckets[hash & hmap->mask];
+    return *hmap_bucket__(hmap, hash);
 }
 
 /* Returns the next node in the same bucket as 'node', or a null pointer if
@@ -302,7 +343,9 @@ hmap_next__(const struct hmap *hmap, size_t start)
             return node;
         }
     }
-    return NULL;
+    return (hmap->old_buckets
+            ? hmap_next_old__(hmap, i - (hmap->mask + 1))
+            : NULL);
 }
 
 /* Returns the first node in 'hmap', in arbitrary order, or a null pointer if
@@ -325,7 +368,7 @@ hmap_next(const struct hmap *hmap, const struct hmap_node *node)
 {
     return (node->next
             ? node->next
-            : hmap_next__(hmap, (node->hash & hmap->mask) + 1));
+            : hmap_next__(hmap, hmap_position__(hmap, node->hash) + 1));
 }
 
 #ifdef  __cplusplus
@@ -26,6 +26,7 @@
 #include "fatal-signal.h"
 #include "json.h"
 #include "list.h"
+#include "memory.h"
 #include "ofpbuf.h"
 #include "poll-loop.h"
 #include "reconnect.h"
@@ -34,6 +35,9 @@
 #include "vlog.h"
 
 VLOG_DEFINE_THIS_MODULE(jsonrpc);
+
+/* Messages queued for sending but not yet sent. */
+MEMORY_DEFINE(jsonrpc_backlog);
 
 struct jsonrpc {
     struct stream *stream;
@@ -118,6 +122,7 @@ jsonrpc_run(struct jsonrpc *rpc)
             ofpbuf_pull(buf, retval);
             if (!buf->size) {
                 list_remove(&buf->list_node);
+                memory_dec(&memory_jsonrpc_backlog, buf->allocated);
                 ofpbuf_delete(buf);
             }
         } else {
@@ -222,6 +227,7 @@ jsonrpc_send(struct jsonrpc *rpc, struct jsonrpc_msg *msg)
     ofpbuf_use(buf, s, length);
     buf->size = length;
     list_push_back(&rpc->output, &buf->list_node);
+    memory_inc(&memory_jsonrpc_backlog, buf->allocated);
     rpc->backlog += length;
 
     if (rpc->backlog == length) {
@@ -409,6 +415,8 @@ jsonrpc_error(struct jsonrpc *rpc, int error)
 static void
 jsonrpc_cleanup(struct jsonrpc *rpc)
 {
+    struct ofpbuf *buf;
+
     stream_close(rpc->stream);
     rpc->stream = NULL;
 
@@ -418,6 +426,9 @@ jsonrpc_cleanup(struct jsonrpc *rpc)
     jsonrpc_msg_destroy(rpc->received);
     rpc->received = NULL;
 
+    LIST_FOR_EACH (buf, list_node, &rpc->output) {
+        memory_dec(&memory_jsonrpc_backlog, buf->allocated);
+    }
     ofpbuf_list_delete(&rpc->output);
     rpc->backlog = 0;
 }
@@ -67,6 +67,17 @@ struct lswitch {
 
     /* Number of outgoing queued packets on the rconn. */
     struct rconn_packet_counter *queued;
+
+    /* Batching (see lswitch_flush()). */
+    bool batch;                 /* Hold back messages until lswitch_flush()? */
+    struct ofpbuf *txbuf;       /* Messages held back, or NULL. */
+    struct hmap batch_flows;    /* Contains "struct lswitch_batch_flow"s. */
+};
+
+/* A flow that has been added to a switch's pending batch of messages. */
+struct lswitch_batch_flow {
+    struct hmap_node hmap_node; /* In struct lswitch's 'batch_flows'. */
+    struct flow flow;           /* Flow, with wildcarded fields zeroed. */
 };
 
 /* The log messages here could actually be useful in debugging, so keep the
@@ -74,6 +85,8 @@ struct lswitch {
 static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(30, 300);
 
 static void queue_tx(struct lswitch *, struct rconn *, struct ofpbuf *);
+static void send_tx(struct lswitch *, struct rconn *, struct ofpbuf *);
+static void clear_batch_flows(struct lswitch *);
 static void send_features_request(struct lswitch *, struct rconn *);
 
 static void process_switch_features(struct lswitch *,
@@ -133,6 +146,9 @@ lswitch_create(struct rconn *rconn, const struct lswitch_config *cfg)
     }
 
     sw->queued = rconn_packet_counter_create();
+    sw->batch = cfg->batch;
+    sw->txbuf = NULL;
+    hmap_init(&sw->batch_flows);
     send_features_request(sw, rconn);
 
     if (cfg->default_flows) {
@@ -140,7 +156,15 @@ lswitch_create(struct rconn *rconn, const struct lswitch_config *cfg)
 
         LIST_FOR_EACH (b, list_node, cfg->default_flows) {
             struct ofpbuf *copy = ofpbuf_clone(b);
-            int error = rconn_send(rconn, copy, NULL);
+            int error;
+
+            if (sw->batch) {
+                /* Goes out with the features request, in lswitch_flush(). */
+                queue_tx(sw, rconn, copy);
+                continue;
+            }
+
+            error = rconn_send(rconn, copy, NULL);
             if (error) {
                 VLOG_INFO_RL(&rl, "%s: failed to queue default flows (%s)",
                              rconn_get_name(rconn), strerror(error));
@@ -149,6 +173,7 @@ lswitch_create(struct rconn *rconn, const struct lswitch_config *cfg)
             }
         }
     }
+    lswitch_flush(sw, rconn);
 
     return sw;
 }
@@ -167,6 +192,9 @@ lswitch_destroy(struct lswitch *sw)
         shash_destroy(&sw->queue_names);
         mac_learning_destroy(sw->ml);
         rconn_packet_counter_destroy(sw->queued);
+        ofpbuf_delete(sw->txbuf);
+        clear_batch_flows(sw);
+        hmap_destroy(&sw->batch_flows);
         free(sw);
     }
 }
@@ -261,8 +289,12 @@ lswitch_process_packet(struct lswitch *sw, struct rconn *rconn,
     case OFPUTIL_NXT_FLOW_REMOVED:
     case OFPUTIL_NXST_FLOW_REQUEST:
     case OFPUTIL_NXST_AGGREGATE_REQUEST:
+    case OFPUTIL_NXST_FLOW_DIGEST_REQUEST:
+    case OFPUTIL_NXST_FLOW_BUCKETS_REQUEST:
     case OFPUTIL_NXST_FLOW_REPLY:
     case OFPUTIL_NXST_AGGREGATE_REPLY:
+    case OFPUTIL_NXST_FLOW_DIGEST_REPLY:
+    case OFPUTIL_NXST_FLOW_BUCKETS_REPLY:
     default:
         if (VLOG_IS_DBG_ENABLED()) {
             char *s = ofp_to_string(msg->data, msg->size, 2);
@@ -273,6 +305,63 @@ lswitch_process_packet(struct lswitch *sw, struct rconn *rconn,
     }
 }
 
+/* If 'sw' was configured to batch its messages, sends all of the OpenFlow
+ * messages that it has generated since the last call to lswitch_flush() to
+ * 'rconn' as a single transmission.  Otherwise, does nothing.
+ *
+ * Within a batch, 'sw' sets up each flow at most once.  Additional packets
+ * for a flow already set up in the same batch are forwarded with a
+ * packet-out (referring to the switch's buffered copy, if any), instead of
+ * with a redundant flow setup. */
+void
+lswitch_flush(struct lswitch *sw, struct rconn *rconn)
+{
+    if (sw->txbuf) {
+        struct ofpbuf *txbuf = sw->txbuf;
+
+        sw->txbuf = NULL;
+        send_tx(sw, rconn, txbuf);
+    }
+    clear_batch_flows(sw);
+}
+
+static void
+clear_batch_flows(struct lswitch *sw)
+{
+    struct lswitch_batch_flow *bf, *next;
+
+    HMAP_FOR_EACH_SAFE (bf, next, hmap_node, &sw->batch_flows) {
+        hmap_remove(&sw->batch_flows, &bf->hmap_node);
+        free(bf);
+    }
+}
+
+/* Returns true if 'flow' has already been set up in the current batch of
+ * messages for 'sw', otherwise records that it has been and returns false.
+ * Always returns false if 'sw' does not batch messages. */
+static bool
+flow_set_up_in_batch(struct lswitch *sw, const struct flow *flow)
+{
+    struct lswitch_batch_flow *bf;
+    uint32_t hash;
+
+    if (!sw->batch) {
+        return false;
+    }
+
+    hash = flow_hash(flow, 0);
+    HMAP_FOR_EACH_WITH_HASH (bf, hmap_node, hash, &sw->batch_flows) {
+        if (flow_equal(&bf->flow, flow)) {
+            return true;
+        }
+    }
+
+    bf = xmalloc(sizeof *bf);
+    bf->flow = *flow;
+    hmap_insert(&sw->batch_flows, &bf->hmap_node, hash);
+    return false;
+}
+
 static void
 send_features_request(struct lswitch *sw, struct rconn *rconn)
 {
@@ -296,6 +385,19 @@ send_features_request(struct lswitch *sw, struct rconn *rconn)
 
 static void
 queue_tx(struct lswitch *sw, struct rconn *rconn, struct ofpbuf *b)
+{
+    if (!sw->batch) {
+        send_tx(sw, rconn, b);
+    } else if (!sw->txbuf) {
+        sw->txbuf = b;
+    } else {
+        ofpbuf_put(sw->txbuf, b->data, b->size);
+        ofpbuf_delete(b);
+    }
+}
+
+static void
+send_tx(struct lswitch *sw, struct rconn *rconn, struct ofpbuf *b)
 {
     int retval = rconn_send_with_limit(rconn, b, sw->queued, 10);
     if (retval && retval != ENOTCONN) {
@@ -458,12 +560,18 @@ process_packet_in(struct lswitch *sw, struct rconn *rconn,
         struct cls_rule rule;
 
         /* The output port is known, or we always flood everything, so add a
-         * new flow. */
+         * new flow, unless we already did so earlier in this batch. */
         cls_rule_init(&flow, &sw->wc, 0, &rule);
-        buffer = make_add_flow(&rule, ntohl(opi->buffer_id),
-                               sw->max_idle, actions_len);
-        ofpbuf_put(buffer, actions, actions_len);
-        queue_tx(sw, rconn, buffer);
+        if (!flow_set_up_in_batch(sw, &rule.flow)) {
+            buffer = make_add_flow(&rule, ntohl(opi->buffer_id),
+                                   sw->max_idle, actions_len);
+            ofpbuf_put(buffer, actions, actions_len);
+            queue_tx(sw, rconn, buffer);
+        } else if (ntohl(opi->buffer_id) != UINT32_MAX) {
+            queue_tx(sw, rconn,
+                     make_packet_out(NULL, ntohl(opi->buffer_id), in_port,
+                                     actions, actions_len / sizeof *actions));
+        }
 
         /* If the switch didn't buffer the packet, we need to send a copy. */
         if (ntohl(opi->buffer_id) == UINT32_MAX && actions_len > 0) {
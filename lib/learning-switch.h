@@ -57,6 +57,11 @@ struct lswitch_config {
 
     /* Maps from a port name to a queue_id (cast to void *). */
     const struct shash *port_queues;
+
+    /* If true, OpenFlow messages sent in response to received messages are
+     * held back until the caller calls lswitch_flush(), then sent as a
+     * single transmission.  If false, each message is sent immediately. */
+    bool batch;
 };
 
 struct lswitch *lswitch_create(struct rconn *, const struct lswitch_config *);
@@ -66,6 +71,7 @@ void lswitch_wait(struct lswitch *);
 void lswitch_destroy(struct lswitch *);
 void lswitch_process_packet(struct lswitch *, struct rconn *,
                             const struct ofpbuf *);
+void lswitch_flush(struct lswitch *, struct rconn *);
 
 
 #endif /* learning-switch.h */
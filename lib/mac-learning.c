@@ -25,6 +25,7 @@
 #include "coverage.h"
 #include "hash.h"
 #include "list.h"
+#include "memory.h"
 #include "poll-loop.h"
 #include "tag.h"
 #include "timeval.h"
@@ -37,6 +38,8 @@ VLOG_DEFINE_THIS_MODULE(mac_learning);
 COVERAGE_DEFINE(mac_learning_learned);
 COVERAGE_DEFINE(mac_learning_expired);
 
+MEMORY_DEFINE(mac_entry);
+
 /* Returns the number of seconds since 'e' was last learned. */
 int
 mac_entry_age(const struct mac_entry *e)
@@ -121,6 +124,7 @@ mac_learning_destroy(struct mac_learning *ml)
 
         HMAP_FOR_EACH_SAFE (e, next, hmap_node, &ml->table) {
             hmap_remove(&ml->table, &e->hmap_node);
+            memory_dec(&memory_mac_entry, sizeof *e);
             free(e);
         }
         hmap_destroy(&ml->table);
@@ -188,6 +192,7 @@ mac_learning_insert(struct mac_learning *ml,
         }
 
         e = xmalloc(sizeof *e);
+        memory_inc(&memory_mac_entry, sizeof *e);
         hmap_insert(&ml->table, &e->hmap_node, hash);
         memcpy(e->mac, src_mac, ETH_ADDR_LEN);
         e->vlan = vlan;
@@ -257,6 +262,7 @@ mac_learning_expire(struct mac_learning *ml, struct mac_entry *e)
 {
     hmap_remove(&ml->table, &e->hmap_node);
     list_remove(&e->lru_node);
+    memory_dec(&memory_mac_entry, sizeof *e);
     free(e);
 }
 
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2011 Nicira Networks.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <config.h>
+#include "memory.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include "dynamic-string.h"
+#include "unixctl.h"
+#include "util.h"
+#include "vlog.h"
+
+VLOG_DEFINE_THIS_MODULE(memory);
+
+/* All the memory counters that have been used. */
+static struct memory_counter *all_counters;
+static size_t n_counters;
+
+/* Log each counter's growth past this many bytes, then past twice as many,
+ * and so on, or never if 0. */
+static long long int log_threshold;
+
+/* Returns the smallest power-of-2 multiple of 'log_threshold' that exceeds
+ * 'c''s current size, or LLONG_MAX if growth logging is disabled. */
+static long long int
+next_log_point(const struct memory_counter *c)
+{
+    long long int next;
+
+    if (!log_threshold) {
+        return LLONG_MAX;
+    }
+    for (next = log_threshold; next <= c->bytes; next *= 2) {
+        if (next > LLONG_MAX / 2) {
+            return LLONG_MAX;
+        }
+    }
+    return next;
+}
+
+void
+memory_register__(struct memory_counter *c)
+{
+    c->registered = true;
+    c->next = all_counters;
+    c->next_log = next_log_point(c);
+    all_counters = c;
+    n_counters++;
+}
+
+void
+memory_log__(struct memory_counter *c)
+{
+    VLOG_INFO("%s: %lld objects, %lld kB", c->name, c->n, c->bytes / 1024);
+    c->next_log = next_log_point(c);
+}
+
+static int
+compare_counters(const void *a_, const void *b_)
+{
+    const struct memory_counter *const *a = a_;
+    const struct memory_counter *const *b = b_;
+
+    return strcmp((*a)->name, (*b)->name);
+}
+
+static void
+memory_unixctl_show(struct unixctl_conn *conn, const char *args OVS_UNUSED,
+                    void *aux OVS_UNUSED)
+{
+    struct memory_counter **counters;
+    struct memory_counter *c;
+    struct rusage usage;
+    struct ds s;
+    size_t i;
+
+    counters = xmalloc(n_counters * sizeof *counters);
+    i = 0;
+    for (c = all_counters; c; c = c->next) {
+        counters[i++] = c;
+    }
+    qsort(counters, n_counters, sizeof *counters, compare_counters);
+
+    ds_init(&s);
+    ds_put_cstr(&s, "counter                   count        bytes\n");
+    for (i = 0; i < n_counters; i++) {
+        c = counters[i];
+        ds_put_format(&s, "%-20s %10lld %12lld\n", c->name, c->n, c->bytes);
+    }
+    free(counters);
+
+    if (!getrusage(RUSAGE_SELF, &usage)) {
+        ds_put_format(&s, "peak resident set size: %ld kB\n",
+                      usage.ru_maxrss);
+    }
+    if (log_threshold) {
+        ds_put_format(&s, "logging growth past %lld kB\n",
+                      log_threshold / 1024);
+    }
+    unixctl_command_reply(conn, 200, ds_cstr(&s));
+    ds_destroy(&s);
+}
+
+static void
+memory_unixctl_log_threshold(struct unixctl_conn *conn, const char *args,
+                             void *aux OVS_UNUSED)
+{
+    struct memory_counter *c;
+    unsigned int kb;
+
+    if (!str_to_uint(args, 10, &kb)) {
+        unixctl_command_reply(conn, 501, "argument must be a nonnegative "
+                              "number of kilobytes");
+        return;
+    }
+    log_threshold = kb * 1024LL;
+    for (c = all_counters; c; c = c->next) {
+        c->next_log = next_log_point(c);
+    }
+    unixctl_command_reply(conn, 200, NULL);
+}
+
+/* Registers the "memory/show" and "memory/log-threshold" commands. */
+void
+memory_init_command(void)
+{
+    unixctl_command_register("memory/show", memory_unixctl_show, NULL);
+    unixctl_command_register("memory/log-threshold",
+                             memory_unixctl_log_threshold, NULL);
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2011 Nicira Networks.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MEMORY_H
+#define MEMORY_H 1
+
+/* Memory accounting.
+ *
+ * A "memory counter" tracks the number of live objects of some kind and the
+ * number of bytes that they occupy.  Modules that allocate many objects of a
+ * kind, e.g. facets or MAC learning entries, report each allocation and free
+ * with memory_inc() and memory_dec(), and the "memory/show" command reported
+ * by ovs-appctl lists the totals.  This makes it possible to tell which
+ * kind of object is responsible when a daemon grows large.
+ *
+ * Like coverage counters, memory counters are cheap enough to be left enabled
+ * in production builds. */
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* A memory counter. */
+struct memory_counter {
+    const char *name;           /* Textual name. */
+    struct memory_counter *next; /* Next in list of all counters. */
+    bool registered;            /* In list of all counters? */
+    long long int n;            /* Number of live objects. */
+    long long int bytes;        /* Bytes in live objects. */
+    long long int next_log;     /* Log when 'bytes' reaches this value. */
+};
+
+/* Defines a memory counter named NAME, as a static variable named
+ * memory_NAME.  Each counter should have a unique NAME within a program. */
+#define MEMORY_DEFINE(NAME) \
+        static struct memory_counter memory_##NAME = { #NAME, NULL, false, \
+                                                       0, 0, LLONG_MAX }
+
+void memory_init_command(void);
+
+void memory_register__(struct memory_counter *);
+void memory_log__(struct memory_counter *);
+
+/* Records that an object of 'bytes' bytes has been allocated. */
+static inline void
+memory_inc(struct memory_counter *c, size_t bytes)
+{
+    if (!c->registered) {
+        memory_register__(c);
+    }
+    c->n++;
+    c->bytes += bytes;
+    if (c->bytes >= c->next_log) {
+        memory_log__(c);
+    }
+}
+
+/* Records that an object of 'bytes' bytes has been freed. */
+static inline void
+memory_dec(struct memory_counter *c, size_t bytes)
+{
+    c->n--;
+    c->bytes -= bytes;
+}
+
+/* Records that an existing object has grown or shrunk from 'old_bytes' to
+ * 'new_bytes' bytes. */
+static inline void
+memory_resize(struct memory_counter *c, size_t old_bytes, size_t new_bytes)
+{
+    c->bytes += (long long int) new_bytes - (long long int) old_bytes;
+    if (c->bytes >= c->next_log) {
+        memory_log__(c);
+    }
+}
+
+#endif /* memory.h */
@@ -19,15 +19,30 @@
 #include "dummy.h"
 
 #include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "dynamic-string.h"
+#include "flow.h"
 #include "list.h"
 #include "netdev-provider.h"
+#include "odp-util.h"
+#include "ofpbuf.h"
 #include "packets.h"
+#include "pcap.h"
+#include "poll-loop.h"
 #include "shash.h"
+#include "timeval.h"
+#include "unixctl.h"
 #include "vlog.h"
 
 VLOG_DEFINE_THIS_MODULE(netdev_dummy);
 
+/* Maximum number of packets queued for reception on a dummy device.  Packets
+ * injected beyond this are counted as rx_dropped. */
+#define NETDEV_DUMMY_MAX_QUEUE 65536
+
 struct netdev_dev_dummy {
     struct netdev_dev netdev_dev;
     uint8_t hwaddr[ETH_ADDR_LEN];
@@ -35,10 +50,25 @@ struct netdev_dev_dummy {
     struct netdev_stats stats;
     enum netdev_flags flags;
     unsigned int change_seq;
+
+    /* Packets waiting to be received, as "struct ofpbuf"s. */
+    struct list rxq;
+    size_t rxq_len;
+
+    /* Packet generator.  After the packets in 'rxq', the device receives
+     * 'gen_remaining' more packets, cycling through 'gen_packets'. */
+    struct ofpbuf **gen_packets;
+    size_t n_gen_packets;
+    size_t gen_next;            /* Index of next packet in 'gen_packets'. */
+    unsigned long long int gen_remaining;
+
+    /* Transmit capture. */
+    struct pcap_writer *tx_pcap; /* If nonnull, sent packets go here. */
 };
 
 struct netdev_dummy {
     struct netdev netdev;
+    bool listening;             /* Receives packets? */
 };
 
 static int netdev_dummy_create(const struct netdev_class *, const char *,
@@ -84,6 +114,7 @@ netdev_dummy_create(const struct netdev_class *class, const char *name,
     netdev_dev->mtu = 1500;
     netdev_dev->flags = 0;
     netdev_dev->change_seq = 1;
+    list_init(&netdev_dev->rxq);
 
     n++;
 
@@ -92,11 +123,41 @@ netdev_dummy_create(const struct netdev_class *class, const char *name,
     return 0;
 }
 
+static void
+netdev_dummy_clear_generator(struct netdev_dev_dummy *dev)
+{
+    size_t i;
+
+    for (i = 0; i < dev->n_gen_packets; i++) {
+        ofpbuf_delete(dev->gen_packets[i]);
+    }
+    free(dev->gen_packets);
+    dev->gen_packets = NULL;
+    dev->n_gen_packets = 0;
+    dev->gen_next = 0;
+    dev->gen_remaining = 0;
+}
+
+static void
+netdev_dummy_clear_rxq(struct netdev_dev_dummy *dev)
+{
+    struct ofpbuf *packet, *next;
+
+    LIST_FOR_EACH_SAFE (packet, next, list_node, &dev->rxq) {
+        list_remove(&packet->list_node);
+        ofpbuf_delete(packet);
+    }
+    dev->rxq_len = 0;
+}
+
 static void
 netdev_dummy_destroy(struct netdev_dev *netdev_dev_)
 {
     struct netdev_dev_dummy *netdev_dev = netdev_dev_dummy_cast(netdev_dev_);
 
+    netdev_dummy_clear_rxq(netdev_dev);
+    netdev_dummy_clear_generator(netdev_dev);
+    pcap_writer_close(netdev_dev->tx_pcap);
     free(netdev_dev);
 }
 
@@ -107,6 +168,7 @@ netdev_dummy_open(struct netdev_dev *netdev_dev_, struct netdev **netdevp)
 
     netdev = xmalloc(sizeof *netdev);
     netdev_init(&netdev->netdev, netdev_dev_);
+    netdev->listening = false;
 
     *netdevp = &netdev->netdev;
     return 0;
@@ -120,19 +182,88 @@ netdev_dummy_close(struct netdev *netdev_)
 }
 
 static int
-netdev_dummy_listen(struct netdev *netdev_ OVS_UNUSED)
+netdev_dummy_listen(struct netdev *netdev_)
+{
+    /* A dummy device only receives packets injected with the
+     * "netdev-dummy/receive", "netdev-dummy/inject-pcap", or
+     * "netdev-dummy/generate" commands or the corresponding functions. */
+    netdev_dummy_cast(netdev_)->listening = true;
+    return 0;
+}
+
+static int
+netdev_dummy_recv(struct netdev *netdev_, void *buffer, size_t size)
+{
+    struct netdev_dummy *netdev = netdev_dummy_cast(netdev_);
+    struct netdev_dev_dummy *dev =
+        netdev_dev_dummy_cast(netdev_get_dev(netdev_));
+    const struct ofpbuf *packet;
+    struct ofpbuf *queued;
+    size_t n;
+
+    if (!netdev->listening) {
+        return -EAGAIN;
+    }
+
+    queued = NULL;
+    if (!list_is_empty(&dev->rxq)) {
+        queued = CONTAINER_OF(list_pop_front(&dev->rxq),
+                              struct ofpbuf, list_node);
+        dev->rxq_len--;
+        packet = queued;
+    } else if (dev->gen_remaining) {
+        packet = dev->gen_packets[dev->gen_next];
+        if (++dev->gen_next >= dev->n_gen_packets) {
+            dev->gen_next = 0;
+        }
+        dev->gen_remaining--;
+    } else {
+        return -EAGAIN;
+    }
+
+    n = MIN(packet->size, size);
+    memcpy(buffer, packet->data, n);
+    dev->stats.rx_packets++;
+    dev->stats.rx_bytes += n;
+    ofpbuf_delete(queued);
+    return n;
+}
+
+static void
+netdev_dummy_recv_wait(struct netdev *netdev_)
+{
+    struct netdev_dummy *netdev = netdev_dummy_cast(netdev_);
+    struct netdev_dev_dummy *dev =
+        netdev_dev_dummy_cast(netdev_get_dev(netdev_));
+
+    if (netdev->listening && (dev->rxq_len || dev->gen_remaining)) {
+        poll_immediate_wake();
+    }
+}
+
+static int
+netdev_dummy_drain(struct netdev *netdev_)
 {
-    /* It's OK to listen on a dummy device.  It just never receives any
-     * packets. */
+    struct netdev_dev_dummy *dev =
+        netdev_dev_dummy_cast(netdev_get_dev(netdev_));
+
+    netdev_dummy_clear_rxq(dev);
+    dev->gen_remaining = 0;
     return 0;
 }
 
 static int
-netdev_dummy_recv(struct netdev *netdev_ OVS_UNUSED,
-                  void *buffer OVS_UNUSED, size_t size OVS_UNUSED)
+netdev_dummy_send(struct netdev *netdev, const void *buffer, size_t size)
 {
-    /* A dummy device never receives any packets. */
-    return -EAGAIN;
+    struct netdev_dev_dummy *dev =
+        netdev_dev_dummy_cast(netdev_get_dev(netdev));
+
+    dev->stats.tx_packets++;
+    dev->stats.tx_bytes += size;
+    if (dev->tx_pcap) {
+        pcap_writer_put(dev->tx_pcap, buffer, size, time_wall_msec() * 1000);
+    }
+    return 0;
 }
 
 static int
@@ -260,10 +391,10 @@ static const struct netdev_class dummy_class = {
 
     netdev_dummy_listen,        /* listen */
     netdev_dummy_recv,          /* recv */
-    NULL,                       /* recv_wait */
-    NULL,                       /* drain */
+    netdev_dummy_recv_wait,     /* recv_wait */
+    netdev_dummy_drain,         /* drain */
 
-    NULL,                       /* send */
+    netdev_dummy_send,          /* send */
     NULL,                       /* send_wait */
 
     netdev_dummy_set_etheraddr,
@@ -305,8 +436,389 @@ static const struct netdev_class dummy_class = {
     netdev_dummy_change_seq
 };
 
+/* Packet injection. */
+
+static struct netdev_dev_dummy *
+netdev_dummy_lookup(const char *name)
+{
+    struct netdev_dev *netdev_dev = netdev_dev_from_name(name);
+
+    return (netdev_dev && is_dummy_class(netdev_dev_get_class(netdev_dev))
+            ? netdev_dev_dummy_cast(netdev_dev)
+            : NULL);
+}
+
+/* Appends a copy of 'packet' to 'dev''s receive queue, or drops it if the
+ * queue is full. */
+static void
+netdev_dummy_queue_packet__(struct netdev_dev_dummy *dev,
+                            const struct ofpbuf *packet)
+{
+    if (dev->rxq_len >= NETDEV_DUMMY_MAX_QUEUE) {
+        dev->stats.rx_dropped++;
+        return;
+    }
+    list_push_back(&dev->rxq, &ofpbuf_clone(packet)->list_node);
+    dev->rxq_len++;
+}
+
+/* Queues a copy of 'packet' to be received on the dummy network device named
+ * 'name'.  Returns 0 if successful, ENODEV if there is no such dummy device.
+ * (A packet dropped because the device's receive queue is full still counts
+ * as success.) */
+int
+netdev_dummy_queue_packet(const char *name, const struct ofpbuf *packet)
+{
+    struct netdev_dev_dummy *dev = netdev_dummy_lookup(name);
+
+    if (!dev) {
+        return ENODEV;
+    }
+    netdev_dummy_queue_packet__(dev, packet);
+    return 0;
+}
+
+/* Queues each of the packets in the pcap file named 'file_name' to be received
+ * on the dummy network device named 'name'.  Returns 0 if successful,
+ * otherwise a positive errno value. */
+int
+netdev_dummy_inject_pcap(const char *name, const char *file_name)
+{
+    struct netdev_dev_dummy *dev = netdev_dummy_lookup(name);
+    struct pcap_reader *reader;
+    struct pcap_packet packet;
+    int error;
+
+    if (!dev) {
+        return ENODEV;
+    }
+
+    error = pcap_reader_open(file_name, &reader);
+    if (error) {
+        return error;
+    }
+    while (!(error = pcap_reader_next(reader, &packet))) {
+        struct ofpbuf buf;
+
+        ofpbuf_use_const(&buf, packet.data, packet.size);
+        netdev_dummy_queue_packet__(dev, &buf);
+    }
+    pcap_reader_close(reader);
+    return error == EOF ? 0 : error;
+}
+
+/* Composes the packet for the 'i'th generated flow into 'packet'.
+ *
+ * The flows mix IPv4 TCP, UDP, and ICMP, with and without VLAN headers, with
+ * a few ARP flows, like the flows that tests/flowgen.pl generates.  Each flow
+ * differs from all the others in its IP source address. */
+static void
+netdev_dummy_compose_flow(struct ofpbuf *packet, unsigned int i)
+{
+    struct flow flow;
+
+    memset(&flow, 0, sizeof flow);
+    flow.dl_src[0] = 0x50;
+    flow.dl_src[4] = i >> 8;
+    flow.dl_src[5] = i;
+    flow.dl_dst[0] = 0x50;
+    flow.dl_dst[5] = 0xff;
+    flow.nw_src = htonl(0x0a000000 | (i & 0xffffff));
+    flow.nw_dst = htonl(0xc0a80001);
+    if (i % 4 == 3) {
+        flow.vlan_tci = htons(VLAN_CFI | (i % 4095 + 1));
+    }
+
+    if (i % 16 == 15) {
+        flow.dl_type = htons(ETH_TYPE_ARP);
+        flow.nw_proto = ARP_OP_REQUEST;
+        memcpy(flow.arp_sha, flow.dl_src, ETH_ADDR_LEN);
+    } else {
+        static const uint8_t protos[] = {
+            IPPROTO_TCP, IPPROTO_UDP, IPPROTO_TCP, IPPROTO_ICMP
+        };
+
+        flow.dl_type = htons(ETH_TYPE_IP);
+        flow.nw_proto = protos[i % ARRAY_SIZE(protos)];
+        if (flow.nw_proto == IPPROTO_ICMP) {
+            flow.tp_src = htons(8);     /* Echo request. */
+        } else {
+            flow.tp_src = htons(1024 + i % 60000);
+            flow.tp_dst = htons(80);
+        }
+    }
+    flow_compose(packet, &flow);
+}
+
+/* Arranges for the dummy network device named 'name' to receive 'n_packets'
+ * generated packets, cycling among 'n_flows' different flows, after any
+ * packets already queued.  This replaces any previous generator on the
+ * device.  Returns 0 if successful, otherwise a positive errno value. */
+int
+netdev_dummy_generate(const char *name, unsigned long long int n_packets,
+                      unsigned int n_flows)
+{
+    struct netdev_dev_dummy *dev = netdev_dummy_lookup(name);
+    unsigned int i;
+
+    if (!dev) {
+        return ENODEV;
+    } else if (!n_flows) {
+        return EINVAL;
+    }
+
+    netdev_dummy_clear_generator(dev);
+    dev->gen_packets = xmalloc(n_flows * sizeof *dev->gen_packets);
+    for (i = 0; i < n_flows; i++) {
+        dev->gen_packets[i] = ofpbuf_new(128);
+        netdev_dummy_compose_flow(dev->gen_packets[i], i);
+    }
+    dev->n_gen_packets = n_flows;
+    dev->gen_remaining = n_packets;
+    return 0;
+}
+
+/* Starts writing the packets sent on the dummy network device named 'name'
+ * to a new pcap file named 'file_name', or stops if 'file_name' is NULL.
+ * Writes are buffered, so the file is complete only after capturing stops.
+ * Returns 0 if successful, otherwise a positive errno value. */
+int
+netdev_dummy_capture(const char *name, const char *file_name)
+{
+    struct netdev_dev_dummy *dev = netdev_dummy_lookup(name);
+
+    if (!dev) {
+        return ENODEV;
+    }
+    if (dev->tx_pcap) {
+        pcap_writer_close(dev->tx_pcap);
+        dev->tx_pcap = NULL;
+    }
+    return file_name ? pcap_writer_open(file_name, &dev->tx_pcap) : 0;
+}
+
+/* unixctl commands. */
+
+static void
+netdev_dummy_reply_error(struct unixctl_conn *conn, const char *name,
+                         int error)
+{
+    char *msg = (error == ENODEV
+                 ? xasprintf("%s: no such dummy device", name)
+                 : xasprintf("%s: %s", name, strerror(error)));
+    unixctl_command_reply(conn, 501, msg);
+    free(msg);
+}
+
+/* Parses 's' as a packet, which may be a datapath flow in the syntax used by
+ * ovs-dpctl, e.g. "in_port(1),eth(...),...", or an Ethernet frame as a string
+ * of hex digits.  Returns a new ofpbuf if successful, otherwise NULL. */
+static struct ofpbuf *
+netdev_dummy_parse_packet(const char *s)
+{
+    struct ofpbuf *packet = ofpbuf_new(strlen(s) / 2);
+
+    if (s[strspn(s, "0123456789abcdefABCDEF")] == '\0') {
+        const char *end = ofpbuf_put_hex(packet, s, NULL);
+        if (*end || packet->size < ETH_HEADER_LEN) {
+            ofpbuf_delete(packet);
+            return NULL;
+        }
+    } else {
+        struct ofpbuf odp_key;
+        struct flow flow;
+        int error;
+
+        ofpbuf_init(&odp_key, 0);
+        error = odp_flow_key_from_string(s, &odp_key);
+        if (!error) {
+            error = odp_flow_key_to_flow(odp_key.data, odp_key.size, &flow);
+        }
+        ofpbuf_uninit(&odp_key);
+        if (error) {
+            ofpbuf_delete(packet);
+            return NULL;
+        }
+        flow_compose(packet, &flow);
+    }
+    return packet;
+}
+
+static void
+netdev_dummy_unixctl_receive(struct unixctl_conn *conn, const char *args_,
+                             void *aux OVS_UNUSED)
+{
+    char *args = xstrdup(args_);
+    char *save_ptr = NULL;
+    struct netdev_dev_dummy *dev;
+    char *name, *arg;
+    int n;
+
+    name = strtok_r(args, " ", &save_ptr);
+    dev = name ? netdev_dummy_lookup(name) : NULL;
+    if (!dev) {
+        netdev_dummy_reply_error(conn, name ? name : "", ENODEV);
+        goto exit;
+    }
+
+    n = 0;
+    while ((arg = strtok_r(NULL, " ", &save_ptr)) != NULL) {
+        struct ofpbuf *packet = netdev_dummy_parse_packet(arg);
+        if (!packet) {
+            char *msg = xasprintf("%s: bad packet syntax", arg);
+            unixctl_command_reply(conn, 501, msg);
+            free(msg);
+            goto exit;
+        }
+        netdev_dummy_queue_packet__(dev, packet);
+        ofpbuf_delete(packet);
+        n++;
+    }
+    if (!n) {
+        unixctl_command_reply(conn, 501, "at least one packet required");
+        goto exit;
+    }
+    unixctl_command_reply(conn, 200, NULL);
+
+exit:
+    free(args);
+}
+
+static void
+netdev_dummy_unixctl_inject_pcap(struct unixctl_conn *conn, const char *args_,
+                                 void *aux OVS_UNUSED)
+{
+    char *args = xstrdup(args_);
+    char *save_ptr = NULL;
+    char *name, *file_name;
+    int error;
+
+    name = strtok_r(args, " ", &save_ptr);
+    file_name = strtok_r(NULL, " ", &save_ptr);
+    if (!name || !file_name) {
+        unixctl_command_reply(conn, 501, "usage: NETDEV FILE");
+    } else if ((error = netdev_dummy_inject_pcap(name, file_name))) {
+        netdev_dummy_reply_error(conn, error == ENODEV ? name : file_name,
+                                 error);
+    } else {
+        unixctl_command_reply(conn, 200, NULL);
+    }
+    free(args);
+}
+
+static void
+netdev_dummy_unixctl_generate(struct unixctl_conn *conn, const char *args_,
+                              void *aux OVS_UNUSED)
+{
+    char *args = xstrdup(args_);
+    char *save_ptr = NULL;
+    char *name, *n_packets_s, *n_flows_s;
+    unsigned int n_flows;
+    int error;
+
+    name = strtok_r(args, " ", &save_ptr);
+    n_packets_s = strtok_r(NULL, " ", &save_ptr);
+    n_flows_s = strtok_r(NULL, " ", &save_ptr);
+    n_flows = n_flows_s ? atoi(n_flows_s) : 1;
+    if (!name || !n_packets_s || !n_flows) {
+        unixctl_command_reply(conn, 501, "usage: NETDEV N_PACKETS [N_FLOWS]");
+    } else if ((error = netdev_dummy_generate(name, strtoull(n_packets_s,
+                                                             NULL, 10),
+                                              n_flows))) {
+        netdev_dummy_reply_error(conn, name, error);
+    } else {
+        unixctl_command_reply(conn, 200, NULL);
+    }
+    free(args);
+}
+
+static void
+netdev_dummy_unixctl_capture(struct unixctl_conn *conn, const char *args_,
+                             void *aux OVS_UNUSED)
+{
+    char *args = xstrdup(args_);
+    char *save_ptr = NULL;
+    char *name, *file_name;
+    int error;
+
+    name = strtok_r(args, " ", &save_ptr);
+    file_name = strtok_r(NULL, " ", &save_ptr);
+    if (!name || !file_name) {
+        unixctl_command_reply(conn, 501, "usage: NETDEV FILE|off");
+    } else if ((error = netdev_dummy_capture(name, (strcmp(file_name, "off")
+                                                    ? file_name : NULL)))) {
+        netdev_dummy_reply_error(conn, error == ENODEV ? name : file_name,
+                                 error);
+    } else {
+        unixctl_command_reply(conn, 200, NULL);
+    }
+    free(args);
+}
+
+static void
+netdev_dummy_format_stats(struct ds *s, const struct netdev_dev_dummy *dev)
+{
+    const struct netdev_stats *stats = &dev->stats;
+
+    ds_put_format(s, "%s:\n", netdev_dev_get_name(&dev->netdev_dev));
+    ds_put_format(s, "  rx: %"PRIu64" packets, %"PRIu64" bytes, "
+                  "%"PRIu64" dropped, %zu queued, %llu to generate\n",
+                  stats->rx_packets, stats->rx_bytes, stats->rx_dropped,
+                  dev->rxq_len, dev->gen_remaining);
+    ds_put_format(s, "  tx: %"PRIu64" packets, %"PRIu64" bytes%s\n",
+                  stats->tx_packets, stats->tx_bytes,
+                  dev->tx_pcap ? ", capturing" : "");
+}
+
+static void
+netdev_dummy_unixctl_stats(struct unixctl_conn *conn, const char *args,
+                           void *aux OVS_UNUSED)
+{
+    struct ds s;
+
+    ds_init(&s);
+    if (*args) {
+        const struct netdev_dev_dummy *dev = netdev_dummy_lookup(args);
+
+        if (!dev) {
+            netdev_dummy_reply_error(conn, args, ENODEV);
+            ds_destroy(&s);
+            return;
+        }
+        netdev_dummy_format_stats(&s, dev);
+    } else {
+        struct shash dummy_devs;
+        const struct shash_node **nodes;
+        size_t i, n;
+
+        shash_init(&dummy_devs);
+        netdev_dev_get_devices(&dummy_class, &dummy_devs);
+        nodes = shash_sort(&dummy_devs);
+        n = shash_count(&dummy_devs);
+        for (i = 0; i < n; i++) {
+            netdev_dummy_format_stats(&s,
+                                      netdev_dev_dummy_cast(nodes[i]->data));
+        }
+        free(nodes);
+        shash_destroy(&dummy_devs);
+    }
+    unixctl_command_reply(conn, 200, ds_cstr(&s));
+    ds_destroy(&s);
+}
+
 void
 netdev_dummy_register(void)
 {
     netdev_register_provider(&dummy_class);
+
+    unixctl_command_register("netdev-dummy/receive",
+                             netdev_dummy_unixctl_receive, NULL);
+    unixctl_command_register("netdev-dummy/inject-pcap",
+                             netdev_dummy_unixctl_inject_pcap, NULL);
+    unixctl_command_register("netdev-dummy/generate",
+                             netdev_dummy_unixctl_generate, NULL);
+    unixctl_command_register("netdev-dummy/capture",
+                             netdev_dummy_unixctl_capture, NULL);
+    unixctl_command_register("netdev-dummy/stats",
+                             netdev_dummy_unixctl_stats, NULL);
 }
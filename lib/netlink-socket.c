@@ -118,6 +118,7 @@ nl_sock_create(int protocol, struct nl_sock **sockp)
         goto error_free_pid;
     }
 
+    poll_fd_register(sock->fd);
     *sockp = sock;
     return 0;
 
@@ -154,6 +155,7 @@ nl_sock_destroy(struct nl_sock *sock)
         if (sock->dump) {
             sock->dump = NULL;
         } else {
+            poll_fd_unregister(sock->fd);
             close(sock->fd);
             free_pid(sock->pid);
             free(sock);
@@ -26,6 +26,7 @@
 #include <stdlib.h>
 #include <ctype.h>
 
+#include "bitmap.h"
 #include "bundle.h"
 #include "byte-order.h"
 #include "compiler.h"
@@ -1078,6 +1079,69 @@ ofp_print_nxst_aggregate_reply(struct ds *string,
     ds_put_format(string, " flow_count=%"PRIu32, ntohl(nasr->flow_count));
 }
 
+static void
+ofp_print_nxst_flow_digest_request(struct ds *string,
+                                   const struct ofp_header *oh)
+{
+    struct ofputil_flow_digest_request fdr;
+    int error;
+
+    error = ofputil_decode_flow_digest_request(&fdr, oh);
+    if (error) {
+        ofp_print_error(string, error);
+        return;
+    }
+
+    if (fdr.table_id != 0xff) {
+        ds_put_format(string, " table=%"PRIu8, fdr.table_id);
+    }
+    ds_put_format(string, " n_buckets=%u", fdr.n_buckets);
+
+    if (fdr.buckets) {
+        unsigned int i;
+        bool first;
+
+        ds_put_cstr(string, " buckets=");
+        first = true;
+        for (i = 0; i < fdr.n_buckets; i++) {
+            if (bitmap_is_set(fdr.buckets, i)) {
+                if (!first) {
+                    ds_put_char(string, ',');
+                }
+                ds_put_format(string, "%u", i);
+                first = false;
+            }
+        }
+        if (first) {
+            ds_put_cstr(string, "none");
+        }
+        bitmap_free(fdr.buckets);
+    }
+}
+
+static void
+ofp_print_nxst_flow_digest_reply(struct ds *string,
+                                 const struct ofp_header *oh)
+{
+    struct ofputil_flow_digest_reply fdr;
+    unsigned int i;
+    int error;
+
+    error = ofputil_decode_flow_digest_reply(&fdr, oh);
+    if (error) {
+        ofp_print_error(string, error);
+        return;
+    }
+
+    ds_put_format(string, " flow_count=%"PRIu32" n_buckets=%u",
+                  fdr.flow_count, fdr.n_buckets);
+    for (i = 0; i < fdr.n_buckets; i++) {
+        ds_put_format(string, "\n bucket %u: digest=0x%016"PRIx64,
+                      i, fdr.digests[i]);
+    }
+    free(fdr.digests);
+}
+
 static void print_port_stat(struct ds *string, const char *leader,
                             const ovs_32aligned_be64 *statp, int more)
 {
@@ -1401,6 +1465,7 @@ ofp_to_string__(const struct ofp_header *oh,
 
     case OFPUTIL_OFPST_FLOW_REPLY:
     case OFPUTIL_NXST_FLOW_REPLY:
+    case OFPUTIL_NXST_FLOW_BUCKETS_REPLY:
         ofp_print_stats_reply(string, oh);
         ofp_print_flow_stats_reply(string, oh);
         break;
@@ -1446,6 +1511,17 @@ ofp_to_string__(const struct ofp_header *oh,
         ofp_print_stats_reply(string, oh);
         ofp_print_nxst_aggregate_reply(string, msg);
         break;
+
+    case OFPUTIL_NXST_FLOW_DIGEST_REQUEST:
+    case OFPUTIL_NXST_FLOW_BUCKETS_REQUEST:
+        ofp_print_stats_request(string, oh);
+        ofp_print_nxst_flow_digest_request(string, oh);
+        break;
+
+    case OFPUTIL_NXST_FLOW_DIGEST_REPLY:
+        ofp_print_stats_reply(string, oh);
+        ofp_print_nxst_flow_digest_reply(string, oh);
+        break;
     }
 }
 
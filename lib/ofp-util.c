@@ -21,6 +21,7 @@
 #include <netinet/icmp6.h>
 #include <stdlib.h>
 #include "autopath.h"
+#include "bitmap.h"
 #include "bundle.h"
 #include "byte-order.h"
 #include "classifier.h"
@@ -33,6 +34,7 @@
 #include "ofpbuf.h"
 #include "packets.h"
 #include "random.h"
+#include "sha1.h"
 #include "unaligned.h"
 #include "type-props.h"
 #include "vlog.h"
@@ -431,6 +433,14 @@ ofputil_decode_nxst_request(const struct ofp_header *oh,
         { OFPUTIL_NXST_AGGREGATE_REQUEST,
           NXST_AGGREGATE, "NXST_AGGREGATE request",
           sizeof(struct nx_aggregate_stats_request), 8 },
+
+        { OFPUTIL_NXST_FLOW_DIGEST_REQUEST,
+          NXST_FLOW_DIGEST, "NXST_FLOW_DIGEST request",
+          sizeof(struct nx_flow_digest_request), 0 },
+
+        { OFPUTIL_NXST_FLOW_BUCKETS_REQUEST,
+          NXST_FLOW_BUCKETS, "NXST_FLOW_BUCKETS request",
+          sizeof(struct nx_flow_buckets_request), 8 },
     };
 
     static const struct ofputil_msg_category nxst_request_category = {
@@ -465,6 +475,14 @@ ofputil_decode_nxst_reply(const struct ofp_header *oh,
         { OFPUTIL_NXST_AGGREGATE_REPLY,
           NXST_AGGREGATE, "NXST_AGGREGATE reply",
           sizeof(struct nx_aggregate_stats_reply), 0 },
+
+        { OFPUTIL_NXST_FLOW_DIGEST_REPLY,
+          NXST_FLOW_DIGEST, "NXST_FLOW_DIGEST reply",
+          sizeof(struct nx_flow_digest_reply), 8 },
+
+        { OFPUTIL_NXST_FLOW_BUCKETS_REPLY,
+          NXST_FLOW_BUCKETS, "NXST_FLOW_BUCKETS reply",
+          sizeof(struct nicira_stats_msg), 8 },
     };
 
     static const struct ofputil_msg_category nxst_reply_category = {
@@ -1116,8 +1134,8 @@ ofputil_encode_flow_stats_request(const struct ofputil_flow_stats_request *fsr,
     return msg;
 }
 
-/* Converts an OFPST_FLOW or NXST_FLOW reply in 'msg' into an abstract
- * ofputil_flow_stats in 'fs'.
+/* Converts an OFPST_FLOW, NXST_FLOW, or NXST_FLOW_BUCKETS reply in 'msg' into
+ * an abstract ofputil_flow_stats in 'fs'.
  *
  * Multiple OFPST_FLOW or NXST_FLOW replies can be packed into a single
  * OpenFlow message.  Calling this function multiple times for a single 'msg'
@@ -1135,6 +1153,10 @@ ofputil_decode_flow_stats_reply(struct ofputil_flow_stats *fs,
 
     ofputil_decode_msg_type(msg->l2 ? msg->l2 : msg->data, &type);
     code = ofputil_msg_type_code(type);
+    if (code == OFPUTIL_NXST_FLOW_BUCKETS_REPLY) {
+        /* Same format as NXST_FLOW. */
+        code = OFPUTIL_NXST_FLOW_REPLY;
+    }
     if (!msg->l2) {
         msg->l2 = msg->data;
         if (code == OFPUTIL_OFPST_FLOW_REPLY) {
@@ -1328,6 +1350,228 @@ ofputil_encode_aggregate_stats_reply(
     return msg;
 }
 
+/* Computes the NXST_FLOW_DIGEST match digest "M" for 'rule' into 'sha1'.  See
+ * the comment on struct nx_flow_digest_request for the definition. */
+static void
+flow_digest_match(const struct cls_rule *rule, uint8_t sha1[SHA1_DIGEST_SIZE])
+{
+    OFPBUF_STACK_BUFFER(stub, NXM_MAX_LEN + 8);
+    ovs_be16 priority;
+    struct ofpbuf b;
+
+    /* Drop the padding that nx_put_match() appends. */
+    ofpbuf_use_stack(&b, stub, sizeof stub);
+    b.size = nx_put_match(&b, rule);
+
+    priority = htons(rule->priority);
+    ofpbuf_put(&b, &priority, sizeof priority);
+    sha1_bytes(b.data, b.size, sha1);
+    ofpbuf_uninit(&b);
+}
+
+/* Returns the hash that determines the NXST_FLOW_DIGEST bucket of a flow with
+ * the given 'rule'.  The bucket is the return value modulo the number of
+ * buckets. */
+uint32_t
+ofputil_flow_digest_hash(const struct cls_rule *rule)
+{
+    uint8_t m[SHA1_DIGEST_SIZE];
+    ovs_be32 hash;
+
+    flow_digest_match(rule, m);
+    memcpy(&hash, m, sizeof hash);
+    return ntohl(hash);
+}
+
+/* Returns the NXST_FLOW_DIGEST digest of a flow with the given 'rule',
+ * 'cookie', timeouts, and actions.  If 'hashp' is nonnull, also stores the
+ * flow's bucket hash, as returned by ofputil_flow_digest_hash(), into
+ * '*hashp'. */
+uint64_t
+ofputil_flow_digest(const struct cls_rule *rule, ovs_be64 cookie,
+                    uint16_t idle_timeout, uint16_t hard_timeout,
+                    const union ofp_action *actions, size_t n_actions,
+                    uint32_t *hashp)
+{
+    uint8_t m[SHA1_DIGEST_SIZE];
+    uint8_t digest[SHA1_DIGEST_SIZE];
+    ovs_be16 idle, hard;
+    struct sha1_ctx ctx;
+    ovs_be64 value;
+
+    flow_digest_match(rule, m);
+    if (hashp) {
+        ovs_be32 hash;
+
+        memcpy(&hash, m, sizeof hash);
+        *hashp = ntohl(hash);
+    }
+
+    idle = htons(idle_timeout);
+    hard = htons(hard_timeout);
+
+    sha1_init(&ctx);
+    sha1_update(&ctx, m, sizeof m);
+    sha1_update(&ctx, &cookie, sizeof cookie);
+    sha1_update(&ctx, &idle, sizeof idle);
+    sha1_update(&ctx, &hard, sizeof hard);
+    sha1_update(&ctx, actions, n_actions * sizeof *actions);
+    sha1_final(&ctx, digest);
+
+    memcpy(&value, digest, sizeof value);
+    return ntohll(value);
+}
+
+static bool
+flow_digest_n_buckets_is_valid(unsigned int n_buckets)
+{
+    return (n_buckets >= 1 && n_buckets <= NX_FLOW_DIGEST_MAX_BUCKETS
+            && !(n_buckets & (n_buckets - 1)));
+}
+
+/* Converts an NXST_FLOW_DIGEST or NXST_FLOW_BUCKETS request 'oh' into an
+ * abstract ofputil_flow_digest_request in 'fdr'.  Returns 0 if successful,
+ * otherwise an OpenFlow error code.
+ *
+ * For an NXST_FLOW_BUCKETS request, the caller must eventually free
+ * 'fdr->buckets' with bitmap_free(). */
+int
+ofputil_decode_flow_digest_request(struct ofputil_flow_digest_request *fdr,
+                                   const struct ofp_header *oh)
+{
+    const struct nx_flow_digest_request *nfdr;
+    const struct ofputil_msg_type *type;
+    enum ofputil_msg_code code;
+    unsigned int i;
+
+    ofputil_decode_msg_type(oh, &type);
+
+    /* struct nx_flow_digest_request and struct nx_flow_buckets_request have
+     * the same layout up to the bitmap. */
+    nfdr = (const struct nx_flow_digest_request *) oh;
+    fdr->table_id = nfdr->table_id;
+    fdr->n_buckets = ntohs(nfdr->n_buckets);
+    fdr->buckets = NULL;
+    if (!flow_digest_n_buckets_is_valid(fdr->n_buckets)) {
+        return ofp_mkerr_nicira(OFPET_BAD_REQUEST, NXBRC_BAD_N_BUCKETS);
+    }
+
+    code = ofputil_msg_type_code(type);
+    if (code == OFPUTIL_NXST_FLOW_BUCKETS_REQUEST) {
+        const uint8_t *bitmap;
+        size_t bitmap_len;
+
+        bitmap = (const uint8_t *) oh + sizeof(struct nx_flow_buckets_request);
+        bitmap_len = ntohs(oh->length) - sizeof(struct nx_flow_buckets_request);
+        if (bitmap_len != ROUND_UP(fdr->n_buckets, 64) / 8) {
+            return ofp_mkerr(OFPET_BAD_REQUEST, OFPBRC_BAD_LEN);
+        }
+
+        fdr->buckets = bitmap_allocate(fdr->n_buckets);
+        for (i = 0; i < fdr->n_buckets; i++) {
+            if (bitmap[i / 8] & (1u << (i % 8))) {
+                bitmap_set1(fdr->buckets, i);
+            }
+        }
+    } else if (code != OFPUTIL_NXST_FLOW_DIGEST_REQUEST) {
+        NOT_REACHED();
+    }
+
+    return 0;
+}
+
+/* Converts abstract ofputil_flow_digest_request 'fdr' into an
+ * NXST_FLOW_BUCKETS request, if 'fdr->buckets' is nonnull, or an
+ * NXST_FLOW_DIGEST request otherwise, and returns the message. */
+struct ofpbuf *
+ofputil_encode_flow_digest_request(const struct ofputil_flow_digest_request *fdr)
+{
+    struct nx_flow_digest_request *nfdr;
+    struct ofpbuf *msg;
+
+    assert(flow_digest_n_buckets_is_valid(fdr->n_buckets));
+    if (!fdr->buckets) {
+        nfdr = ofputil_make_stats_request(sizeof *nfdr, OFPST_VENDOR,
+                                          NXST_FLOW_DIGEST, &msg);
+    } else {
+        size_t bitmap_len = ROUND_UP(fdr->n_buckets, 64) / 8;
+        uint8_t *bitmap;
+        unsigned int i;
+
+        ofputil_make_stats_request(sizeof(struct nx_flow_buckets_request),
+                                   OFPST_VENDOR, NXST_FLOW_BUCKETS, &msg);
+        bitmap = ofpbuf_put_zeros(msg, bitmap_len);
+        for (i = 0; i < fdr->n_buckets; i++) {
+            if (bitmap_is_set(fdr->buckets, i)) {
+                bitmap[i / 8] |= 1u << (i % 8);
+            }
+        }
+        nfdr = msg->data;
+    }
+    nfdr->n_buckets = htons(fdr->n_buckets);
+    nfdr->table_id = fdr->table_id;
+
+    return msg;
+}
+
+/* Converts an NXST_FLOW_DIGEST reply 'oh' into an abstract
+ * ofputil_flow_digest_reply in 'fdr'.  Returns 0 if successful, otherwise an
+ * OpenFlow error code.
+ *
+ * The caller must eventually free 'fdr->digests'. */
+int
+ofputil_decode_flow_digest_reply(struct ofputil_flow_digest_reply *fdr,
+                                 const struct ofp_header *oh)
+{
+    const struct nx_flow_digest_reply *nfdr;
+    const ovs_be64 *digests;
+    unsigned int i;
+
+    nfdr = (const struct nx_flow_digest_reply *) oh;
+    fdr->flow_count = ntohl(nfdr->flow_count);
+    fdr->n_buckets = ntohs(nfdr->n_buckets);
+    fdr->digests = NULL;
+    if (ntohs(oh->length) != sizeof *nfdr + fdr->n_buckets * sizeof *digests) {
+        VLOG_WARN_RL(&bad_ofmsg_rl, "NXST_FLOW_DIGEST reply with n_buckets=%u "
+                     "has invalid length %"PRIu16,
+                     fdr->n_buckets, ntohs(oh->length));
+        return ofp_mkerr(OFPET_BAD_REQUEST, OFPBRC_BAD_LEN);
+    }
+
+    digests = (const ovs_be64 *) (nfdr + 1);
+    fdr->digests = xmalloc(fdr->n_buckets * sizeof *fdr->digests);
+    for (i = 0; i < fdr->n_buckets; i++) {
+        fdr->digests[i] = ntohll(digests[i]);
+    }
+    return 0;
+}
+
+/* Converts abstract ofputil_flow_digest_reply 'fdr' into an NXST_FLOW_DIGEST
+ * reply to 'request', and returns the message. */
+struct ofpbuf *
+ofputil_encode_flow_digest_reply(const struct ofputil_flow_digest_reply *fdr,
+                                 const struct ofp_stats_msg *request)
+{
+    struct nx_flow_digest_reply *nfdr;
+    ovs_be64 *digests;
+    struct ofpbuf *msg;
+    unsigned int i;
+
+    nfdr = ofputil_make_stats_reply(sizeof *nfdr
+                                    + fdr->n_buckets * sizeof *digests,
+                                    request, &msg);
+    assert(nfdr->nsm.subtype == htonl(NXST_FLOW_DIGEST));
+    nfdr->flow_count = htonl(fdr->flow_count);
+    nfdr->n_buckets = htons(fdr->n_buckets);
+
+    digests = (ovs_be64 *) (nfdr + 1);
+    for (i = 0; i < fdr->n_buckets; i++) {
+        digests[i] = htonll(fdr->digests[i]);
+    }
+
+    return msg;
+}
+
 /* Converts an OFPT_FLOW_REMOVED or NXT_FLOW_REMOVED message 'oh' into an
  * abstract ofputil_flow_removed in 'fr'.  Returns 0 if successful, otherwise
  * an OpenFlow error code. */
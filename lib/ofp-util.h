@@ -81,10 +81,14 @@ enum ofputil_msg_code {
     /* NXST_* stat requests. */
     OFPUTIL_NXST_FLOW_REQUEST,
     OFPUTIL_NXST_AGGREGATE_REQUEST,
+    OFPUTIL_NXST_FLOW_DIGEST_REQUEST,
+    OFPUTIL_NXST_FLOW_BUCKETS_REQUEST,
 
     /* NXST_* stat replies. */
     OFPUTIL_NXST_FLOW_REPLY,
-    OFPUTIL_NXST_AGGREGATE_REPLY
+    OFPUTIL_NXST_AGGREGATE_REPLY,
+    OFPUTIL_NXST_FLOW_DIGEST_REPLY,
+    OFPUTIL_NXST_FLOW_BUCKETS_REPLY
 };
 
 struct ofputil_msg_type;
@@ -190,6 +194,36 @@ struct ofpbuf *ofputil_encode_aggregate_stats_reply(
     const struct ofputil_aggregate_stats *stats,
     const struct ofp_stats_msg *request);
 
+/* Flow table digests (NXST_FLOW_DIGEST and NXST_FLOW_BUCKETS). */
+struct ofputil_flow_digest_request {
+    uint8_t table_id;
+    unsigned int n_buckets;     /* Power of 2, 1...NX_FLOW_DIGEST_MAX_BUCKETS. */
+    unsigned long *buckets;     /* Bitmap of selected buckets.  Nonnull only
+                                 * for NXST_FLOW_BUCKETS. */
+};
+
+struct ofputil_flow_digest_reply {
+    uint32_t flow_count;
+    unsigned int n_buckets;
+    uint64_t *digests;          /* One per bucket. */
+};
+
+uint32_t ofputil_flow_digest_hash(const struct cls_rule *);
+uint64_t ofputil_flow_digest(const struct cls_rule *, ovs_be64 cookie,
+                             uint16_t idle_timeout, uint16_t hard_timeout,
+                             const union ofp_action *, size_t n_actions,
+                             uint32_t *hashp);
+
+int ofputil_decode_flow_digest_request(struct ofputil_flow_digest_request *,
+                                       const struct ofp_header *);
+struct ofpbuf *ofputil_encode_flow_digest_request(
+    const struct ofputil_flow_digest_request *);
+int ofputil_decode_flow_digest_reply(struct ofputil_flow_digest_reply *,
+                                     const struct ofp_header *);
+struct ofpbuf *ofputil_encode_flow_digest_reply(
+    const struct ofputil_flow_digest_reply *,
+    const struct ofp_stats_msg *request);
+
 /* Flow removed message, independent of flow format. */
 struct ofputil_flow_removed {
     struct cls_rule rule;
@@ -0,0 +1,273 @@
+/*
+ * Copyright (c) 2011 Nicira Networks.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <config.h>
+#include "ohmap.h"
+#include <assert.h>
+#include "coverage.h"
+#include "util.h"
+
+COVERAGE_DEFINE(ohmap_expand);
+COVERAGE_DEFINE(ohmap_rehash_finish);
+
+/* Number of groups to move from the old table to the new one on each
+ * insertion while resizing.  The new table is sized for the nodes in the old
+ * one, not for its deleted slots, so after heavy deletion the new table can
+ * still fill up first.  In that case ohmap_expand() moves the rest of the old
+ * table straight into the table that replaces it. */
+#define OHMAP_MIGRATE_GROUPS 2
+
+static void ohmap_migrate(struct ohmap *, size_t max_groups);
+
+/* Initializes 'ohmap' as an empty hash table. */
+void
+ohmap_init(struct ohmap *ohmap)
+{
+    memset(ohmap, 0, sizeof *ohmap);
+}
+
+static void
+ohmap_table_init(struct ohmap_table *t, size_t n_slots)
+{
+    t->n_slots = n_slots;
+    t->tags = xmalloc(n_slots);
+    memset(t->tags, OHMAP_EMPTY, n_slots);
+    t->nodes = xmalloc(n_slots * sizeof *t->nodes);
+}
+
+static void
+ohmap_table_destroy(struct ohmap_table *t)
+{
+    free(t->tags);
+    free(t->nodes);
+    memset(t, 0, sizeof *t);
+}
+
+/* Frees memory reserved by 'ohmap'.  It is the client's responsibility to
+ * free the nodes themselves, if necessary. */
+void
+ohmap_destroy(struct ohmap *ohmap)
+{
+    if (ohmap) {
+        ohmap_table_destroy(&ohmap->cur);
+        ohmap_table_destroy(&ohmap->old);
+    }
+}
+
+/* Returns the maximum number of full and deleted slots in a table with
+ * 'n_slots' slots. */
+static size_t
+ohmap_max_used(size_t n_slots)
+{
+    return n_slots - n_slots / 8;
+}
+
+/* Inserts 'node' into 't', which must have a free slot.  Returns true if the
+ * slot was previously empty, false if it was deleted. */
+static bool
+ohmap_table_insert(struct ohmap_table *t, struct ohmap_node *node,
+                   size_t epoch)
+{
+    size_t group = ohmap_table_home(t, node->hash);
+
+    for (;;) {
+        /* A free slot, empty or deleted, is one without OHMAP_FULL. */
+        uint64_t free_slots = (~ohmap_group_load(t, group)
+                               & ohmap_group_from(0));
+        if (free_slots) {
+            size_t slot = group + ohmap_group_first(free_slots);
+            bool was_empty = t->tags[slot] == OHMAP_EMPTY;
+
+            t->tags[slot] = ohmap_tag(node->hash);
+            t->nodes[slot] = node;
+            node->slot = slot | epoch;
+            return was_empty;
+        }
+        group = (group + OHMAP_GROUP_SIZE) & (t->n_slots - 1);
+    }
+}
+
+/* Starts moving the nodes in 'ohmap' to a new table with room for at least
+ * twice as many nodes.  Any nodes still in the old table move to the new table
+ * immediately, since the current table is full. */
+static void
+ohmap_expand(struct ohmap *ohmap)
+{
+    struct ohmap_table full;
+    size_t n_slots;
+
+    COVERAGE_INC(ohmap_expand);
+
+    n_slots = OHMAP_GROUP_SIZE;
+    while (ohmap_max_used(n_slots) < (ohmap->n + 1) * 2) {
+        n_slots *= 2;
+    }
+
+    full = ohmap->cur;
+    ohmap_table_init(&ohmap->cur, n_slots);
+    ohmap->cur_used = 0;
+    ohmap->epoch ^= OHMAP_EPOCH;
+    ohmap_migrate(ohmap, SIZE_MAX);
+    assert(!ohmap->old.n_slots);
+
+    ohmap->old = full;
+    ohmap->migrated = 0;
+    ohmap_migrate(ohmap, OHMAP_MIGRATE_GROUPS);
+}
+
+/* Moves the nodes in up to 'max_groups' groups of 'ohmap''s old table into
+ * its current table, freeing the old table once it is empty.  Stops early
+ * rather than filling the current table past ohmap_max_used(). */
+static void
+ohmap_migrate(struct ohmap *ohmap, size_t max_groups)
+{
+    struct ohmap_table *old = &ohmap->old;
+    size_t n_groups = old->n_slots / OHMAP_GROUP_SIZE;
+
+    if (!old->n_slots) {
+        return;
+    }
+
+    if (max_groups == SIZE_MAX && ohmap->migrated < n_groups) {
+        COVERAGE_INC(ohmap_rehash_finish);
+    }
+    for (; max_groups > 0 && ohmap->migrated < n_groups; max_groups--) {
+        size_t group = ohmap->migrated * OHMAP_GROUP_SIZE;
+        size_t n_full = 0;
+        size_t i;
+
+        for (i = group; i < group + OHMAP_GROUP_SIZE; i++) {
+            n_full += (old->tags[i] & OHMAP_FULL) != 0;
+        }
+        if (ohmap->cur_used + n_full > ohmap_max_used(ohmap->cur.n_slots)) {
+            break;
+        }
+
+        ohmap->migrated++;
+        for (i = group; i < group + OHMAP_GROUP_SIZE; i++) {
+            if (old->tags[i] & OHMAP_FULL) {
+                /* Leave a deleted slot behind, so that searches of the old
+                 * table for other nodes still probe past this slot. */
+                old->tags[i] = OHMAP_DELETED;
+                if (ohmap_table_insert(&ohmap->cur, old->nodes[i],
+                                       ohmap->epoch)) {
+                    ohmap->cur_used++;
+                }
+            }
+        }
+    }
+
+    if (ohmap->migrated >= n_groups) {
+        ohmap_table_destroy(old);
+        ohmap->migrated = 0;
+    }
+}
+
+/* Inserts 'node', with the given 'hash', into 'ohmap'.  This may move other
+ * nodes in 'ohmap', and it expands 'ohmap' if necessary, a little at a
+ * time. */
+void
+ohmap_insert(struct ohmap *ohmap, struct ohmap_node *node, size_t hash)
+{
+    ohmap_migrate(ohmap, OHMAP_MIGRATE_GROUPS);
+    if (ohmap->cur_used >= ohmap_max_used(ohmap->cur.n_slots)) {
+        ohmap_expand(ohmap);
+    }
+
+    node->hash = hash;
+    if (ohmap_table_insert(&ohmap->cur, node, ohmap->epoch)) {
+        ohmap->cur_used++;
+    }
+    ohmap->n++;
+}
+
+/* Removes 'node' from 'ohmap'.  Does not shrink the hash table. */
+void
+ohmap_remove(struct ohmap *ohmap, struct ohmap_node *node)
+{
+    bool in_old = ohmap_node_in_old(ohmap, node);
+    struct ohmap_table *t = in_old ? &ohmap->old : &ohmap->cur;
+    size_t slot = node->slot & ~OHMAP_EPOCH;
+    size_t group = slot & ~(size_t) (OHMAP_GROUP_SIZE - 1);
+
+    assert(t->tags[slot] & OHMAP_FULL && t->nodes[slot] == node);
+    if (ohmap_group_zero(ohmap_group_load(t, group))) {
+        /* The group already ends every probe sequence that reaches it, so
+         * the slot can become empty again. */
+        t->tags[slot] = OHMAP_EMPTY;
+        if (!in_old) {
+            ohmap->cur_used--;
+        }
+    } else {
+        t->tags[slot] = OHMAP_DELETED;
+    }
+    ohmap->n--;
+}
+
+/* Puts 'new_node' in the position in 'ohmap' currently occupied by
+ * 'old_node'.  The 'new_node' must hash to the same value as 'old_node'.  The
+ * client is responsible for ensuring that the replacement does not violate
+ * any client-imposed invariants (e.g. uniqueness of keys within a map).
+ *
+ * Afterward, 'old_node' is not part of 'ohmap', and the client is responsible
+ * for freeing it (if this is desirable). */
+void
+ohmap_replace(struct ohmap *ohmap,
+              const struct ohmap_node *old_node, struct ohmap_node *new_node)
+{
+    struct ohmap_table *t = (ohmap_node_in_old(ohmap, old_node)
+                             ? &ohmap->old : &ohmap->cur);
+
+    t->nodes[old_node->slot & ~OHMAP_EPOCH] = new_node;
+    new_node->hash = old_node->hash;
+    new_node->slot = old_node->slot;
+}
+
+/* Returns the next node in 'ohmap' in slot order, or NULL if no nodes remain
+ * in 'ohmap'.  Uses '*bucketp' to determine where to begin iteration, and
+ * stores a new value to pass on the next iteration into it before returning.
+ * '*offsetp' is not used but is kept for compatibility with
+ * hmap_at_position().
+ *
+ * It's better to use plain OHMAP_FOR_EACH and related functions, since they
+ * are faster and better at dealing with ohmaps that change during iteration.
+ *
+ * Before beginning iteration, store 0 into '*bucketp' and '*offsetp'. */
+struct ohmap_node *
+ohmap_at_position(const struct ohmap *ohmap,
+                  uint32_t *bucketp, uint32_t *offsetp)
+{
+    size_t n_cur = ohmap->cur.n_slots;
+    struct ohmap_node *node;
+
+    node = (*bucketp < n_cur
+            ? ohmap_table_next__(&ohmap->cur, *bucketp)
+            : NULL);
+    if (!node) {
+        node = ohmap_table_next__(&ohmap->old,
+                                  *bucketp > n_cur ? *bucketp - n_cur : 0);
+    }
+
+    if (node) {
+        size_t slot = node->slot & ~OHMAP_EPOCH;
+        *bucketp = (ohmap_node_in_old(ohmap, node) ? n_cur + slot : slot) + 1;
+    } else {
+        *bucketp = 0;
+    }
+    *offsetp = 0;
+    return node;
+}
@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) 2011 Nicira Networks.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef OHMAP_H
+#define OHMAP_H 1
+
+/* Open-addressing hash map.
+ *
+ * An ohmap has the same interface as an hmap: clients embed a "struct
+ * ohmap_node" in the structures that they store and look them up by hash
+ * value with OHMAP_FOR_EACH_WITH_HASH.  The implementation is different,
+ * though.  Instead of chaining nodes through a 'next' pointer in each node,
+ * an ohmap keeps pointers to its nodes in an array of slots, probed linearly.
+ * Alongside each slot it keeps a one-byte tag derived from the node's hash
+ * value.  Slots are grouped by OHMAP_GROUP_SIZE, and a single 64-bit word
+ * operation compares a group's tags against a hash value's tag.  A lookup
+ * therefore usually touches one cache line of tags and dereferences only the
+ * node that it is looking for, instead of every node that shares its bucket.
+ *
+ * An ohmap also resizes incrementally: when it grows, it allocates a new slot
+ * array but moves only a few groups of nodes out of the old one on each
+ * insertion, searching both arrays until the move is complete, so that no
+ * single insertion has to rehash the whole map.
+ *
+ * Removing a node from an ohmap does not invalidate an iteration that has
+ * visited it.  Inserting a node into an ohmap may move any node. */
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/* A hash map node, to be embedded inside the data structure being mapped. */
+struct ohmap_node {
+    size_t hash;                /* Hash value. */
+    size_t slot;                /* Slot index, plus table's OHMAP_EPOCH. */
+};
+
+/* Returns the hash value embedded in 'node'. */
+static inline size_t ohmap_node_hash(const struct ohmap_node *node)
+{
+    return node->hash;
+}
+
+/* Number of slots in a group.  One group's tags fit in a uint64_t. */
+#define OHMAP_GROUP_SIZE 8
+
+/* Values for the tag of a slot.  The tag of a slot that holds a node is
+ * OHMAP_FULL plus 7 bits of the node's hash value. */
+#define OHMAP_EMPTY 0x00        /* Never held a node since last rehash. */
+#define OHMAP_DELETED 0x01      /* Held a node that was removed. */
+#define OHMAP_FULL 0x80         /* Holds a node. */
+
+/* A bit in an ohmap_node's 'slot' that identifies the table that the node is
+ * in.  Each time an ohmap starts to resize, it flips the bit that it uses for
+ * its current table, so that the nodes that it has not yet moved are marked
+ * as being in its old table without having to touch them. */
+#define OHMAP_EPOCH ((size_t) 1 << (sizeof(size_t) * CHAR_BIT - 1))
+
+/* An array of slots. */
+struct ohmap_table {
+    uint8_t *tags;              /* 'n_slots' tags. */
+    struct ohmap_node **nodes;  /* 'n_slots' nodes, valid if tag is full. */
+    size_t n_slots;             /* 0 or a power of 2 >= OHMAP_GROUP_SIZE. */
+};
+
+/* A hash map. */
+struct ohmap {
+    struct ohmap_table cur;     /* Table for insertions. */
+    struct ohmap_table old;     /* Table being emptied into 'cur', if any. */
+    size_t migrated;            /* Number of groups moved out of 'old'. */
+    size_t n;                   /* Number of nodes in both tables. */
+    size_t cur_used;            /* Full and deleted slots in 'cur'. */
+    size_t epoch;               /* OHMAP_EPOCH bit for nodes in 'cur'. */
+};
+
+/* Initializer for an empty hash map. */
+#define OHMAP_INITIALIZER { { NULL, NULL, 0 }, { NULL, NULL, 0 }, 0, 0, 0, 0 }
+
+/* Initialization. */
+void ohmap_init(struct ohmap *);
+void ohmap_destroy(struct ohmap *);
+static inline size_t ohmap_count(const struct ohmap *);
+static inline bool ohmap_is_empty(const struct ohmap *);
+
+/* Insertion and deletion. */
+void ohmap_insert(struct ohmap *, struct ohmap_node *, size_t hash);
+void ohmap_remove(struct ohmap *, struct ohmap_node *);
+void ohmap_replace(struct ohmap *, const struct ohmap_node *old,
+                   struct ohmap_node *new_node);
+
+/* Search.
+ *
+ * OHMAP_FOR_EACH_WITH_HASH iterates NODE over all of the nodes in OHMAP that
+ * have hash value equal to HASH.  MEMBER must be the name of the 'struct
+ * ohmap_node' member within NODE.
+ *
+ * The loop should not change NODE to point to a different node or insert or
+ * delete nodes in OHMAP (unless it "break"s out of the loop to terminate
+ * iteration).
+ *
+ * HASH is only evaluated once.
+ */
+#define OHMAP_FOR_EACH_WITH_HASH(NODE, MEMBER, HASH, OHMAP)             \
+    for (ASSIGN_CONTAINER(NODE, ohmap_first_with_hash(OHMAP, HASH), MEMBER); \
+         &(NODE)->MEMBER != NULL;                                       \
+         ASSIGN_CONTAINER(NODE, ohmap_next_with_hash(OHMAP, &(NODE)->MEMBER), \
+                          MEMBER))
+
+static inline struct ohmap_node *ohmap_first_with_hash(const struct ohmap *,
+                                                       size_t hash);
+static inline struct ohmap_node *ohmap_next_with_hash(
+    const struct ohmap *, const struct ohmap_node *);
+
+/* Iteration. */
+
+/* Iterates through every node in OHMAP. */
+#define OHMAP_FOR_EACH(NODE, MEMBER, OHMAP)                             \
+    for (ASSIGN_CONTAINER(NODE, ohmap_first(OHMAP), MEMBER);            \
+         &(NODE)->MEMBER != NULL;                                       \
+         ASSIGN_CONTAINER(NODE, ohmap_next(OHMAP, &(NODE)->MEMBER), MEMBER))
+
+/* Safe when NODE may be freed (not needed when NODE may be removed from the
+ * hash map but its members remain accessible and intact). */
+#define OHMAP_FOR_EACH_SAFE(NODE, NEXT, MEMBER, OHMAP)                  \
+    for (ASSIGN_CONTAINER(NODE, ohmap_first(OHMAP), MEMBER);            \
+         (&(NODE)->MEMBER != NULL                                       \
+          ? ASSIGN_CONTAINER(NEXT, ohmap_next(OHMAP, &(NODE)->MEMBER), MEMBER) \
+          : 0);                                                         \
+         (NODE) = (NEXT))
+
+/* Continues an iteration from just after NODE. */
+#define OHMAP_FOR_EACH_CONTINUE(NODE, MEMBER, OHMAP)                    \
+    for (ASSIGN_CONTAINER(NODE, ohmap_next(OHMAP, &(NODE)->MEMBER), MEMBER); \
+         &(NODE)->MEMBER != NULL;                                       \
+         ASSIGN_CONTAINER(NODE, ohmap_next(OHMAP, &(NODE)->MEMBER), MEMBER))
+
+static inline struct ohmap_node *ohmap_first(const struct ohmap *);
+static inline struct ohmap_node *ohmap_next(const struct ohmap *,
+                                            const struct ohmap_node *);
+
+struct ohmap_node *ohmap_at_position(const struct ohmap *,
+                                     uint32_t *bucket, uint32_t *offset);
+
+/* Returns the number of nodes currently in 'ohmap'. */
+static inline size_t
+ohmap_count(const struct ohmap *ohmap)
+{
+    return ohmap->n;
+}
+
+/* Returns true if 'ohmap' currently contains no nodes, false otherwise. */
+static inline bool
+ohmap_is_empty(const struct ohmap *ohmap)
+{
+    return ohmap->n == 0;
+}
+
+/* Group operations.
+ *
+ * These treat the tags of a group of slots as a 64-bit word and return masks
+ * in which the high bit of each byte indicates a matching slot. */
+
+static inline uint64_t
+ohmap_group_load(const struct ohmap_table *t, size_t group)
+{
+    uint64_t word;
+
+    memcpy(&word, &t->tags[group], sizeof word);
+    return word;
+}
+
+/* Returns a mask of the bytes in 'word' that are zero. */
+static inline uint64_t
+ohmap_group_zero(uint64_t word)
+{
+    const uint64_t lo7 = UINT64_C(0x7f7f7f7f7f7f7f7f);
+
+    return ~(((word & lo7) + lo7) | word | lo7);
+}
+
+/* Returns a mask of the bytes in 'word' that equal 'tag'. */
+static inline uint64_t
+ohmap_group_match(uint64_t word, uint8_t tag)
+{
+    return ohmap_group_zero(word ^ (tag * UINT64_C(0x0101010101010101)));
+}
+
+/* Returns a mask of the slots with index 'first' or later in a group. */
+static inline uint64_t
+ohmap_group_from(size_t first)
+{
+    const uint64_t all = UINT64_C(0x8080808080808080);
+
+    return (first >= OHMAP_GROUP_SIZE ? 0
+#ifdef WORDS_BIGENDIAN
+            : all >> (first * 8)
+#else
+            : all << (first * 8)
+#endif
+            );
+}
+
+/* Returns the index within its group of the first slot in 'mask', which must
+ * be nonzero. */
+static inline size_t
+ohmap_group_first(uint64_t mask)
+{
+#ifdef WORDS_BIGENDIAN
+    return __builtin_clzll(mask) / 8;
+#else
+    return __builtin_ctzll(mask) / 8;
+#endif
+}
+
+/* Returns the tag for a node with the given 'hash'. */
+static inline uint8_t
+ohmap_tag(size_t hash)
+{
+    return OHMAP_FULL | ((hash >> 25) & 0x7f);
+}
+
+/* Searches 't' for a node with the given 'hash', starting from the slot
+ * 'group' + 'first', which must be in the probe sequence for 'hash'. */
+static inline struct ohmap_node *
+ohmap_table_find__(const struct ohmap_table *t, size_t hash,
+                   size_t group, size_t first)
+{
+    uint8_t tag = ohmap_tag(hash);
+
+    for (;;) {
+        uint64_t word = ohmap_group_load(t, group);
+        uint64_t match = ohmap_group_match(word, tag) & ohmap_group_from(first);
+
+        while (match) {
+            size_t i = ohmap_group_first(match);
+            struct ohmap_node *node = t->nodes[group + i];
+
+            if (node->hash == hash) {
+                return node;
+            }
+            match &= ~ohmap_group_from(i) | ohmap_group_from(i + 1);
+        }
+        if (ohmap_group_zero(word)) {
+            /* A group with an empty slot ends the probe sequence. */
+            return NULL;
+        }
+        group = (group + OHMAP_GROUP_SIZE) & (t->n_slots - 1);
+        first = 0;
+    }
+}
+
+/* Returns the first slot in the probe sequence for 'hash' in 't'. */
+static inline size_t
+ohmap_table_home(const struct ohmap_table *t, size_t hash)
+{
+    return (hash * OHMAP_GROUP_SIZE) & (t->n_slots - 1);
+}
+
+static inline struct ohmap_node *
+ohmap_table_find(const struct ohmap_table *t, size_t hash)
+{
+    return (t->n_slots
+            ? ohmap_table_find__(t, hash, ohmap_table_home(t, hash), 0)
+            : NULL);
+}
+
+/* Returns the first node in 'ohmap' with the given 'hash', or a null pointer
+ * if no nodes have that hash value. */
+static inline struct ohmap_node *
+ohmap_first_with_hash(const struct ohmap *ohmap, size_t hash)
+{
+    struct ohmap_node *node = ohmap_table_find(&ohmap->cur, hash);
+    return node ? node : ohmap_table_find(&ohmap->old, hash);
+}
+
+/* Returns true if 'node' is in (or was most recently removed from) the old
+ * table of 'ohmap'. */
+static inline bool
+ohmap_node_in_old(const struct ohmap *ohmap, const struct ohmap_node *node)
+{
+    return (node->slot & OHMAP_EPOCH) != ohmap->epoch;
+}
+
+/* Returns the next node in 'ohmap' with the same hash value as 'node', or a
+ * null pointer if no more nodes have that hash value. */
+static inline struct ohmap_node *
+ohmap_next_with_hash(const struct ohmap *ohmap, const struct ohmap_node *node)
+{
+    size_t slot = node->slot & ~OHMAP_EPOCH;
+    size_t group = slot & ~(size_t) (OHMAP_GROUP_SIZE - 1);
+    size_t first = slot - group + 1;
+
+    if (ohmap_node_in_old(ohmap, node)) {
+        return ohmap_table_find__(&ohmap->old, node->hash, group, first);
+    } else {
+        struct ohmap_node *next;
+
+        next = ohmap_table_find__(&ohmap->cur, node->hash, group, first);
+        return next ? next : ohmap_table_find(&ohmap->old, node->hash);
+    }
+}
+
+/* Returns the first node in 't' at or after 'slot', or a null pointer if
+ * there is none. */
+static inline struct ohmap_node *
+ohmap_table_next__(const struct ohmap_table *t, size_t slot)
+{
+    while (slot < t->n_slots) {
+        size_t group = slot & ~(size_t) (OHMAP_GROUP_SIZE - 1);
+        uint64_t full = (ohmap_group_load(t, group)
+                         & ohmap_group_from(slot - group));
+
+        if (full) {
+            return t->nodes[group + ohmap_group_first(full)];
+        }
+        slot = group + OHMAP_GROUP_SIZE;
+    }
+    return NULL;
+}
+
+/* Returns the first node in 'ohmap', in arbitrary order, or a null pointer if
+ * 'ohmap' is empty. */
+static inline struct ohmap_node *
+ohmap_first(const struct ohmap *ohmap)
+{
+    struct ohmap_node *node = ohmap_table_next__(&ohmap->cur, 0);
+    return node ? node : ohmap_table_next__(&ohmap->old, 0);
+}
+
+/* Returns the next node in 'ohmap' following 'node', in arbitrary order, or a
+ * null pointer if 'node' is the last node in 'ohmap'.
+ *
+ * If a node has been inserted into 'ohmap' since 'node' was visited, some
+ * nodes may be skipped or visited twice.  (Removing 'node' from the hash map
+ * does not prevent calling this function, although freeing 'node' of course
+ * does.) */
+static inline struct ohmap_node *
+ohmap_next(const struct ohmap *ohmap, const struct ohmap_node *node)
+{
+    size_t slot = node->slot & ~OHMAP_EPOCH;
+
+    if (ohmap_node_in_old(ohmap, node)) {
+        return ohmap_table_next__(&ohmap->old, slot + 1);
+    } else {
+        struct ohmap_node *next = ohmap_table_next__(&ohmap->cur, slot + 1);
+        return next ? next : ohmap_table_next__(&ohmap->old, 0);
+    }
+}
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* ohmap.h */
@@ -28,6 +28,7 @@
 #include "fatal-signal.h"
 #include "json.h"
 #include "jsonrpc.h"
+#include "memory.h"
 #include "ovsdb-data.h"
 #include "ovsdb-error.h"
 #include "ovsdb-idl-provider.h"
@@ -38,6 +39,8 @@
 
 VLOG_DEFINE_THIS_MODULE(ovsdb_idl);
 
+MEMORY_DEFINE(idl_row);
+
 /* An arc from one idl_row to another.  When row A contains a UUID that
  * references row B, this is represented by an arc from A (the source) to B
  * (the destination).
@@ -129,6 +132,7 @@ static bool ovsdb_idl_modify_row(struct ovsdb_idl_row *, const struct json *);
 static bool ovsdb_idl_row_is_orphan(const struct ovsdb_idl_row *);
 static struct ovsdb_idl_row *ovsdb_idl_row_create__(
     const struct ovsdb_idl_table_class *);
+static void ovsdb_idl_row_free__(struct ovsdb_idl_row *);
 static struct ovsdb_idl_row *ovsdb_idl_row_create(struct ovsdb_idl_table *,
                                                   const struct uuid *);
 static void ovsdb_idl_row_destroy(struct ovsdb_idl_row *);
@@ -199,6 +203,7 @@ ovsdb_idl_create(const char *remote, const struct ovsdb_idl_class *class,
             shash_add_assert(&table->columns, column->name, column);
         }
         hmap_init(&table->rows);
+        hmap_set_incremental(&table->rows, true);
         table->idl = idl;
     }
     idl->last_monitor_request_seqno = UINT_MAX;
@@ -912,12 +917,22 @@ static struct ovsdb_idl_row *
 ovsdb_idl_row_create__(const struct ovsdb_idl_table_class *class)
 {
     struct ovsdb_idl_row *row = xzalloc(class->allocation_size);
+    memory_inc(&memory_idl_row, class->allocation_size);
     list_init(&row->src_arcs);
     list_init(&row->dst_arcs);
     hmap_node_nullify(&row->txn_node);
     return row;
 }
 
+/* Frees 'row', which must have been created with ovsdb_idl_row_create__() and
+ * had its 'table' member set. */
+static void
+ovsdb_idl_row_free__(struct ovsdb_idl_row *row)
+{
+    memory_dec(&memory_idl_row, row->table->class->allocation_size);
+    free(row);
+}
+
 static struct ovsdb_idl_row *
 ovsdb_idl_row_create(struct ovsdb_idl_table *table, const struct uuid *uuid)
 {
@@ -934,7 +949,7 @@ ovsdb_idl_row_destroy(struct ovsdb_idl_row *row)
     if (row) {
         ovsdb_idl_row_clear_old(row);
         hmap_remove(&row->table->rows, &row->hmap_node);
-        free(row);
+        ovsdb_idl_row_free__(row);
     }
 }
 
@@ -1386,7 +1401,7 @@ ovsdb_idl_txn_disassemble(struct ovsdb_idl_txn *txn)
         hmap_node_nullify(&row->txn_node);
         if (!row->old) {
             hmap_remove(&row->table->rows, &row->hmap_node);
-            free(row);
+            ovsdb_idl_row_free__(row);
         }
     }
     hmap_destroy(&txn->txn_rows);
@@ -1824,7 +1839,7 @@ ovsdb_idl_txn_delete(const struct ovsdb_idl_row *row_)
         assert(!row->prereqs);
         hmap_remove(&row->table->rows, &row->hmap_node);
         hmap_remove(&row->table->idl->txn->txn_rows, &row->txn_node);
-        free(row);
+        ovsdb_idl_row_free__(row);
         return;
     }
     if (hmap_node_is_null(&row->txn_node)) {
@@ -18,10 +18,17 @@
 #include "pcap.h"
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "compiler.h"
 #include "ofpbuf.h"
+#include "socket-util.h"
+#include "util.h"
 #include "vlog.h"
 
 VLOG_DEFINE_THIS_MODULE(pcap);
@@ -116,8 +123,11 @@ pcap_read(FILE *file, struct ofpbuf **bufp)
     /* Read header. */
     if (fread(&prh, sizeof prh, 1, file) != 1) {
         int error = ferror(file) ? errno : EOF;
-        VLOG_WARN("failed to read pcap record header: %s",
-                  ovs_retval_to_string(error));
+        if (error != EOF) {
+            /* End of file between records is the normal end of a capture. */
+            VLOG_WARN("failed to read pcap record header: %s",
+                      ovs_retval_to_string(error));
+        }
         return error;
     }
 
@@ -162,3 +172,323 @@ pcap_write(FILE *file, struct ofpbuf *buf)
     ignore(fwrite(&prh, sizeof prh, 1, file));
     ignore(fwrite(buf->data, buf->size, 1, file));
 }
+
+/* Fast pcap reading. */
+
+/* Magic numbers for pcap files with timestamps in microseconds and
+ * nanoseconds, respectively, in the byte order of the machine that wrote
+ * them. */
+#define PCAP_MAGIC_USEC 0xa1b2c3d4
+#define PCAP_MAGIC_NSEC 0xa1b23c4d
+
+struct pcap_reader {
+    char *file_name;
+    uint8_t *data;              /* Contents of the file. */
+    size_t size;                /* Number of bytes in 'data'. */
+    size_t ofs;                 /* Offset of the next record in 'data'. */
+    bool mapped;                /* Is 'data' mmap()'d (versus malloc()'d)? */
+    bool swap;                  /* Is the file in the opposite byte order? */
+    bool nsec;                  /* Are timestamps in nanoseconds? */
+};
+
+static uint32_t
+swap32(uint32_t x)
+{
+    return (((x & 0xff000000) >> 24) |
+            ((x & 0x00ff0000) >>  8) |
+            ((x & 0x0000ff00) <<  8) |
+            ((x & 0x000000ff) << 24));
+}
+
+/* Reads all of 'fd' into a newly allocated buffer, for files that cannot be
+ * mapped, such as pipes.  Returns 0 if successful, otherwise a positive errno
+ * value. */
+static int
+pcap_reader_slurp(struct pcap_reader *r, int fd)
+{
+    size_t allocated = 0;
+
+    r->data = NULL;
+    r->size = 0;
+    for (;;) {
+        size_t n;
+        int error;
+
+        if (r->size >= allocated) {
+            allocated = MAX(65536, allocated * 2);
+            r->data = xrealloc(r->data, allocated);
+        }
+        error = read_fully(fd, r->data + r->size, allocated - r->size, &n);
+        r->size += n;
+        if (error == EOF) {
+            return 0;
+        } else if (error) {
+            return error;
+        }
+    }
+}
+
+/* Opens the pcap file named 'file_name' for reading with pcap_reader_next().
+ * Regular files are mapped into memory, so that reading a packet does not
+ * copy it; other files are read into memory in their entirety.
+ *
+ * Returns 0 and stores the new reader in '*readerp' if successful, otherwise
+ * stores NULL in '*readerp' and returns a positive errno value. */
+int
+pcap_reader_open(const char *file_name, struct pcap_reader **readerp)
+{
+    struct pcap_reader *r;
+    struct pcap_hdr ph;
+    struct stat s;
+    int error;
+    int fd;
+
+    *readerp = NULL;
+
+    fd = open(file_name, O_RDONLY);
+    if (fd < 0) {
+        error = errno;
+        VLOG_WARN("%s: failed to open pcap file for reading (%s)",
+                  file_name, strerror(error));
+        return error;
+    }
+
+    r = xzalloc(sizeof *r);
+    r->file_name = xstrdup(file_name);
+    if (!fstat(fd, &s) && S_ISREG(s.st_mode) && s.st_size > 0) {
+        void *p = mmap(NULL, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            r->data = p;
+            r->size = s.st_size;
+            r->mapped = true;
+            madvise(p, s.st_size, MADV_SEQUENTIAL);
+        }
+    }
+    error = r->mapped ? 0 : pcap_reader_slurp(r, fd);
+    close(fd);
+    if (error) {
+        VLOG_WARN("%s: error reading pcap file (%s)",
+                  file_name, strerror(error));
+        goto error;
+    }
+
+    if (r->size < sizeof ph) {
+        VLOG_WARN("%s: pcap file too short", file_name);
+        error = EPROTO;
+        goto error;
+    }
+    memcpy(&ph, r->data, sizeof ph);
+    if (ph.magic_number == PCAP_MAGIC_USEC
+        || ph.magic_number == PCAP_MAGIC_NSEC) {
+        r->swap = false;
+    } else if (ph.magic_number == swap32(PCAP_MAGIC_USEC)
+               || ph.magic_number == swap32(PCAP_MAGIC_NSEC)) {
+        r->swap = true;
+    } else {
+        VLOG_WARN("%s: bad magic 0x%08"PRIx32" reading pcap file",
+                  file_name, ph.magic_number);
+        error = EPROTO;
+        goto error;
+    }
+    r->nsec = (ph.magic_number == PCAP_MAGIC_NSEC
+               || ph.magic_number == swap32(PCAP_MAGIC_NSEC));
+    r->ofs = sizeof ph;
+
+    *readerp = r;
+    return 0;
+
+error:
+    pcap_reader_close(r);
+    return error;
+}
+
+/* Reads the next packet from 'r' into 'packet'.  The packet data remains
+ * valid until 'r' is closed.
+ *
+ * Returns 0 if successful, EOF at the end of the file, or EPROTO if the file
+ * is truncated or corrupt. */
+int
+pcap_reader_next(struct pcap_reader *r, struct pcap_packet *packet)
+{
+    struct pcaprec_hdr prh;
+
+    if (r->ofs >= r->size) {
+        return EOF;
+    } else if (r->size - r->ofs < sizeof prh) {
+        VLOG_WARN("%s: truncated pcap record header", r->file_name);
+        r->ofs = r->size;
+        return EPROTO;
+    }
+
+    memcpy(&prh, &r->data[r->ofs], sizeof prh);
+    if (r->swap) {
+        prh.ts_sec = swap32(prh.ts_sec);
+        prh.ts_usec = swap32(prh.ts_usec);
+        prh.incl_len = swap32(prh.incl_len);
+        prh.orig_len = swap32(prh.orig_len);
+    }
+    if (prh.incl_len > r->size - r->ofs - sizeof prh) {
+        VLOG_WARN("%s: truncated pcap packet", r->file_name);
+        r->ofs = r->size;
+        return EPROTO;
+    }
+
+    packet->data = &r->data[r->ofs + sizeof prh];
+    packet->size = prh.incl_len;
+    packet->usec = (prh.ts_sec * 1000000LL
+                    + (r->nsec ? prh.ts_usec / 1000 : prh.ts_usec));
+    r->ofs += sizeof prh + prh.incl_len;
+    return 0;
+}
+
+/* Makes the next call to pcap_reader_next() on 'r' return the first packet
+ * in the file again. */
+void
+pcap_reader_rewind(struct pcap_reader *r)
+{
+    r->ofs = sizeof(struct pcap_hdr);
+}
+
+/* Closes 'r' and frees all of its resources. */
+void
+pcap_reader_close(struct pcap_reader *r)
+{
+    if (r) {
+        if (r->mapped) {
+            munmap(r->data, r->size);
+        } else {
+            free(r->data);
+        }
+        free(r->file_name);
+        free(r);
+    }
+}
+
+/* Buffered pcap writing. */
+
+#define PCAP_WRITER_BUFSIZE 65536
+
+struct pcap_writer {
+    char *file_name;
+    int fd;
+    int error;                  /* First write error, or 0 if none. */
+    size_t len;                 /* Number of bytes in 'buf'. */
+    uint8_t buf[PCAP_WRITER_BUFSIZE];
+};
+
+static void
+pcap_writer_write(struct pcap_writer *w, const void *data, size_t size)
+{
+    if (!w->error) {
+        size_t n;
+
+        w->error = write_fully(w->fd, data, size, &n);
+        if (w->error) {
+            VLOG_WARN("%s: error writing pcap file (%s)",
+                      w->file_name, strerror(w->error));
+        }
+    }
+}
+
+/* Creates a pcap file named 'file_name', truncating it if it already exists,
+ * and writes its header.  Packets added with pcap_writer_put() are buffered
+ * in memory and written in large chunks, so a packet is not in the file until
+ * the buffer fills up or it is explicitly flushed or closed.
+ *
+ * Returns 0 and stores the new writer in '*writerp' if successful, otherwise
+ * stores NULL in '*writerp' and returns a positive errno value. */
+int
+pcap_writer_open(const char *file_name, struct pcap_writer **writerp)
+{
+    struct pcap_writer *w;
+    struct pcap_hdr ph;
+    int fd;
+
+    *writerp = NULL;
+
+    fd = open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        int error = errno;
+        VLOG_WARN("%s: failed to open pcap file for writing (%s)",
+                  file_name, strerror(error));
+        return error;
+    }
+
+    w = xmalloc(sizeof *w);
+    w->file_name = xstrdup(file_name);
+    w->fd = fd;
+    w->error = 0;
+    w->len = 0;
+
+    ph.magic_number = PCAP_MAGIC_USEC;
+    ph.version_major = 2;
+    ph.version_minor = 4;
+    ph.thiszone = 0;
+    ph.sigfigs = 0;
+    ph.snaplen = 65535;
+    ph.network = 1;             /* Ethernet */
+    memcpy(w->buf, &ph, sizeof ph);
+    w->len = sizeof ph;
+
+    *writerp = w;
+    return 0;
+}
+
+/* Adds the 'size' bytes of packet data in 'data' to 'w', with a timestamp of
+ * 'usec' microseconds since the epoch. */
+void
+pcap_writer_put(struct pcap_writer *w, const void *data, size_t size,
+                long long int usec)
+{
+    struct pcaprec_hdr prh;
+
+    prh.ts_sec = usec / 1000000;
+    prh.ts_usec = usec % 1000000;
+    prh.incl_len = size;
+    prh.orig_len = size;
+
+    if (w->len + sizeof prh + size > PCAP_WRITER_BUFSIZE) {
+        pcap_writer_flush(w);
+    }
+    memcpy(&w->buf[w->len], &prh, sizeof prh);
+    w->len += sizeof prh;
+    if (size <= PCAP_WRITER_BUFSIZE - w->len) {
+        memcpy(&w->buf[w->len], data, size);
+        w->len += size;
+    } else {
+        pcap_writer_flush(w);
+        pcap_writer_write(w, data, size);
+    }
+}
+
+/* Writes any packets buffered in 'w' to its file.  Returns 0 if successful,
+ * otherwise the positive errno value for the first error that occurred while
+ * writing to the file. */
+int
+pcap_writer_flush(struct pcap_writer *w)
+{
+    if (w->len) {
+        pcap_writer_write(w, w->buf, w->len);
+        w->len = 0;
+    }
+    return w->error;
+}
+
+/* Flushes and closes 'w' and frees all of its resources.  Returns 0 if all of
+ * the packets were written successfully, otherwise a positive errno
+ * value. */
+int
+pcap_writer_close(struct pcap_writer *w)
+{
+    int error = 0;
+
+    if (w) {
+        error = pcap_writer_flush(w);
+        if (close(w->fd) && !error) {
+            error = errno;
+        }
+        free(w->file_name);
+        free(w);
+    }
+    return error;
+}
@@ -17,6 +17,7 @@
 #ifndef PCAP_H
 #define PCAP_H 1
 
+#include <stddef.h>
 #include <stdio.h>
 
 struct ofpbuf;
@@ -27,4 +28,31 @@ void pcap_write_header(FILE *);
 int pcap_read(FILE *, struct ofpbuf **);
 void pcap_write(FILE *, struct ofpbuf *);
 
-#endif /* dhcp.h */
+/* Fast pcap reading.
+ *
+ * Unlike pcap_read(), which copies each packet into a newly allocated ofpbuf,
+ * a pcap_reader maps the whole file into memory and returns pointers into
+ * it. */
+struct pcap_reader;
+
+struct pcap_packet {
+    const void *data;           /* Packet data. */
+    size_t size;                /* Number of bytes in 'data'. */
+    long long int usec;         /* Capture time, in microseconds. */
+};
+
+int pcap_reader_open(const char *file_name, struct pcap_reader **);
+int pcap_reader_next(struct pcap_reader *, struct pcap_packet *);
+void pcap_reader_rewind(struct pcap_reader *);
+void pcap_reader_close(struct pcap_reader *);
+
+/* Buffered pcap writing. */
+struct pcap_writer;
+
+int pcap_writer_open(const char *file_name, struct pcap_writer **);
+void pcap_writer_put(struct pcap_writer *, const void *, size_t,
+                     long long int usec);
+int pcap_writer_flush(struct pcap_writer *);
+int pcap_writer_close(struct pcap_writer *);
+
+#endif /* pcap.h */
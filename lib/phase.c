@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2011 Nicira Networks.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <config.h>
+#include "phase.h"
+#include <stdlib.h>
+#include "dynamic-string.h"
+#include "timeval.h"
+#include "unixctl.h"
+#include "util.h"
+#include "vlog.h"
+
+VLOG_DEFINE_THIS_MODULE(phase);
+
+/* All the phases that have run at least once. */
+static struct phase *all_phases;
+
+/* Log phases that take at least this long, in usec, or never if 0. */
+static long long int log_threshold;
+
+static void phase_unixctl_init(void);
+
+/* Marks the beginning of a run of 'phase'.  A phase may not be nested within
+ * itself. */
+void
+phase_begin(struct phase *phase)
+{
+    if (!phase->registered) {
+        phase_unixctl_init();
+        phase->registered = true;
+        phase->next = all_phases;
+        all_phases = phase;
+    }
+    phase->start = time_usec();
+}
+
+/* Marks the end of the run of 'phase' most recently begun with phase_begin()
+ * and records its duration. */
+void
+phase_end(struct phase *phase)
+{
+    long long int elapsed = time_usec() - phase->start;
+
+    if (elapsed < 0) {
+        elapsed = 0;
+    }
+    histogram_add(&phase->durations, elapsed);
+
+    if (log_threshold && elapsed >= log_threshold) {
+        static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(10, 10);
+        VLOG_WARN_RL(&rl, "%s phase took %lld.%03lld ms", phase->name,
+                     elapsed / 1000, elapsed % 1000);
+    }
+}
+
+static void
+phase_unixctl_show(struct unixctl_conn *conn, const char *args OVS_UNUSED,
+                   void *aux OVS_UNUSED)
+{
+    const struct phase *phase;
+    struct ds s;
+
+    ds_init(&s);
+    ds_put_cstr(&s, "phase                     count     p50 ms     p99 ms"
+                "     max ms   total ms\n");
+    for (phase = all_phases; phase; phase = phase->next) {
+        const struct histogram *h = &phase->durations;
+
+        if (!h->n) {
+            continue;
+        }
+        ds_put_format(&s, "%-20s %10llu", phase->name, h->n);
+        histogram_format_msec(h, &s);
+        ds_put_char(&s, '\n');
+    }
+    if (log_threshold) {
+        ds_put_format(&s, "logging phases that take %lld ms or longer\n",
+                      log_threshold / 1000);
+    }
+    unixctl_command_reply(conn, 200, ds_cstr(&s));
+    ds_destroy(&s);
+}
+
+static void
+phase_unixctl_reset(struct unixctl_conn *conn, const char *args OVS_UNUSED,
+                    void *aux OVS_UNUSED)
+{
+    struct phase *phase;
+
+    for (phase = all_phases; phase; phase = phase->next) {
+        histogram_clear(&phase->durations);
+    }
+    unixctl_command_reply(conn, 200, NULL);
+}
+
+static void
+phase_unixctl_log_threshold(struct unixctl_conn *conn, const char *args,
+                            void *aux OVS_UNUSED)
+{
+    unsigned int msec;
+
+    if (!str_to_uint(args, 10, &msec)) {
+        unixctl_command_reply(conn, 501, "argument must be a nonnegative "
+                              "number of milliseconds");
+        return;
+    }
+    log_threshold = msec * 1000LL;
+    unixctl_command_reply(conn, 200, NULL);
+}
+
+static void
+phase_unixctl_init(void)
+{
+    static bool registered;
+    if (registered) {
+        return;
+    }
+    registered = true;
+
+    unixctl_command_register("phase/show", phase_unixctl_show, NULL);
+    unixctl_command_register("phase/reset", phase_unixctl_reset, NULL);
+    unixctl_command_register("phase/log-threshold",
+                             phase_unixctl_log_threshold, NULL);
+}
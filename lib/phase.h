@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2011 Nicira Networks.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PHASE_H
+#define PHASE_H 1
+
+/* Main loop phase timing.
+ *
+ * A "phase" is a named piece of work that a program's main loop does on each
+ * trip through the loop, e.g. running one module.  Bracketing the work with
+ * phase_begin() and phase_end() records how long it took, in a histogram that
+ * the "phase/show" command reported by ovs-appctl summarizes.  This makes it
+ * possible to tell which part of the main loop is responsible for a long
+ * interval between polls.
+ *
+ * Like coverage counters, phases are intended to be cheap enough to be left
+ * enabled in production builds: each phase_begin() and phase_end() pair costs
+ * two reads of the monotonic clock and a few arithmetic operations. */
+
+#include <stdbool.h>
+#include "histogram.h"
+
+/* A phase of a main loop. */
+struct phase {
+    const char *name;           /* Textual name. */
+    struct phase *next;         /* Next in list of all phases. */
+    bool registered;            /* In list of all phases? */
+    long long int start;        /* Start time of current run, in usec. */
+    struct histogram durations; /* Durations of runs, in usec. */
+};
+
+/* Defines a phase named NAME, as a static variable named phase_NAME.  Each
+ * phase should have a unique NAME within a program. */
+#define PHASE_DEFINE(NAME) \
+        static struct phase phase_##NAME = { #NAME, NULL, false, 0, \
+                                             { 0, 0, 0, { 0 } } }
+
+void phase_begin(struct phase *);
+void phase_end(struct phase *);
+
+#endif /* phase.h */
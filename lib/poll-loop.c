@@ -19,12 +19,19 @@
 #include <assert.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <poll.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
 #include "coverage.h"
 #include "dynamic-string.h"
 #include "fatal-signal.h"
+#include "hash.h"
+#include "hmap.h"
 #include "list.h"
 #include "socket-util.h"
 #include "timeval.h"
@@ -39,16 +46,18 @@ VLOG_DEFINE_THIS_MODULE(poll_loop);
 
 COVERAGE_DEFINE(poll_fd_wait);
 COVERAGE_DEFINE(poll_zero_timeout);
+COVERAGE_DEFINE(poll_epoll_ctl);
 
 /* An event that will wake the following call to poll_block(). */
 struct poll_waiter {
     /* Set when the waiter is created. */
-    struct list node;           /* Element in global waiters list. */
+    struct list node;           /* In 'waiters' or a poll_reg's 'waiters'. */
     int fd;                     /* File descriptor. */
     short int events;           /* Events to wait for (POLLIN, POLLOUT). */
     const char *where;          /* Where the waiter was created. */
 
-    /* Set only when poll_block() is called. */
+    /* Set only when poll_block() is called, and only for waiters in the
+     * global 'waiters' list. */
     struct pollfd *pollfd;      /* Pointer to element of the pollfds array. */
 };
 
@@ -65,6 +74,102 @@ static const char *timeout_where;
 static struct poll_waiter *new_waiter(int fd, short int events,
                                       const char *where);
 
+/* A file descriptor registered with poll_fd_register(). */
+struct poll_reg {
+    struct hmap_node hmap_node; /* In 'poll_regs', hashed on 'fd'. */
+    int fd;                     /* File descriptor. */
+    int n_refs;                 /* Number of poll_fd_register() calls. */
+
+    /* With the "epoll" backend, poll_fd_wait() puts waiters for 'fd' here
+     * instead of in 'waiters'.  They belong to the current poll_block() only
+     * if 'seen' == 'poll_seq'.  Older ones are freed the next time 'fd' is
+     * waited on, so that poll_block() does not have to visit every registered
+     * file descriptor to clean up. */
+    unsigned int seen;          /* Last poll_block() that waited on 'fd'. */
+    struct list waiters;        /* Contains "struct poll_waiter"s. */
+    short int wanted;           /* Union of the waiters' events. */
+    short int revents;          /* Events that occurred. */
+
+#ifdef HAVE_SYS_EPOLL_H
+    struct list dirty_node;     /* In 'dirty_regs', if 'dirty'. */
+    bool dirty;                 /* Needs epoll_arm() before waiting? */
+    bool fired;                 /* In 'fired_regs'? */
+    bool in_epoll;              /* Added to 'epoll_fd'? */
+    uint32_t armed;             /* Events armed in 'epoll_fd', 0 if none. */
+#endif
+};
+
+/* All registered file descriptors. */
+static struct hmap poll_regs = HMAP_INITIALIZER(&poll_regs);
+
+/* Incremented at the end of each poll_block(). */
+static unsigned int poll_seq = 1;
+
+static struct poll_reg *poll_reg_find(int fd);
+static void poll_reg_wait(struct poll_reg *, struct poll_waiter *);
+static void epoll_log_wakeups(void);
+
+/* Implementation used by poll_block(). */
+enum poll_backend {
+    POLL_BACKEND_DEFAULT,       /* Not yet chosen. */
+    POLL_BACKEND_POLL,          /* poll(), rebuilt on every call. */
+    POLL_BACKEND_EPOLL          /* epoll, with persistent registrations. */
+};
+static enum poll_backend backend = POLL_BACKEND_DEFAULT;
+
+static int epoll_poll(struct pollfd *, int n_pollfds, int timeout);
+
+/* Selects the implementation that poll_block() uses to wait for events:
+ *
+ *   - "poll" passes every file descriptor to poll() on every call to
+ *     poll_block().  This is the default and is available everywhere.
+ *
+ *   - "epoll" keeps file descriptors registered with poll_fd_register()
+ *     registered with the kernel across calls to poll_block(), so that the
+ *     cost of each call depends on the number of file descriptors that are
+ *     ready rather than the number being waited on.  Other file descriptors
+ *     are still passed to poll().  It is available only on Linux.
+ *
+ * The semantics of poll_fd_wait() and the other functions in this module do
+ * not depend on the implementation.  If this function is never called, the
+ * OVS_POLL_BACKEND environment variable, if set, selects the implementation.
+ *
+ * Returns true if successful, false if 'name' is unknown or unsupported on
+ * this platform. */
+bool
+poll_set_backend(const char *name)
+{
+    if (!strcmp(name, "poll")) {
+        backend = POLL_BACKEND_POLL;
+        return true;
+#ifdef HAVE_SYS_EPOLL_H
+    } else if (!strcmp(name, "epoll")) {
+        backend = POLL_BACKEND_EPOLL;
+        return true;
+#endif
+    } else {
+        return false;
+    }
+}
+
+/* Returns the name of the implementation that poll_block() uses. */
+const char *
+poll_get_backend(void)
+{
+    if (backend == POLL_BACKEND_DEFAULT) {
+        const char *name = getenv("OVS_POLL_BACKEND");
+
+        if (!name || !poll_set_backend(name)) {
+            if (name) {
+                VLOG_WARN("OVS_POLL_BACKEND=%s: unknown or unsupported poll "
+                          "loop implementation, using poll", name);
+            }
+            backend = POLL_BACKEND_POLL;
+        }
+    }
+    return backend == POLL_BACKEND_EPOLL ? "epoll" : "poll";
+}
+
 /* Registers 'fd' as waiting for the specified 'events' (which should be POLLIN
  * or POLLOUT or POLLIN | POLLOUT).  The following call to poll_block() will
  * wake up when 'fd' becomes ready for one or more of the requested events.
@@ -221,9 +326,10 @@ poll_block(void)
      * poll_block. */
     fatal_signal_wait();
 
+    /* The "epoll" backend uses one more pollfd, for the epoll fd. */
     n_waiters = list_size(&waiters);
-    if (max_pollfds < n_waiters) {
-        max_pollfds = n_waiters;
+    if (max_pollfds < n_waiters + 1) {
+        max_pollfds = n_waiters + 1;
         pollfds = xrealloc(pollfds, max_pollfds * sizeof *pollfds);
     }
 
@@ -239,7 +345,12 @@ poll_block(void)
     if (!timeout) {
         COVERAGE_INC(poll_zero_timeout);
     }
-    retval = time_poll(pollfds, n_pollfds, timeout);
+    poll_get_backend();
+    if (backend == POLL_BACKEND_EPOLL) {
+        retval = epoll_poll(pollfds, n_pollfds, timeout);
+    } else {
+        retval = time_poll(pollfds, n_pollfds, timeout);
+    }
     if (retval < 0) {
         static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
         VLOG_ERR_RL(&rl, "poll: %s", strerror(-retval));
@@ -253,6 +364,8 @@ poll_block(void)
         }
         poll_cancel(pw);
     }
+    epoll_log_wakeups();
+    poll_seq++;
 
     timeout = -1;
     timeout_where = NULL;
@@ -262,7 +375,9 @@ poll_block(void)
 }
 
 /* Cancels the file descriptor event registered with poll_fd_wait() using 'pw',
- * the struct poll_waiter returned by that function.
+ * the struct poll_waiter returned by that function.  (With the "epoll"
+ * backend, a canceled event on a registered file descriptor might still wake
+ * the following poll_block().)
  *
  * An event registered with poll_fd_wait() may be canceled from its time of
  * registration until the next call to poll_block().  At that point, the event
@@ -281,10 +396,428 @@ static struct poll_waiter *
 new_waiter(int fd, short int events, const char *where)
 {
     struct poll_waiter *waiter = xzalloc(sizeof *waiter);
+    struct poll_reg *reg;
+
     assert(fd >= 0);
     waiter->fd = fd;
     waiter->events = events;
     waiter->where = where;
-    list_push_back(&waiters, &waiter->node);
+
+    poll_get_backend();
+    if (backend == POLL_BACKEND_EPOLL && (reg = poll_reg_find(fd)) != NULL) {
+        poll_reg_wait(reg, waiter);
+    } else {
+        list_push_back(&waiters, &waiter->node);
+    }
     return waiter;
 }
+
+static struct poll_reg *
+poll_reg_find(int fd)
+{
+    struct poll_reg *reg;
+
+    HMAP_FOR_EACH_WITH_HASH (reg, hmap_node, hash_int(fd, 0), &poll_regs) {
+        if (reg->fd == fd) {
+            return reg;
+        }
+    }
+    return NULL;
+}
+
+/* Declares that 'fd' is a long-lived file descriptor that will likely be
+ * passed to poll_fd_wait() before many calls to poll_block().  The "epoll"
+ * implementation (see poll_set_backend()) keeps a registered 'fd' registered
+ * with the kernel across calls to poll_block() instead of passing it to
+ * poll() every time.  Registration does not otherwise change the semantics of
+ * poll_fd_wait().
+ *
+ * The caller must call poll_fd_unregister() before it closes 'fd'. */
+void
+poll_fd_register(int fd)
+{
+    struct poll_reg *reg = poll_reg_find(fd);
+
+    if (!reg) {
+        reg = xzalloc(sizeof *reg);
+        reg->fd = fd;
+        list_init(&reg->waiters);
+        hmap_insert(&poll_regs, &reg->hmap_node, hash_int(fd, 0));
+    }
+    reg->n_refs++;
+}
+
+static void
+poll_reg_free_waiters(struct poll_reg *reg)
+{
+    struct poll_waiter *pw, *next;
+
+    LIST_FOR_EACH_SAFE (pw, next, node, &reg->waiters) {
+        poll_cancel(pw);
+    }
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+static void epoll_del(struct poll_reg *);
+static void epoll_mark_dirty(struct poll_reg *);
+#else
+static void
+epoll_del(struct poll_reg *reg OVS_UNUSED)
+{
+}
+
+static void
+epoll_mark_dirty(struct poll_reg *reg OVS_UNUSED)
+{
+}
+#endif
+
+/* Adds 'waiter' to the waiters for 'reg' in the current poll_block(). */
+static void
+poll_reg_wait(struct poll_reg *reg, struct poll_waiter *waiter)
+{
+    if (reg->seen != poll_seq) {
+        poll_reg_free_waiters(reg);
+        reg->seen = poll_seq;
+        reg->wanted = 0;
+    }
+    list_push_back(&reg->waiters, &waiter->node);
+    reg->wanted |= waiter->events;
+    epoll_mark_dirty(reg);
+}
+
+/* Cancels a registration of 'fd' made with poll_fd_register().  This must be
+ * called before 'fd' is closed, since otherwise a new file descriptor with the
+ * same number could be mistaken for a registered one. */
+void
+poll_fd_unregister(int fd)
+{
+    struct poll_reg *reg = poll_reg_find(fd);
+
+    if (reg && !--reg->n_refs) {
+        epoll_del(reg);
+        poll_reg_free_waiters(reg);
+        hmap_remove(&poll_regs, &reg->hmap_node);
+        free(reg);
+    }
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+/* epoll backend.
+ *
+ * Each registered file descriptor is added to 'epoll_fd' the first time it is
+ * waited on and stays there until it is unregistered.  Registrations use
+ * EPOLLONESHOT, so that a file descriptor that becomes ready is disarmed
+ * until a later poll_block() waits on it again.  poll_reg_wait() puts a file
+ * descriptor on 'dirty_regs' only if it is not already armed for the events
+ * requested, which in the steady state means only if it was ready last time.
+ * poll_block() then calls epoll_ctl() only for 'dirty_regs' and looks only at
+ * the events that epoll_wait() returns, so its cost does not depend on the
+ * number of registered file descriptors.
+ *
+ * A file descriptor that is no longer waited on stays armed.  If it becomes
+ * ready, epoll_poll() ignores the event, which also disarms it, and goes back
+ * to waiting.
+ *
+ * Unregistered file descriptors are passed to poll() along with 'epoll_fd',
+ * just as with the "poll" backend. */
+
+static int epoll_fd = -1;       /* epoll instance, -1 if none yet. */
+static pid_t epoll_pid;         /* Process that created 'epoll_fd'. */
+
+/* Registered file descriptors that need epoll_arm(). */
+static struct list dirty_regs = LIST_INITIALIZER(&dirty_regs);
+
+/* Registered file descriptors with events in the current poll_block(). */
+static struct poll_reg **fired_regs;
+static size_t n_fired_regs, max_fired_regs;
+
+static int
+epoll_ctl__(int op, struct poll_reg *reg, uint32_t events)
+{
+    struct epoll_event event;
+
+    COVERAGE_INC(poll_epoll_ctl);
+    memset(&event, 0, sizeof event);
+    event.events = events | EPOLLONESHOT;
+    event.data.ptr = reg;
+    return epoll_ctl(epoll_fd, op, reg->fd, &event) ? errno : 0;
+}
+
+static void
+epoll_del(struct poll_reg *reg)
+{
+    if (reg->in_epoll) {
+        epoll_ctl__(EPOLL_CTL_DEL, reg, 0);
+        reg->in_epoll = false;
+        reg->armed = 0;
+    }
+    if (reg->dirty) {
+        list_remove(&reg->dirty_node);
+        reg->dirty = false;
+    }
+}
+
+static uint32_t
+poll_to_epoll_events(short int events)
+{
+    return ((events & POLLIN ? EPOLLIN : 0)
+            | (events & POLLPRI ? EPOLLPRI : 0)
+            | (events & POLLOUT ? EPOLLOUT : 0));
+}
+
+static short int
+epoll_to_poll_events(uint32_t events)
+{
+    return ((events & EPOLLIN ? POLLIN : 0)
+            | (events & EPOLLPRI ? POLLPRI : 0)
+            | (events & EPOLLOUT ? POLLOUT : 0)
+            | (events & EPOLLERR ? POLLERR : 0)
+            | (events & EPOLLHUP ? POLLHUP : 0));
+}
+
+/* Puts 'reg', which is being waited on in the current poll_block(), on
+ * 'dirty_regs' if it is not armed for exactly the events requested. */
+static void
+epoll_mark_dirty(struct poll_reg *reg)
+{
+    if (!reg->dirty
+        && (!reg->in_epoll
+            || reg->armed != poll_to_epoll_events(reg->wanted))) {
+        list_push_back(&dirty_regs, &reg->dirty_node);
+        reg->dirty = true;
+    }
+}
+
+/* Notes that 'reg' has events to report in the current poll_block(). */
+static void
+epoll_fire(struct poll_reg *reg)
+{
+    if (!reg->fired) {
+        if (n_fired_regs >= max_fired_regs) {
+            fired_regs = x2nrealloc(fired_regs, &max_fired_regs,
+                                    sizeof *fired_regs);
+        }
+        fired_regs[n_fired_regs++] = reg;
+        reg->fired = true;
+    }
+}
+
+/* Arms 'reg' in 'epoll_fd' for the events requested in the current
+ * poll_block().  Returns 0 if successful, otherwise the events that poll()
+ * would report immediately for 'reg->fd'. */
+static short int
+epoll_arm(struct poll_reg *reg)
+{
+    uint32_t events = poll_to_epoll_events(reg->wanted);
+    int error;
+
+    if (!reg->in_epoll) {
+        error = epoll_ctl__(EPOLL_CTL_ADD, reg, events);
+        if (error == EEXIST) {
+            error = epoll_ctl__(EPOLL_CTL_MOD, reg, events);
+        }
+        reg->in_epoll = !error;
+    } else if (reg->armed != events) {
+        error = epoll_ctl__(EPOLL_CTL_MOD, reg, events);
+    } else {
+        return 0;
+    }
+
+    if (error) {
+        /* epoll does not support some kinds of files, e.g. regular files,
+         * that poll() always reports as ready. */
+        static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
+
+        if (error != EPERM) {
+            VLOG_WARN_RL(&rl, "epoll_ctl on fd %d failed (%s)",
+                         reg->fd, strerror(error));
+        }
+        reg->in_epoll = false;
+        reg->armed = 0;
+        return error == EBADF ? POLLNVAL : reg->wanted & (POLLIN | POLLOUT);
+    }
+    reg->armed = events;
+    return 0;
+}
+
+/* Creates 'epoll_fd'.  Returns true if successful.  Otherwise, switches to the
+ * "poll" backend and returns false. */
+static bool
+epoll_open(void)
+{
+    struct poll_reg *reg;
+
+    epoll_fd = epoll_create(16);
+    if (epoll_fd < 0) {
+        VLOG_ERR("epoll_create failed (%s), falling back to poll",
+                 strerror(errno));
+        backend = POLL_BACKEND_POLL;
+        return false;
+    }
+    epoll_pid = getpid();
+
+    /* Nothing is in the new epoll set yet.  This is the only time that every
+     * registered file descriptor is visited, which is fine because it happens
+     * only at startup and after a fork. */
+    HMAP_FOR_EACH (reg, hmap_node, &poll_regs) {
+        reg->in_epoll = false;
+        reg->armed = 0;
+        if (reg->seen == poll_seq) {
+            epoll_mark_dirty(reg);
+        }
+    }
+    return true;
+}
+
+/* Like time_poll(), but waits for registered file descriptors using
+ * 'epoll_fd'.  'pollfds' must have room for 'n_pollfds + 1' elements.
+ * Returns the number of file descriptors with events, counting both those in
+ * 'pollfds' and those in 'fired_regs'. */
+static int
+epoll_poll(struct pollfd *pollfds, int n_pollfds, int timeout)
+{
+    static struct epoll_event *events;
+    static size_t max_events;
+
+    struct poll_reg *reg, *next;
+    long long int deadline;
+    int n_others, n_events;
+    int i;
+
+    if (epoll_fd >= 0 && epoll_pid != getpid()) {
+        /* We forked, so we share 'epoll_fd' with our parent.  Registrations
+         * made by one process would affect the other, so start over. */
+        close(epoll_fd);
+        epoll_fd = -1;
+    }
+    if (epoll_fd < 0 && !epoll_open()) {
+        /* The file descriptors waited on in this poll_block() aren't in
+         * 'pollfds', so report them all as ready.  That can only cause a
+         * spurious wakeup. */
+        HMAP_FOR_EACH (reg, hmap_node, &poll_regs) {
+            if (reg->seen == poll_seq) {
+                reg->revents = reg->wanted & (POLLIN | POLLOUT);
+                epoll_fire(reg);
+            }
+        }
+        n_others = time_poll(pollfds, n_pollfds, n_fired_regs ? 0 : timeout);
+        return n_others < 0 ? n_others : n_others + n_fired_regs;
+    }
+
+    /* Arm the file descriptors whose requested events changed. */
+    LIST_FOR_EACH_SAFE (reg, next, dirty_node, &dirty_regs) {
+        list_remove(&reg->dirty_node);
+        reg->dirty = false;
+
+        reg->revents = epoll_arm(reg);
+        if (reg->revents) {
+            epoll_fire(reg);
+        }
+    }
+
+    if (max_events < hmap_count(&poll_regs)) {
+        max_events = hmap_count(&poll_regs);
+        events = xrealloc(events, max_events * sizeof *events);
+    }
+
+    deadline = timeout < 0 ? LLONG_MAX : time_msec() + timeout;
+    for (;;) {
+        int wait_timeout = n_fired_regs ? 0 : timeout;
+
+        if (!n_pollfds) {
+            n_others = 0;
+            n_events = time_epoll_wait(epoll_fd, events, MAX(max_events, 1),
+                                       wait_timeout);
+            if (n_events < 0) {
+                return n_events;
+            }
+        } else {
+            struct pollfd *epoll_pollfd = &pollfds[n_pollfds];
+
+            epoll_pollfd->fd = epoll_fd;
+            epoll_pollfd->events = POLLIN;
+            epoll_pollfd->revents = 0;
+            n_others = time_poll(pollfds, n_pollfds + 1, wait_timeout);
+            if (n_others < 0) {
+                return n_others;
+            }
+
+            n_events = 0;
+            if (epoll_pollfd->revents) {
+                n_others--;
+                n_events = epoll_wait(epoll_fd, events, MAX(max_events, 1),
+                                      0);
+                if (n_events < 0) {
+                    n_events = 0;
+                }
+            }
+        }
+
+        /* Note the events that occurred on registered file descriptors.
+         * Each of them is now disarmed, because of EPOLLONESHOT. */
+        for (i = 0; i < n_events; i++) {
+            reg = events[i].data.ptr;
+            reg->armed = 0;
+            if (reg->seen == poll_seq) {
+                reg->revents |= epoll_to_poll_events(events[i].events);
+                epoll_fire(reg);
+            }
+        }
+
+        if (n_others || n_fired_regs || !n_events) {
+            return n_others + n_fired_regs;
+        }
+
+        /* Only file descriptors that are no longer waited on woke us up.
+         * Keep waiting, for whatever remains of 'timeout'. */
+        if (timeout > 0) {
+            long long int now = time_msec();
+
+            timeout = now < deadline ? MIN(deadline - now, INT_MAX) : 0;
+        }
+        if (!timeout) {
+            return 0;
+        }
+    }
+}
+
+/* Logs the wakeups due to registered file descriptors in the current
+ * poll_block(), then forgets them. */
+static void
+epoll_log_wakeups(void)
+{
+    size_t i;
+
+    for (i = 0; i < n_fired_regs; i++) {
+        struct poll_reg *reg = fired_regs[i];
+        struct poll_waiter *pw;
+
+        LIST_FOR_EACH (pw, node, &reg->waiters) {
+            struct pollfd pollfd;
+
+            pollfd.fd = reg->fd;
+            pollfd.events = pw->events;
+            pollfd.revents = reg->revents & (pw->events | POLLERR | POLLHUP
+                                             | POLLNVAL);
+            if (pollfd.revents) {
+                log_wakeup(pw->where, &pollfd, 0);
+            }
+        }
+        reg->revents = 0;
+        reg->fired = false;
+    }
+    n_fired_regs = 0;
+}
+#else  /* !HAVE_SYS_EPOLL_H */
+static int
+epoll_poll(struct pollfd *pollfds, int n_pollfds, int timeout)
+{
+    return time_poll(pollfds, n_pollfds, timeout);
+}
+
+static void
+epoll_log_wakeups(void)
+{
+}
+#endif /* !HAVE_SYS_EPOLL_H */
@@ -28,6 +28,7 @@
 #define POLL_LOOP_H 1
 
 #include <poll.h>
+#include <stdbool.h>
 #include "util.h"
 
 #ifdef  __cplusplus
@@ -65,6 +66,14 @@ void poll_block(void);
 /* Cancel a file descriptor callback or event. */
 void poll_cancel(struct poll_waiter *);
 
+/* Long-lived file descriptors, for the benefit of the "epoll" backend. */
+void poll_fd_register(int fd);
+void poll_fd_unregister(int fd);
+
+/* Choose how poll_block() waits: "poll" or, on Linux, "epoll". */
+bool poll_set_backend(const char *name);
+const char *poll_get_backend(void);
+
 #ifdef  __cplusplus
 }
 #endif
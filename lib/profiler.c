@@ -0,0 +1,367 @@
+/*
+ * Copyright (c) 2011 Nicira Networks.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <config.h>
+#include "profiler.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "backtrace.h"
+#include "dynamic-string.h"
+#include "hash.h"
+#include "hmap.h"
+#include "signals.h"
+#include "unixctl.h"
+#include "util.h"
+#include "vlog.h"
+
+#ifdef HAVE_BACKTRACE
+#include <execinfo.h>
+#endif
+
+VLOG_DEFINE_THIS_MODULE(profiler);
+
+/* Default and maximum sampling rates, in samples per second of CPU time. */
+#define PROFILER_DEFAULT_HZ 100
+#define PROFILER_MAX_HZ 1000
+
+/* Number of samples in the ring buffer.  At the default rate this holds the
+ * most recent 80 seconds of CPU time. */
+#define PROFILER_MAX_SAMPLES 8192
+
+/* Number of innermost frames in each sample that belong to the profiler
+ * itself (backtrace_capture(), the signal handler, and the signal trampoline)
+ * rather than to the code being profiled. */
+#define PROFILER_SKIP_FRAMES 3
+
+/* Ring buffer of samples, written by the SIGPROF handler.  'n_samples' counts
+ * every sample ever captured, so samples[n_samples % PROFILER_MAX_SAMPLES] is
+ * the next slot to be overwritten. */
+static struct backtrace *samples;
+static volatile unsigned int n_samples;
+
+static bool running;
+
+static void
+sigprof_handler(int sig_nr OVS_UNUSED)
+{
+    int save_errno = errno;
+
+    backtrace_capture(&samples[n_samples % PROFILER_MAX_SAMPLES]);
+    n_samples++;
+
+    errno = save_errno;
+}
+
+static void
+block_sigprof(sigset_t *oldsigs)
+{
+    sigset_t sigprof;
+
+    sigemptyset(&sigprof);
+    sigaddset(&sigprof, SIGPROF);
+    xsigprocmask(SIG_BLOCK, &sigprof, oldsigs);
+}
+
+static void
+unblock_sigprof(const sigset_t *oldsigs)
+{
+    xsigprocmask(SIG_SETMASK, oldsigs, NULL);
+}
+
+static int
+set_itimer_prof(unsigned int rate)
+{
+    struct itimerval itimer;
+
+    itimer.it_interval.tv_sec = 0;
+    itimer.it_interval.tv_usec = rate ? 1000000 / rate : 0;
+    itimer.it_value = itimer.it_interval;
+    return setitimer(ITIMER_PROF, &itimer, NULL) ? errno : 0;
+}
+
+static void
+profiler_start(void)
+{
+    struct sigaction sa;
+
+    if (!samples) {
+        struct backtrace dummy;
+
+        samples = xmalloc(PROFILER_MAX_SAMPLES * sizeof *samples);
+
+        /* glibc's backtrace() loads libgcc, which calls malloc(), the first
+         * time that it is called, so get that out of the way now instead of
+         * in the signal handler. */
+        backtrace_capture(&dummy);
+    }
+    n_samples = 0;
+
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = sigprof_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    xsigaction(SIGPROF, &sa, NULL);
+
+    running = true;
+}
+
+static void
+profiler_stop(void)
+{
+    set_itimer_prof(0);
+    running = false;
+}
+
+/* Appends to 's' a name for the code at 'address': a function name if one is
+ * available, otherwise the address as an offset within its binary, suitable
+ * for passing to addr2line. */
+static void
+format_frame(struct ds *s, uintptr_t address)
+{
+#ifdef HAVE_BACKTRACE
+    void *p = (void *) address;
+    char **symbols = backtrace_symbols(&p, 1);
+
+    if (symbols) {
+        /* Parse "binary(function+0x12) [0x1234]" or "binary(+0x12) ...". */
+        const char *symbol = symbols[0];
+        const char *open = strchr(symbol, '(');
+        const char *plus = open ? strchr(open, '+') : NULL;
+        const char *close = plus ? strchr(plus, ')') : NULL;
+
+        if (close && plus > open + 1) {
+            ds_put_buffer(s, open + 1, plus - (open + 1));
+        } else if (close) {
+            const char *base = open;
+
+            while (base > symbol && base[-1] != '/') {
+                base--;
+            }
+            ds_put_buffer(s, base, open - base);
+            ds_put_buffer(s, plus, close - plus);
+        } else {
+            ds_put_format(s, "%#"PRIxPTR, address);
+        }
+        free(symbols);
+        return;
+    }
+#endif
+    ds_put_format(s, "%#"PRIxPTR, address);
+}
+
+/* A distinct stack and the number of samples in which it appeared. */
+struct profiler_stack {
+    struct hmap_node hmap_node;
+    const struct backtrace *bt;
+    unsigned int count;
+};
+
+/* Caches the formatted name of a frame address. */
+struct profiler_frame {
+    struct hmap_node hmap_node;
+    uintptr_t address;
+    char *name;
+};
+
+static uint32_t
+hash_backtrace(const struct backtrace *bt)
+{
+    return hash_bytes(bt->frames, bt->n_frames * sizeof bt->frames[0],
+                      bt->n_frames);
+}
+
+static bool
+backtrace_equal(const struct backtrace *a, const struct backtrace *b)
+{
+    return (a->n_frames == b->n_frames
+            && !memcmp(a->frames, b->frames,
+                       a->n_frames * sizeof a->frames[0]));
+}
+
+static const char *
+lookup_frame(struct hmap *frames, uintptr_t address)
+{
+    struct profiler_frame *frame;
+    uint32_t hash = hash_bytes(&address, sizeof address, 0);
+    struct ds s;
+
+    HMAP_FOR_EACH_WITH_HASH (frame, hmap_node, hash, frames) {
+        if (frame->address == address) {
+            return frame->name;
+        }
+    }
+
+    ds_init(&s);
+    format_frame(&s, address);
+    frame = xmalloc(sizeof *frame);
+    frame->address = address;
+    frame->name = ds_steal_cstr(&s);
+    hmap_insert(frames, &frame->hmap_node, hash);
+    return frame->name;
+}
+
+/* Appends the samples to 's' in folded stack format. */
+static void
+profiler_format_folded(struct ds *s)
+{
+    struct profiler_stack *stack, *next_stack;
+    struct profiler_frame *frame, *next_frame;
+    struct hmap stacks, frames;
+    unsigned int i, n;
+
+    /* Count the distinct stacks. */
+    hmap_init(&stacks);
+    n = MIN(n_samples, PROFILER_MAX_SAMPLES);
+    for (i = 0; i < n; i++) {
+        const struct backtrace *bt = &samples[i];
+        uint32_t hash = hash_backtrace(bt);
+
+        HMAP_FOR_EACH_WITH_HASH (stack, hmap_node, hash, &stacks) {
+            if (backtrace_equal(stack->bt, bt)) {
+                goto found;
+            }
+        }
+        stack = xmalloc(sizeof *stack);
+        stack->bt = bt;
+        stack->count = 0;
+        hmap_insert(&stacks, &stack->hmap_node, hash);
+    found:
+        stack->count++;
+    }
+
+    /* Print them, outermost frame first. */
+    hmap_init(&frames);
+    HMAP_FOR_EACH_SAFE (stack, next_stack, hmap_node, &stacks) {
+        const struct backtrace *bt = stack->bt;
+        int j;
+
+        if (bt->n_frames <= PROFILER_SKIP_FRAMES) {
+            ds_put_cstr(s, "[unknown]");
+        }
+        for (j = bt->n_frames - 1; j >= PROFILER_SKIP_FRAMES; j--) {
+            ds_put_cstr(s, lookup_frame(&frames, bt->frames[j]));
+            if (j > PROFILER_SKIP_FRAMES) {
+                ds_put_char(s, ';');
+            }
+        }
+        ds_put_format(s, " %u\n", stack->count);
+
+        hmap_remove(&stacks, &stack->hmap_node);
+        free(stack);
+    }
+    hmap_destroy(&stacks);
+
+    HMAP_FOR_EACH_SAFE (frame, next_frame, hmap_node, &frames) {
+        hmap_remove(&frames, &frame->hmap_node);
+        free(frame->name);
+        free(frame);
+    }
+    hmap_destroy(&frames);
+}
+
+static void
+profiler_unixctl_start(struct unixctl_conn *conn, const char *args,
+                       void *aux OVS_UNUSED)
+{
+    unsigned int rate = PROFILER_DEFAULT_HZ;
+    char *reply;
+    int error;
+
+    if (args[0] && (!str_to_uint(args, 10, &rate)
+                    || !rate || rate > PROFILER_MAX_HZ)) {
+        reply = xasprintf("sampling rate must be between 1 and %d Hz",
+                          PROFILER_MAX_HZ);
+        unixctl_command_reply(conn, 501, reply);
+        free(reply);
+        return;
+    }
+    if (running) {
+        unixctl_command_reply(conn, 501, "profiler already running");
+        return;
+    }
+
+    profiler_start();
+    error = set_itimer_prof(rate);
+    if (error) {
+        profiler_stop();
+        reply = xasprintf("setitimer failed (%s)", strerror(error));
+        unixctl_command_reply(conn, 501, reply);
+        free(reply);
+        return;
+    }
+
+    VLOG_INFO("profiling at %u Hz", rate);
+    reply = xasprintf("profiling at %u Hz", rate);
+    unixctl_command_reply(conn, 200, reply);
+    free(reply);
+}
+
+static void
+profiler_unixctl_stop(struct unixctl_conn *conn, const char *args OVS_UNUSED,
+                      void *aux OVS_UNUSED)
+{
+    unsigned int n;
+    char *reply;
+
+    if (!running) {
+        unixctl_command_reply(conn, 501, "profiler not running");
+        return;
+    }
+    profiler_stop();
+
+    n = n_samples;
+    VLOG_INFO("profiler stopped after %u samples", n);
+    if (n > PROFILER_MAX_SAMPLES) {
+        reply = xasprintf("%u samples (oldest %u discarded)",
+                          n, n - PROFILER_MAX_SAMPLES);
+    } else {
+        reply = xasprintf("%u samples", n);
+    }
+    unixctl_command_reply(conn, 200, reply);
+    free(reply);
+}
+
+static void
+profiler_unixctl_show(struct unixctl_conn *conn, const char *args OVS_UNUSED,
+                      void *aux OVS_UNUSED)
+{
+    sigset_t oldsigs;
+    struct ds s;
+
+    ds_init(&s);
+    if (samples) {
+        /* Keep the handler from overwriting samples while we read them. */
+        block_sigprof(&oldsigs);
+        profiler_format_folded(&s);
+        unblock_sigprof(&oldsigs);
+    }
+    unixctl_command_reply(conn, 200, ds_cstr(&s));
+    ds_destroy(&s);
+}
+
+/* Registers the "profiler/start", "profiler/stop", and "profiler/show"
+ * commands. */
+void
+profiler_init_command(void)
+{
+    unixctl_command_register("profiler/start", profiler_unixctl_start, NULL);
+    unixctl_command_register("profiler/stop", profiler_unixctl_stop, NULL);
+    unixctl_command_register("profiler/show", profiler_unixctl_show, NULL);
+}
@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2011 Nicira Networks.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H 1
+
+/* Sampling CPU profiler.
+ *
+ * When started with the "profiler/start" command, a SIGPROF interval timer
+ * captures a backtrace of the running program at a fixed rate into a ring
+ * buffer.  "profiler/show" prints the samples in the "folded stack" format
+ * that flame graph tools accept: one line per distinct stack, with frames
+ * separated by semicolons from outermost to innermost, followed by the
+ * number of samples with that stack.
+ *
+ * The profiler is off by default and costs nothing until started. */
+
+void profiler_init_command(void);
+
+#endif /* profiler.h */
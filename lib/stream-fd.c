@@ -69,6 +69,7 @@ new_fd_stream(const char *name, int fd, int connect_status,
     s = xmalloc(sizeof *s);
     stream_init(&s->stream, &stream_fd_class, connect_status, name);
     s->fd = fd;
+    poll_fd_register(fd);
     s->unlink_path = unlink_path;
     *streamp = &s->stream;
     return 0;
@@ -85,6 +86,7 @@ static void
 fd_close(struct stream *stream)
 {
     struct stream_fd *s = stream_fd_cast(stream);
+    poll_fd_unregister(s->fd);
     close(s->fd);
     maybe_unlink_and_free(s->unlink_path);
     free(s);
@@ -209,6 +211,7 @@ new_fd_pstream(const char *name, int fd,
     struct fd_pstream *ps = xmalloc(sizeof *ps);
     pstream_init(&ps->pstream, &fd_pstream_class, name);
     ps->fd = fd;
+    poll_fd_register(fd);
     ps->accept_cb = accept_cb;
     ps->unlink_path = unlink_path;
     *pstreamp = &ps->pstream;
@@ -219,6 +222,7 @@ static void
 pfd_close(struct pstream *pstream)
 {
     struct fd_pstream *ps = fd_pstream_cast(pstream);
+    poll_fd_unregister(ps->fd);
     close(ps->fd);
     maybe_unlink_and_free(ps->unlink_path);
     free(ps);
@@ -277,6 +277,7 @@ new_ssl_stream(const char *name, int fd, enum session_type type,
     sslv->state = state;
     sslv->type = type;
     sslv->fd = fd;
+    poll_fd_register(fd);
     sslv->ssl = ssl;
     sslv->txbuf = NULL;
     sslv->rx_want = sslv->tx_want = SSL_NOTHING;
@@ -505,6 +506,7 @@ ssl_close(struct stream *stream)
     ERR_clear_error();
 
     SSL_free(sslv->ssl);
+    poll_fd_unregister(sslv->fd);
     close(sslv->fd);
     free(sslv);
 }
@@ -805,6 +807,7 @@ pssl_open(const char *name OVS_UNUSED, char *suffix, struct pstream **pstreamp)
     pssl = xmalloc(sizeof *pssl);
     pstream_init(&pssl->pstream, &pssl_pstream_class, bound_name);
     pssl->fd = fd;
+    poll_fd_register(fd);
     *pstreamp = &pssl->pstream;
     return 0;
 }
@@ -813,6 +816,7 @@ static void
 pssl_close(struct pstream *pstream)
 {
     struct pssl_pstream *pssl = pssl_pstream_cast(pstream);
+    poll_fd_unregister(pssl->fd);
     close(pssl->fd);
     free(pssl);
 }
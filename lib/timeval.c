@@ -20,10 +20,14 @@
 #include <errno.h>
 #include <poll.h>
 #include <signal.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/time.h>
 #include <sys/resource.h>
 #include <unistd.h>
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
 #include "coverage.h"
 #include "fatal-signal.h"
 #include "signals.h"
@@ -37,6 +41,28 @@ VLOG_DEFINE_THIS_MODULE(timeval);
  * to CLOCK_REALTIME. */
 static clockid_t monotonic_clock;
 
+/* How the current time is obtained.  See time_set_source() for details. */
+enum time_source {
+    TIME_SOURCE_DEFAULT,        /* Not yet chosen. */
+    TIME_SOURCE_CACHED,         /* Refreshed by a periodic SIGALRM. */
+    TIME_SOURCE_DIRECT,         /* Read on every call. */
+    TIME_SOURCE_COARSE          /* Read on every call from coarse clocks. */
+};
+static enum time_source time_source = TIME_SOURCE_DEFAULT;
+
+/* The clocks read on every call in TIME_SOURCE_DIRECT and TIME_SOURCE_COARSE
+ * modes. */
+static clockid_t direct_monotonic_clock;
+static clockid_t direct_wall_clock;
+
+/* The interval timer that drives TIME_SOURCE_CACHED and time_alarm(). */
+static timer_t timer_id;
+static bool timer_created;
+static bool timer_running;
+
+/* Has time_disable_restart() been called without time_enable_restart()? */
+static bool restart_disabled;
+
 /* Has a timer tick occurred?
  *
  * We initialize these to true to force time_init() to get called on the first
@@ -52,6 +78,8 @@ static struct timespec monotonic_time;
 static time_t deadline = TIME_MIN;
 
 static void set_up_timer(void);
+static void stop_timer(void);
+static void update_timer(void);
 static void set_up_signal(int flags);
 static void sigalrm_handler(int);
 static void refresh_wall_if_ticked(void);
@@ -86,7 +114,87 @@ time_init(void)
     }
 
     set_up_signal(SA_RESTART);
-    set_up_timer();
+    if (time_source == TIME_SOURCE_DEFAULT) {
+        const char *name = getenv("OVS_TIME_SOURCE");
+
+        if (!name || !time_set_source(name)) {
+            if (name) {
+                VLOG_WARN("OVS_TIME_SOURCE=%s: unknown or unsupported time "
+                          "source, using cached", name);
+            }
+            time_set_source("cached");
+        }
+    }
+}
+
+/* Selects how time_msec() and the other functions in this module that report
+ * the current time obtain it, according to 'name':
+ *
+ *   - "cached", the default, reads the clocks only after SIGALRM from an
+ *     interval timer that fires every TIME_UPDATE_INTERVAL ms, or after
+ *     time_refresh().  Reading the time is then nearly free, but it is only
+ *     accurate within TIME_UPDATE_INTERVAL ms, and the signal interrupts
+ *     system calls (see time_disable_restart()).
+ *
+ *   - "direct" reads CLOCK_MONOTONIC or CLOCK_REALTIME on every call.  On
+ *     Linux, clock_gettime() is implemented in the vDSO without a system
+ *     call, so this costs tens of nanoseconds per call and gives
+ *     submillisecond accuracy.  No periodic signal is needed (although
+ *     time_alarm() still uses one).
+ *
+ *   - "coarse" is like "direct" but reads CLOCK_MONOTONIC_COARSE and
+ *     CLOCK_REALTIME_COARSE, which are cheaper still but only as accurate as
+ *     the kernel's timer tick, typically 1 to 10 ms.  It is available only on
+ *     Linux.
+ *
+ * time_usec() always reads the monotonic clock directly, regardless of the
+ * time source.  If this function is never called, the OVS_TIME_SOURCE
+ * environment variable, if set, selects the time source.
+ *
+ * Returns true if successful, false if 'name' is unknown or unsupported on
+ * this platform. */
+bool
+time_set_source(const char *name)
+{
+    enum time_source source;
+
+    time_init();
+    if (!strcmp(name, "cached")) {
+        source = TIME_SOURCE_CACHED;
+    } else if (!strcmp(name, "direct")) {
+        source = TIME_SOURCE_DIRECT;
+        direct_monotonic_clock = monotonic_clock;
+        direct_wall_clock = CLOCK_REALTIME;
+#if defined CLOCK_MONOTONIC_COARSE && defined CLOCK_REALTIME_COARSE
+    } else if (!strcmp(name, "coarse")) {
+        struct timespec ts;
+
+        if (clock_gettime(CLOCK_MONOTONIC_COARSE, &ts)
+            || clock_gettime(CLOCK_REALTIME_COARSE, &ts)) {
+            return false;
+        }
+        source = TIME_SOURCE_COARSE;
+        direct_monotonic_clock = CLOCK_MONOTONIC_COARSE;
+        direct_wall_clock = CLOCK_REALTIME_COARSE;
+#endif
+    } else {
+        return false;
+    }
+
+    time_source = source;
+    update_timer();
+    time_refresh();
+    return true;
+}
+
+/* Returns the name of the current time source (see time_set_source()). */
+const char *
+time_get_source(void)
+{
+    time_init();
+    return (time_source == TIME_SOURCE_DIRECT ? "direct"
+            : time_source == TIME_SOURCE_COARSE ? "coarse"
+            : "cached");
 }
 
 static void
@@ -112,12 +220,16 @@ set_up_signal(int flags)
  *   time_disable_restart();
  *   fcntl(fd, F_SETLKW, &lock);
  *   time_enable_restart();
- */
+ *
+ * The periodic timer runs while restart is disabled, even with a time source
+ * that does not otherwise need it (see time_set_source()). */
 void
 time_disable_restart(void)
 {
     time_init();
     set_up_signal(0);
+    restart_disabled = true;
+    update_timer();
 }
 
 /* Add SA_RESTART to the flags for SIGALRM, so that any system call that
@@ -128,16 +240,20 @@ time_enable_restart(void)
 {
     time_init();
     set_up_signal(SA_RESTART);
+    restart_disabled = false;
+    update_timer();
 }
 
 static void
 set_up_timer(void)
 {
-    static timer_t timer_id;    /* "static" to avoid apparent memory leak. */
     struct itimerspec itimer;
 
-    if (timer_create(monotonic_clock, NULL, &timer_id)) {
-        VLOG_FATAL("timer_create failed (%s)", strerror(errno));
+    if (!timer_created) {
+        if (timer_create(monotonic_clock, NULL, &timer_id)) {
+            VLOG_FATAL("timer_create failed (%s)", strerror(errno));
+        }
+        timer_created = true;
     }
 
     itimer.it_interval.tv_sec = 0;
@@ -147,6 +263,37 @@ set_up_timer(void)
     if (timer_settime(timer_id, 0, &itimer, NULL)) {
         VLOG_FATAL("timer_settime failed (%s)", strerror(errno));
     }
+    timer_running = true;
+}
+
+static void
+stop_timer(void)
+{
+    if (timer_running) {
+        struct itimerspec itimer;
+
+        memset(&itimer, 0, sizeof itimer);
+        if (timer_settime(timer_id, 0, &itimer, NULL)) {
+            VLOG_FATAL("timer_settime failed (%s)", strerror(errno));
+        }
+        timer_running = false;
+    }
+}
+
+/* Starts or stops the interval timer according to whether anything needs
+ * SIGALRM: the "cached" time source, a time_alarm() deadline (checked from
+ * the signal handler), or time_disable_restart(). */
+static void
+update_timer(void)
+{
+    if (time_source == TIME_SOURCE_CACHED || deadline != TIME_MIN
+        || restart_disabled) {
+        if (!timer_running) {
+            set_up_timer();
+        }
+    } else {
+        stop_timer();
+    }
 }
 
 /* Set up the interval timer, to ensure that time advances even without calling
@@ -158,14 +305,18 @@ void
 time_postfork(void)
 {
     time_init();
-    set_up_timer();
+    timer_created = false;
+    if (timer_running) {
+        set_up_timer();
+    }
 }
 
 static void
 refresh_wall(void)
 {
     time_init();
-    clock_gettime(CLOCK_REALTIME, &wall_time);
+    clock_gettime(time_source == TIME_SOURCE_CACHED
+                  ? CLOCK_REALTIME : direct_wall_clock, &wall_time);
     wall_tick = false;
 }
 
@@ -174,7 +325,9 @@ refresh_monotonic(void)
 {
     time_init();
 
-    if (monotonic_clock == CLOCK_MONOTONIC) {
+    if (time_source != TIME_SOURCE_CACHED) {
+        clock_gettime(direct_monotonic_clock, &monotonic_time);
+    } else if (monotonic_clock == CLOCK_MONOTONIC) {
         clock_gettime(monotonic_clock, &monotonic_time);
     } else {
         refresh_wall_if_ticked();
@@ -186,7 +339,8 @@ refresh_monotonic(void)
 
 /* Forces a refresh of the current time from the kernel.  It is not usually
  * necessary to call this function, since the time will be refreshed
- * automatically at least every TIME_UPDATE_INTERVAL milliseconds. */
+ * automatically at least every TIME_UPDATE_INTERVAL milliseconds, or on every
+ * call with the "direct" and "coarse" time sources. */
 void
 time_refresh(void)
 {
@@ -236,6 +390,19 @@ time_wall_msec(void)
     return timespec_to_msec(&wall_time);
 }
 
+/* Returns a monotonic timer, in microseconds.  Unlike time_msec(), this reads
+ * the clock on every call, so it is suitable for timing short intervals, at
+ * the cost of a system call on platforms that lack a fast clock_gettime(). */
+long long int
+time_usec(void)
+{
+    struct timespec ts;
+
+    time_init();
+    clock_gettime(monotonic_clock, &ts);
+    return (long long int) ts.tv_sec * 1000 * 1000 + ts.tv_nsec / 1000;
+}
+
 /* Stores a monotonic timer, accurate within TIME_UPDATE_INTERVAL ms, into
  * '*ts'. */
 void
@@ -264,21 +431,15 @@ time_alarm(unsigned int secs)
     time_init();
     block_sigalrm(&oldsigs);
     deadline = secs ? time_add(time_now(), secs) : TIME_MIN;
+    update_timer();
     unblock_sigalrm(&oldsigs);
 }
 
-/* Like poll(), except:
- *
- *      - On error, returns a negative error code (instead of setting errno).
- *
- *      - If interrupted by a signal, retries automatically until the original
- *        'timeout' expires.  (Because of this property, this function will
- *        never return -EINTR.)
- *
- *      - As a side effect, refreshes the current time (like time_refresh()).
- */
-int
-time_poll(struct pollfd *pollfds, int n_pollfds, int timeout)
+/* Calls 'wait_cb(aux, time_left)', which should block for up to 'time_left'
+ * milliseconds in a poll()-like system call and return its return value,
+ * with the semantics documented for time_poll(). */
+static int
+time_wait__(int (*wait_cb)(void *aux, int time_left), void *aux, int timeout)
 {
     static long long int last_wakeup;
     long long int start;
@@ -300,7 +461,7 @@ time_poll(struct pollfd *pollfds, int n_pollfds, int timeout)
             time_left = timeout;
         }
 
-        retval = poll(pollfds, n_pollfds, time_left);
+        retval = wait_cb(aux, time_left);
         if (retval < 0) {
             retval = -errno;
         }
@@ -322,6 +483,66 @@ time_poll(struct pollfd *pollfds, int n_pollfds, int timeout)
     return retval;
 }
 
+struct time_poll_aux {
+    struct pollfd *pollfds;
+    int n_pollfds;
+};
+
+static int
+time_poll_cb(void *aux_, int time_left)
+{
+    struct time_poll_aux *aux = aux_;
+    return poll(aux->pollfds, aux->n_pollfds, time_left);
+}
+
+/* Like poll(), except:
+ *
+ *      - On error, returns a negative error code (instead of setting errno).
+ *
+ *      - If interrupted by a signal, retries automatically until the original
+ *        'timeout' expires.  (Because of this property, this function will
+ *        never return -EINTR.)
+ *
+ *      - As a side effect, refreshes the current time (like time_refresh()).
+ */
+int
+time_poll(struct pollfd *pollfds, int n_pollfds, int timeout)
+{
+    struct time_poll_aux aux;
+
+    aux.pollfds = pollfds;
+    aux.n_pollfds = n_pollfds;
+    return time_wait__(time_poll_cb, &aux, timeout);
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+struct time_epoll_aux {
+    int epfd;
+    struct epoll_event *events;
+    int max_events;
+};
+
+static int
+time_epoll_cb(void *aux_, int time_left)
+{
+    struct time_epoll_aux *aux = aux_;
+    return epoll_wait(aux->epfd, aux->events, aux->max_events, time_left);
+}
+
+/* Like epoll_wait(), with the same differences as time_poll(). */
+int
+time_epoll_wait(int epfd, struct epoll_event *events, int max_events,
+                int timeout)
+{
+    struct time_epoll_aux aux;
+
+    aux.epfd = epfd;
+    aux.events = events;
+    aux.max_events = max_events;
+    return time_wait__(time_epoll_cb, &aux, timeout);
+}
+#endif /* HAVE_SYS_EPOLL_H */
+
 /* Returns the sum of 'a' and 'b', with saturation on overflow or underflow. */
 static time_t
 time_add(time_t a, time_t b)
@@ -344,7 +565,7 @@ sigalrm_handler(int sig_nr)
 static void
 refresh_wall_if_ticked(void)
 {
-    if (wall_tick) {
+    if (wall_tick || time_source != TIME_SOURCE_CACHED) {
         refresh_wall();
     }
 }
@@ -352,7 +573,7 @@ refresh_wall_if_ticked(void)
 static void
 refresh_monotonic_if_ticked(void)
 {
-    if (monotonic_tick) {
+    if (monotonic_tick || time_source != TIME_SOURCE_CACHED) {
         refresh_monotonic();
     }
 }
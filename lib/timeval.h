@@ -25,6 +25,7 @@
 extern "C" {
 #endif
 
+struct epoll_event;
 struct pollfd;
 struct timespec;
 struct timeval;
@@ -44,6 +45,8 @@ BUILD_ASSERT_DECL(TYPE_IS_SIGNED(time_t));
  * much time will be wasted in signal handlers and calls to clock_gettime(). */
 #define TIME_UPDATE_INTERVAL 100
 
+bool time_set_source(const char *name);
+const char *time_get_source(void);
 void time_disable_restart(void);
 void time_enable_restart(void);
 void time_postfork(void);
@@ -52,10 +55,15 @@ time_t time_now(void);
 time_t time_wall(void);
 long long int time_msec(void);
 long long int time_wall_msec(void);
+long long int time_usec(void);
 void time_timespec(struct timespec *);
 void time_wall_timespec(struct timespec *);
 void time_alarm(unsigned int secs);
 int time_poll(struct pollfd *, int n_pollfds, int timeout);
+#ifdef HAVE_SYS_EPOLL_H
+int time_epoll_wait(int epfd, struct epoll_event *, int max_events,
+                    int timeout);
+#endif
 
 long long int timespec_to_msec(const struct timespec *);
 long long int timeval_to_msec(const struct timeval *);
@@ -46,6 +46,7 @@ VLOG_DEFINE_THIS_MODULE(unixctl);
 
 COVERAGE_DEFINE(unixctl_received);
 COVERAGE_DEFINE(unixctl_replied);
+COVERAGE_DEFINE(unixctl_streamed);
 
 struct unixctl_command {
     unixctl_cb_func *cb;
@@ -60,8 +61,20 @@ struct unixctl_conn {
     struct ofpbuf in;
     struct ds out;
     size_t out_pos;
+
+    /* Streaming reply, if 'produce' is nonnull. */
+    unixctl_produce_func *produce;
+    unixctl_destroy_func *destroy;
+    void *aux;
 };
 
+/* A streaming reply is produced into chunks of about this many bytes, and at
+ * most UNIXCTL_STREAM_BUDGET bytes of it are produced per connection per call
+ * to unixctl_server_run(), so that a huge reply does not stall the main
+ * loop. */
+#define UNIXCTL_STREAM_CHUNK 4096
+#define UNIXCTL_STREAM_BUDGET 65536
+
 /* Server for control connection. */
 struct unixctl_server {
     char *path;
@@ -148,36 +161,101 @@ translate_reply_code(int code)
     }
 }
 
-void
-unixctl_command_reply(struct unixctl_conn *conn,
-                      int code, const char *body)
+/* Appends 'body' to 'out', escaping lines that begin with '.' and ensuring
+ * that it ends in a new-line. */
+static void
+put_body(struct ds *out, const char *body)
 {
-    struct ds *out = &conn->out;
+    const char *p;
+
+    for (p = body; *p != '\0'; ) {
+        size_t n = strcspn(p, "\n");
+
+        if (*p == '.') {
+            ds_put_char(out, '.');
+        }
+        ds_put_buffer(out, p, n);
+        ds_put_char(out, '\n');
+        p += n;
+        if (*p == '\n') {
+            p++;
+        }
+    }
+}
 
+static void
+start_reply(struct unixctl_conn *conn, int code)
+{
     COVERAGE_INC(unixctl_replied);
     assert(conn->state == S_PROCESS);
     conn->state = S_SEND;
     conn->out_pos = 0;
 
-    ds_clear(out);
-    ds_put_format(out, "%03d %s\n", code, translate_reply_code(code));
+    ds_clear(&conn->out);
+    ds_put_format(&conn->out, "%03d %s\n", code, translate_reply_code(code));
+}
+
+void
+unixctl_command_reply(struct unixctl_conn *conn,
+                      int code, const char *body)
+{
+    start_reply(conn, code);
     if (body) {
-        const char *p;
-        for (p = body; *p != '\0'; ) {
-            size_t n = strcspn(p, "\n");
+        put_body(&conn->out, body);
+    }
+    ds_put_cstr(&conn->out, ".\n");
+}
 
-            if (*p == '.') {
-                ds_put_char(out, '.');
-            }
-            ds_put_buffer(out, p, n);
-            ds_put_char(out, '\n');
-            p += n;
-            if (*p == '\n') {
-                p++;
-            }
+/* Replies to the command on 'conn' with the given 'code' and a body that
+ * 'produce' generates incrementally.  See the comment on
+ * unixctl_produce_func in unixctl.h for details. */
+void
+unixctl_command_reply_stream(struct unixctl_conn *conn, int code,
+                             unixctl_produce_func *produce,
+                             unixctl_destroy_func *destroy, void *aux)
+{
+    COVERAGE_INC(unixctl_streamed);
+    start_reply(conn, code);
+    conn->produce = produce;
+    conn->destroy = destroy;
+    conn->aux = aux;
+}
+
+/* Ends the streaming reply on 'conn', if any, and frees its state. */
+static void
+end_stream(struct unixctl_conn *conn)
+{
+    if (conn->produce) {
+        if (conn->destroy) {
+            conn->destroy(conn->aux);
         }
+        conn->produce = NULL;
+        conn->destroy = NULL;
+        conn->aux = NULL;
+    }
+}
+
+/* Replaces the output buffered for 'conn', which must all have been sent
+ * already, by the next chunk of its streaming reply. */
+static void
+produce_chunk(struct unixctl_conn *conn)
+{
+    struct ds chunk = DS_EMPTY_INITIALIZER;
+    bool more;
+
+    do {
+        more = conn->produce(&chunk, conn->aux);
+    } while (more && chunk.length < UNIXCTL_STREAM_CHUNK);
+
+    ds_clear(&conn->out);
+    conn->out_pos = 0;
+    put_body(&conn->out, ds_cstr(&chunk));
+    ds_destroy(&chunk);
+
+    if (!more) {
+        ds_put_cstr(&conn->out, ".\n");
+        end_stream(conn);
     }
-    ds_put_cstr(out, ".\n");
 }
 
 /* Creates a unixctl server listening on 'path', which may be:
@@ -274,21 +352,39 @@ new_connection(struct unixctl_server *server, int fd)
     ofpbuf_init(&conn->in, 128);
     ds_init(&conn->out);
     conn->out_pos = 0;
+    conn->produce = NULL;
+    conn->destroy = NULL;
+    conn->aux = NULL;
 }
 
 static int
 run_connection_output(struct unixctl_conn *conn)
 {
-    while (conn->out_pos < conn->out.length) {
-        size_t bytes_written;
-        int error;
+    size_t produced = 0;
 
-        error = write_fully(conn->fd, conn->out.string + conn->out_pos,
-                            conn->out.length - conn->out_pos, &bytes_written);
-        conn->out_pos += bytes_written;
-        if (error) {
-            return error;
+    for (;;) {
+        while (conn->out_pos < conn->out.length) {
+            size_t bytes_written;
+            int error;
+
+            error = write_fully(conn->fd, conn->out.string + conn->out_pos,
+                                conn->out.length - conn->out_pos,
+                                &bytes_written);
+            conn->out_pos += bytes_written;
+            if (error) {
+                return error;
+            }
+        }
+
+        if (!conn->produce) {
+            break;
+        } else if (produced >= UNIXCTL_STREAM_BUDGET) {
+            /* Let the rest of the main loop run before producing more. */
+            poll_immediate_wake();
+            return EAGAIN;
         }
+        produce_chunk(conn);
+        produced += conn->out.length;
     }
     conn->state = S_RECV;
     return 0;
@@ -408,6 +504,7 @@ static void
 kill_connection(struct unixctl_conn *conn)
 {
     list_remove(&conn->node);
+    end_stream(conn);
     ofpbuf_uninit(&conn->in);
     ds_destroy(&conn->out);
     close(conn->fd);
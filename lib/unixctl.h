@@ -17,6 +17,8 @@
 #ifndef UNIXCTL_H
 #define UNIXCTL_H 1
 
+#include <stdbool.h>
+
 #ifdef  __cplusplus
 extern "C" {
 #endif
@@ -46,6 +48,28 @@ void unixctl_command_register(const char *name,
 void unixctl_command_reply(struct unixctl_conn *, int code,
                            const char *body);
 
+/* Streaming replies.
+ *
+ * A command whose reply might be very large, such as a dump of every flow in
+ * a bridge, can use unixctl_command_reply_stream() instead of building the
+ * whole reply in memory and passing it to unixctl_command_reply().  The server
+ * then calls the 'produce' function each time the connection has room for
+ * more output.  Each call should append a small, bounded amount of the reply
+ * to 'out', as one or more complete lines, and return true, or return false
+ * if the reply is complete.  When the reply is complete or the connection
+ * closes, whichever comes first, the server calls 'destroy', if it is
+ * nonnull, to free 'aux'.
+ *
+ * The server calls 'produce' from unixctl_server_run(), interleaved with the
+ * rest of the main loop, so any data that 'aux' refers to can change between
+ * calls. */
+struct ds;
+typedef bool unixctl_produce_func(struct ds *out, void *aux);
+typedef void unixctl_destroy_func(void *aux);
+void unixctl_command_reply_stream(struct unixctl_conn *, int code,
+                                  unixctl_produce_func *produce,
+                                  unixctl_destroy_func *destroy, void *aux);
+
 #ifdef  __cplusplus
 }
 #endif
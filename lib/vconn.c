@@ -577,6 +577,11 @@ do_recv(struct vconn *vconn, struct ofpbuf **msgp)
  * Returns a positive errno value on failure, in which case the caller
  * retains ownership of 'msg'.
  *
+ * 'msg' normally contains a single OpenFlow message, but it may also contain
+ * any number of complete OpenFlow messages back to back.  The messages are
+ * then transmitted together, which saves per-message overhead when a caller
+ * has many small messages to send at once.
+ *
  * vconn_send will not block.  If 'msg' cannot be immediately accepted for
  * transmission, it returns EAGAIN immediately. */
 int
@@ -589,18 +594,69 @@ vconn_send(struct vconn *vconn, struct ofpbuf *msg)
     return retval;
 }
 
+/* Returns true if 'msg' consists of one or more complete OpenFlow messages,
+ * false otherwise. */
+static bool
+is_msg_sequence(const struct ofpbuf *msg)
+{
+    size_t ofs = 0;
+
+    do {
+        const struct ofp_header *oh;
+        size_t len;
+
+        if (msg->size - ofs < sizeof *oh) {
+            return false;
+        }
+        oh = (const struct ofp_header *) ((const char *) msg->data + ofs);
+        len = ntohs(oh->length);
+        if (len < sizeof *oh || len > msg->size - ofs) {
+            return false;
+        }
+        ofs += len;
+    } while (ofs < msg->size);
+
+    return true;
+}
+
+/* Returns a string describing each of the OpenFlow messages in 'msg', which
+ * must satisfy is_msg_sequence().  The caller must free the string. */
+static char *
+msg_sequence_to_string(const struct ofpbuf *msg)
+{
+    struct ds string = DS_EMPTY_INITIALIZER;
+    size_t ofs;
+
+    for (ofs = 0; ofs < msg->size; ) {
+        const struct ofp_header *oh;
+        size_t len;
+        char *s;
+
+        oh = (const struct ofp_header *) ((const char *) msg->data + ofs);
+        len = ntohs(oh->length);
+        s = ofp_to_string(oh, len, 1);
+        if (ofs) {
+            ds_put_cstr(&string, "; ");
+        }
+        ds_put_cstr(&string, s);
+        free(s);
+
+        ofs += len;
+    }
+    return ds_steal_cstr(&string);
+}
+
 static int
 do_send(struct vconn *vconn, struct ofpbuf *msg)
 {
     int retval;
 
-    assert(msg->size >= sizeof(struct ofp_header));
-    assert(((struct ofp_header *) msg->data)->length == htons(msg->size));
+    assert(is_msg_sequence(msg));
     if (!VLOG_IS_DBG_ENABLED()) {
         COVERAGE_INC(vconn_sent);
         retval = (vconn->class->send)(vconn, msg);
     } else {
-        char *s = ofp_to_string(msg->data, msg->size, 1);
+        char *s = msg_sequence_to_string(msg);
         retval = (vconn->class->send)(vconn, msg);
         if (retval != EAGAIN) {
             VLOG_DBG_RL(&ofmsg_rl, "%s: sent (%s): %s",
@@ -800,6 +856,147 @@ vconn_transact_multiple_noreply(struct vconn *vconn, struct list *requests,
     return 0;
 }
 
+/* Helper for vconn_transact_batch_noreply().  Keeps 'msg' in '*replyp' if it
+ * is the first reply to one of the 'n_xids' requests in 'xids', and otherwise
+ * destroys it. */
+static void
+vconn_batch_reply(struct vconn *vconn, struct ofpbuf *msg,
+                  const ovs_be32 *xids, size_t n_xids, struct ofpbuf **replyp)
+{
+    ovs_be32 msg_xid = ((struct ofp_header *) msg->data)->xid;
+    size_t i;
+
+    for (i = 0; i < n_xids; i++) {
+        if (msg_xid == xids[i]) {
+            break;
+        }
+    }
+
+    if (i < n_xids && !*replyp) {
+        *replyp = msg;
+    } else {
+        if (i >= n_xids) {
+            VLOG_DBG_RL(&bad_ofmsg_rl, "%s: reply with unexpected xid "
+                        "%08"PRIx32, vconn->name, ntohl(msg_xid));
+        }
+        ofpbuf_delete(msg);
+    }
+}
+
+/* Helper for vconn_transact_batch_noreply().  Same as vconn_send_block(),
+ * except that it also receives replies to the requests already sent while it
+ * waits, so that a switch that stops reading once too many of its replies are
+ * queued cannot deadlock with us.  Replies are passed to
+ * vconn_batch_reply(). */
+static int
+vconn_batch_send(struct vconn *vconn, struct ofpbuf *msg,
+                 const ovs_be32 *xids, size_t n_xids, struct ofpbuf **replyp)
+{
+    fatal_signal_run();
+
+    for (;;) {
+        struct ofpbuf *reply;
+        int retval;
+
+        retval = vconn_send(vconn, msg);
+        if (retval != EAGAIN) {
+            return retval;
+        }
+
+        retval = vconn_recv(vconn, &reply);
+        if (!retval) {
+            vconn_batch_reply(vconn, reply, xids, n_xids, replyp);
+            continue;
+        } else if (retval != EAGAIN) {
+            return retval;
+        }
+
+        vconn_run(vconn);
+        vconn_run_wait(vconn);
+        vconn_send_wait(vconn);
+        vconn_recv_wait(vconn);
+        poll_block();
+    }
+}
+
+/* Like vconn_transact_multiple_noreply(), except that it sends all of the
+ * requests back-to-back, followed by a single barrier request, then blocks
+ * until it receives a reply to the barrier.  If successful, stores the first
+ * reply received to any of the requests in '*replyp', if there was one, and
+ * otherwise NULL, then returns 0.  Otherwise returns a positive errno value,
+ * or EOF, and sets '*replyp' to null.
+ *
+ * Sending one barrier per batch, instead of one per request, allows the
+ * switch to process the whole batch at once.  Because of this, unlike
+ * vconn_transact_multiple_noreply(), an error in one request does not
+ * prevent the switch from processing later requests.
+ *
+ * All of the requests on 'requests' are always destroyed, regardless of the
+ * return value. */
+int
+vconn_transact_batch_noreply(struct vconn *vconn, struct list *requests,
+                             struct ofpbuf **replyp)
+{
+    struct ofpbuf *request, *next;
+    ovs_be32 *request_xids;
+    size_t n_requests;
+    ovs_be32 barrier_xid;
+    struct ofpbuf *barrier;
+    int error;
+
+    *replyp = NULL;
+
+    /* Send requests. */
+    request_xids = xmalloc(list_size(requests) * sizeof *request_xids);
+    n_requests = 0;
+    LIST_FOR_EACH_SAFE (request, next, list_node, requests) {
+        list_remove(&request->list_node);
+
+        request_xids[n_requests] = ((struct ofp_header *) request->data)->xid;
+        error = vconn_batch_send(vconn, request, request_xids, n_requests,
+                                 replyp);
+        if (error) {
+            ofpbuf_delete(request);
+            ofpbuf_list_delete(requests);
+            goto error;
+        }
+        n_requests++;
+    }
+
+    /* Send barrier. */
+    make_openflow(sizeof(struct ofp_header), OFPT_BARRIER_REQUEST, &barrier);
+    barrier_xid = ((struct ofp_header *) barrier->data)->xid;
+    error = vconn_batch_send(vconn, barrier, request_xids, n_requests, replyp);
+    if (error) {
+        ofpbuf_delete(barrier);
+        goto error;
+    }
+
+    for (;;) {
+        struct ofpbuf *msg;
+
+        error = vconn_recv_block(vconn, &msg);
+        if (error) {
+            goto error;
+        }
+
+        if (((struct ofp_header *) msg->data)->xid == barrier_xid) {
+            ofpbuf_delete(msg);
+            break;
+        }
+        vconn_batch_reply(vconn, msg, request_xids, n_requests, replyp);
+    }
+
+    free(request_xids);
+    return 0;
+
+error:
+    ofpbuf_delete(*replyp);
+    *replyp = NULL;
+    free(request_xids);
+    return error;
+}
+
 void
 vconn_wait(struct vconn *vconn, enum vconn_wait_type wait)
 {
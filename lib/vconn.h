@@ -56,6 +56,8 @@ int vconn_transact(struct vconn *, struct ofpbuf *, struct ofpbuf **);
 int vconn_transact_noreply(struct vconn *, struct ofpbuf *, struct ofpbuf **);
 int vconn_transact_multiple_noreply(struct vconn *, struct list *requests,
                                     struct ofpbuf **replyp);
+int vconn_transact_batch_noreply(struct vconn *, struct list *requests,
+                                 struct ofpbuf **replyp);
 
 void vconn_run(struct vconn *);
 void vconn_run_wait(struct vconn *);
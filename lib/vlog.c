@@ -19,6 +19,8 @@
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
@@ -28,12 +30,18 @@
 #include <unistd.h>
 #include "dirs.h"
 #include "dynamic-string.h"
+#include "fatal-signal.h"
 #include "sat-math.h"
+#include "socket-util.h"
 #include "svec.h"
 #include "timeval.h"
 #include "unixctl.h"
 #include "util.h"
 
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
 VLOG_DEFINE_THIS_MODULE(vlog);
 
 /* Name for each logging level. */
@@ -91,6 +99,41 @@ static FILE *log_file;
 /* vlog initialized? */
 static bool vlog_inited;
 
+/* Asynchronous logging.
+ *
+ * In asynchronous mode, vlog_valist() formats messages for the syslog and file
+ * facilities as usual but, instead of writing them itself, appends them to
+ * 'async_ring' for a writer thread to write.  This keeps a slow disk or a
+ * stalled syslog daemon from blocking the main loop.  Console output is still
+ * written synchronously.
+ *
+ * The ring has a single producer (the thread that logs) and a single consumer
+ * (the writer thread), so it needs no locks: only the producer modifies
+ * 'async_head' and only the consumer modifies 'async_tail'.  A message that
+ * arrives when the ring is full is dropped and counted in 'async_n_dropped',
+ * so that logging never blocks. */
+#define VLOG_ASYNC_RING_SIZE 4096 /* Must be a power of 2. */
+
+struct async_msg {
+    char *file_line;            /* Line for VLF_FILE, or NULL. */
+    char *syslog_msg;           /* Message for VLF_SYSLOG, or NULL. */
+    int syslog_level;           /* Syslog priority for 'syslog_msg'. */
+};
+
+static struct async_msg async_ring[VLOG_ASYNC_RING_SIZE];
+static volatile unsigned int async_head; /* Next slot to fill. */
+static volatile unsigned int async_tail; /* Next slot to write. */
+static volatile bool async_sleeping;     /* Writer waiting on 'async_fds'? */
+static volatile bool async_exiting;      /* Writer should exit? */
+static int async_fds[2] = { -1, -1 };    /* Pipe to wake up writer. */
+static bool async_enabled;
+static unsigned long long int async_n_dropped;
+#ifdef HAVE_PTHREAD_H
+static pthread_t async_thread;
+#endif
+
+static void vlog_async_flush(void);
+
 static void format_log_message(const struct vlog_module *, enum vlog_level,
                                enum vlog_facility, unsigned int msg_num,
                                const char *message, va_list, struct ds *)
@@ -283,6 +326,7 @@ vlog_set_log_file(const char *file_name)
     /* Close old log file. */
     if (log_file) {
         VLOG_INFO("closing log file");
+        vlog_async_flush();
         fclose(log_file);
         log_file = NULL;
     }
@@ -325,6 +369,198 @@ vlog_reopen_log_file(void)
     return log_file_name ? vlog_set_log_file(log_file_name) : 0;
 }
 
+/* Writes 'msg', which may contain multiple lines, to syslog at priority
+ * 'syslog_level'.  Modifies 'msg'. */
+static void
+write_syslog(int syslog_level, char *msg)
+{
+    char *save_ptr = NULL;
+    char *line;
+
+    for (line = strtok_r(msg, "\n", &save_ptr); line;
+         line = strtok_r(NULL, "\n", &save_ptr)) {
+        syslog(syslog_level, "%s", line);
+    }
+}
+
+/* Appends a message to 'async_ring' for the writer thread, taking ownership
+ * of 'file_line' and 'syslog_msg'.  Drops the message if the ring is full. */
+static void
+vlog_async_enqueue(char *file_line, char *syslog_msg, int syslog_level)
+{
+    unsigned int head = async_head;
+    struct async_msg *msg;
+
+    if (head - async_tail >= VLOG_ASYNC_RING_SIZE) {
+        async_n_dropped++;
+        free(file_line);
+        free(syslog_msg);
+        return;
+    }
+
+    msg = &async_ring[head & (VLOG_ASYNC_RING_SIZE - 1)];
+    msg->file_line = file_line;
+    msg->syslog_msg = syslog_msg;
+    msg->syslog_level = syslog_level;
+
+    /* Fill in the slot before publishing it, and publish it before checking
+     * whether the writer needs waking. */
+    __sync_synchronize();
+    async_head = head + 1;
+    __sync_synchronize();
+    if (async_sleeping) {
+        ignore(write(async_fds[1], "", 1));
+    }
+}
+
+/* Waits until the writer thread has written every queued message. */
+static void
+vlog_async_flush(void)
+{
+    while (async_enabled && async_tail != async_head) {
+        struct timespec delay = { 0, 100 * 1000 };
+        nanosleep(&delay, NULL);
+    }
+}
+
+#ifdef HAVE_PTHREAD_H
+/* Writes the messages queued in 'async_ring' until told to exit.  This runs in
+ * the writer thread, so it must not log or touch any state other than the
+ * ring, 'log_file', and syslog. */
+static void *
+vlog_async_writer(void *aux OVS_UNUSED)
+{
+    const struct timespec batch_delay = { 0, 1000 * 1000 };
+
+    for (;;) {
+        unsigned int tail = async_tail;
+        unsigned int head = async_head;
+        bool wrote_file = false;
+
+        if (tail == head) {
+            if (async_exiting) {
+                return NULL;
+            }
+
+            /* Announce that we are going to sleep, then check for messages
+             * again, so that a message queued concurrently is either seen
+             * here or followed by a wakeup. */
+            async_sleeping = true;
+            __sync_synchronize();
+            if (async_head == tail && !async_exiting) {
+                char buffer[128];
+
+                ignore(read(async_fds[0], buffer, sizeof buffer));
+            }
+            async_sleeping = false;
+            continue;
+        }
+
+        /* Read the slots only after reading 'async_head'. */
+        __sync_synchronize();
+        for (; tail != head; tail++) {
+            struct async_msg *msg;
+
+            msg = &async_ring[tail & (VLOG_ASYNC_RING_SIZE - 1)];
+            if (msg->syslog_msg) {
+                write_syslog(msg->syslog_level, msg->syslog_msg);
+                free(msg->syslog_msg);
+            }
+            if (msg->file_line) {
+                if (log_file) {
+                    fputs(msg->file_line, log_file);
+                    wrote_file = true;
+                }
+                free(msg->file_line);
+            }
+        }
+        if (wrote_file) {
+            fflush(log_file);
+        }
+
+        /* Release the slots only after we are done with them. */
+        __sync_synchronize();
+        async_tail = tail;
+
+        /* Give a burst of messages time to accumulate, so that they are
+         * written as a batch and the logging thread rarely has to wake us. */
+        nanosleep(&batch_delay, NULL);
+    }
+}
+
+static void
+vlog_async_exit_cb(void *aux OVS_UNUSED)
+{
+    vlog_set_async(false);
+}
+#endif
+
+/* Enables or disables asynchronous logging, in which a separate thread writes
+ * log messages to syslog and the log file so that logging never waits for
+ * I/O.  Disabling it writes every queued message before returning.  Returns 0
+ * if successful, otherwise a positive errno value (EOPNOTSUPP if this build
+ * lacks thread support).
+ *
+ * Threads do not survive fork(), so a daemon should enable asynchronous
+ * logging only after daemonizing. */
+int
+vlog_set_async(bool enable)
+{
+#ifdef HAVE_PTHREAD_H
+    if (enable && !async_enabled) {
+        static bool hooked;
+        sigset_t all_signals, old_signals;
+        int error;
+
+        if (async_fds[0] < 0) {
+            xpipe(async_fds);
+            set_nonblocking(async_fds[1]);
+        }
+
+        /* Block all signals in the writer thread, so that the main thread
+         * receives them. */
+        sigfillset(&all_signals);
+        pthread_sigmask(SIG_SETMASK, &all_signals, &old_signals);
+        async_exiting = false;
+        error = pthread_create(&async_thread, NULL, vlog_async_writer, NULL);
+        pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+        if (error) {
+            return error;
+        }
+        async_enabled = true;
+
+        if (!hooked) {
+            hooked = true;
+            fatal_signal_add_hook(vlog_async_exit_cb, NULL, NULL, true);
+        }
+    } else if (!enable && async_enabled) {
+        async_exiting = true;
+        __sync_synchronize();
+        ignore(write(async_fds[1], "", 1));
+        pthread_join(async_thread, NULL);
+        async_enabled = false;
+    }
+    return 0;
+#else
+    return enable ? EOPNOTSUPP : 0;
+#endif
+}
+
+/* Returns true if asynchronous logging is enabled, false otherwise. */
+bool
+vlog_get_async(void)
+{
+    return async_enabled;
+}
+
+/* Returns the number of log messages dropped because asynchronous logging
+ * could not keep up. */
+unsigned long long int
+vlog_get_async_dropped(void)
+{
+    return async_n_dropped;
+}
+
 /* Set debugging levels:
  *
  *  mod[:facility[:level]] mod2[:facility[:level]] ...
@@ -439,6 +675,29 @@ vlog_unixctl_reopen(struct unixctl_conn *conn,
     }
 }
 
+static void
+vlog_unixctl_async(struct unixctl_conn *conn,
+                   const char *args, void *aux OVS_UNUSED)
+{
+    char *msg;
+
+    if (!strcmp(args, "on") || !strcmp(args, "off")) {
+        int error = vlog_set_async(!strcmp(args, "on"));
+        if (error) {
+            unixctl_command_reply(conn, 501, strerror(error));
+            return;
+        }
+    } else if (args[0]) {
+        unixctl_command_reply(conn, 501, "usage: vlog/async [on|off]");
+        return;
+    }
+
+    msg = xasprintf("asynchronous logging %s, %llu messages dropped",
+                    async_enabled ? "enabled" : "disabled", async_n_dropped);
+    unixctl_command_reply(conn, 200, msg);
+    free(msg);
+}
+
 /* Initializes the logging subsystem and registers its unixctl server
  * commands. */
 void
@@ -467,6 +726,7 @@ vlog_init(void)
     unixctl_command_register("vlog/set", vlog_unixctl_set, NULL);
     unixctl_command_register("vlog/list", vlog_unixctl_list, NULL);
     unixctl_command_register("vlog/reopen", vlog_unixctl_reopen, NULL);
+    unixctl_command_register("vlog/async", vlog_unixctl_async, NULL);
 }
 
 /* Closes the logging subsystem. */
@@ -474,6 +734,7 @@ void
 vlog_exit(void)
 {
     if (vlog_inited) {
+        vlog_set_async(false);
         closelog();
         vlog_inited = false;
     }
@@ -639,10 +900,20 @@ vlog_valist(const struct vlog_module *module, enum vlog_level level,
     if (log_to_console || log_to_syslog || log_to_file) {
         int save_errno = errno;
         static unsigned int msg_num;
+        char *syslog_msg = NULL;
+        char *file_line = NULL;
+        bool async;
         struct ds s;
 
         vlog_init();
 
+        /* Write emergency messages synchronously, after anything queued, so
+         * that they reach the log even if the process is about to die. */
+        async = async_enabled && level != VLL_EMER;
+        if (!async) {
+            vlog_async_flush();
+        }
+
         ds_init(&s);
         ds_reserve(&s, 1024);
         msg_num++;
@@ -655,15 +926,12 @@ vlog_valist(const struct vlog_module *module, enum vlog_level level,
         }
 
         if (log_to_syslog) {
-            int syslog_level = syslog_levels[level];
-            char *save_ptr = NULL;
-            char *line;
-
             format_log_message(module, level, VLF_SYSLOG, msg_num,
                                message, args, &s);
-            for (line = strtok_r(s.string, "\n", &save_ptr); line;
-                 line = strtok_r(NULL, "\n", &save_ptr)) {
-                syslog(syslog_level, "%s", line);
+            if (async) {
+                syslog_msg = xstrdup(ds_cstr(&s));
+            } else {
+                write_syslog(syslog_levels[level], ds_cstr(&s));
             }
         }
 
@@ -671,8 +939,16 @@ vlog_valist(const struct vlog_module *module, enum vlog_level level,
             format_log_message(module, level, VLF_FILE, msg_num,
                                message, args, &s);
             ds_put_char(&s, '\n');
-            fputs(ds_cstr(&s), log_file);
-            fflush(log_file);
+            if (async) {
+                file_line = xstrdup(ds_cstr(&s));
+            } else {
+                fputs(ds_cstr(&s), log_file);
+                fflush(log_file);
+            }
+        }
+
+        if (async) {
+            vlog_async_enqueue(file_line, syslog_msg, syslog_levels[level]);
         }
 
         ds_destroy(&s);
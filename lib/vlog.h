@@ -134,6 +134,9 @@ void vlog_set_pattern(enum vlog_facility, const char *pattern);
 const char *vlog_get_log_file(void);
 int vlog_set_log_file(const char *file_name);
 int vlog_reopen_log_file(void);
+int vlog_set_async(bool enable);
+bool vlog_get_async(void);
+unsigned long long int vlog_get_async_dropped(void);
 
 /* Initialization. */
 void vlog_init(void);
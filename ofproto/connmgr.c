@@ -1407,6 +1407,9 @@ connmgr_may_set_up_flow(struct connmgr *mgr, const struct flow *flow,
 void
 connmgr_flushed(struct connmgr *mgr)
 {
+    if (mgr->in_band) {
+        in_band_flushed(mgr->in_band);
+    }
     if (mgr->fail_open) {
         fail_open_flushed(mgr->fail_open);
     }
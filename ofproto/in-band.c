@@ -71,10 +71,12 @@ struct in_band_remote {
     uint8_t remote_mac[ETH_ADDR_LEN]; /* Next-hop MAC, all-zeros if unknown. */
     uint8_t last_remote_mac[ETH_ADDR_LEN]; /* Previous nonzero next-hop MAC. */
     struct netdev *remote_netdev; /* Device to send to next-hop MAC. */
+    unsigned int remote_seqno;    /* 'remote_netdev''s change_seq. */
 };
 
 /* What to do to an in_band_rule. */
 enum in_band_op {
+    KEEP,                      /* Rule is already in ofproto's flow table. */
     ADD,                       /* Add the rule to ofproto's flow table. */
     DELETE                     /* Delete the rule from ofproto's flow table. */
 };
@@ -83,6 +85,7 @@ enum in_band_op {
 struct in_band_rule {
     struct cls_rule cls_rule;
     enum in_band_op op;
+    bool installed;             /* Added to ofproto's flow table? */
 };
 
 struct in_band {
@@ -95,12 +98,14 @@ struct in_band {
     size_t n_remotes;
 
     /* Local information. */
-    time_t next_local_refresh;       /* Refresh timer. */
     uint8_t local_mac[ETH_ADDR_LEN]; /* Current MAC. */
     struct netdev *local_netdev;     /* Local port's network device. */
+    unsigned int local_seqno;        /* 'local_netdev''s change_seq. */
 
     /* Flow tracking. */
-    struct hmap rules;          /* Contains "struct in_band_rule"s. */
+    struct ohmap rules;         /* Contains "struct in_band_rule"s. */
+    bool need_update;           /* Must recompute the rules? */
+    bool need_sync;             /* Some rule has an 'op' other than KEEP? */
 };
 
 static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(60, 60);
@@ -142,6 +147,7 @@ refresh_remote(struct in_band *ib, struct in_band_remote *r)
         }
     }
     free(next_hop_dev);
+    r->remote_seqno = netdev_change_seq(r->remote_netdev);
 
     /* Look up the MAC address of the next-hop IP address. */
     retval = netdev_arp_lookup(r->remote_netdev, next_hop_inaddr.s_addr,
@@ -153,17 +159,39 @@ refresh_remote(struct in_band *ib, struct in_band_remote *r)
 
     /* If we don't have a MAC address, then refresh quickly, since we probably
      * will get a MAC address soon (via ARP).  Otherwise, we can afford to wait
-     * a little while. */
+     * a little while: changes to the next-hop device wake us up earlier, and
+     * there is no notification for other route or ARP cache changes. */
     return eth_addr_is_zero(r->remote_mac) ? 1 : 10;
 }
 
+/* Returns true if the remotes in 'ib' are due for a refresh, because their
+ * refresh timer expired or one of their next-hop devices changed. */
+static bool
+remotes_need_refresh(const struct in_band *ib)
+{
+    const struct in_band_remote *r;
+
+    if (time_now() >= ib->next_remote_refresh) {
+        return true;
+    }
+
+    for (r = ib->remotes; r < &ib->remotes[ib->n_remotes]; r++) {
+        if (r->remote_netdev
+            && netdev_change_seq(r->remote_netdev) != r->remote_seqno) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 static bool
 refresh_remotes(struct in_band *ib)
 {
     struct in_band_remote *r;
     bool any_changes;
 
-    if (time_now() < ib->next_remote_refresh) {
+    if (!remotes_need_refresh(ib)) {
         return false;
     }
 
@@ -197,19 +225,23 @@ refresh_remotes(struct in_band *ib)
     return any_changes;
 }
 
-/* Refreshes the MAC address of the local port into ib->local_mac, if it is due
- * for a refresh.  Returns true if anything changed, otherwise false.  */
+/* Refreshes the MAC address of the local port into ib->local_mac, if the local
+ * port has changed since the last refresh.  If the MAC address changed, marks
+ * 'ib''s rules for recomputation and returns true, otherwise returns false. */
 static bool
 refresh_local(struct in_band *ib)
 {
+    unsigned int seqno;
     uint8_t ea[ETH_ADDR_LEN];
-    time_t now;
 
-    now = time_now();
-    if (now < ib->next_local_refresh) {
+    seqno = netdev_change_seq(ib->local_netdev);
+    if (seqno == ib->local_seqno) {
         return false;
     }
-    ib->next_local_refresh = now + 1;
+    ib->local_seqno = seqno;
+
+    /* A change to the local port can also change routes to the remotes. */
+    ib->next_remote_refresh = TIME_MIN;
 
     if (netdev_get_etheraddr(ib->local_netdev, ea)
         || eth_addr_equals(ea, ib->local_mac)) {
@@ -217,6 +249,7 @@ refresh_local(struct in_band *ib)
     }
 
     memcpy(ib->local_mac, ea, ETH_ADDR_LEN);
+    ib->need_update = true;
     return true;
 }
 
@@ -284,9 +317,9 @@ add_rule(struct in_band *ib, const struct cls_rule *cls_rule)
     uint32_t hash = cls_rule_hash(cls_rule, 0);
     struct in_band_rule *rule;
 
-    HMAP_FOR_EACH_WITH_HASH (rule, cls_rule.hmap_node, hash, &ib->rules) {
+    OHMAP_FOR_EACH_WITH_HASH (rule, cls_rule.ohmap_node, hash, &ib->rules) {
         if (cls_rule_equal(&rule->cls_rule, cls_rule)) {
-            rule->op = ADD;
+            rule->op = rule->installed ? KEEP : ADD;
             return;
         }
     }
@@ -294,9 +327,13 @@ add_rule(struct in_band *ib, const struct cls_rule *cls_rule)
     rule = xmalloc(sizeof *rule);
     rule->cls_rule = *cls_rule;
     rule->op = ADD;
-    hmap_insert(&ib->rules, &rule->cls_rule.hmap_node, hash);
+    rule->installed = false;
+    ohmap_insert(&ib->rules, &rule->cls_rule.ohmap_node, hash);
 }
 
+/* Recomputes the set of rules that 'ib' needs.  Rules that are no longer
+ * needed are marked for deletion and new rules are marked to be added.  Rules
+ * that are still needed and already in the flow table are left alone. */
 static void
 update_rules(struct in_band *ib)
 {
@@ -304,9 +341,9 @@ update_rules(struct in_band *ib)
     struct in_band_remote *r;
     struct cls_rule rule;
 
-    /* Mark all the existing rules for deletion.  (Afterward we will re-add any
-     * rules that are still valid.) */
-    HMAP_FOR_EACH (ib_rule, cls_rule.hmap_node, &ib->rules) {
+    /* Mark all the existing rules for deletion.  (Afterward we will keep or
+     * re-add any rules that are still valid.) */
+    OHMAP_FOR_EACH (ib_rule, cls_rule.ohmap_node, &ib->rules) {
         ib_rule->op = DELETE;
     }
 
@@ -412,6 +449,19 @@ in_band_run(struct in_band *ib)
 
     struct in_band_rule *rule, *next;
 
+    refresh_local(ib);
+    if (refresh_remotes(ib)) {
+        ib->need_update = true;
+    }
+    if (ib->need_update) {
+        update_rules(ib);
+        ib->need_update = false;
+        ib->need_sync = true;
+    }
+    if (!ib->need_sync) {
+        return ib->n_remotes || !ohmap_is_empty(&ib->rules);
+    }
+
     memset(&actions, 0, sizeof actions);
     actions.oa.output.type = htons(OFPAT_OUTPUT);
     actions.oa.output.len = htons(sizeof actions.oa);
@@ -430,37 +480,70 @@ in_band_run(struct in_band *ib)
         na = sizeof actions / sizeof(union ofp_action);
     }
 
-    refresh_local(ib);
-    refresh_remotes(ib);
-
-    update_rules(ib);
-
-    HMAP_FOR_EACH_SAFE (rule, next, cls_rule.hmap_node, &ib->rules) {
+    ib->need_sync = false;
+    OHMAP_FOR_EACH_SAFE (rule, next, cls_rule.ohmap_node, &ib->rules) {
         switch (rule->op) {
+        case KEEP:
+            break;
+
         case ADD:
-            ofproto_add_flow(ib->ofproto, &rule->cls_rule, a, na);
+            if (ofproto_add_flow(ib->ofproto, &rule->cls_rule, a, na)) {
+                rule->op = KEEP;
+                rule->installed = true;
+            } else {
+                /* Try again on the next call. */
+                ib->need_sync = true;
+            }
             break;
 
         case DELETE:
             if (ofproto_delete_flow(ib->ofproto, &rule->cls_rule)) {
                 /* ofproto doesn't have the rule anymore so there's no reason
                  * for us to track it any longer. */
-                hmap_remove(&ib->rules, &rule->cls_rule.hmap_node);
+                ohmap_remove(&ib->rules, &rule->cls_rule.ohmap_node);
                 free(rule);
+            } else {
+                /* Try again on the next call. */
+                ib->need_sync = true;
             }
             break;
         }
     }
 
-    return ib->n_remotes || !hmap_is_empty(&ib->rules);
+    return ib->n_remotes || !ohmap_is_empty(&ib->rules);
 }
 
 void
 in_band_wait(struct in_band *in_band)
 {
-    long long int wakeup
-            = MIN(in_band->next_remote_refresh, in_band->next_local_refresh);
-    poll_timer_wait_until(wakeup * 1000);
+    if (in_band->need_update) {
+        poll_immediate_wake();
+    } else {
+        if (in_band->need_sync) {
+            /* A flow table operation had to be postponed.  Retry soon. */
+            poll_timer_wait(100);
+        }
+        poll_timer_wait_until(in_band->next_remote_refresh * 1000);
+    }
+}
+
+/* Informs 'ib' that the flow table has been flushed, so that it can re-add
+ * the rules that it needs. */
+void
+in_band_flushed(struct in_band *ib)
+{
+    struct in_band_rule *rule, *next;
+
+    OHMAP_FOR_EACH_SAFE (rule, next, cls_rule.ohmap_node, &ib->rules) {
+        if (rule->op == DELETE) {
+            ohmap_remove(&ib->rules, &rule->cls_rule.ohmap_node);
+            free(rule);
+        } else {
+            rule->op = ADD;
+            rule->installed = false;
+        }
+    }
+    ib->need_update = true;
 }
 
 int
@@ -483,9 +566,9 @@ in_band_create(struct ofproto *ofproto, const char *local_name,
     in_band->ofproto = ofproto;
     in_band->queue_id = -1;
     in_band->next_remote_refresh = TIME_MIN;
-    in_band->next_local_refresh = TIME_MIN;
     in_band->local_netdev = local_netdev;
-    hmap_init(&in_band->rules);
+    ohmap_init(&in_band->rules);
+    in_band->need_update = true;
 
     *in_bandp = in_band;
 
@@ -498,11 +581,11 @@ in_band_destroy(struct in_band *ib)
     if (ib) {
         struct in_band_rule *rule, *next;
 
-        HMAP_FOR_EACH_SAFE (rule, next, cls_rule.hmap_node, &ib->rules) {
-            hmap_remove(&ib->rules, &rule->cls_rule.hmap_node);
+        OHMAP_FOR_EACH_SAFE (rule, next, cls_rule.ohmap_node, &ib->rules) {
+            ohmap_remove(&ib->rules, &rule->cls_rule.ohmap_node);
             free(rule);
         }
-        hmap_destroy(&ib->rules);
+        ohmap_destroy(&ib->rules);
         in_band_set_remotes(ib, NULL, 0);
         netdev_close(ib->local_netdev);
         free(ib);
@@ -557,6 +640,7 @@ in_band_set_remotes(struct in_band *ib,
 
     /* Force refresh in next call to in_band_run(). */
     ib->next_remote_refresh = TIME_MIN;
+    ib->need_update = true;
 }
 
 /* Sets the OpenFlow queue used by flows set up by 'ib' to 'queue_id'.  If
@@ -565,6 +649,15 @@ in_band_set_remotes(struct in_band *ib,
 void
 in_band_set_queue(struct in_band *ib, int queue_id)
 {
-    ib->queue_id = queue_id;
+    if (ib->queue_id != queue_id) {
+        struct in_band_rule *rule;
+
+        /* Every rule's actions change, so re-add them all. */
+        OHMAP_FOR_EACH (rule, cls_rule.ohmap_node, &ib->rules) {
+            rule->installed = false;
+        }
+        ib->queue_id = queue_id;
+        ib->need_update = true;
+    }
 }
 
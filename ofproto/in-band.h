@@ -37,6 +37,7 @@ void in_band_set_remotes(struct in_band *,
 
 bool in_band_run(struct in_band *);
 void in_band_wait(struct in_band *);
+void in_band_flushed(struct in_band *);
 
 bool in_band_msg_in_hook(struct in_band *, const struct flow *,
                          const struct ofpbuf *packet);
@@ -270,6 +270,7 @@ dpif_sflow_clear(struct dpif_sflow *ds)
 
     /* Turn off sampling to save CPU cycles. */
     dpif_set_sflow_probability(ds->dpif, 0);
+    dpif_set_sflow_sample_len(ds->dpif, 0);
 }
 
 bool
@@ -455,9 +456,12 @@ dpif_sflow_set_options(struct dpif_sflow *ds,
     sfl_receiver_set_sFlowRcvrOwner(receiver, "Open vSwitch sFlow");
     sfl_receiver_set_sFlowRcvrTimeout(receiver, 0xffffffff);
 
-    /* Set the sampling_rate down in the datapath. */
+    /* Set the sampling_rate down in the datapath.  Only the sampled headers
+     * are reported, so the datapath need not pass up the rest of each
+     * packet. */
     dpif_set_sflow_probability(ds->dpif,
                                MAX(1, UINT32_MAX / options->sampling_rate));
+    dpif_set_sflow_sample_len(ds->dpif, options->header_len);
 
     /* Add samplers and pollers for the currently known ports. */
     HMAP_FOR_EACH (dsp, hmap_node, &ds->ports) {
@@ -510,7 +514,8 @@ dpif_sflow_received(struct dpif_sflow *ds, const struct dpif_upcall *upcall,
     header->header_protocol = SFLHEADER_ETHERNET_ISO8023;
     /* The frame_length should include the Ethernet FCS (4 bytes),
        but it has already been stripped,  so we need to add 4 here. */
-    header->frame_length = upcall->packet->size + 4;
+    header->frame_length = (upcall->orig_len ? upcall->orig_len
+                            : upcall->packet->size) + 4;
     /* Ethernet FCS stripped off. */
     header->stripped = 4;
     header->header_length = MIN(upcall->packet->size,
@@ -30,10 +30,12 @@
 #include "dpif.h"
 #include "dynamic-string.h"
 #include "fail-open.h"
+#include "histogram.h"
 #include "hmapx.h"
 #include "lacp.h"
 #include "learn.h"
 #include "mac-learning.h"
+#include "memory.h"
 #include "multipath.h"
 #include "netdev.h"
 #include "netlink.h"
@@ -43,8 +45,10 @@
 #include "ofpbuf.h"
 #include "ofp-print.h"
 #include "ofproto-dpif-sflow.h"
+#include "ohmap.h"
 #include "poll-loop.h"
 #include "timer.h"
+#include "timeval.h"
 #include "unaligned.h"
 #include "unixctl.h"
 #include "vlan-bitmap.h"
@@ -59,8 +63,12 @@ COVERAGE_DEFINE(ofproto_dpif_xlate);
 COVERAGE_DEFINE(facet_changed_rule);
 COVERAGE_DEFINE(facet_invalidated);
 COVERAGE_DEFINE(facet_revalidate);
+COVERAGE_DEFINE(facet_revalidate_deferred);
 COVERAGE_DEFINE(facet_unexpected);
 
+MEMORY_DEFINE(facet);
+MEMORY_DEFINE(rule_dpif);
+
 /* Maximum depth of flow table recursion (due to resubmit actions) in a
  * flow translation. */
 #define MAX_RESUBMIT_RECURSION 16
@@ -237,7 +245,7 @@ struct facet {
 
     uint64_t accounted_bytes;    /* Bytes processed by facet_account(). */
 
-    struct hmap_node hmap_node;  /* In owning ofproto's 'facets' hmap. */
+    struct ohmap_node ohmap_node; /* In owning ofproto's 'facets' ohmap. */
     struct list list_node;       /* In owning rule's 'facets' list. */
     struct rule_dpif *rule;      /* Owning rule. */
     struct flow flow;            /* Exact-match flow. */
@@ -305,6 +313,8 @@ struct ofport_dpif {
     tag_type tag;               /* Tag associated with this port. */
     uint32_t bond_stable_id;    /* stable_id to use as bond slave, or 0. */
     bool may_enable;            /* May be enabled in bonds. */
+    uint32_t upcall_rate;       /* Datapath upcall limit, 0 if unlimited. */
+    uint32_t upcall_burst;      /* Datapath upcall burst size. */
 };
 
 static struct ofport_dpif *
@@ -334,6 +344,60 @@ struct table_dpif {
     uint32_t basis;                   /* Keeps each table's tags separate. */
 };
 
+/* Maximum number of flow table changes that may be deferred in a single
+ * revalidation window, regardless of the configured delay. */
+#define REVALIDATE_MAX_DEFERRED 1000
+
+/* Revalidation statistics, for "ofproto/revalidate-stats". */
+struct revalidate_stats {
+    unsigned long long int n_passes;        /* Revalidation passes. */
+    unsigned long long int n_full_passes;   /* Passes over all facets. */
+    unsigned long long int n_facets;        /* Facets revalidated. */
+    unsigned long long int n_windows;       /* Deferral windows opened. */
+    unsigned long long int n_deferred;      /* Changes deferred. */
+    unsigned long long int n_timeouts;      /* Windows closed by delay. */
+    unsigned long long int n_overflows;     /* Windows closed by size. */
+    unsigned long long int n_barriers;      /* Windows closed by barrier. */
+};
+
+/* Maximum number of upcalls that run() handles in one call. */
+#define UPCALL_MAX_BATCH 50
+
+/* Stages of upcall processing, for "ofproto/upcall-stats". */
+enum upcall_stage {
+    UPCALL_QUEUE,               /* Queued until received from datapath. */
+    UPCALL_KEY_PARSE,           /* Parsing the datapath flow key. */
+    UPCALL_FLOW_EXTRACT,        /* Parsing the packet's headers. */
+    UPCALL_LOOKUP,              /* Special cases, facet and rule lookup. */
+    UPCALL_XLATE,               /* Translating OpenFlow actions. */
+    UPCALL_EXECUTE,             /* Executing the miss packet's actions. */
+    UPCALL_INSTALL,             /* Installing the datapath flow. */
+    UPCALL_TOTAL,               /* Queued until flow installed. */
+    N_UPCALL_STAGES
+};
+
+static const char *upcall_stage_names[N_UPCALL_STAGES] = {
+    "queue", "key_parse", "flow_extract", "lookup", "xlate", "execute",
+    "install", "total"
+};
+
+/* Upcall statistics, for "ofproto/upcall-stats". */
+struct upcall_stats {
+    unsigned long long int n_upcalls[DPIF_N_UC_TYPES];
+    struct histogram stages[N_UPCALL_STAGES]; /* Latencies, in usec. */
+
+    /* Queue depth, sampled as the number of upcalls received in each batch.
+     * A batch that reaches UPCALL_MAX_BATCH left upcalls queued. */
+    struct histogram batches;
+    unsigned long long int n_full_batches;
+
+    /* Upcall rate, measured over successive intervals of about a second. */
+    long long int interval_start;       /* time_msec() at start. */
+    unsigned long long int interval_base;   /* Total upcalls at start. */
+    unsigned long long int last_rate;   /* Per second, last interval. */
+    unsigned long long int peak_rate;   /* Per second, busiest interval. */
+};
+
 struct ofproto_dpif {
     struct ofproto up;
     struct dpif *dpif;
@@ -354,13 +418,28 @@ struct ofproto_dpif {
     struct timer next_expiration;
 
     /* Facets. */
-    struct hmap facets;
+    struct ohmap facets;
 
     /* Revalidation. */
     struct table_dpif tables[N_TABLES];
     bool need_revalidate;
     struct tag_set revalidate_set;
 
+    /* Deferred revalidation.
+     *
+     * When 'up.revalidate_delay' is nonzero, flow table changes accumulate
+     * here instead of in 'need_revalidate' and 'revalidate_set', so that a
+     * burst of flow_mods costs a single revalidation pass.  The window closes
+     * when 'revalidate_deadline' passes, when 'n_deferred' reaches
+     * REVALIDATE_MAX_DEFERRED, or when a controller sends a barrier. */
+    bool deferred_revalidate_all;
+    struct tag_set deferred_revalidate_set;
+    unsigned int n_deferred;        /* Changes in the current window. */
+    long long int revalidate_deadline;
+    struct revalidate_stats revalidate_stats;
+
+    struct upcall_stats upcall_stats;
+
     /* Support for debugging async flow mods. */
     struct list completions;
 
@@ -488,7 +567,7 @@ construct(struct ofproto *ofproto_, int *n_tablesp)
 
     timer_set_duration(&ofproto->next_expiration, 1000);
 
-    hmap_init(&ofproto->facets);
+    ohmap_init(&ofproto->facets);
 
     for (i = 0; i < N_TABLES; i++) {
         struct table_dpif *table = &ofproto->tables[i];
@@ -499,6 +578,13 @@ construct(struct ofproto *ofproto_, int *n_tablesp)
     }
     ofproto->need_revalidate = false;
     tag_set_init(&ofproto->revalidate_set);
+    ofproto->deferred_revalidate_all = false;
+    tag_set_init(&ofproto->deferred_revalidate_set);
+    ofproto->n_deferred = 0;
+    ofproto->revalidate_deadline = LLONG_MAX;
+    memset(&ofproto->revalidate_stats, 0, sizeof ofproto->revalidate_stats);
+    memset(&ofproto->upcall_stats, 0, sizeof ofproto->upcall_stats);
+    ofproto->upcall_stats.interval_start = time_msec();
 
     list_init(&ofproto->completions);
 
@@ -550,11 +636,15 @@ destruct(struct ofproto *ofproto_)
     hmap_destroy(&ofproto->bundles);
     mac_learning_destroy(ofproto->ml);
 
-    hmap_destroy(&ofproto->facets);
+    ohmap_destroy(&ofproto->facets);
 
     dpif_close(ofproto->dpif);
 }
 
+static void revalidate(struct ofproto_dpif *);
+static void end_revalidate_window(struct ofproto_dpif *);
+static void upcall_stats_run(struct ofproto_dpif *, int n_upcalls);
+
 static int
 run(struct ofproto *ofproto_)
 {
@@ -568,7 +658,7 @@ run(struct ofproto *ofproto_)
     }
     dpif_run(ofproto->dpif);
 
-    for (i = 0; i < 50; i++) {
+    for (i = 0; i < UPCALL_MAX_BATCH; i++) {
         struct dpif_upcall packet;
         int error;
 
@@ -583,6 +673,7 @@ run(struct ofproto *ofproto_)
 
         handle_upcall(ofproto, &packet);
     }
+    upcall_stats_run(ofproto, i);
 
     if (timer_expired(&ofproto->next_expiration)) {
         int delay = expire(ofproto);
@@ -605,9 +696,33 @@ run(struct ofproto *ofproto_)
 
     mac_learning_run(ofproto->ml, &ofproto->revalidate_set);
 
+    /* Close the deferral window, if it's time. */
+    if (ofproto->n_deferred) {
+        struct revalidate_stats *stats = &ofproto->revalidate_stats;
+
+        if (ofproto->n_deferred >= REVALIDATE_MAX_DEFERRED) {
+            stats->n_overflows++;
+            end_revalidate_window(ofproto);
+        } else if (time_msec() >= ofproto->revalidate_deadline
+                   || !ofproto->up.revalidate_delay) {
+            stats->n_timeouts++;
+            end_revalidate_window(ofproto);
+        }
+    }
+
     /* Now revalidate if there's anything to do. */
+    revalidate(ofproto);
+
+    return 0;
+}
+
+/* Revalidates the facets in 'ofproto' that need it, if any. */
+static void
+revalidate(struct ofproto_dpif *ofproto)
+{
     if (ofproto->need_revalidate
         || !tag_set_is_empty(&ofproto->revalidate_set)) {
+        struct revalidate_stats *stats = &ofproto->revalidate_stats;
         struct tag_set revalidate_set = ofproto->revalidate_set;
         bool revalidate_all = ofproto->need_revalidate;
         struct facet *facet, *next;
@@ -616,15 +731,36 @@ run(struct ofproto *ofproto_)
         tag_set_init(&ofproto->revalidate_set);
         ofproto->need_revalidate = false;
 
-        HMAP_FOR_EACH_SAFE (facet, next, hmap_node, &ofproto->facets) {
+        stats->n_passes++;
+        if (revalidate_all) {
+            stats->n_full_passes++;
+        }
+        OHMAP_FOR_EACH_SAFE (facet, next, ohmap_node, &ofproto->facets) {
             if (revalidate_all
                 || tag_set_intersects(&revalidate_set, facet->tags)) {
+                stats->n_facets++;
                 facet_revalidate(ofproto, facet);
             }
         }
     }
+}
 
-    return 0;
+/* Closes 'ofproto''s revalidation deferral window, if one is open, moving the
+ * revalidation work accumulated in it to where the next call to revalidate()
+ * will find it. */
+static void
+end_revalidate_window(struct ofproto_dpif *ofproto)
+{
+    if (ofproto->deferred_revalidate_all) {
+        ofproto->need_revalidate = true;
+    } else {
+        tag_set_union(&ofproto->revalidate_set,
+                      &ofproto->deferred_revalidate_set);
+    }
+    ofproto->deferred_revalidate_all = false;
+    tag_set_init(&ofproto->deferred_revalidate_set);
+    ofproto->n_deferred = 0;
+    ofproto->revalidate_deadline = LLONG_MAX;
 }
 
 static void
@@ -660,6 +796,21 @@ wait(struct ofproto *ofproto_)
     } else {
         timer_wait(&ofproto->next_expiration);
     }
+    if (ofproto->n_deferred) {
+        poll_timer_wait_until(ofproto->revalidate_deadline);
+    }
+}
+
+static void
+barrier(struct ofproto *ofproto_)
+{
+    struct ofproto_dpif *ofproto = ofproto_dpif_cast(ofproto_);
+
+    if (ofproto->n_deferred) {
+        ofproto->revalidate_stats.n_barriers++;
+        end_revalidate_window(ofproto);
+        revalidate(ofproto);
+    }
 }
 
 static void
@@ -668,7 +819,7 @@ flush(struct ofproto *ofproto_)
     struct ofproto_dpif *ofproto = ofproto_dpif_cast(ofproto_);
     struct facet *facet, *next_facet;
 
-    HMAP_FOR_EACH_SAFE (facet, next_facet, hmap_node, &ofproto->facets) {
+    OHMAP_FOR_EACH_SAFE (facet, next_facet, ohmap_node, &ofproto->facets) {
         /* Mark the facet as not installed so that facet_remove() doesn't
          * bother trying to uninstall it.  There is no point in uninstalling it
          * individually since we are about to blow away all the facets with
@@ -757,6 +908,8 @@ port_construct(struct ofport *port_)
     port->cfm = NULL;
     port->tag = tag_create_random();
     port->may_enable = true;
+    port->upcall_rate = 0;
+    port->upcall_burst = 0;
 
     if (ofproto->sflow) {
         dpif_sflow_add_port(ofproto->sflow, port->odp_port,
@@ -876,6 +1029,30 @@ get_cfm_remote_mpids(const struct ofport *ofport_, const uint64_t **rmps,
     }
 }
 
+static int
+set_upcall_limit(struct ofport *ofport_, uint32_t rate, uint32_t burst)
+{
+    struct ofport_dpif *ofport = ofport_dpif_cast(ofport_);
+    struct ofproto_dpif *ofproto = ofproto_dpif_cast(ofport->up.ofproto);
+    int error;
+
+    /* The bridge reapplies this setting on every reconfiguration, so skip the
+     * datapath round trip if nothing changed. */
+    if (rate == ofport->upcall_rate && burst == ofport->upcall_burst) {
+        return 0;
+    }
+
+    error = dpif_port_set_upcall_limit(ofproto->dpif, ofport->odp_port,
+                                       rate, burst);
+    if (!error || error == EOPNOTSUPP) {
+        /* Remember an unsupported request too, so that it is reported once
+         * rather than on every reconfiguration. */
+        ofport->upcall_rate = rate;
+        ofport->upcall_burst = burst;
+    }
+    return error;
+}
+
 /* Bundles. */
 
 /* Expires all MAC learning entries associated with 'port' and forces ofproto
@@ -1698,17 +1875,35 @@ process_special(struct ofproto_dpif *ofproto, const struct flow *flow,
     return false;
 }
 
+/* Records that 'stage' of handling an upcall in 'ofproto', which began at
+ * 'start' (in usec), has ended, and returns the current time_usec(). */
+static long long int
+upcall_stage_done(struct ofproto_dpif *ofproto, enum upcall_stage stage,
+                  long long int start)
+{
+    long long int now = time_usec();
+
+    histogram_add(&ofproto->upcall_stats.stages[stage], MAX(now - start, 0));
+    return now;
+}
+
+/* Handles the miss 'upcall' in 'ofproto'.  'start' is the time_usec() at
+ * which handling began. */
 static void
-handle_miss_upcall(struct ofproto_dpif *ofproto, struct dpif_upcall *upcall)
+handle_miss_upcall(struct ofproto_dpif *ofproto, struct dpif_upcall *upcall,
+                   long long int start)
 {
     struct facet *facet;
     struct flow flow;
+    long long int t;
 
     /* Obtain in_port and tun_id, at least. */
     odp_flow_key_to_flow(upcall->key, upcall->key_len, &flow);
+    t = upcall_stage_done(ofproto, UPCALL_KEY_PARSE, start);
 
     /* Set header pointers in 'flow'. */
     flow_extract(upcall->packet, flow.tun_id, flow.in_port, &flow);
+    t = upcall_stage_done(ofproto, UPCALL_FLOW_EXTRACT, t);
 
     /* Handle 802.1ag and LACP. */
     if (process_special(ofproto, &flow, upcall->packet)) {
@@ -1726,6 +1921,7 @@ handle_miss_upcall(struct ofproto_dpif *ofproto, struct dpif_upcall *upcall)
     facet = facet_lookup_valid(ofproto, &flow);
     if (!facet) {
         struct rule_dpif *rule = rule_dpif_lookup(ofproto, &flow, 0);
+        t = upcall_stage_done(ofproto, UPCALL_LOOKUP, t);
         if (!rule) {
             /* Don't send a packet-in if OFPPC_NO_PACKET_IN asserted. */
             struct ofport_dpif *port = get_ofp_port(ofproto, flow.in_port);
@@ -1746,10 +1942,15 @@ handle_miss_upcall(struct ofproto_dpif *ofproto, struct dpif_upcall *upcall)
         }
 
         facet = facet_create(rule, &flow, upcall->packet);
-    } else if (!facet->may_install) {
-        /* The facet is not installable, that is, we need to process every
-         * packet, so process the current packet's actions into 'facet'. */
-        facet_make_actions(ofproto, facet, upcall->packet);
+        t = upcall_stage_done(ofproto, UPCALL_XLATE, t);
+    } else {
+        t = upcall_stage_done(ofproto, UPCALL_LOOKUP, t);
+        if (!facet->may_install) {
+            /* The facet is not installable, that is, we need to process every
+             * packet, so process the current packet's actions into 'facet'. */
+            facet_make_actions(ofproto, facet, upcall->packet);
+            t = upcall_stage_done(ofproto, UPCALL_XLATE, t);
+        }
     }
 
     if (facet->rule->up.cr.priority == FAIL_OPEN_PRIORITY) {
@@ -1767,14 +1968,25 @@ handle_miss_upcall(struct ofproto_dpif *ofproto, struct dpif_upcall *upcall)
     }
 
     facet_execute(ofproto, facet, upcall->packet);
+    t = upcall_stage_done(ofproto, UPCALL_EXECUTE, t);
     facet_install(ofproto, facet, false);
+    t = upcall_stage_done(ofproto, UPCALL_INSTALL, t);
+    histogram_add(&ofproto->upcall_stats.stages[UPCALL_TOTAL],
+                  MAX(t - upcall->queued, 0));
     ofproto->n_matches++;
 }
 
 static void
 handle_upcall(struct ofproto_dpif *ofproto, struct dpif_upcall *upcall)
 {
+    struct upcall_stats *stats = &ofproto->upcall_stats;
     struct flow flow;
+    long long int start;
+
+    start = upcall_stage_done(ofproto, UPCALL_QUEUE, upcall->queued);
+    if (upcall->type < DPIF_N_UC_TYPES) {
+        stats->n_upcalls[upcall->type]++;
+    }
 
     switch (upcall->type) {
     case DPIF_UC_ACTION:
@@ -1792,7 +2004,7 @@ handle_upcall(struct ofproto_dpif *ofproto, struct dpif_upcall *upcall)
         break;
 
     case DPIF_UC_MISS:
-        handle_miss_upcall(ofproto, upcall);
+        handle_miss_upcall(ofproto, upcall, start);
         break;
 
     case DPIF_N_UC_TYPES:
@@ -1802,6 +2014,37 @@ handle_upcall(struct ofproto_dpif *ofproto, struct dpif_upcall *upcall)
     }
 }
 
+/* Updates 'ofproto''s upcall statistics after run() received a batch of
+ * 'n_upcalls' upcalls. */
+static void
+upcall_stats_run(struct ofproto_dpif *ofproto, int n_upcalls)
+{
+    struct upcall_stats *stats = &ofproto->upcall_stats;
+    long long int now, elapsed;
+
+    if (n_upcalls) {
+        histogram_add(&stats->batches, n_upcalls);
+        if (n_upcalls >= UPCALL_MAX_BATCH) {
+            stats->n_full_batches++;
+        }
+    }
+
+    now = time_msec();
+    elapsed = now - stats->interval_start;
+    if (elapsed >= 1000) {
+        unsigned long long int total = 0;
+        int i;
+
+        for (i = 0; i < DPIF_N_UC_TYPES; i++) {
+            total += stats->n_upcalls[i];
+        }
+        stats->last_rate = (total - stats->interval_base) * 1000 / elapsed;
+        stats->peak_rate = MAX(stats->peak_rate, stats->last_rate);
+        stats->interval_start = now;
+        stats->interval_base = total;
+    }
+}
+
 /* Flow expiration. */
 
 static int facet_max_idle(const struct ofproto_dpif *);
@@ -1966,14 +2209,14 @@ facet_max_idle(const struct ofproto_dpif *ofproto)
     long long int now;
     int i;
 
-    total = hmap_count(&ofproto->facets);
+    total = ohmap_count(&ofproto->facets);
     if (total <= ofproto->up.flow_eviction_threshold) {
         return N_BUCKETS * BUCKET_WIDTH;
     }
 
     /* Build histogram. */
     now = time_msec();
-    HMAP_FOR_EACH (facet, hmap_node, &ofproto->facets) {
+    OHMAP_FOR_EACH (facet, ohmap_node, &ofproto->facets) {
         long long int idle = now - facet->used;
         int bucket = (idle <= 0 ? 0
                       : idle >= BUCKET_WIDTH * N_BUCKETS ? N_BUCKETS - 1
@@ -2037,7 +2280,7 @@ expire_facets(struct ofproto_dpif *ofproto, int dp_max_idle)
     long long int cutoff = time_msec() - dp_max_idle;
     struct facet *facet, *next_facet;
 
-    HMAP_FOR_EACH_SAFE (facet, next_facet, hmap_node, &ofproto->facets) {
+    OHMAP_FOR_EACH_SAFE (facet, next_facet, ohmap_node, &ofproto->facets) {
         facet_active_timeout(ofproto, facet);
         if (facet->used < cutoff) {
             facet_remove(ofproto, facet);
@@ -2095,8 +2338,9 @@ facet_create(struct rule_dpif *rule, const struct flow *flow,
     struct facet *facet;
 
     facet = xzalloc(sizeof *facet);
+    memory_inc(&memory_facet, sizeof *facet);
     facet->used = time_msec();
-    hmap_insert(&ofproto->facets, &facet->hmap_node, flow_hash(flow, 0));
+    ohmap_insert(&ofproto->facets, &facet->ohmap_node, flow_hash(flow, 0));
     list_push_back(&rule->facets, &facet->list_node);
     facet->rule = rule;
     facet->flow = *flow;
@@ -2111,6 +2355,7 @@ facet_create(struct rule_dpif *rule, const struct flow *flow,
 static void
 facet_free(struct facet *facet)
 {
+    memory_dec(&memory_facet, sizeof *facet + facet->actions_len);
     free(facet->actions);
     free(facet);
 }
@@ -2135,10 +2380,12 @@ execute_odp_actions(struct ofproto_dpif *ofproto, const struct flow *flow,
         upcall.packet = packet;
         upcall.key = NULL;
         upcall.key_len = 0;
+        upcall.queued = time_usec();
         upcall.userdata = nl_attr_get_u64(odp_actions);
         upcall.sample_pool = 0;
         upcall.actions = NULL;
         upcall.actions_len = 0;
+        upcall.orig_len = 0;
 
         send_packet_in(ofproto, &upcall, flow, false);
 
@@ -2199,7 +2446,7 @@ facet_remove(struct ofproto_dpif *ofproto, struct facet *facet)
 {
     facet_uninstall(ofproto, facet);
     facet_flush_stats(ofproto, facet);
-    hmap_remove(&ofproto->facets, &facet->hmap_node);
+    ohmap_remove(&ofproto->facets, &facet->ohmap_node);
     list_remove(&facet->list_node);
     facet_free(facet);
 }
@@ -2224,6 +2471,7 @@ facet_make_actions(struct ofproto_dpif *p, struct facet *facet,
     if (facet->actions_len != odp_actions->size
         || memcmp(facet->actions, odp_actions->data, odp_actions->size)) {
         free(facet->actions);
+        memory_resize(&memory_facet, facet->actions_len, odp_actions->size);
         facet->actions_len = odp_actions->size;
         facet->actions = xmemdup(odp_actions->data, odp_actions->size);
     }
@@ -2442,8 +2690,8 @@ facet_find(struct ofproto_dpif *ofproto, const struct flow *flow)
 {
     struct facet *facet;
 
-    HMAP_FOR_EACH_WITH_HASH (facet, hmap_node, flow_hash(flow, 0),
-                             &ofproto->facets) {
+    OHMAP_FOR_EACH_WITH_HASH (facet, ohmap_node, flow_hash(flow, 0),
+                              &ofproto->facets) {
         if (flow_equal(flow, &facet->flow)) {
             return facet;
         }
@@ -2464,7 +2712,7 @@ facet_lookup_valid(struct ofproto_dpif *ofproto, const struct flow *flow)
     /* The facet we found might not be valid, since we could be in need of
      * revalidation.  If it is not valid, don't return it. */
     if (facet
-        && ofproto->need_revalidate
+        && (ofproto->need_revalidate || ofproto->deferred_revalidate_all)
         && !facet_revalidate(ofproto, facet)) {
         COVERAGE_INC(facet_invalidated);
         return NULL;
@@ -2540,6 +2788,7 @@ facet_revalidate(struct ofproto_dpif *ofproto, struct facet *facet)
     facet->has_normal = ctx.has_normal;
     if (actions_changed) {
         free(facet->actions);
+        memory_resize(&memory_facet, facet->actions_len, odp_actions->size);
         facet->actions_len = odp_actions->size;
         facet->actions = xmemdup(odp_actions->data, odp_actions->size);
     }
@@ -2696,6 +2945,7 @@ static struct rule *
 rule_alloc(void)
 {
     struct rule_dpif *rule = xmalloc(sizeof *rule);
+    memory_inc(&memory_rule_dpif, sizeof *rule);
     return &rule->up;
 }
 
@@ -2703,6 +2953,7 @@ static void
 rule_dealloc(struct rule *rule_)
 {
     struct rule_dpif *rule = rule_dpif_cast(rule_);
+    memory_dec(&memory_rule_dpif, sizeof *rule);
     free(rule);
 }
 
@@ -4068,8 +4319,11 @@ rule_calculate_tag(const struct flow *flow, const struct flow_wildcards *wc,
  * be invalid if you get unlucky.  For example, if a flow removal causes a
  * cls_table to be destroyed and then a flow insertion causes a cls_table with
  * different wildcards to be created with the same address, then this function
- * will incorrectly skip revalidation. */
-static void
+ * will incorrectly skip revalidation.
+ *
+ * Returns true if the taggability of the table changed, in which case every
+ * facet must be revalidated. */
+static bool
 table_update_taggable(struct ofproto_dpif *ofproto, uint8_t table_id)
 {
     struct table_dpif *table = &ofproto->tables[table_id];
@@ -4109,8 +4363,9 @@ table_update_taggable(struct ofproto_dpif *ofproto, uint8_t table_id)
     if (table->catchall_table != catchall || table->other_table != other) {
         table->catchall_table = catchall;
         table->other_table = other;
-        ofproto->need_revalidate = true;
+        return true;
     }
+    return false;
 }
 
 /* Given 'rule' that has changed in some way (either it is a rule being
@@ -4119,21 +4374,46 @@ table_update_taggable(struct ofproto_dpif *ofproto, uint8_t table_id)
  * forwarded correctly according to the new state of the flow table.
  *
  * This function must be called after *each* change to a flow table.  See
- * the comment on table_update_taggable() for more information. */
+ * the comment on table_update_taggable() for more information.
+ *
+ * If 'ofproto' has a nonzero revalidation delay, the facets are only marked
+ * for revalidation when the current deferral window closes. */
 static void
 rule_invalidate(const struct rule_dpif *rule)
 {
     struct ofproto_dpif *ofproto = ofproto_dpif_cast(rule->up.ofproto);
+    struct tag_set *revalidate_set;
+    bool *revalidate_all;
 
-    table_update_taggable(ofproto, rule->up.table_id);
+    if (ofproto->up.revalidate_delay) {
+        struct revalidate_stats *stats = &ofproto->revalidate_stats;
 
-    if (!ofproto->need_revalidate) {
+        if (!ofproto->n_deferred++) {
+            ofproto->revalidate_deadline = (time_msec()
+                                            + ofproto->up.revalidate_delay);
+            stats->n_windows++;
+        }
+        stats->n_deferred++;
+        COVERAGE_INC(facet_revalidate_deferred);
+
+        revalidate_all = &ofproto->deferred_revalidate_all;
+        revalidate_set = &ofproto->deferred_revalidate_set;
+    } else {
+        revalidate_all = &ofproto->need_revalidate;
+        revalidate_set = &ofproto->revalidate_set;
+    }
+
+    if (table_update_taggable(ofproto, rule->up.table_id)) {
+        *revalidate_all = true;
+    }
+
+    if (!*revalidate_all) {
         struct table_dpif *table = &ofproto->tables[rule->up.table_id];
 
         if (table->other_table && rule->tag) {
-            tag_set_add(&ofproto->revalidate_set, rule->tag);
+            tag_set_add(revalidate_set, rule->tag);
         } else {
-            ofproto->need_revalidate = true;
+            *revalidate_all = true;
         }
     }
 }
@@ -4202,13 +4482,57 @@ ofproto_dpif_lookup(const char *name)
             : NULL);
 }
 
+/* State of an "fdb/show" reply in progress.
+ *
+ * The MAC learning table can change while the reply is being streamed out, so
+ * it is copied when the command arrives. */
+struct fdb_dump {
+    struct fdb_dump_entry {
+        uint32_t odp_port;
+        uint16_t vlan;
+        uint8_t mac[ETH_ADDR_LEN];
+        int age;
+    } *entries;
+    size_t n, pos;
+    bool header_done;
+};
+
+static bool
+fdb_dump_next(struct ds *ds, void *dump_)
+{
+    struct fdb_dump *dump = dump_;
+    size_t i;
+
+    if (!dump->header_done) {
+        ds_put_cstr(ds, " port  VLAN  MAC                Age\n");
+        dump->header_done = true;
+    }
+
+    for (i = 0; i < 64 && dump->pos < dump->n; i++) {
+        const struct fdb_dump_entry *e = &dump->entries[dump->pos++];
+        ds_put_format(ds, "%5d  %4d  "ETH_ADDR_FMT"  %3d\n",
+                      e->odp_port, e->vlan, ETH_ADDR_ARGS(e->mac), e->age);
+    }
+    return dump->pos < dump->n;
+}
+
+static void
+fdb_dump_destroy(void *dump_)
+{
+    struct fdb_dump *dump = dump_;
+
+    free(dump->entries);
+    free(dump);
+}
+
 static void
 ofproto_unixctl_fdb_show(struct unixctl_conn *conn,
                          const char *args, void *aux OVS_UNUSED)
 {
-    struct ds ds = DS_EMPTY_INITIALIZER;
     const struct ofproto_dpif *ofproto;
     const struct mac_entry *e;
+    struct fdb_dump *dump;
+    size_t allocated;
 
     ofproto = ofproto_dpif_lookup(args);
     if (!ofproto) {
@@ -4216,15 +4540,24 @@ ofproto_unixctl_fdb_show(struct unixctl_conn *conn,
         return;
     }
 
-    ds_put_cstr(&ds, " port  VLAN  MAC                Age\n");
+    dump = xzalloc(sizeof *dump);
+    allocated = 0;
     LIST_FOR_EACH (e, lru_node, &ofproto->ml->lrus) {
         struct ofbundle *bundle = e->port.p;
-        ds_put_format(&ds, "%5d  %4d  "ETH_ADDR_FMT"  %3d\n",
-                      ofbundle_get_a_port(bundle)->odp_port,
-                      e->vlan, ETH_ADDR_ARGS(e->mac), mac_entry_age(e));
+        struct fdb_dump_entry *de;
+
+        if (dump->n >= allocated) {
+            dump->entries = x2nrealloc(dump->entries, &allocated,
+                                       sizeof *dump->entries);
+        }
+        de = &dump->entries[dump->n++];
+        memcpy(de->mac, e->mac, ETH_ADDR_LEN);
+        de->vlan = e->vlan;
+        de->odp_port = ofbundle_get_a_port(bundle)->odp_port;
+        de->age = mac_entry_age(e);
     }
-    unixctl_command_reply(conn, 200, ds_cstr(&ds));
-    ds_destroy(&ds);
+    unixctl_command_reply_stream(conn, 200, fdb_dump_next, fdb_dump_destroy,
+                                 dump);
 }
 
 struct ofproto_trace {
@@ -4423,6 +4756,91 @@ exit:
     free(args);
 }
 
+static void
+ofproto_unixctl_revalidate_stats(struct unixctl_conn *conn, const char *args,
+                                 void *aux OVS_UNUSED)
+{
+    const struct revalidate_stats *stats;
+    const struct ofproto_dpif *ofproto;
+    struct ds ds;
+
+    ofproto = ofproto_dpif_lookup(args);
+    if (!ofproto) {
+        unixctl_command_reply(conn, 501, "no such bridge");
+        return;
+    }
+    stats = &ofproto->revalidate_stats;
+
+    ds_init(&ds);
+    ds_put_format(&ds, "deferral window: %u ms, max %d changes\n",
+                  ofproto->up.revalidate_delay, REVALIDATE_MAX_DEFERRED);
+    if (ofproto->n_deferred) {
+        ds_put_format(&ds, "  open window: %u changes, closes in %lld ms\n",
+                      ofproto->n_deferred,
+                      MAX(ofproto->revalidate_deadline - time_msec(), 0));
+    }
+    ds_put_format(&ds, "windows: %llu (deferred %llu changes)\n",
+                  stats->n_windows, stats->n_deferred);
+    ds_put_format(&ds, "  closed by: delay %llu, size %llu, barrier %llu\n",
+                  stats->n_timeouts, stats->n_overflows, stats->n_barriers);
+    ds_put_format(&ds, "revalidations: %llu (%llu full), %llu facets\n",
+                  stats->n_passes, stats->n_full_passes, stats->n_facets);
+    unixctl_command_reply(conn, 200, ds_cstr(&ds));
+    ds_destroy(&ds);
+}
+
+static void
+ofproto_unixctl_upcall_stats(struct unixctl_conn *conn, const char *args,
+                             void *aux OVS_UNUSED)
+{
+    const struct upcall_stats *stats;
+    const struct ofproto_dpif *ofproto;
+    unsigned long long int total;
+    struct ds ds;
+    int i;
+
+    ofproto = ofproto_dpif_lookup(args);
+    if (!ofproto) {
+        unixctl_command_reply(conn, 501, "no such bridge");
+        return;
+    }
+    stats = &ofproto->upcall_stats;
+
+    ds_init(&ds);
+    total = 0;
+    for (i = 0; i < DPIF_N_UC_TYPES; i++) {
+        total += stats->n_upcalls[i];
+    }
+    ds_put_format(&ds, "upcalls: %llu (", total);
+    for (i = 0; i < DPIF_N_UC_TYPES; i++) {
+        ds_put_format(&ds, "%s%s %llu", i ? ", " : "",
+                      dpif_upcall_type_to_string(i), stats->n_upcalls[i]);
+    }
+    ds_put_cstr(&ds, ")\n");
+    ds_put_format(&ds, "  rate: %llu/s last second, %llu/s peak\n",
+                  stats->last_rate, stats->peak_rate);
+    ds_put_format(&ds, "batches: %llu, max %d per batch, %llu full\n",
+                  stats->batches.n, UPCALL_MAX_BATCH, stats->n_full_batches);
+    if (stats->batches.n) {
+        ds_put_format(&ds, "  upcalls per batch: p50 %llu, p99 %llu, "
+                      "max %llu\n",
+                      histogram_percentile(&stats->batches, 50),
+                      histogram_percentile(&stats->batches, 99),
+                      stats->batches.max);
+    }
+    ds_put_cstr(&ds, "stage                     count     p50 ms     p99 ms"
+                "     max ms   total ms\n");
+    for (i = 0; i < N_UPCALL_STAGES; i++) {
+        const struct histogram *h = &stats->stages[i];
+
+        ds_put_format(&ds, "%-20s %10llu", upcall_stage_names[i], h->n);
+        histogram_format_msec(h, &ds);
+        ds_put_char(&ds, '\n');
+    }
+    unixctl_command_reply(conn, 200, ds_cstr(&ds));
+    ds_destroy(&ds);
+}
+
 static void
 ofproto_dpif_clog(struct unixctl_conn *conn OVS_UNUSED,
                   const char *args_ OVS_UNUSED, void *aux OVS_UNUSED)
@@ -4450,6 +4868,10 @@ ofproto_dpif_unixctl_init(void)
 
     unixctl_command_register("ofproto/trace", ofproto_unixctl_trace, NULL);
     unixctl_command_register("fdb/show", ofproto_unixctl_fdb_show, NULL);
+    unixctl_command_register("ofproto/revalidate-stats",
+                             ofproto_unixctl_revalidate_stats, NULL);
+    unixctl_command_register("ofproto/upcall-stats",
+                             ofproto_unixctl_upcall_stats, NULL);
 
     unixctl_command_register("ofproto/clog", ofproto_dpif_clog, NULL);
     unixctl_command_register("ofproto/unclog", ofproto_dpif_unclog, NULL);
@@ -4500,10 +4922,12 @@ const struct ofproto_class ofproto_dpif_class = {
     set_cfm,
     get_cfm_fault,
     get_cfm_remote_mpids,
+    set_upcall_limit,
     bundle_set,
     bundle_remove,
     mirror_set,
     set_flood_vlans,
     is_mirror_output_bundle,
     forward_bpdu_changed,
+    barrier,
 };
@@ -46,6 +46,9 @@ struct ofproto {
                                        * ofproto-dpif implementation */
     bool forward_bpdu;          /* Option to allow forwarding of BPDU frames
                                  * when NORMAL action is invoked. */
+    unsigned revalidate_delay;  /* Max msecs to defer revalidation after flow
+                                 * table changes.  Only affects the
+                                 * ofproto-dpif implementation. */
     char *mfr_desc;             /* Manufacturer. */
     char *hw_desc;              /* Hardware. */
     char *sw_desc;              /* Software version. */
@@ -68,6 +71,13 @@ struct ofproto {
     struct list pending;        /* List of "struct ofopgroup"s. */
     unsigned int n_pending;     /* list_size(&pending). */
     struct hmap deletions;      /* All OFOPERATION_DELETE "ofoperation"s. */
+
+    /* Flow dumps in progress (see ofproto_flow_dump_start()).  While any dump
+     * is in progress, rules are not freed but instead moved to 'dead_rules',
+     * through their 'ofproto_node' members, so that the dumps can recognize
+     * them as deleted. */
+    struct list flow_dumps;     /* Contains "struct ofproto_flow_dump"s. */
+    struct list dead_rules;     /* Contains "struct rule"s. */
 };
 
 struct ofproto *ofproto_lookup(const char *name);
@@ -894,6 +904,18 @@ struct ofproto_class {
     int (*get_cfm_remote_mpids)(const struct ofport *ofport,
                                 const uint64_t **rmps, size_t *n_rmps);
 
+    /* Limits the rate at which packets received on 'ofport' that require a
+     * flow setup, e.g. because they miss in a datapath flow table, are passed
+     * up to the implementation to 'rate' per second with bursts of up to
+     * 'burst' packets, or removes the limit if 'rate' is 0.  A 'burst' of 0
+     * requests a default.  Link-layer control protocol frames such as LACP,
+     * CFM, and STP BPDUs must never be limited.
+     *
+     * EOPNOTSUPP as a return value indicates that this ofproto_class does not
+     * support upcall limits, as does a null pointer. */
+    int (*set_upcall_limit)(struct ofport *ofport, uint32_t rate,
+                            uint32_t burst);
+
     /* If 's' is nonnull, this function registers a "bundle" associated with
      * client data pointer 'aux' in 'ofproto'.  A bundle is the same concept as
      * a Port in OVSDB, that is, it consists of one or more "slave" devices
@@ -953,6 +975,17 @@ struct ofproto_class {
     /* When the configuration option of forward_bpdu changes, this function
      * will be invoked. */
     void (*forward_bpdu_changed)(struct ofproto *ofproto);
+
+    /* Called when a controller sends a barrier request, after every flow
+     * table modification that preceded it has completed but before the
+     * barrier reply is sent.  An implementation that defers work triggered
+     * by flow table changes (e.g. revalidation of cached flows) should
+     * complete that work here, so that the controller may rely on the
+     * barrier reply to indicate that its changes have taken effect.
+     *
+     * This function may be a null pointer if the ofproto implementation
+     * never defers such work. */
+    void (*barrier)(struct ofproto *ofproto);
 };
 
 extern const struct ofproto_class ofproto_dpif_class;
@@ -972,7 +1005,7 @@ int ofproto_class_unregister(const struct ofproto_class *);
 enum { OFPROTO_POSTPONE = -100000 };
 
 int ofproto_flow_mod(struct ofproto *, const struct ofputil_flow_mod *);
-void ofproto_add_flow(struct ofproto *, const struct cls_rule *,
+bool ofproto_add_flow(struct ofproto *, const struct cls_rule *,
                       const union ofp_action *, size_t n_actions);
 bool ofproto_delete_flow(struct ofproto *, const struct cls_rule *);
 void ofproto_flush_flows(struct ofproto *);
@@ -21,6 +21,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include "bitmap.h"
 #include "byte-order.h"
 #include "classifier.h"
 #include "connmgr.h"
@@ -122,6 +123,19 @@ static void ofoperation_create(struct ofopgroup *, struct rule *,
                                enum ofoperation_type);
 static void ofoperation_destroy(struct ofoperation *);
 
+/* An incremental dump of all of the flows in an ofproto.
+ *
+ * A dump takes a snapshot of the rules in the ofproto's flow tables when it
+ * starts.  A rule that is deleted before the dump reaches it is skipped, and
+ * rules added after the dump starts are not included. */
+struct ofproto_flow_dump {
+    struct list node;           /* In ofproto's "flow_dumps" list. */
+    struct ofproto *ofproto;    /* Null if the ofproto was destroyed. */
+    struct rule **rules;        /* Snapshot of rules. */
+    size_t n_rules;             /* Number of rules in 'rules'. */
+    size_t pos;                 /* Index of next rule in 'rules' to dump. */
+};
+
 static void ofport_destroy__(struct ofport *);
 static void ofport_destroy(struct ofport *);
 
@@ -131,6 +145,7 @@ static uint64_t pick_fallback_dpid(void);
 static void ofproto_destroy__(struct ofproto *);
 
 static void ofproto_rule_destroy__(struct rule *);
+static void free_dead_rules(struct ofproto *);
 static void ofproto_rule_send_removed(struct rule *, uint8_t reason);
 
 static void ofopgroup_destroy(struct ofopgroup *);
@@ -321,6 +336,7 @@ ofproto_create(const char *datapath_name, const char *datapath_type,
     ofproto_set_flow_eviction_threshold(ofproto,
                                         OFPROTO_FLOW_EVICTON_THRESHOLD_DEFAULT);
     ofproto->forward_bpdu = false;
+    ofproto->revalidate_delay = 0;
     ofproto->fallback_dpid = pick_fallback_dpid();
     ofproto->mfr_desc = xstrdup(DEFAULT_MFR_DESC);
     ofproto->hw_desc = xstrdup(DEFAULT_HW_DESC);
@@ -336,6 +352,8 @@ ofproto_create(const char *datapath_name, const char *datapath_type,
     list_init(&ofproto->pending);
     ofproto->n_pending = 0;
     hmap_init(&ofproto->deletions);
+    list_init(&ofproto->flow_dumps);
+    list_init(&ofproto->dead_rules);
 
     error = ofproto->ofproto_class->construct(ofproto, &n_tables);
     if (error) {
@@ -427,6 +445,17 @@ ofproto_set_flow_eviction_threshold(struct ofproto *ofproto, unsigned threshold)
     }
 }
 
+/* Sets the maximum number of milliseconds for which 'ofproto' may defer
+ * revalidating its cached flows after a change to the flow table, so that a
+ * burst of flow_mods triggers one revalidation pass instead of one per
+ * flow_mod.  A barrier request always ends the deferral early.  Zero, the
+ * default, disables deferral. */
+void
+ofproto_set_revalidate_delay(struct ofproto *ofproto, unsigned msec)
+{
+    ofproto->revalidate_delay = msec;
+}
+
 /* If forward_bpdu is true, the NORMAL action will forward frames with
  * reserved (e.g. STP) destination Ethernet addresses. if forward_bpdu is false,
  * the NORMAL action will drop these frames. */
@@ -574,6 +603,34 @@ ofproto_port_set_cfm(struct ofproto *ofproto, uint16_t ofp_port,
     }
 }
 
+/* Limits the rate at which packets received on 'ofp_port' within 'ofproto'
+ * that require a flow setup are passed up from the datapath to 'rate' per
+ * second, with bursts of up to 'burst' packets, or removes the limit if 'rate'
+ * is 0.  If 'burst' is 0, the datapath chooses a default burst size. */
+void
+ofproto_port_set_upcall_limit(struct ofproto *ofproto, uint16_t ofp_port,
+                              uint32_t rate, uint32_t burst)
+{
+    struct ofport *ofport;
+    int error;
+
+    ofport = ofproto_get_port(ofproto, ofp_port);
+    if (!ofport) {
+        VLOG_WARN("%s: cannot limit upcalls on nonexistent port %"PRIu16,
+                  ofproto->name, ofp_port);
+        return;
+    }
+
+    error = (ofproto->ofproto_class->set_upcall_limit
+             ? ofproto->ofproto_class->set_upcall_limit(ofport, rate, burst)
+             : EOPNOTSUPP);
+    if (error) {
+        VLOG_WARN_RL(&rl, "%s: upcall limit on port %"PRIu16" (%s) failed "
+                     "(%s)", ofproto->name, ofp_port,
+                     netdev_get_name(ofport->netdev), strerror(error));
+    }
+}
+
 /* Checks the status of LACP negotiation for 'ofp_port' within ofproto.
  * Returns 1 if LACP partner information for 'ofp_port' is up-to-date,
  * 0 if LACP partner information is not current (generally indicating a
@@ -739,12 +796,21 @@ ofproto_destroy__(struct ofproto *ofproto)
 void
 ofproto_destroy(struct ofproto *p)
 {
+    struct ofproto_flow_dump *dump, *next_dump;
     struct ofport *ofport, *next_ofport;
 
     if (!p) {
         return;
     }
 
+    /* Orphan any flow dumps in progress, so that they end early and rules can
+     * be freed immediately. */
+    LIST_FOR_EACH_SAFE (dump, next_dump, node, &p->flow_dumps) {
+        list_remove(&dump->node);
+        dump->ofproto = NULL;
+    }
+    free_dead_rules(p);
+
     ofproto_flush__(p);
     HMAP_FOR_EACH_SAFE (ofport, next_ofport, hmap_node, &p->ports) {
         ofport_destroy(ofport);
@@ -1035,8 +1101,12 @@ ofproto_port_del(struct ofproto *ofproto, uint16_t ofp_port)
  *
  * The caller retains ownership of 'cls_rule' and 'actions'.
  *
+ * Returns false if the flow cannot be added now because a pending operation
+ * on an identical flow must complete first, in which case the caller should
+ * retry later.  Otherwise returns true.
+ *
  * This is a helper function for in-band control and fail-open. */
-void
+bool
 ofproto_add_flow(struct ofproto *ofproto, const struct cls_rule *cls_rule,
                  const union ofp_action *actions, size_t n_actions)
 {
@@ -1053,8 +1123,9 @@ ofproto_add_flow(struct ofproto *ofproto, const struct cls_rule *cls_rule,
         fm.buffer_id = UINT32_MAX;
         fm.actions = (union ofp_action *) actions;
         fm.n_actions = n_actions;
-        add_flow(ofproto, NULL, &fm, NULL);
+        return add_flow(ofproto, NULL, &fm, NULL) != OFPROTO_POSTPONE;
     }
+    return true;
 }
 
 /* Executes the flow modification specified in 'fm'.  Returns 0 on success, an
@@ -1465,12 +1536,37 @@ set_internal_devs_mtu(struct ofproto *p)
 }
 
 static void
-ofproto_rule_destroy__(struct rule *rule)
+ofproto_rule_free(struct rule *rule)
 {
     free(rule->actions);
     rule->ofproto->ofproto_class->rule_dealloc(rule);
 }
 
+static void
+ofproto_rule_destroy__(struct rule *rule)
+{
+    struct ofproto *ofproto = rule->ofproto;
+
+    if (list_is_empty(&ofproto->flow_dumps)) {
+        ofproto_rule_free(rule);
+    } else {
+        /* A flow dump might still refer to 'rule'.  Keep it around until the
+         * dump completes. */
+        list_push_back(&ofproto->dead_rules, &rule->ofproto_node);
+    }
+}
+
+static void
+free_dead_rules(struct ofproto *ofproto)
+{
+    struct rule *rule, *next;
+
+    LIST_FOR_EACH_SAFE (rule, next, ofproto_node, &ofproto->dead_rules) {
+        list_remove(&rule->ofproto_node);
+        ofproto_rule_free(rule);
+    }
+}
+
 /* This function allows an ofproto implementation to destroy any rules that
  * remain when its ->destruct() function is called.  The caller must have
  * already uninitialized any derived members of 'rule' (step 5 described in the
@@ -1967,6 +2063,27 @@ collect_rules_strict(struct ofproto *ofproto, uint8_t table_id,
     return 0;
 }
 
+/* Appends a flow stats reply for 'rule' to 'replies', which should have been
+ * initialized with ofputil_start_stats_reply(). */
+static void
+append_flow_stats(struct rule *rule, struct list *replies)
+{
+    struct ofproto *ofproto = rule->ofproto;
+    struct ofputil_flow_stats fs;
+
+    fs.rule = rule->cr;
+    fs.cookie = rule->flow_cookie;
+    fs.table_id = rule->table_id;
+    calc_flow_duration__(rule->created, &fs.duration_sec, &fs.duration_nsec);
+    fs.idle_timeout = rule->idle_timeout;
+    fs.hard_timeout = rule->hard_timeout;
+    ofproto->ofproto_class->rule_get_stats(rule, &fs.packet_count,
+                                           &fs.byte_count);
+    fs.actions = rule->actions;
+    fs.n_actions = rule->n_actions;
+    ofputil_append_flow_stats_reply(&fs, replies);
+}
+
 static int
 handle_flow_stats_request(struct ofconn *ofconn,
                           const struct ofp_stats_msg *osm)
@@ -1991,26 +2108,89 @@ handle_flow_stats_request(struct ofconn *ofconn,
 
     ofputil_start_stats_reply(osm, &replies);
     LIST_FOR_EACH (rule, ofproto_node, &rules) {
-        struct ofputil_flow_stats fs;
-
-        fs.rule = rule->cr;
-        fs.cookie = rule->flow_cookie;
-        fs.table_id = rule->table_id;
-        calc_flow_duration__(rule->created, &fs.duration_sec,
-                             &fs.duration_nsec);
-        fs.idle_timeout = rule->idle_timeout;
-        fs.hard_timeout = rule->hard_timeout;
-        ofproto->ofproto_class->rule_get_stats(rule, &fs.packet_count,
-                                               &fs.byte_count);
-        fs.actions = rule->actions;
-        fs.n_actions = rule->n_actions;
-        ofputil_append_flow_stats_reply(&fs, &replies);
+        append_flow_stats(rule, &replies);
     }
     ofconn_send_replies(ofconn, &replies);
 
     return 0;
 }
 
+/* Handles an NXST_FLOW_DIGEST or NXST_FLOW_BUCKETS request.  The digests are
+ * computed on demand, so the cost is proportional to the number of flows in
+ * the requested tables, but that is still far cheaper than encoding and
+ * sending every flow. */
+static int
+handle_flow_digest_request(struct ofconn *ofconn,
+                           const struct ofp_stats_msg *osm)
+{
+    struct ofproto *ofproto = ofconn_get_ofproto(ofconn);
+    struct ofputil_flow_digest_request request;
+    struct ofputil_flow_digest_reply reply;
+    struct classifier *cls;
+    struct list replies;
+    struct list rules;
+    struct rule *rule;
+    int error;
+
+    error = ofputil_decode_flow_digest_request(&request, &osm->header);
+    if (error) {
+        return error;
+    }
+
+    /* Gather all the visible rules first, so that we can postpone the request
+     * without side effects if any of them has an operation pending. */
+    list_init(&rules);
+    FOR_EACH_MATCHING_TABLE (cls, request.table_id, ofproto) {
+        struct cls_cursor cursor;
+
+        cls_cursor_init(&cursor, cls, NULL);
+        CLS_CURSOR_FOR_EACH (rule, cr, &cursor) {
+            if (rule->pending) {
+                bitmap_free(request.buckets);
+                return OFPROTO_POSTPONE;
+            }
+            if (!rule_is_hidden(rule)) {
+                list_push_back(&rules, &rule->ofproto_node);
+            }
+        }
+    }
+
+    if (!request.buckets) {
+        reply.flow_count = 0;
+        reply.n_buckets = request.n_buckets;
+        reply.digests = xcalloc(request.n_buckets, sizeof *reply.digests);
+        LIST_FOR_EACH (rule, ofproto_node, &rules) {
+            uint64_t digest;
+            uint32_t hash;
+
+            digest = ofputil_flow_digest(&rule->cr, rule->flow_cookie,
+                                         rule->idle_timeout,
+                                         rule->hard_timeout,
+                                         rule->actions, rule->n_actions,
+                                         &hash);
+            reply.digests[hash & (request.n_buckets - 1)] += digest;
+            reply.flow_count++;
+        }
+        ofconn_send_reply(ofconn,
+                          ofputil_encode_flow_digest_reply(&reply, osm));
+        free(reply.digests);
+    } else {
+        ofputil_start_stats_reply(osm, &replies);
+        LIST_FOR_EACH (rule, ofproto_node, &rules) {
+            uint32_t hash = ofputil_flow_digest_hash(&rule->cr);
+
+            if (bitmap_is_set(request.buckets,
+                              hash & (request.n_buckets - 1))) {
+                append_flow_stats(rule, &replies);
+            }
+        }
+        ofconn_send_replies(ofconn, &replies);
+        bitmap_free(request.buckets);
+    }
+
+    return 0;
+}
+
 static void
 flow_stats_ds(struct rule *rule, struct ds *results)
 {
@@ -2037,12 +2217,25 @@ flow_stats_ds(struct rule *rule, struct ds *results)
     ds_put_cstr(results, "\n");
 }
 
-/* Adds a pretty-printed description of all flows to 'results', including
- * hidden flows (e.g., set up by in-band control). */
-void
-ofproto_get_all_flows(struct ofproto *p, struct ds *results)
+/* Starts a dump of all of the flows in 'p', including hidden flows (e.g., set
+ * up by in-band control).  Use ofproto_flow_dump_next() to obtain the flows
+ * and ofproto_flow_dump_destroy() to free the dump.
+ *
+ * The dump remains valid across calls to ofproto_run() and even if 'p' is
+ * destroyed (in which case the dump ends early). */
+struct ofproto_flow_dump *
+ofproto_flow_dump_start(struct ofproto *p)
 {
+    struct ofproto_flow_dump *dump;
     struct classifier *cls;
+    size_t allocated;
+
+    dump = xmalloc(sizeof *dump);
+    list_push_back(&p->flow_dumps, &dump->node);
+    dump->ofproto = p;
+    dump->rules = NULL;
+    dump->n_rules = allocated = 0;
+    dump->pos = 0;
 
     OFPROTO_FOR_EACH_TABLE (cls, p) {
         struct cls_cursor cursor;
@@ -2050,8 +2243,61 @@ ofproto_get_all_flows(struct ofproto *p, struct ds *results)
 
         cls_cursor_init(&cursor, cls, NULL);
         CLS_CURSOR_FOR_EACH (rule, cr, &cursor) {
+            if (dump->n_rules >= allocated) {
+                dump->rules = x2nrealloc(dump->rules, &allocated,
+                                         sizeof *dump->rules);
+            }
+            dump->rules[dump->n_rules++] = rule;
+        }
+    }
+
+    return dump;
+}
+
+/* Appends a pretty-printed description of the next flow in 'dump' to
+ * 'results' and returns true, or returns false without modifying 'results' if
+ * the dump is complete. */
+bool
+ofproto_flow_dump_next(struct ofproto_flow_dump *dump, struct ds *results)
+{
+    struct ofproto *ofproto = dump->ofproto;
+
+    if (!ofproto) {
+        return false;
+    }
+
+    while (dump->pos < dump->n_rules) {
+        struct rule *rule = dump->rules[dump->pos++];
+        struct cls_rule *cr;
+
+        /* Skip rules deleted since the dump started.  A deleted rule is kept
+         * in 'dead_rules' while dumps are in progress, so 'rule' still points
+         * to a rule, but a rule that is no longer in its classifier. */
+        cr = classifier_find_rule_exactly(&ofproto->tables[rule->table_id],
+                                          &rule->cr);
+        if (cr == &rule->cr) {
             flow_stats_ds(rule, results);
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Frees 'dump', whether it is complete or not. */
+void
+ofproto_flow_dump_destroy(struct ofproto_flow_dump *dump)
+{
+    if (dump) {
+        struct ofproto *ofproto = dump->ofproto;
+
+        if (ofproto) {
+            list_remove(&dump->node);
+            if (list_is_empty(&ofproto->flow_dumps)) {
+                free_dead_rules(ofproto);
+            }
         }
+        free(dump->rules);
+        free(dump);
     }
 }
 
@@ -2675,6 +2921,7 @@ handle_nxt_set_flow_format(struct ofconn *ofconn, const struct ofp_header *oh)
 static int
 handle_barrier_request(struct ofconn *ofconn, const struct ofp_header *oh)
 {
+    struct ofproto *ofproto = ofconn_get_ofproto(ofconn);
     struct ofp_header *ob;
     struct ofpbuf *buf;
 
@@ -2682,6 +2929,10 @@ handle_barrier_request(struct ofconn *ofconn, const struct ofp_header *oh)
         return OFPROTO_POSTPONE;
     }
 
+    if (ofproto->ofproto_class->barrier) {
+        ofproto->ofproto_class->barrier(ofproto);
+    }
+
     ob = make_openflow_xid(sizeof *ob, OFPT_BARRIER_REPLY, oh->xid, &buf);
     ofconn_send_reply(ofconn, buf);
     return 0;
@@ -2754,6 +3005,10 @@ handle_openflow__(struct ofconn *ofconn, const struct ofpbuf *msg)
     case OFPUTIL_NXST_AGGREGATE_REQUEST:
         return handle_aggregate_stats_request(ofconn, msg->data);
 
+    case OFPUTIL_NXST_FLOW_DIGEST_REQUEST:
+    case OFPUTIL_NXST_FLOW_BUCKETS_REQUEST:
+        return handle_flow_digest_request(ofconn, msg->data);
+
     case OFPUTIL_OFPST_TABLE_REQUEST:
         return handle_table_stats_request(ofconn, msg->data);
 
@@ -2784,6 +3039,8 @@ handle_openflow__(struct ofconn *ofconn, const struct ofpbuf *msg)
     case OFPUTIL_NXT_FLOW_REMOVED:
     case OFPUTIL_NXST_FLOW_REPLY:
     case OFPUTIL_NXST_AGGREGATE_REPLY:
+    case OFPUTIL_NXST_FLOW_DIGEST_REPLY:
+    case OFPUTIL_NXST_FLOW_BUCKETS_REPLY:
     default:
         if (VLOG_IS_WARN_ENABLED()) {
             char *s = ofp_to_string(oh, ntohs(oh->length), 2);
@@ -162,6 +162,7 @@ void ofproto_set_extra_in_band_remotes(struct ofproto *,
 void ofproto_set_in_band_queue(struct ofproto *, int queue_id);
 void ofproto_set_flow_eviction_threshold(struct ofproto *, unsigned threshold);
 void ofproto_set_forward_bpdu(struct ofproto *, bool forward_bpdu);
+void ofproto_set_revalidate_delay(struct ofproto *, unsigned msec);
 void ofproto_set_desc(struct ofproto *,
                       const char *mfr_desc, const char *hw_desc,
                       const char *sw_desc, const char *serial_desc,
@@ -179,6 +180,8 @@ void ofproto_port_clear_cfm(struct ofproto *, uint16_t ofp_port);
 void ofproto_port_set_cfm(struct ofproto *, uint16_t ofp_port,
                           const struct cfm_settings *);
 int ofproto_port_is_lacp_current(struct ofproto *, uint16_t ofp_port);
+void ofproto_port_set_upcall_limit(struct ofproto *, uint16_t ofp_port,
+                                   uint32_t rate, uint32_t burst);
 
 /* Configuration of bundles. */
 struct ofproto_bundle_settings {
@@ -232,7 +235,9 @@ bool ofproto_is_mirror_output_bundle(struct ofproto *, void *aux);
 /* Configuration querying. */
 bool ofproto_has_snoops(const struct ofproto *);
 void ofproto_get_snoops(const struct ofproto *, struct sset *);
-void ofproto_get_all_flows(struct ofproto *p, struct ds *);
+struct ofproto_flow_dump *ofproto_flow_dump_start(struct ofproto *);
+bool ofproto_flow_dump_next(struct ofproto_flow_dump *, struct ds *);
+void ofproto_flow_dump_destroy(struct ofproto_flow_dump *);
 void ofproto_get_netflow_ids(const struct ofproto *,
                              uint8_t *engine_type, uint8_t *engine_id);
 int ofproto_port_get_cfm_fault(const struct ofproto *, uint16_t ofp_port);
@@ -32,12 +32,14 @@
 #include "jsonrpc-server.h"
 #include "leak-checker.h"
 #include "list.h"
+#include "memory.h"
 #include "ovsdb.h"
 #include "ovsdb-data.h"
 #include "ovsdb-types.h"
 #include "ovsdb-error.h"
 #include "poll-loop.h"
 #include "process.h"
+#include "profiler.h"
 #include "row.h"
 #include "stream-ssl.h"
 #include "stream.h"
@@ -95,6 +97,8 @@ main(int argc, char *argv[])
     proctitle_init(argc, argv);
     set_program_name(argv[0]);
     stress_init_command();
+    profiler_init_command();
+    memory_init_command();
     signal(SIGPIPE, SIG_IGN);
     process_init();
 
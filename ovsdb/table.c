@@ -299,8 +299,10 @@ ovsdb_table_create(struct ovsdb_table_schema *ts)
     table->indexes = xmalloc(ts->n_indexes * sizeof *table->indexes);
     for (i = 0; i < ts->n_indexes; i++) {
         hmap_init(&table->indexes[i]);
+        hmap_set_incremental(&table->indexes[i], true);
     }
     hmap_init(&table->rows);
+    hmap_set_incremental(&table->rows, true);
 
     return table;
 }
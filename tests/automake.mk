@@ -27,6 +27,8 @@ TESTSUITE_AT = \
 	tests/jsonrpc.at \
 	tests/jsonrpc-py.at \
 	tests/timeval.at \
+	tests/poll-loop.at \
+	tests/vlog.at \
 	tests/lockfile.at \
 	tests/reconnect.at \
 	tests/ofproto-dpif.at \
@@ -70,10 +72,12 @@ lcov_wrappers = \
 	tests/lcov/ovsdb-server \
 	tests/lcov/ovsdb-tool \
 	tests/lcov/test-aes128 \
+	tests/lcov/test-bench \
 	tests/lcov/test-bundle \
 	tests/lcov/test-byte-order \
 	tests/lcov/test-classifier \
 	tests/lcov/test-csum \
+	tests/lcov/test-dpif-bench \
 	tests/lcov/test-file_name \
 	tests/lcov/test-flows \
 	tests/lcov/test-hash \
@@ -86,14 +90,17 @@ lcov_wrappers = \
 	tests/lcov/test-odp \
 	tests/lcov/test-ovsdb \
 	tests/lcov/test-packets \
+	tests/lcov/test-poll-loop \
 	tests/lcov/test-random \
 	tests/lcov/test-reconnect \
+	tests/lcov/test-replay \
 	tests/lcov/test-sha1 \
 	tests/lcov/test-timeval \
 	tests/lcov/test-type-props \
 	tests/lcov/test-unix-socket \
 	tests/lcov/test-uuid \
-	tests/lcov/test-vconn
+	tests/lcov/test-vconn \
+	tests/lcov/test-vlog
 
 $(lcov_wrappers): tests/lcov-wrapper.in
 	@test -d tests/lcov || mkdir tests/lcov
@@ -124,10 +131,12 @@ valgrind_wrappers = \
 	tests/valgrind/ovsdb-server \
 	tests/valgrind/ovsdb-tool \
 	tests/valgrind/test-aes128 \
+	tests/valgrind/test-bench \
 	tests/valgrind/test-bundle \
 	tests/valgrind/test-byte-order \
 	tests/valgrind/test-classifier \
 	tests/valgrind/test-csum \
+	tests/valgrind/test-dpif-bench \
 	tests/valgrind/test-file_name \
 	tests/valgrind/test-flows \
 	tests/valgrind/test-hash \
@@ -141,14 +150,17 @@ valgrind_wrappers = \
 	tests/valgrind/test-openflowd \
 	tests/valgrind/test-ovsdb \
 	tests/valgrind/test-packets \
+	tests/valgrind/test-poll-loop \
 	tests/valgrind/test-random \
 	tests/valgrind/test-reconnect \
+	tests/valgrind/test-replay \
 	tests/valgrind/test-sha1 \
 	tests/valgrind/test-timeval \
 	tests/valgrind/test-type-props \
 	tests/valgrind/test-unix-socket \
 	tests/valgrind/test-uuid \
-	tests/valgrind/test-vconn
+	tests/valgrind/test-vconn \
+	tests/valgrind/test-vlog
 
 $(valgrind_wrappers): tests/valgrind-wrapper.in
 	@test -d tests/valgrind || mkdir tests/valgrind
@@ -193,6 +205,21 @@ noinst_PROGRAMS += tests/test-aes128
 tests_test_aes128_SOURCES = tests/test-aes128.c
 tests_test_aes128_LDADD = lib/libopenvswitch.a
 
+noinst_PROGRAMS += tests/test-bench
+tests_test_bench_SOURCES = tests/test-bench.c
+tests_test_bench_LDADD = lib/libopenvswitch.a
+
+# "make bench" runs the micro-benchmarks and prints their results as JSON.
+# Set BENCHFLAGS to pass options, e.g. BENCHFLAGS='--pcap=FILE hmap/*'.
+bench: tests/test-bench
+	@tests/test-bench $(BENCHFLAGS)
+
+# "make bench-dpif" measures userspace datapath flow setup and forwarding
+# rates, e.g. BENCHFLAGS='--flows=100000 --packets=10000000'.
+bench-dpif: tests/test-dpif-bench
+	@tests/test-dpif-bench $(BENCHFLAGS)
+.PHONY: bench bench-dpif
+
 noinst_PROGRAMS += tests/test-bundle
 tests_test_bundle_SOURCES = tests/test-bundle.c
 tests_test_bundle_LDADD = lib/libopenvswitch.a
@@ -205,6 +232,14 @@ noinst_PROGRAMS += tests/test-csum
 tests_test_csum_SOURCES = tests/test-csum.c
 tests_test_csum_LDADD = lib/libopenvswitch.a
 
+noinst_PROGRAMS += tests/test-dpif-bench
+tests_test_dpif_bench_SOURCES = tests/test-dpif-bench.c
+tests_test_dpif_bench_LDADD = \
+	ofproto/libofproto.a \
+	lib/libsflow.a \
+	lib/libopenvswitch.a \
+	$(SSL_LIBS)
+
 noinst_PROGRAMS += tests/test-file_name
 tests_test_file_name_SOURCES = tests/test-file_name.c
 tests_test_file_name_LDADD = lib/libopenvswitch.a
@@ -288,6 +323,14 @@ tests/idltest.ovsidl: $(IDLTEST_IDL_FILES)
 
 tests/idltest.c: tests/idltest.h
 
+noinst_PROGRAMS += tests/test-replay
+tests_test_replay_SOURCES = tests/test-replay.c
+tests_test_replay_LDADD = \
+	ofproto/libofproto.a \
+	lib/libsflow.a \
+	lib/libopenvswitch.a \
+	$(SSL_LIBS)
+
 noinst_PROGRAMS += tests/test-reconnect
 tests_test_reconnect_SOURCES = tests/test-reconnect.c
 tests_test_reconnect_LDADD = lib/libopenvswitch.a
@@ -300,6 +343,14 @@ noinst_PROGRAMS += tests/test-timeval
 tests_test_timeval_SOURCES = tests/test-timeval.c
 tests_test_timeval_LDADD = lib/libopenvswitch.a
 
+noinst_PROGRAMS += tests/test-poll-loop
+tests_test_poll_loop_SOURCES = tests/test-poll-loop.c
+tests_test_poll_loop_LDADD = lib/libopenvswitch.a
+
+noinst_PROGRAMS += tests/test-vlog
+tests_test_vlog_SOURCES = tests/test-vlog.c
+tests_test_vlog_LDADD = lib/libopenvswitch.a
+
 noinst_PROGRAMS += tests/test-strtok_r
 tests_test_strtok_r_SOURCES = tests/test-strtok_r.c
 
@@ -328,7 +379,8 @@ EXTRA_DIST += \
 	tests/test-json.py \
 	tests/test-jsonrpc.py \
 	tests/test-ovsdb.py \
-	tests/test-reconnect.py
+	tests/test-reconnect.py \
+	tests/test-unixctl-stall.py
 
 if HAVE_OPENSSL
 TESTPKI_FILES = \
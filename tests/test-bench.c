@@ -0,0 +1,1088 @@
+/*
+ * Copyright (c) 2011 Nicira Networks.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Micro-benchmarks for hot-path library code.
+ *
+ * Each benchmark runs a fixed number of operations per repetition.  After a
+ * few warmup repetitions, whose times are discarded, the time per operation
+ * of each repetition is measured and summarized as JSON on stdout, so that
+ * results from different builds can be compared mechanically. */
+
+#include <config.h>
+
+#include <errno.h>
+#include <fnmatch.h>
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "byte-order.h"
+#include "classifier.h"
+#include "command-line.h"
+#include "csum.h"
+#include "dynamic-string.h"
+#include "flow.h"
+#include "hash.h"
+#include "hmap.h"
+#include "json.h"
+#include "odp-util.h"
+#include "ofpbuf.h"
+#include "ovsdb-data.h"
+#include "ovsdb-error.h"
+#include "ovsdb-types.h"
+#include "packets.h"
+#include "pcap.h"
+#include "random.h"
+#include "util.h"
+
+#undef NDEBUG
+#include <assert.h>
+
+/* A benchmark. */
+struct benchmark {
+    const char *name;
+    unsigned int n_ops;         /* Operations per repetition. */
+    void (*setup)(unsigned int n_ops);  /* Optional. */
+    void (*run)(unsigned int n_ops);
+    void (*teardown)(void);     /* Optional. */
+};
+
+/* Command-line options. */
+static int n_repetitions = 10;
+static int n_warmup = 2;
+static bool quick;
+static const char *pcap_file_name;
+
+/* Results are stored here so that the compiler cannot optimize the work
+ * away. */
+static volatile size_t sink;
+
+static void usage(void) NO_RETURN;
+static void parse_options(int argc, char *argv[]);
+
+/* Returns the current time on the monotonic clock, in nanoseconds.  This does
+ * not use time_msec() and friends because they only have millisecond
+ * resolution and are normally cached. */
+static long long int
+nsec_now(void)
+{
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts)) {
+        ovs_fatal(errno, "clock_gettime failed");
+    }
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static double
+round_tenth(double x)
+{
+    return floor(x * 10.0 + 0.5) / 10.0;
+}
+
+/* Test data shared among benchmarks. */
+
+/* Packets for flow/extract and the flows extracted from them. */
+static struct ofpbuf **packets;
+static struct flow *flows;
+static size_t n_packets;
+
+static void
+random_flow(struct flow *flow)
+{
+    static const uint8_t protos[] = { IPPROTO_TCP, IPPROTO_UDP, IPPROTO_ICMP };
+
+    memset(flow, 0, sizeof *flow);
+    random_bytes(flow->dl_src, sizeof flow->dl_src);
+    random_bytes(flow->dl_dst, sizeof flow->dl_dst);
+    flow->in_port = random_range(64);
+    if (random_range(10)) {
+        flow->dl_type = htons(ETH_TYPE_IP);
+        flow->nw_src = htonl(random_uint32());
+        flow->nw_dst = htonl(random_uint32());
+        flow->nw_proto = protos[random_range(ARRAY_SIZE(protos))];
+        flow->tp_src = htons(flow->nw_proto == IPPROTO_ICMP
+                             ? random_range(16) : random_uint16());
+        flow->tp_dst = htons(flow->nw_proto == IPPROTO_ICMP
+                             ? random_range(16) : random_uint16());
+    } else {
+        flow->dl_type = htons(ETH_TYPE_ARP);
+        flow->nw_proto = ARP_OP_REQUEST;
+        flow->nw_src = htonl(random_uint32());
+        flow->nw_dst = htonl(random_uint32());
+        memcpy(flow->arp_sha, flow->dl_src, ETH_ADDR_LEN);
+    }
+    if (!random_range(4)) {
+        flow->vlan_tci = htons(VLAN_CFI | random_range(4096));
+    }
+}
+
+/* Reads packets from the pcap file specified on the command line, if any, or
+ * otherwise composes packets with random headers. */
+static void
+load_packets(void)
+{
+    size_t allocated = 0;
+    size_t i;
+
+    if (packets) {
+        return;
+    }
+
+    if (pcap_file_name) {
+        FILE *pcap = fopen(pcap_file_name, "rb");
+        int retval;
+
+        if (!pcap) {
+            ovs_fatal(errno, "failed to open %s", pcap_file_name);
+        }
+        retval = pcap_read_header(pcap);
+        if (retval) {
+            ovs_fatal(retval > 0 ? retval : 0, "reading pcap header failed");
+        }
+        for (;;) {
+            struct ofpbuf *packet;
+
+            retval = pcap_read(pcap, &packet);
+            if (retval == EOF) {
+                break;
+            } else if (retval) {
+                ovs_fatal(retval, "error reading pcap file");
+            }
+            if (n_packets >= allocated) {
+                packets = x2nrealloc(packets, &allocated, sizeof *packets);
+            }
+            packets[n_packets++] = packet;
+        }
+        fclose(pcap);
+        if (!n_packets) {
+            ovs_fatal(0, "%s: no packets", pcap_file_name);
+        }
+    } else {
+        n_packets = 1000;
+        packets = xmalloc(n_packets * sizeof *packets);
+        for (i = 0; i < n_packets; i++) {
+            struct flow flow;
+
+            random_flow(&flow);
+            packets[i] = ofpbuf_new(128);
+            flow_compose(packets[i], &flow);
+        }
+    }
+
+    flows = xmalloc(n_packets * sizeof *flows);
+    for (i = 0; i < n_packets; i++) {
+        flow_extract(packets[i], 0, i % 64, &flows[i]);
+    }
+}
+
+/* hmap. */
+
+struct element {
+    struct hmap_node node;
+    uint32_t value;
+};
+
+static struct element *elements;
+static struct hmap hmap;
+
+static void
+hmap_setup(unsigned int n)
+{
+    unsigned int i;
+
+    elements = xmalloc(n * sizeof *elements);
+    for (i = 0; i < n; i++) {
+        elements[i].value = random_uint32();
+    }
+    hmap_init(&hmap);
+}
+
+static void
+hmap_teardown(void)
+{
+    hmap_destroy(&hmap);
+    free(elements);
+}
+
+static void
+hmap_insert_run(unsigned int n)
+{
+    unsigned int i;
+
+    hmap_destroy(&hmap);
+    hmap_init(&hmap);
+    for (i = 0; i < n; i++) {
+        hmap_insert(&hmap, &elements[i].node,
+                    hash_int(elements[i].value, 0));
+    }
+}
+
+static void
+hmap_lookup_setup(unsigned int n)
+{
+    hmap_setup(n);
+    hmap_insert_run(n);
+}
+
+static void
+hmap_lookup_run(unsigned int n)
+{
+    size_t found = 0;
+    unsigned int i;
+
+    for (i = 0; i < n; i++) {
+        uint32_t value = elements[i].value;
+        struct element *e;
+
+        HMAP_FOR_EACH_WITH_HASH (e, node, hash_int(value, 0), &hmap) {
+            if (e->value == value) {
+                found++;
+                break;
+            }
+        }
+    }
+    assert(found == n);
+    sink = found;
+}
+
+/* Hash functions. */
+
+static uint32_t hash_data[64];
+
+static void
+hash_setup(unsigned int n OVS_UNUSED)
+{
+    random_bytes(hash_data, sizeof hash_data);
+}
+
+static void
+hash_bytes_run(unsigned int n)
+{
+    uint32_t hash = 0;
+    unsigned int i;
+
+    for (i = 0; i < n; i++) {
+        hash = hash_bytes(hash_data, 64, hash);
+    }
+    sink = hash;
+}
+
+static void
+hash_words_run(unsigned int n)
+{
+    uint32_t hash = 0;
+    unsigned int i;
+
+    for (i = 0; i < n; i++) {
+        hash = hash_words(hash_data, 16, hash);
+    }
+    sink = hash;
+}
+
+static void
+hash_int_run(unsigned int n)
+{
+    uint32_t hash = 0;
+    unsigned int i;
+
+    for (i = 0; i < n; i++) {
+        hash = hash_int(i, hash);
+    }
+    sink = hash;
+}
+
+static void
+flow_setup(unsigned int n OVS_UNUSED)
+{
+    load_packets();
+}
+
+static void
+flow_hash_run(unsigned int n)
+{
+    size_t hash = 0;
+    unsigned int i;
+
+    for (i = 0; i < n; i++) {
+        hash += flow_hash(&flows[i % n_packets], 0);
+    }
+    sink = hash;
+}
+
+/* flow_extract(). */
+
+static void
+flow_extract_run(unsigned int n)
+{
+    size_t sum = 0;
+    unsigned int i;
+
+    for (i = 0; i < n; i++) {
+        struct flow flow;
+
+        flow_extract(packets[i % n_packets], 0, 1, &flow);
+        sum += flow.tp_src;
+    }
+    sink = sum;
+}
+
+/* Classifier. */
+
+/* Number of rules in the classifier for classifier/lookup. */
+#define N_CLS_RULES 10000
+
+static struct classifier cls;
+static struct cls_rule *cls_rules;
+static unsigned int n_cls_rules;
+
+/* Initializes 'rule' as the 'i'th of a set of rules that use four different
+ * sets of wildcards and in which no two rules have the same match. */
+static void
+make_cls_rule(struct cls_rule *rule, unsigned int i)
+{
+    uint8_t mac[ETH_ADDR_LEN];
+
+    cls_rule_init_catchall(rule, random_range(8));
+    switch (i % 4) {
+    case 0:
+        cls_rule_set_dl_type(rule, htons(ETH_TYPE_IP));
+        cls_rule_set_nw_src(rule, htonl(i));
+        cls_rule_set_nw_dst(rule, htonl(random_uint32()));
+        break;
+
+    case 1:
+        cls_rule_set_dl_type(rule, htons(ETH_TYPE_IP));
+        cls_rule_set_nw_dst_masked(rule, htonl(i << 8), htonl(0xffffff00));
+        cls_rule_set_nw_proto(rule, IPPROTO_TCP);
+        cls_rule_set_tp_dst(rule, htons(80));
+        break;
+
+    case 2:
+        memset(mac, 0, sizeof mac);
+        memcpy(mac + 2, &i, sizeof i);
+        cls_rule_set_in_port(rule, i % 64);
+        cls_rule_set_dl_dst(rule, mac);
+        break;
+
+    case 3:
+        cls_rule_set_tun_id(rule, htonll(i));
+        break;
+    }
+}
+
+static void
+cls_setup(unsigned int n)
+{
+    unsigned int i;
+
+    n_cls_rules = MAX(n, N_CLS_RULES);
+    cls_rules = xmalloc(n_cls_rules * sizeof *cls_rules);
+    for (i = 0; i < n_cls_rules; i++) {
+        make_cls_rule(&cls_rules[i], i);
+    }
+    classifier_init(&cls);
+}
+
+static void
+cls_teardown(void)
+{
+    classifier_destroy(&cls);
+    free(cls_rules);
+}
+
+static void
+cls_insert_run(unsigned int n)
+{
+    unsigned int i;
+
+    for (i = 0; i < n; i++) {
+        classifier_insert(&cls, &cls_rules[i]);
+    }
+    for (i = 0; i < n; i++) {
+        classifier_remove(&cls, &cls_rules[i]);
+    }
+}
+
+static void
+cls_lookup_setup(unsigned int n)
+{
+    unsigned int i;
+
+    cls_setup(n);
+    for (i = 0; i < N_CLS_RULES; i++) {
+        classifier_insert(&cls, &cls_rules[i]);
+    }
+    load_packets();
+}
+
+static void
+cls_lookup_run(unsigned int n)
+{
+    size_t found = 0;
+    unsigned int i;
+
+    /* Alternate between flows that probably match no rule and flows that
+     * match a rule. */
+    for (i = 0; i < n; i++) {
+        struct flow flow;
+
+        if (i % 2) {
+            flow = flows[i % n_packets];
+        } else {
+            flow = cls_rules[i % N_CLS_RULES].flow;
+            flow.tp_src = htons(i);
+        }
+        found += classifier_lookup(&cls, &flow) != NULL;
+    }
+    sink = found;
+}
+
+static void
+cls_lookup_teardown(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < N_CLS_RULES; i++) {
+        classifier_remove(&cls, &cls_rules[i]);
+    }
+    cls_teardown();
+}
+
+/* JSON. */
+
+static char *json_text;
+static struct json *json_doc;
+
+/* Composes an OVSDB "transact" request with 'n_ops' "insert" operations, as a
+ * representative JSON document. */
+static void
+json_setup(unsigned int n OVS_UNUSED)
+{
+    struct ds s;
+    int i;
+
+    ds_init(&s);
+    ds_put_cstr(&s, "{\"method\":\"transact\",\"id\":1,"
+                "\"params\":[\"Open_vSwitch\"");
+    for (i = 0; i < 100; i++) {
+        ds_put_format(&s, ",{\"op\":\"insert\",\"table\":\"Interface\","
+                      "\"uuid-name\":\"row%d\",\"row\":{"
+                      "\"name\":\"eth%d\",\"type\":\"internal\","
+                      "\"ofport\":%d,\"mtu\":1500,\"link_speed\":1.0e10,"
+                      "\"admin_state\":\"up\",\"other_config\":[\"map\","
+                      "[[\"key1\",\"value1\"],[\"key2\",\"value2\"]]],"
+                      "\"statistics\":[\"map\",[[\"rx_packets\",%d],"
+                      "[\"tx_packets\",%d]]]}}",
+                      i, i, i, i * 1000, i * 2000);
+    }
+    ds_put_cstr(&s, "]}");
+    json_text = ds_steal_cstr(&s);
+    json_doc = json_from_string(json_text);
+    assert(json_doc->type == JSON_OBJECT);
+}
+
+static void
+json_teardown(void)
+{
+    json_destroy(json_doc);
+    free(json_text);
+}
+
+static void
+json_parse_run(unsigned int n)
+{
+    unsigned int i;
+
+    for (i = 0; i < n; i++) {
+        json_destroy(json_from_string(json_text));
+    }
+}
+
+static void
+json_serialize_run(unsigned int n)
+{
+    size_t length = 0;
+    unsigned int i;
+
+    for (i = 0; i < n; i++) {
+        char *s = json_to_string(json_doc, 0);
+        length += strlen(s);
+        free(s);
+    }
+    sink = length;
+}
+
+/* ovsdb_datum. */
+
+static struct ovsdb_type datum_type;
+static struct json *datum_json;
+static struct ovsdb_datum datum, datum2;
+
+/* Sets up a map from strings to integers with 100 pairs, in the form of a
+ * JSON representation and two identical datums. */
+static void
+datum_setup(unsigned int n OVS_UNUSED)
+{
+    struct json *type_json, *pairs;
+    int i;
+
+    type_json = json_from_string("{\"key\":\"string\",\"value\":\"integer\","
+                                 "\"min\":0,\"max\":\"unlimited\"}");
+    ovsdb_error_assert(ovsdb_type_from_json(&datum_type, type_json));
+    json_destroy(type_json);
+
+    pairs = json_array_create_empty();
+    for (i = 99; i >= 0; i--) {
+        char key[16];
+
+        sprintf(key, "key%d", i);
+        json_array_add(pairs,
+                       json_array_create_2(json_string_create(key),
+                                           json_integer_create(i)));
+    }
+    datum_json = json_array_create_2(json_string_create("map"), pairs);
+
+    ovsdb_error_assert(ovsdb_datum_from_json(&datum, &datum_type, datum_json,
+                                             NULL));
+    ovsdb_datum_clone(&datum2, &datum, &datum_type);
+}
+
+static void
+datum_teardown(void)
+{
+    ovsdb_datum_destroy(&datum, &datum_type);
+    ovsdb_datum_destroy(&datum2, &datum_type);
+    json_destroy(datum_json);
+    ovsdb_type_destroy(&datum_type);
+}
+
+static void
+datum_from_json_run(unsigned int n)
+{
+    unsigned int i;
+
+    for (i = 0; i < n; i++) {
+        struct ovsdb_datum d;
+
+        ovsdb_error_assert(ovsdb_datum_from_json(&d, &datum_type, datum_json,
+                                                 NULL));
+        ovsdb_datum_destroy(&d, &datum_type);
+    }
+}
+
+static void
+datum_to_json_run(unsigned int n)
+{
+    unsigned int i;
+
+    for (i = 0; i < n; i++) {
+        json_destroy(ovsdb_datum_to_json(&datum, &datum_type));
+    }
+}
+
+static void
+datum_compare_run(unsigned int n)
+{
+    int sum = 0;
+    unsigned int i;
+
+    for (i = 0; i < n; i++) {
+        sum += ovsdb_datum_compare_3way(&datum, &datum2, &datum_type);
+    }
+    assert(!sum);
+    sink = sum;
+}
+
+static void
+datum_hash_run(unsigned int n)
+{
+    uint32_t hash = 0;
+    unsigned int i;
+
+    for (i = 0; i < n; i++) {
+        hash = ovsdb_datum_hash(&datum, &datum_type, hash);
+    }
+    sink = hash;
+}
+
+/* odp-util flow key conversion. */
+
+static struct ofpbuf *odp_keys;
+
+static void
+odp_setup(unsigned int n OVS_UNUSED)
+{
+    size_t i;
+
+    load_packets();
+    odp_keys = xmalloc(n_packets * sizeof *odp_keys);
+    for (i = 0; i < n_packets; i++) {
+        ofpbuf_init(&odp_keys[i], 0);
+        odp_flow_key_from_flow(&odp_keys[i], &flows[i]);
+    }
+}
+
+static void
+odp_teardown(void)
+{
+    size_t i;
+
+    for (i = 0; i < n_packets; i++) {
+        ofpbuf_uninit(&odp_keys[i]);
+    }
+    free(odp_keys);
+}
+
+static void
+odp_from_flow_run(unsigned int n)
+{
+    uint64_t stub[1024 / 8];
+    size_t size = 0;
+    unsigned int i;
+
+    for (i = 0; i < n; i++) {
+        struct ofpbuf key;
+
+        ofpbuf_use_stack(&key, stub, sizeof stub);
+        odp_flow_key_from_flow(&key, &flows[i % n_packets]);
+        size += key.size;
+    }
+    sink = size;
+}
+
+static void
+odp_to_flow_run(unsigned int n)
+{
+    size_t sum = 0;
+    unsigned int i;
+
+    for (i = 0; i < n; i++) {
+        const struct ofpbuf *key = &odp_keys[i % n_packets];
+        struct flow flow;
+
+        if (!odp_flow_key_to_flow(key->data, key->size, &flow)) {
+            sum += flow.in_port;
+        }
+    }
+    sink = sum;
+}
+
+/* Checksums. */
+
+static uint8_t csum_data[1500];
+
+static void
+csum_setup(unsigned int n OVS_UNUSED)
+{
+    random_bytes(csum_data, sizeof csum_data);
+}
+
+static void
+csum_run(unsigned int n)
+{
+    size_t sum = 0;
+    unsigned int i;
+
+    for (i = 0; i < n; i++) {
+        sum += csum(csum_data, sizeof csum_data);
+    }
+    sink = sum;
+}
+
+static void
+csum_recalc32_run(unsigned int n)
+{
+    ovs_be16 sum = htons(0x1234);
+    unsigned int i;
+
+    for (i = 0; i < n; i++) {
+        sum = recalc_csum32(sum, htonl(i), htonl(i + 1));
+    }
+    sink = sum;
+}
+
+/* pcap files. */
+
+static char pcap_tmp_name[] = "/tmp/test-bench-pcap.XXXXXX";
+
+static void
+pcap_setup(unsigned int n OVS_UNUSED)
+{
+    struct pcap_writer *writer;
+    size_t i;
+    int error;
+    int fd;
+
+    load_packets();
+    strcpy(pcap_tmp_name, "/tmp/test-bench-pcap.XXXXXX");
+    fd = mkstemp(pcap_tmp_name);
+    if (fd < 0) {
+        ovs_fatal(errno, "mkstemp failed");
+    }
+    close(fd);
+
+    error = pcap_writer_open(pcap_tmp_name, &writer);
+    if (error) {
+        ovs_fatal(error, "%s: open failed", pcap_tmp_name);
+    }
+    for (i = 0; i < n_packets; i++) {
+        pcap_writer_put(writer, packets[i]->data, packets[i]->size, 0);
+    }
+    error = pcap_writer_close(writer);
+    if (error) {
+        ovs_fatal(error, "%s: write failed", pcap_tmp_name);
+    }
+}
+
+static void
+pcap_teardown(void)
+{
+    unlink(pcap_tmp_name);
+}
+
+static void
+pcap_read_stdio_run(unsigned int n)
+{
+    FILE *file = fopen(pcap_tmp_name, "rb");
+    size_t size = 0;
+    unsigned int i;
+
+    pcap_read_header(file);
+    for (i = 0; i < n; i++) {
+        struct ofpbuf *packet;
+
+        if (pcap_read(file, &packet)) {
+            fseek(file, 0, SEEK_SET);
+            pcap_read_header(file);
+            pcap_read(file, &packet);
+        }
+        size += packet->size;
+        ofpbuf_delete(packet);
+    }
+    fclose(file);
+    sink = size;
+}
+
+static void
+pcap_read_mmap_run(unsigned int n)
+{
+    struct pcap_reader *reader;
+    size_t size = 0;
+    unsigned int i;
+
+    pcap_reader_open(pcap_tmp_name, &reader);
+    for (i = 0; i < n; i++) {
+        struct pcap_packet packet;
+
+        if (pcap_reader_next(reader, &packet)) {
+            pcap_reader_rewind(reader);
+            pcap_reader_next(reader, &packet);
+        }
+        size += packet.size;
+    }
+    pcap_reader_close(reader);
+    sink = size;
+}
+
+static void
+pcap_write_stdio_run(unsigned int n)
+{
+    FILE *file = fopen(pcap_tmp_name, "wb");
+    unsigned int i;
+
+    pcap_write_header(file);
+    for (i = 0; i < n; i++) {
+        pcap_write(file, packets[i % n_packets]);
+        fflush(file);
+    }
+    fclose(file);
+}
+
+static void
+pcap_write_buffered_run(unsigned int n)
+{
+    struct pcap_writer *writer;
+    unsigned int i;
+
+    pcap_writer_open(pcap_tmp_name, &writer);
+    for (i = 0; i < n; i++) {
+        const struct ofpbuf *packet = packets[i % n_packets];
+        pcap_writer_put(writer, packet->data, packet->size, 0);
+    }
+    pcap_writer_close(writer);
+}
+
+static const struct benchmark all_benchmarks[] = {
+    { "hmap/insert", 100000, hmap_setup, hmap_insert_run, hmap_teardown },
+    { "hmap/lookup", 100000, hmap_lookup_setup, hmap_lookup_run,
+      hmap_teardown },
+    { "hash/bytes-64", 1000000, hash_setup, hash_bytes_run, NULL },
+    { "hash/words-16", 1000000, hash_setup, hash_words_run, NULL },
+    { "hash/int", 10000000, NULL, hash_int_run, NULL },
+    { "hash/flow", 1000000, flow_setup, flow_hash_run, NULL },
+    { "flow/extract", 1000000, flow_setup, flow_extract_run, NULL },
+    { "classifier/insert", 10000, cls_setup, cls_insert_run, cls_teardown },
+    { "classifier/lookup", 100000, cls_lookup_setup, cls_lookup_run,
+      cls_lookup_teardown },
+    { "json/parse", 100, json_setup, json_parse_run, json_teardown },
+    { "json/serialize", 100, json_setup, json_serialize_run, json_teardown },
+    { "ovsdb-datum/from-json", 10000, datum_setup, datum_from_json_run,
+      datum_teardown },
+    { "ovsdb-datum/to-json", 10000, datum_setup, datum_to_json_run,
+      datum_teardown },
+    { "ovsdb-datum/compare", 100000, datum_setup, datum_compare_run,
+      datum_teardown },
+    { "ovsdb-datum/hash", 100000, datum_setup, datum_hash_run,
+      datum_teardown },
+    { "odp/key-from-flow", 1000000, odp_setup, odp_from_flow_run,
+      odp_teardown },
+    { "odp/key-to-flow", 1000000, odp_setup, odp_to_flow_run, odp_teardown },
+    { "csum/1500", 100000, csum_setup, csum_run, NULL },
+    { "csum/recalc32", 10000000, NULL, csum_recalc32_run, NULL },
+    { "pcap/read-stdio", 100000, pcap_setup, pcap_read_stdio_run,
+      pcap_teardown },
+    { "pcap/read-mmap", 100000, pcap_setup, pcap_read_mmap_run,
+      pcap_teardown },
+    { "pcap/write-stdio", 10000, pcap_setup, pcap_write_stdio_run,
+      pcap_teardown },
+    { "pcap/write-buffered", 10000, pcap_setup, pcap_write_buffered_run,
+      pcap_teardown },
+};
+
+static int
+compare_doubles(const void *a_, const void *b_)
+{
+    const double *a = a_;
+    const double *b = b_;
+    return *a < *b ? -1 : *a > *b;
+}
+
+/* Runs 'b' and returns a JSON object that summarizes its results. */
+static struct json *
+run_benchmark(const struct benchmark *b)
+{
+    unsigned int n_ops = quick ? MAX(b->n_ops / 100, 1) : b->n_ops;
+    double *ns_per_op = xmalloc(n_repetitions * sizeof *ns_per_op);
+    double sum, mean, variance, median;
+    struct json *stats, *result;
+    int i;
+
+    random_set_seed(0x2b3c4d5e);
+    if (b->setup) {
+        b->setup(n_ops);
+    }
+    for (i = 0; i < n_warmup; i++) {
+        b->run(n_ops);
+    }
+    for (i = 0; i < n_repetitions; i++) {
+        long long int start = nsec_now();
+        b->run(n_ops);
+        ns_per_op[i] = (double) (nsec_now() - start) / n_ops;
+    }
+    if (b->teardown) {
+        b->teardown();
+    }
+
+    sum = 0.0;
+    for (i = 0; i < n_repetitions; i++) {
+        sum += ns_per_op[i];
+    }
+    mean = sum / n_repetitions;
+
+    variance = 0.0;
+    for (i = 0; i < n_repetitions; i++) {
+        variance += (ns_per_op[i] - mean) * (ns_per_op[i] - mean);
+    }
+    variance = n_repetitions > 1 ? variance / (n_repetitions - 1) : 0.0;
+
+    qsort(ns_per_op, n_repetitions, sizeof *ns_per_op, compare_doubles);
+    median = (n_repetitions % 2
+              ? ns_per_op[n_repetitions / 2]
+              : (ns_per_op[n_repetitions / 2 - 1]
+                 + ns_per_op[n_repetitions / 2]) / 2.0);
+
+    stats = json_object_create();
+    json_object_put(stats, "mean", json_real_create(round_tenth(mean)));
+    json_object_put(stats, "median", json_real_create(round_tenth(median)));
+    json_object_put(stats, "min", json_real_create(round_tenth(ns_per_op[0])));
+    json_object_put(stats, "max", json_real_create(
+                        round_tenth(ns_per_op[n_repetitions - 1])));
+    json_object_put(stats, "stddev",
+                    json_real_create(round_tenth(sqrt(variance))));
+
+    result = json_object_create();
+    json_object_put_string(result, "name", b->name);
+    json_object_put(result, "ops", json_integer_create(n_ops));
+    json_object_put(result, "ns_per_op", stats);
+    json_object_put(result, "rsd_percent",
+                    json_real_create(mean > 0
+                                     ? round_tenth(100.0 * sqrt(variance)
+                                                   / mean)
+                                     : 0.0));
+
+    free(ns_per_op);
+    return result;
+}
+
+/* Returns true if 'b' should run, given the 'n_patterns' glob patterns in
+ * 'patterns'. */
+static bool
+benchmark_selected(const struct benchmark *b, char *patterns[],
+                   int n_patterns)
+{
+    int i;
+
+    if (!n_patterns) {
+        return true;
+    }
+    for (i = 0; i < n_patterns; i++) {
+        if (!fnmatch(patterns[i], b->name, 0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct json *results, *report;
+    char *s;
+    size_t i;
+
+    set_program_name(argv[0]);
+    parse_options(argc, argv);
+
+    results = json_array_create_empty();
+    for (i = 0; i < ARRAY_SIZE(all_benchmarks); i++) {
+        const struct benchmark *b = &all_benchmarks[i];
+
+        if (benchmark_selected(b, argv + optind, argc - optind)) {
+            json_array_add(results, run_benchmark(b));
+        }
+    }
+
+    report = json_object_create();
+    json_object_put_string(report, "version", VERSION);
+    json_object_put(report, "repetitions", json_integer_create(n_repetitions));
+    json_object_put(report, "warmup", json_integer_create(n_warmup));
+    json_object_put(report, "quick", json_boolean_create(quick));
+    json_object_put(report, "benchmarks", results);
+
+    s = json_to_string(report, JSSF_PRETTY | JSSF_SORT);
+    puts(s);
+    free(s);
+    json_destroy(report);
+
+    return 0;
+}
+
+static void
+parse_options(int argc, char *argv[])
+{
+    enum {
+        OPT_PCAP = UCHAR_MAX + 1,
+        OPT_QUICK,
+        OPT_LIST
+    };
+    static struct option long_options[] = {
+        {"repetitions", required_argument, NULL, 'r'},
+        {"warmup", required_argument, NULL, 'w'},
+        {"pcap", required_argument, NULL, OPT_PCAP},
+        {"quick", no_argument, NULL, OPT_QUICK},
+        {"list", no_argument, NULL, OPT_LIST},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    char *short_options = long_options_to_short_options(long_options);
+
+    for (;;) {
+        size_t i;
+        int c;
+
+        c = getopt_long(argc, argv, short_options, long_options, NULL);
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+        case 'r':
+            n_repetitions = atoi(optarg);
+            if (n_repetitions < 1) {
+                ovs_fatal(0, "--repetitions argument must be positive");
+            }
+            break;
+
+        case 'w':
+            n_warmup = atoi(optarg);
+            if (n_warmup < 0) {
+                ovs_fatal(0, "--warmup argument must not be negative");
+            }
+            break;
+
+        case OPT_PCAP:
+            pcap_file_name = optarg;
+            break;
+
+        case OPT_QUICK:
+            quick = true;
+            break;
+
+        case OPT_LIST:
+            for (i = 0; i < ARRAY_SIZE(all_benchmarks); i++) {
+                printf("%s\n", all_benchmarks[i].name);
+            }
+            exit(EXIT_SUCCESS);
+
+        case 'h':
+            usage();
+
+        case '?':
+            exit(EXIT_FAILURE);
+
+        default:
+            abort();
+        }
+    }
+    free(short_options);
+}
+
+static void
+usage(void)
+{
+    printf("%s: micro-benchmarks for Open vSwitch library code\n"
+           "usage: %s [OPTIONS] [PATTERN...]\n"
+           "Runs the benchmarks whose names match any PATTERN (a shell glob),\n"
+           "or all of them if no PATTERN is given, and prints the results\n"
+           "as JSON.\n"
+           "\nOptions:\n"
+           "  -r, --repetitions=N     time N repetitions (default: 10)\n"
+           "  -w, --warmup=N          run N untimed repetitions first "
+           "(default: 2)\n"
+           "  --pcap=FILE             use packets from FILE for "
+           "flow/extract\n"
+           "  --quick                 run 1%% as many operations, for "
+           "testing\n"
+           "  --list                  list the benchmarks and exit\n"
+           "  -h, --help              display this help message\n",
+           program_name, program_name);
+    exit(EXIT_SUCCESS);
+}
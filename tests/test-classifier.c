@@ -413,10 +413,10 @@ check_tables(const struct classifier *cls,
     HMAP_FOR_EACH (table, hmap_node, &cls->tables) {
         const struct cls_rule *head;
 
-        assert(!hmap_is_empty(&table->rules));
+        assert(!ohmap_is_empty(&table->rules));
 
         found_tables++;
-        HMAP_FOR_EACH (head, hmap_node, &table->rules) {
+        OHMAP_FOR_EACH (head, ohmap_node, &table->rules) {
             unsigned int prev_priority = UINT_MAX;
             const struct cls_rule *rule;
 
@@ -0,0 +1,366 @@
+/*
+ * Copyright (c) 2011 Nicira Networks.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Measures the flow setup rate and forwarding rate of the userspace datapath,
+ * end to end through ofproto-dpif, in a single process.
+ *
+ * The benchmark creates a "dummy" datapath with two dummy ports, p1 and p2,
+ * and a single OpenFlow flow that outputs packets received on p1 to p2.  It
+ * then generates packets on p1 with the dummy netdev packet generator and
+ * runs ofproto until they have all been sent on p2:
+ *
+ *   - First, one packet for each of N different flows, each of which misses
+ *     in the datapath and requires ofproto-dpif to set up a flow.
+ *
+ *   - Then, many packets cycling among the same flows, each of which hits in
+ *     the datapath flow table. */
+
+#include <config.h>
+
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "classifier.h"
+#include "command-line.h"
+#include "dummy.h"
+#include "json.h"
+#include "netdev.h"
+#include "ofproto/ofproto.h"
+#include "ofproto/ofproto-provider.h"
+#include "openflow/openflow.h"
+#include "util.h"
+#include "vlog.h"
+
+/* Command-line options. */
+static unsigned int n_flows = 10000;
+static unsigned long long int n_packets = 1000000;
+static int n_repetitions = 3;
+
+/* Number of consecutive calls to ofproto_run() without progress after which
+ * run_until_sent() gives up on the remaining packets. */
+#define MAX_IDLE_RUNS 10000
+
+static void usage(void) NO_RETURN;
+static void parse_options(int argc, char *argv[]);
+
+static long long int
+nsec_now(void)
+{
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts)) {
+        ovs_fatal(errno, "clock_gettime failed");
+    }
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static double
+round_tenth(double x)
+{
+    return floor(x * 10.0 + 0.5) / 10.0;
+}
+
+static uint64_t
+get_stat(struct netdev *netdev, bool tx)
+{
+    struct netdev_stats stats;
+    int error;
+
+    error = netdev_get_stats(netdev, &stats);
+    if (error) {
+        ovs_fatal(error, "%s: failed to get stats", netdev_get_name(netdev));
+    }
+    return tx ? stats.tx_packets : stats.rx_packets;
+}
+
+/* Runs 'ofproto' until 'n' more packets have been sent on 'tx', or until no
+ * more progress is being made.  Returns the number of packets that were
+ * sent and stores the elapsed time, in nanoseconds, into '*elapsed'. */
+static uint64_t
+run_until_sent(struct ofproto *ofproto, struct netdev *rx, struct netdev *tx,
+               uint64_t n, long long int *elapsed)
+{
+    uint64_t tx_base = get_stat(tx, true);
+    uint64_t last_rx = 0, last_tx = 0;
+    long long int start = nsec_now();
+    int idle = 0;
+
+    for (;;) {
+        uint64_t n_rx, n_tx;
+        int error;
+
+        error = ofproto_run(ofproto);
+        if (error) {
+            ovs_fatal(error, "ofproto_run failed");
+        }
+
+        n_rx = get_stat(rx, false);
+        n_tx = get_stat(tx, true) - tx_base;
+        if (n_tx >= n) {
+            break;
+        } else if (n_rx == last_rx && n_tx == last_tx) {
+            if (++idle >= MAX_IDLE_RUNS) {
+                break;
+            }
+        } else {
+            idle = 0;
+            last_rx = n_rx;
+            last_tx = n_tx;
+        }
+    }
+    *elapsed = nsec_now() - start;
+    return get_stat(tx, true) - tx_base;
+}
+
+static struct netdev *
+add_port(struct ofproto *ofproto, const char *name)
+{
+    struct netdev *netdev;
+    int error;
+
+    error = netdev_open(name, "dummy", &netdev);
+    if (!error) {
+        error = ofproto_port_add(ofproto, netdev, NULL);
+    }
+    if (error) {
+        ovs_fatal(error, "%s: failed to add port", name);
+    }
+    return netdev;
+}
+
+struct result {
+    double flows_per_sec;
+    uint64_t flows_lost;
+    double packets_per_sec;
+    uint64_t packets_lost;
+};
+
+/* Runs the benchmark once and stores the results in '*r'. */
+static void
+run_benchmark(struct result *r)
+{
+    struct ofp_action_output output;
+    struct netdev *p1, *p2;
+    struct ofproto *ofproto;
+    long long int elapsed;
+    struct cls_rule rule;
+    uint64_t n_sent;
+    int error;
+
+    error = ofproto_create("bench", "dummy", &ofproto);
+    if (error) {
+        ovs_fatal(error, "failed to create datapath");
+    }
+    ofproto_set_flow_eviction_threshold(ofproto, n_flows + 1000);
+    p1 = add_port(ofproto, "p1");
+    p2 = add_port(ofproto, "p2");
+
+    /* in_port=1 actions=output:2 */
+    cls_rule_init_catchall(&rule, 0);
+    cls_rule_set_in_port(&rule, 1);
+    memset(&output, 0, sizeof output);
+    output.type = htons(OFPAT_OUTPUT);
+    output.len = htons(sizeof output);
+    output.port = htons(2);
+    ofproto_add_flow(ofproto, &rule, (const union ofp_action *) &output, 1);
+
+    /* Flow setup. */
+    netdev_dummy_generate("p1", n_flows, n_flows);
+    n_sent = run_until_sent(ofproto, p1, p2, n_flows, &elapsed);
+    r->flows_per_sec = n_sent / (elapsed / 1e9);
+    r->flows_lost = n_flows - n_sent;
+
+    /* Forwarding through the flows set up above. */
+    netdev_dummy_generate("p1", n_packets, n_flows);
+    n_sent = run_until_sent(ofproto, p1, p2, n_packets, &elapsed);
+    r->packets_per_sec = n_sent / (elapsed / 1e9);
+    r->packets_lost = n_packets - n_sent;
+
+    netdev_close(p1);
+    netdev_close(p2);
+    ofproto_destroy(ofproto);
+    ofproto_delete("bench", "dummy");
+}
+
+/* Returns a JSON object that summarizes the 'n' values in 'values'. */
+static struct json *
+summarize(const double values[], int n)
+{
+    double sum, mean, variance, min, max;
+    struct json *json;
+    int i;
+
+    sum = 0.0;
+    min = max = values[0];
+    for (i = 0; i < n; i++) {
+        sum += values[i];
+        min = MIN(min, values[i]);
+        max = MAX(max, values[i]);
+    }
+    mean = sum / n;
+
+    variance = 0.0;
+    for (i = 0; i < n; i++) {
+        variance += (values[i] - mean) * (values[i] - mean);
+    }
+    variance = n > 1 ? variance / (n - 1) : 0.0;
+
+    json = json_object_create();
+    json_object_put(json, "mean", json_real_create(round_tenth(mean)));
+    json_object_put(json, "min", json_real_create(round_tenth(min)));
+    json_object_put(json, "max", json_real_create(round_tenth(max)));
+    json_object_put(json, "stddev",
+                    json_real_create(round_tenth(sqrt(variance))));
+    return json;
+}
+
+int
+main(int argc, char *argv[])
+{
+    double *flows_per_sec, *packets_per_sec;
+    uint64_t flows_lost, packets_lost;
+    struct json *report, *setup, *forwarding;
+    char *s;
+    int i;
+
+    set_program_name(argv[0]);
+    parse_options(argc, argv);
+    dummy_enable();
+
+    flows_per_sec = xmalloc(n_repetitions * sizeof *flows_per_sec);
+    packets_per_sec = xmalloc(n_repetitions * sizeof *packets_per_sec);
+    flows_lost = packets_lost = 0;
+    for (i = 0; i < n_repetitions; i++) {
+        struct result r;
+
+        run_benchmark(&r);
+        flows_per_sec[i] = r.flows_per_sec;
+        packets_per_sec[i] = r.packets_per_sec;
+        flows_lost += r.flows_lost;
+        packets_lost += r.packets_lost;
+    }
+
+    setup = json_object_create();
+    json_object_put(setup, "flows", json_integer_create(n_flows));
+    json_object_put(setup, "flows_per_sec",
+                    summarize(flows_per_sec, n_repetitions));
+    json_object_put(setup, "lost", json_integer_create(flows_lost));
+
+    forwarding = json_object_create();
+    json_object_put(forwarding, "packets", json_integer_create(n_packets));
+    json_object_put(forwarding, "packets_per_sec",
+                    summarize(packets_per_sec, n_repetitions));
+    json_object_put(forwarding, "lost", json_integer_create(packets_lost));
+
+    report = json_object_create();
+    json_object_put_string(report, "version", VERSION);
+    json_object_put(report, "repetitions", json_integer_create(n_repetitions));
+    json_object_put(report, "flow_setup", setup);
+    json_object_put(report, "forwarding", forwarding);
+
+    s = json_to_string(report, JSSF_PRETTY | JSSF_SORT);
+    puts(s);
+    free(s);
+    json_destroy(report);
+    free(flows_per_sec);
+    free(packets_per_sec);
+
+    return flows_lost || packets_lost;
+}
+
+static void
+parse_options(int argc, char *argv[])
+{
+    enum {
+        OPT_FLOWS = UCHAR_MAX + 1,
+        OPT_PACKETS
+    };
+    static struct option long_options[] = {
+        {"flows", required_argument, NULL, OPT_FLOWS},
+        {"packets", required_argument, NULL, OPT_PACKETS},
+        {"repetitions", required_argument, NULL, 'r'},
+        {"verbose", optional_argument, NULL, 'v'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    char *short_options = long_options_to_short_options(long_options);
+
+    for (;;) {
+        int c = getopt_long(argc, argv, short_options, long_options, NULL);
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+        case OPT_FLOWS:
+            n_flows = atoi(optarg);
+            if (!n_flows) {
+                ovs_fatal(0, "--flows argument must be positive");
+            }
+            break;
+
+        case OPT_PACKETS:
+            n_packets = strtoull(optarg, NULL, 10);
+            break;
+
+        case 'r':
+            n_repetitions = atoi(optarg);
+            if (n_repetitions < 1) {
+                ovs_fatal(0, "--repetitions argument must be positive");
+            }
+            break;
+
+        case 'v':
+            vlog_set_verbosity(optarg);
+            break;
+
+        case 'h':
+            usage();
+
+        case '?':
+            exit(EXIT_FAILURE);
+
+        default:
+            abort();
+        }
+    }
+    free(short_options);
+
+    if (optind != argc) {
+        ovs_fatal(0, "non-option arguments not accepted; "
+                  "use --help for usage");
+    }
+}
+
+static void
+usage(void)
+{
+    printf("%s: userspace datapath benchmark\n"
+           "usage: %s [OPTIONS]\n"
+           "\nOptions:\n"
+           "  --flows=N               set up N flows (default: 10000)\n"
+           "  --packets=N             forward N packets (default: 1000000)\n"
+           "  -r, --repetitions=N     repeat N times (default: 3)\n"
+           "  -v, --verbose=MODULE[:FACILITY[:LEVEL]]  set logging levels\n"
+           "  -h, --help              display this help message\n",
+           program_name, program_name);
+    exit(EXIT_SUCCESS);
+}
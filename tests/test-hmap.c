@@ -15,12 +15,15 @@
  */
 
 /* A non-exhaustive test for some of the functions and macros declared in
- * hmap.h. */
+ * hmap.h and ohmap.h, plus a benchmark that compares them. */
 
 #include <config.h>
 #include "hmap.h"
 #include <string.h>
 #include "hash.h"
+#include "ohmap.h"
+#include "random.h"
+#include "timeval.h"
 #include "util.h"
 
 #undef NDEBUG
@@ -34,6 +37,16 @@ struct element {
 
 typedef size_t hash_func(int value);
 
+/* If true, the hmaps under test expand incrementally. */
+static bool incremental;
+
+static void
+init_hmap(struct hmap *hmap)
+{
+    hmap_init(hmap);
+    hmap_set_incremental(hmap, incremental);
+}
+
 static int
 compare_ints(const void *a_, const void *b_)
 {
@@ -96,7 +109,7 @@ make_hmap(struct hmap *hmap, struct element elements[],
 {
     size_t i;
 
-    hmap_init(hmap);
+    init_hmap(hmap);
     for (i = 0; i < n; i++) {
         elements[i].value = i;
         hmap_insert(hmap, &elements[i].node, hash(elements[i].value));
@@ -172,7 +185,7 @@ test_hmap_insert_delete(hash_func *hash)
     struct hmap hmap;
     size_t i;
 
-    hmap_init(&hmap);
+    init_hmap(&hmap);
     for (i = 0; i < N_ELEMS; i++) {
         elements[i].value = i;
         hmap_insert(&hmap, &elements[i].node, hash(i));
@@ -201,7 +214,7 @@ test_hmap_reserve_shrink(hash_func *hash)
         struct hmap hmap;
         size_t j;
 
-        hmap_init(&hmap);
+        init_hmap(&hmap);
         hmap_reserve(&hmap, i);
         for (j = 0; j < N_ELEMS; j++) {
             elements[j].value = j;
@@ -271,6 +284,247 @@ test_hmap_for_each_safe(hash_func *hash)
     }
 }
 
+/* Tests that searching, iteration, and removal work throughout an incremental
+ * rehash, by checking the hmap after each insertion and removal. */
+static void
+test_hmap_incremental(hash_func *hash)
+{
+    /* Inserting the 256th element expands the hmap, so a rehash is still in
+     * progress afterward. */
+    enum { N_ELEMS = 256 };
+
+    struct element elements[N_ELEMS];
+    int values[N_ELEMS];
+    struct hmap hmap;
+    size_t i;
+
+    init_hmap(&hmap);
+    for (i = 0; i < N_ELEMS; i++) {
+        elements[i].value = i;
+        hmap_insert(&hmap, &elements[i].node, hash(i));
+        values[i] = i;
+        check_hmap(&hmap, values, i + 1, hash);
+    }
+    assert(hmap.old_buckets);
+
+    shuffle(values, N_ELEMS);
+    for (i = 0; i < N_ELEMS; i++) {
+        hmap_remove(&hmap, &elements[values[i]].node);
+        check_hmap(&hmap, values + (i + 1), N_ELEMS - (i + 1), hash);
+    }
+    hmap_destroy(&hmap);
+}
+
+/* Sample ohmap element. */
+struct oelement {
+    int value;
+    struct ohmap_node node;
+};
+
+/* Verifies that 'ohmap' contains exactly the 'n' values in 'values'. */
+static void
+check_ohmap(struct ohmap *ohmap, const int values[], size_t n,
+            hash_func *hash)
+{
+    int *sort_values, *ohmap_values;
+    struct oelement *e;
+    size_t i;
+
+    /* Check that all the values are there in iteration. */
+    sort_values = xmalloc(sizeof *sort_values * n);
+    ohmap_values = xmalloc(sizeof *sort_values * n);
+
+    i = 0;
+    OHMAP_FOR_EACH (e, node, ohmap) {
+        assert(i < n);
+        ohmap_values[i++] = e->value;
+    }
+    assert(i == n);
+
+    memcpy(sort_values, values, sizeof *sort_values * n);
+    qsort(sort_values, n, sizeof *sort_values, compare_ints);
+    qsort(ohmap_values, n, sizeof *ohmap_values, compare_ints);
+
+    for (i = 0; i < n; i++) {
+        assert(sort_values[i] == ohmap_values[i]);
+    }
+
+    free(ohmap_values);
+    free(sort_values);
+
+    /* Check that all the values are there in lookup. */
+    for (i = 0; i < n; i++) {
+        size_t count = 0;
+
+        OHMAP_FOR_EACH_WITH_HASH (e, node, hash(values[i]), ohmap) {
+            count += e->value == values[i];
+        }
+        assert(count == 1);
+    }
+
+    /* Check counters. */
+    assert(ohmap_is_empty(ohmap) == !n);
+    assert(ohmap_count(ohmap) == n);
+}
+
+/* Tests basic ohmap insertion and deletion. */
+static void
+test_ohmap_insert_delete(hash_func *hash)
+{
+    enum { N_ELEMS = 100 };
+
+    struct oelement elements[N_ELEMS];
+    int values[N_ELEMS];
+    struct ohmap ohmap;
+    size_t i;
+
+    ohmap_init(&ohmap);
+    for (i = 0; i < N_ELEMS; i++) {
+        elements[i].value = i;
+        ohmap_insert(&ohmap, &elements[i].node, hash(i));
+        values[i] = i;
+        check_ohmap(&ohmap, values, i + 1, hash);
+    }
+    shuffle(values, N_ELEMS);
+    for (i = 0; i < N_ELEMS; i++) {
+        ohmap_remove(&ohmap, &elements[values[i]].node);
+        check_ohmap(&ohmap, values + (i + 1), N_ELEMS - (i + 1), hash);
+    }
+    ohmap_destroy(&ohmap);
+}
+
+/* Tests interleaved insertion and deletion, so that nodes are removed from
+ * both tables while an ohmap is resizing, and deleted slots accumulate. */
+static void
+test_ohmap_churn(hash_func *hash)
+{
+    enum { N_ELEMS = 300 };
+
+    struct oelement elements[N_ELEMS];
+    int values[N_ELEMS];
+    struct ohmap ohmap;
+    size_t n, i;
+
+    ohmap_init(&ohmap);
+    n = 0;
+    for (i = 0; i < N_ELEMS; i++) {
+        elements[i].value = i;
+        ohmap_insert(&ohmap, &elements[i].node, hash(i));
+        values[n++] = i;
+        if (i % 3 == 2) {
+            size_t j = rand() % n;
+
+            ohmap_remove(&ohmap, &elements[values[j]].node);
+            values[j] = values[--n];
+        }
+        check_ohmap(&ohmap, values, n, hash);
+    }
+    ohmap_destroy(&ohmap);
+}
+
+/* Tests growing an ohmap again after removing most of its nodes, so that the
+ * table being migrated away from is large and nearly empty while the new
+ * table is small and fills up before migration finishes.
+ *
+ * With identity_hash, the values fill 895 of the 1024 groups in an 8192-slot
+ * table with 8 nodes each, so that removing them leaves deleted slots behind,
+ * and the values inserted afterward start out in the groups that are still
+ * empty. */
+static void
+test_ohmap_churn_then_grow(hash_func *hash)
+{
+    enum { N_GROUPS = 1024, N_FULL = 895, N_KEEP = 10, N_GROW = 1000 };
+    enum { N_FILL = N_FULL * 8 };
+
+    struct oelement *elements;
+    int *values;
+    struct ohmap ohmap;
+    size_t n, i;
+
+    elements = xmalloc((N_FILL + N_GROW) * sizeof *elements);
+    values = xmalloc((N_FILL + N_GROW) * sizeof *values);
+
+    ohmap_init(&ohmap);
+    for (i = 0; i < N_FILL; i++) {
+        elements[i].value = i % N_FULL + i / N_FULL * N_GROUPS;
+        ohmap_insert(&ohmap, &elements[i].node, hash(elements[i].value));
+    }
+
+    n = 0;
+    for (i = 0; i < N_FILL; i++) {
+        if (i % (N_FILL / N_KEEP) == N_FILL / N_KEEP - 1) {
+            values[n++] = elements[i].value;
+        } else {
+            ohmap_remove(&ohmap, &elements[i].node);
+        }
+    }
+    check_ohmap(&ohmap, values, n, hash);
+
+    for (i = N_FILL; i < N_FILL + N_GROW; i++) {
+        elements[i].value = 8 * N_GROUPS + N_FULL + (i - N_FILL);
+        ohmap_insert(&ohmap, &elements[i].node, hash(elements[i].value));
+        values[n++] = elements[i].value;
+        if (n % 64 == 0) {
+            check_ohmap(&ohmap, values, n, hash);
+        }
+    }
+    check_ohmap(&ohmap, values, n, hash);
+
+    ohmap_destroy(&ohmap);
+    free(elements);
+    free(values);
+}
+
+/* Tests that OHMAP_FOR_EACH_SAFE properly allows for deletion of the current
+ * element of an ohmap.  */
+static void
+test_ohmap_for_each_safe(hash_func *hash)
+{
+    enum { MAX_ELEMS = 10 };
+    size_t n;
+    unsigned long int pattern;
+
+    for (n = 0; n <= MAX_ELEMS; n++) {
+        for (pattern = 0; pattern < 1ul << n; pattern++) {
+            struct oelement elements[MAX_ELEMS];
+            int values[MAX_ELEMS];
+            struct ohmap ohmap;
+            struct oelement *e, *next;
+            size_t n_remaining;
+            int i;
+
+            ohmap_init(&ohmap);
+            for (i = 0; i < n; i++) {
+                elements[i].value = i;
+                ohmap_insert(&ohmap, &elements[i].node, hash(i));
+                values[i] = i;
+            }
+
+            i = 0;
+            n_remaining = n;
+            OHMAP_FOR_EACH_SAFE (e, next, node, &ohmap) {
+                assert(i < n);
+                if (pattern & (1ul << e->value)) {
+                    size_t j;
+                    ohmap_remove(&ohmap, &e->node);
+                    for (j = 0; ; j++) {
+                        assert(j < n_remaining);
+                        if (values[j] == e->value) {
+                            values[j] = values[--n_remaining];
+                            break;
+                        }
+                    }
+                }
+                check_ohmap(&ohmap, values, n_remaining, hash);
+                i++;
+            }
+            assert(i == n);
+
+            ohmap_destroy(&ohmap);
+        }
+    }
+}
+
 static void
 run_test(void (*function)(hash_func *))
 {
@@ -284,13 +538,181 @@ run_test(void (*function)(hash_func *))
     }
 }
 
+/* Benchmark. */
+
+static double
+elapsed_msec(long long int start)
+{
+    return (time_usec() - start) / 1000.0;
+}
+
+static void
+print_result(const char *name, double insert, long long int worst,
+             double lookup, double iterate, double remove)
+{
+    printf("%-8s %8.1f %10lld %8.1f %8.1f %8.1f\n",
+           name, insert, worst, lookup, iterate, remove);
+}
+
+/* Inserts the 'n' values in 'values' into an hmap, looks each of them up,
+ * iterates over them, and removes them, and prints the time each step
+ * took.  The hmap expands incrementally if 'incremental' is true. */
+static void
+benchmark_hmap(const int values[], size_t n)
+{
+    struct element *elements = xmalloc(n * sizeof *elements);
+    long long int start, worst;
+    struct element *e;
+    struct hmap hmap;
+    size_t i, sum;
+    double insert, lookup, iterate, remove;
+
+    init_hmap(&hmap);
+    worst = 0;
+    start = time_usec();
+    for (i = 0; i < n; i++) {
+        long long int before = time_usec();
+
+        elements[i].value = values[i];
+        hmap_insert(&hmap, &elements[i].node, good_hash(values[i]));
+        worst = MAX(worst, time_usec() - before);
+    }
+    insert = elapsed_msec(start);
+
+    start = time_usec();
+    sum = 0;
+    for (i = 0; i < n; i++) {
+        HMAP_FOR_EACH_WITH_HASH (e, node, good_hash(values[i]), &hmap) {
+            if (e->value == values[i]) {
+                sum++;
+                break;
+            }
+        }
+    }
+    lookup = elapsed_msec(start);
+    assert(sum == n);
+
+    start = time_usec();
+    sum = 0;
+    HMAP_FOR_EACH (e, node, &hmap) {
+        sum++;
+    }
+    iterate = elapsed_msec(start);
+    assert(sum == n);
+
+    start = time_usec();
+    for (i = 0; i < n; i++) {
+        hmap_remove(&hmap, &elements[i].node);
+    }
+    remove = elapsed_msec(start);
+
+    print_result(incremental ? "hmap-inc" : "hmap", insert, worst, lookup, iterate, remove);
+    hmap_destroy(&hmap);
+    free(elements);
+}
+
+/* Same as benchmark_hmap(), for an ohmap. */
+static void
+benchmark_ohmap(const int values[], size_t n)
+{
+    struct oelement *elements = xmalloc(n * sizeof *elements);
+    long long int start, worst;
+    struct oelement *e;
+    struct ohmap ohmap;
+    size_t i, sum;
+    double insert, lookup, iterate, remove;
+
+    ohmap_init(&ohmap);
+    worst = 0;
+    start = time_usec();
+    for (i = 0; i < n; i++) {
+        long long int before = time_usec();
+
+        elements[i].value = values[i];
+        ohmap_insert(&ohmap, &elements[i].node, good_hash(values[i]));
+        worst = MAX(worst, time_usec() - before);
+    }
+    insert = elapsed_msec(start);
+
+    start = time_usec();
+    sum = 0;
+    for (i = 0; i < n; i++) {
+        OHMAP_FOR_EACH_WITH_HASH (e, node, good_hash(values[i]), &ohmap) {
+            if (e->value == values[i]) {
+                sum++;
+                break;
+            }
+        }
+    }
+    lookup = elapsed_msec(start);
+    assert(sum == n);
+
+    start = time_usec();
+    sum = 0;
+    OHMAP_FOR_EACH (e, node, &ohmap) {
+        sum++;
+    }
+    iterate = elapsed_msec(start);
+    assert(sum == n);
+
+    start = time_usec();
+    for (i = 0; i < n; i++) {
+        ohmap_remove(&ohmap, &elements[i].node);
+    }
+    remove = elapsed_msec(start);
+
+    print_result("ohmap", insert, worst, lookup, iterate, remove);
+    ohmap_destroy(&ohmap);
+    free(elements);
+}
+
+/* Compares hmap, incrementally expanding hmap, and ohmap with 'n' elements, inserted in random order and
+ * looked up in a different random order. */
+static void
+benchmark(size_t n)
+{
+    int *values = xmalloc(n * sizeof *values);
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        values[i] = random_uint32();
+    }
+
+    printf("%zu elements:\n"
+           "           insert   worst op   lookup  iterate   remove\n"
+           "               ms         us       ms       ms       ms\n", n);
+    incremental = false;
+    benchmark_hmap(values, n);
+    incremental = true;
+    benchmark_hmap(values, n);
+    benchmark_ohmap(values, n);
+    free(values);
+}
+
 int
-main(void)
+main(int argc, char *argv[])
 {
-    run_test(test_hmap_insert_delete);
-    run_test(test_hmap_for_each_safe);
-    run_test(test_hmap_reserve_shrink);
-    printf("\n");
+    if (argc == 3 && !strcmp(argv[1], "benchmark")) {
+        benchmark(atoi(argv[2]));
+    } else if (argc == 2 && !strcmp(argv[1], "incremental")) {
+        incremental = true;
+        run_test(test_hmap_insert_delete);
+        run_test(test_hmap_for_each_safe);
+        run_test(test_hmap_reserve_shrink);
+        run_test(test_hmap_incremental);
+        printf("\n");
+    } else if (argc == 2 && !strcmp(argv[1], "ohmap")) {
+        run_test(test_ohmap_insert_delete);
+        run_test(test_ohmap_churn);
+        run_test(test_ohmap_churn_then_grow);
+        run_test(test_ohmap_for_each_safe);
+        printf("\n");
+    } else {
+        run_test(test_hmap_insert_delete);
+        run_test(test_hmap_for_each_safe);
+        run_test(test_hmap_reserve_shrink);
+        printf("\n");
+    }
     return 0;
 }
 
@@ -31,13 +31,17 @@
 #include "dummy.h"
 #include "leak-checker.h"
 #include "list.h"
+#include "memory.h"
 #include "netdev.h"
 #include "ofpbuf.h"
 #include "ofproto/ofproto.h"
 #include "openflow/openflow.h"
 #include "packets.h"
+#include "phase.h"
 #include "poll-loop.h"
+#include "profiler.h"
 #include "rconn.h"
+#include "socket-util.h"
 #include "stream-ssl.h"
 #include "timeval.h"
 #include "unixctl.h"
@@ -47,6 +51,10 @@
 
 VLOG_DEFINE_THIS_MODULE(openflowd);
 
+PHASE_DEFINE(ofproto_run);
+PHASE_DEFINE(unixctl);
+PHASE_DEFINE(netdev_run);
+
 /* Settings that may be configured by the user. */
 struct ofsettings {
     const char *unixctl_path;   /* File name for unixctl socket. */
@@ -76,11 +84,16 @@ struct ofsettings {
     /* Failure behavior. */
     int max_idle;             /* Idle time for flows in fail-open mode. */
 
+    /* Flow table. */
+    unsigned int revalidate_delay; /* Max msecs to defer revalidation. */
+
     /* NetFlow. */
     struct sset netflow;        /* NetFlow targets. */
 };
 
 static unixctl_cb_func test_openflowd_exit;
+static unixctl_cb_func test_openflowd_dump_flows;
+static unixctl_cb_func test_openflowd_set_in_band_remotes;
 
 static void parse_options(int argc, char *argv[], struct ofsettings *);
 static void usage(void) NO_RETURN;
@@ -98,6 +111,8 @@ main(int argc, char *argv[])
 
     proctitle_init(argc, argv);
     set_program_name(argv[0]);
+    profiler_init_command();
+    memory_init_command();
     parse_options(argc, argv, &s);
     signal(SIGPIPE, SIG_IGN);
 
@@ -163,17 +178,31 @@ main(int argc, char *argv[])
     }
     ofproto_set_controllers(ofproto, s.controllers, s.n_controllers);
     ofproto_set_fail_mode(ofproto, s.fail_mode);
+    ofproto_set_revalidate_delay(ofproto, s.revalidate_delay);
+
+    unixctl_command_register("dump-flows", test_openflowd_dump_flows,
+                             ofproto);
+    unixctl_command_register("set-in-band-remotes",
+                             test_openflowd_set_in_band_remotes, ofproto);
 
     daemonize_complete();
 
     exiting = false;
     while (!exiting && (s.run_forever || ofproto_is_alive(ofproto))) {
+        phase_begin(&phase_ofproto_run);
         error = ofproto_run(ofproto);
         if (error) {
             VLOG_FATAL("unrecoverable datapath error (%s)", strerror(error));
         }
+        phase_end(&phase_ofproto_run);
+
+        phase_begin(&phase_unixctl);
         unixctl_server_run(unixctl);
+        phase_end(&phase_unixctl);
+
+        phase_begin(&phase_netdev_run);
         netdev_run();
+        phase_end(&phase_netdev_run);
 
         ofproto_wait(ofproto);
         unixctl_server_wait(unixctl);
@@ -185,6 +214,7 @@ main(int argc, char *argv[])
     }
 
     ofproto_destroy(ofproto);
+    unixctl_server_destroy(unixctl);
 
     return 0;
 }
@@ -197,6 +227,61 @@ test_openflowd_exit(struct unixctl_conn *conn, const char *args OVS_UNUSED,
     *exiting = true;
     unixctl_command_reply(conn, 200, NULL);
 }
+
+static bool
+test_openflowd_dump_flows_next(struct ds *results, void *dump)
+{
+    return ofproto_flow_dump_next(dump, results);
+}
+
+static void
+test_openflowd_dump_flows_destroy(void *dump)
+{
+    ofproto_flow_dump_destroy(dump);
+}
+
+static void
+test_openflowd_dump_flows(struct unixctl_conn *conn,
+                          const char *args OVS_UNUSED, void *ofproto)
+{
+    unixctl_command_reply_stream(conn, 200, test_openflowd_dump_flows_next,
+                                 test_openflowd_dump_flows_destroy,
+                                 ofproto_flow_dump_start(ofproto));
+}
+
+/* "set-in-band-remotes [IP[:PORT]]...": makes in-band control guarantee
+ * access to each IP:PORT (OFP_TCP_PORT if PORT is omitted), replacing any
+ * previous set of remotes.  With no arguments, removes all of them. */
+static void
+test_openflowd_set_in_band_remotes(struct unixctl_conn *conn,
+                                   const char *args_, void *ofproto)
+{
+    struct sockaddr_in *remotes = NULL;
+    size_t n_remotes, allocated;
+    char *args = xstrdup(args_);
+    char *save_ptr = NULL;
+    char *remote;
+
+    n_remotes = allocated = 0;
+    for (remote = strtok_r(args, " ", &save_ptr); remote;
+         remote = strtok_r(NULL, " ", &save_ptr)) {
+        if (n_remotes >= allocated) {
+            remotes = x2nrealloc(remotes, &allocated, sizeof *remotes);
+        }
+        if (!inet_parse_active(remote, OFP_TCP_PORT, &remotes[n_remotes])) {
+            unixctl_command_reply(conn, 501, "bad remote syntax");
+            goto exit;
+        }
+        n_remotes++;
+    }
+
+    ofproto_set_extra_in_band_remotes(ofproto, remotes, n_remotes);
+    unixctl_command_reply(conn, 200, NULL);
+
+exit:
+    free(remotes);
+    free(args);
+}
 
 /* User interface. */
 
@@ -240,6 +325,7 @@ parse_options(int argc, char *argv[], struct ofsettings *s)
         OPT_PORTS,
         OPT_UNIXCTL,
         OPT_ENABLE_DUMMY,
+        OPT_REVALIDATE_DELAY,
         VLOG_OPTION_ENUMS,
         LEAK_CHECKER_OPTION_ENUMS,
         DAEMON_OPTION_ENUMS
@@ -267,6 +353,7 @@ parse_options(int argc, char *argv[], struct ofsettings *s)
         {"ports",       required_argument, NULL, OPT_PORTS},
         {"unixctl",     required_argument, NULL, OPT_UNIXCTL},
         {"enable-dummy", no_argument, NULL, OPT_ENABLE_DUMMY},
+        {"revalidate-delay", required_argument, NULL, OPT_REVALIDATE_DELAY},
         {"verbose",     optional_argument, NULL, 'v'},
         {"help",        no_argument, NULL, 'h'},
         {"version",     no_argument, NULL, 'V'},
@@ -298,6 +385,7 @@ parse_options(int argc, char *argv[], struct ofsettings *s)
     s->sw_desc = NULL;
     s->serial_desc = NULL;
     s->dp_desc = NULL;
+    s->revalidate_delay = 0;
     sset_init(&controllers);
     sset_init(&s->snoops);
     s->max_idle = 0;
@@ -429,6 +517,10 @@ parse_options(int argc, char *argv[], struct ofsettings *s)
             dummy_enable();
             break;
 
+        case OPT_REVALIDATE_DELAY:
+            s->revalidate_delay = atoi(optarg);
+            break;
+
         case 'h':
             usage();
 
@@ -531,6 +623,7 @@ usage(void)
            "                          (a passive OpenFlow connection method)\n"
            "  --out-of-band           controller connection is out-of-band\n"
            "  --netflow=HOST:PORT     configure NetFlow output target\n"
+           "  --revalidate-delay=MSEC defer flow revalidation up to MSEC ms\n"
            "\nRate-limiting of \"packet-in\" messages to the controller:\n"
            "  --rate-limit[=PACKETS]  max rate, in packets/s (default: 1000)\n"
            "  --burst-limit=BURST     limit on packet credit for idle time\n");
@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2011 Nicira Networks.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <config.h>
+
+#include "poll-loop.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "timeval.h"
+#include "util.h"
+
+#undef NDEBUG
+#include <assert.h>
+
+/* Long enough that poll_block() returning before it expires must be due to a
+ * file descriptor, short enough that a failing test doesn't hang forever. */
+#define LONG_TIMEOUT 10000
+
+/* Short timeout for cases where poll_block() should not wake early. */
+#define SHORT_TIMEOUT 100
+
+/* If true, register pipes with poll_fd_register(). */
+static bool reg;
+
+static void
+open_pipe(int fds[2])
+{
+    if (pipe(fds)) {
+        ovs_fatal(errno, "pipe failed");
+    }
+    if (reg) {
+        poll_fd_register(fds[0]);
+        poll_fd_register(fds[1]);
+    }
+}
+
+static void
+close_pipe(int fds[2])
+{
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        if (reg) {
+            poll_fd_unregister(fds[i]);
+        }
+        close(fds[i]);
+    }
+}
+
+static void
+make_readable(int fd)
+{
+    ignore(write(fd, "x", 1));
+}
+
+/* Waits for 'fd' to become readable, with the given 'timeout', and returns
+ * the number of milliseconds that poll_block() took. */
+static long long int
+block_on(int fd, int timeout)
+{
+    long long int start = time_msec();
+
+    if (fd >= 0) {
+        poll_fd_wait(fd, POLLIN);
+    }
+    poll_timer_wait(timeout);
+    poll_block();
+    return time_msec() - start;
+}
+
+static bool
+woke_early(int fd)
+{
+    return block_on(fd, LONG_TIMEOUT) < LONG_TIMEOUT / 2;
+}
+
+static bool
+timed_out(int fd)
+{
+    return block_on(fd, SHORT_TIMEOUT) >= SHORT_TIMEOUT;
+}
+
+static void
+run_tests(void)
+{
+    int a[2], b[2], c[2];
+    int fd;
+    int i;
+
+    /* A readable pipe wakes us up, repeatedly while it stays readable. */
+    open_pipe(a);
+    make_readable(a[1]);
+    for (i = 0; i < 3; i++) {
+        assert(woke_early(a[0]));
+    }
+
+    /* A pipe that isn't readable doesn't. */
+    open_pipe(b);
+    assert(timed_out(b[0]));
+
+    /* A readable pipe that we no longer wait on doesn't wake us up. */
+    assert(timed_out(-1));
+    assert(timed_out(b[0]));
+
+    /* Nor does one that only becomes readable after we stop waiting on it,
+     * even though the "epoll" backend may still have it armed. */
+    open_pipe(c);
+    assert(timed_out(c[0]));
+    make_readable(c[1]);
+    assert(timed_out(-1));
+    assert(woke_early(c[0]));
+    close_pipe(c);
+
+    /* Waiting on two file descriptors, and changing the requested events. */
+    poll_fd_wait(a[0], POLLIN);
+    assert(woke_early(b[0]));
+    poll_fd_wait(a[0], POLLOUT);
+    make_readable(b[1]);
+    assert(woke_early(b[0]));
+
+    /* Close a pipe and reuse its file descriptor number for a new pipe,
+     * without an intervening poll_block(). */
+    fd = b[0];
+    close_pipe(a);
+    close_pipe(b);
+    open_pipe(b);
+    if (b[0] != fd) {
+        int new_fd = b[0];
+
+        assert(dup2(new_fd, fd) == fd);
+        if (reg) {
+            poll_fd_register(fd);
+            poll_fd_unregister(new_fd);
+        }
+        close(new_fd);
+        b[0] = fd;
+    }
+    make_readable(b[1]);
+    assert(woke_early(b[0]));
+    close_pipe(b);
+
+    /* poll() reports /dev/null as readable, although epoll can't wait on it. */
+    fd = open("/dev/null", O_RDONLY);
+    assert(fd >= 0);
+    if (reg) {
+        poll_fd_register(fd);
+    }
+    assert(woke_early(fd));
+    if (reg) {
+        poll_fd_unregister(fd);
+    }
+    close(fd);
+
+    /* A closed file descriptor wakes us up immediately (with POLLNVAL). */
+    assert(woke_early(fd));
+}
+
+int
+main(int argc, char *argv[])
+{
+    set_program_name(argv[0]);
+    if (argc != 2) {
+        ovs_fatal(0, "usage: %s poll|epoll", program_name);
+    }
+    if (!poll_set_backend(argv[1])) {
+        /* Not supported on this platform: skip the test. */
+        exit(77);
+    }
+    assert(!strcmp(poll_get_backend(), argv[1]));
+
+    reg = false;
+    run_tests();
+
+    reg = true;
+    run_tests();
+
+    return 0;
+}
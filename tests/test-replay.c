@@ -0,0 +1,547 @@
+/*
+ * Copyright (c) 2011 Nicira Networks.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Replays a pcap file into a bridge, for validating the flow setup behavior
+ * and performance of a build against captured traffic.
+ *
+ * By default, the packets are received on port p1 of a bridge whose ports are
+ * all dummy network devices, running in this process with ofproto-dpif and
+ * the userspace datapath.  Each packet is processed by its own call to
+ * ofproto_run(), which is timed, and the datapath's statistics show whether
+ * the packet hit an existing datapath flow or missed and required a flow
+ * setup.  Alternatively, with --output, the packets are simply sent on a
+ * network device, to drive an external switch. */
+
+#include <config.h>
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "command-line.h"
+#include "dpif.h"
+#include "dummy.h"
+#include "dynamic-string.h"
+#include "flow.h"
+#include "histogram.h"
+#include "json.h"
+#include "netdev.h"
+#include "odp-util.h"
+#include "ofp-parse.h"
+#include "ofp-util.h"
+#include "ofpbuf.h"
+#include "ofproto/ofproto.h"
+#include "ofproto/ofproto-provider.h"
+#include "openflow/openflow.h"
+#include "pcap.h"
+#include "util.h"
+#include "vlog.h"
+
+/* Command-line options. */
+static const char *flows_file_name;
+static int n_ports = 2;
+static int in_port = 1;
+static double speed;
+static double rate;
+static int n_loops = 1;
+static const char *output_netdev;
+static bool print_decisions;
+
+static void usage(void) NO_RETURN;
+static void parse_options(int argc, char *argv[]);
+
+/* What happened to a packet in the datapath. */
+enum decision {
+    DECISION_HIT,               /* Matched an existing datapath flow. */
+    DECISION_MISS,              /* Missed, sent to ofproto for flow setup. */
+    DECISION_LOST,              /* Missed, but the upcall was dropped. */
+    DECISION_OTHER,             /* Dropped otherwise, e.g. a fragment. */
+    N_DECISIONS
+};
+
+static const char *decision_names[N_DECISIONS] = {
+    "hit", "miss", "lost", "other"
+};
+
+/* Replay statistics. */
+static unsigned long long int n_decisions[N_DECISIONS];
+static struct histogram nsecs[N_DECISIONS];
+
+static long long int
+nsec_now(void)
+{
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts)) {
+        ovs_fatal(errno, "clock_gettime failed");
+    }
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Returns the time, relative to the start of the replay, at which the
+ * 'n'th packet should be replayed, given that it was captured 'usec'
+ * microseconds after the first packet. */
+static long long int
+schedule(unsigned long long int n, long long int usec)
+{
+    if (rate > 0) {
+        return n / rate * 1e9;
+    } else if (speed > 0) {
+        return usec * 1000 / speed;
+    } else {
+        return 0;
+    }
+}
+
+static void
+add_flows(struct ofproto *ofproto)
+{
+    struct ds s = DS_EMPTY_INITIALIZER;
+    FILE *file;
+
+    if (!flows_file_name) {
+        struct ofputil_flow_mod fm;
+
+        parse_ofp_str(&fm, OFPFC_ADD, "actions=FLOOD", false);
+        ofproto_add_flow(ofproto, &fm.cr, fm.actions, fm.n_actions);
+        free(fm.actions);
+        return;
+    }
+
+    file = !strcmp(flows_file_name, "-") ? stdin : fopen(flows_file_name, "r");
+    if (!file) {
+        ovs_fatal(errno, "%s: open failed", flows_file_name);
+    }
+    while (!ds_get_preprocessed_line(&s, file)) {
+        struct ofputil_flow_mod fm;
+
+        parse_ofp_str(&fm, OFPFC_ADD, ds_cstr(&s), true);
+        ofproto_add_flow(ofproto, &fm.cr, fm.actions, fm.n_actions);
+        free(fm.actions);
+    }
+    if (file != stdin) {
+        fclose(file);
+    }
+    ds_destroy(&s);
+}
+
+static uint64_t
+dp_stat(const struct ovs_dp_stats *stats, enum decision decision)
+{
+    switch (decision) {
+    case DECISION_HIT:
+        return stats->n_hit;
+    case DECISION_MISS:
+        return stats->n_missed - stats->n_lost;
+    case DECISION_LOST:
+        return stats->n_lost;
+    case DECISION_OTHER:
+    case N_DECISIONS:
+    default:
+        return stats->n_frags;
+    }
+}
+
+/* Prints the datapath actions for the flow that 'packet', received on
+ * datapath port 'in_port', now maps to in 'dpif'. */
+static void
+print_actions(const struct dpif *dpif, const struct pcap_packet *packet)
+{
+    struct ofpbuf buf, key, *actions;
+    struct ds s = DS_EMPTY_INITIALIZER;
+    struct flow flow;
+
+    ofpbuf_use_const(&buf, packet->data, packet->size);
+    flow_extract(&buf, 0, in_port, &flow);
+    ofpbuf_init(&key, 0);
+    odp_flow_key_from_flow(&key, &flow);
+    if (!dpif_flow_get(dpif, key.data, key.size, &actions, NULL)) {
+        format_odp_actions(&s, actions->data, actions->size);
+        ofpbuf_delete(actions);
+    } else {
+        ds_put_cstr(&s, "(no datapath flow)");
+    }
+    printf(" %s\n", ds_cstr(&s));
+    ofpbuf_uninit(&key);
+    ds_destroy(&s);
+}
+
+/* Replays the packets in 'reader' into 'ofproto', whose datapath is 'dpif'. */
+static void
+replay_to_bridge(struct pcap_reader *reader, struct ofproto *ofproto,
+                 const struct dpif *dpif)
+{
+    struct ovs_dp_stats before, after;
+    unsigned long long int n;
+    long long int start, first_usec, last_usec, loop_usec;
+    char in_name[16];
+    int loop;
+
+    snprintf(in_name, sizeof in_name, "p%d", in_port);
+    dpif_get_dp_stats(dpif, &before);
+
+    start = nsec_now();
+    n = 0;
+    first_usec = last_usec = -1;
+    loop_usec = 0;
+    for (loop = 0; loop < n_loops; loop++) {
+        struct pcap_packet packet;
+        int error;
+
+        pcap_reader_rewind(reader);
+        while (!(error = pcap_reader_next(reader, &packet))) {
+            enum decision decision;
+            long long int t0, t1;
+            struct ofpbuf buf;
+
+            if (first_usec < 0) {
+                first_usec = packet.usec;
+            }
+            last_usec = packet.usec;
+            while (nsec_now() - start
+                   < schedule(n, loop_usec + packet.usec - first_usec)) {
+                ofproto_run(ofproto);
+            }
+
+            ofpbuf_use_const(&buf, packet.data, packet.size);
+            netdev_dummy_queue_packet(in_name, &buf);
+            t0 = nsec_now();
+            ofproto_run(ofproto);
+            t1 = nsec_now();
+
+            dpif_get_dp_stats(dpif, &after);
+            for (decision = 0; decision < DECISION_OTHER; decision++) {
+                if (dp_stat(&after, decision) != dp_stat(&before, decision)) {
+                    break;
+                }
+            }
+            before = after;
+            n_decisions[decision]++;
+            histogram_add(&nsecs[decision], t1 - t0);
+
+            if (print_decisions) {
+                printf("%llu: %s %lld ns:", n, decision_names[decision],
+                       t1 - t0);
+                print_actions(dpif, &packet);
+            }
+            n++;
+        }
+        if (error != EOF) {
+            ovs_fatal(error, "error reading pcap file");
+        }
+
+        /* Replay the next loop as if it were captured right after this
+         * one. */
+        loop_usec += last_usec - first_usec;
+        first_usec = -1;
+    }
+}
+
+/* Replays the packets in 'reader' by sending them on 'netdev'. */
+static void
+replay_to_netdev(struct pcap_reader *reader, struct netdev *netdev)
+{
+    unsigned long long int n;
+    long long int start, first_usec, last_usec, loop_usec;
+    int loop;
+
+    start = nsec_now();
+    n = 0;
+    first_usec = last_usec = -1;
+    loop_usec = 0;
+    for (loop = 0; loop < n_loops; loop++) {
+        struct pcap_packet packet;
+        int error;
+
+        pcap_reader_rewind(reader);
+        while (!(error = pcap_reader_next(reader, &packet))) {
+            enum decision decision;
+            struct ofpbuf buf;
+            long long int t0;
+
+            if (first_usec < 0) {
+                first_usec = packet.usec;
+            }
+            last_usec = packet.usec;
+            while (nsec_now() - start
+                   < schedule(n, loop_usec + packet.usec - first_usec)) {
+                continue;
+            }
+
+            t0 = nsec_now();
+            ofpbuf_use_const(&buf, packet.data, packet.size);
+            error = netdev_send(netdev, &buf);
+            decision = error ? DECISION_LOST : DECISION_OTHER;
+            n_decisions[decision]++;
+            histogram_add(&nsecs[decision], nsec_now() - t0);
+            n++;
+        }
+        if (error != EOF) {
+            ovs_fatal(error, "error reading pcap file");
+        }
+
+        /* Replay the next loop as if it were captured right after this
+         * one. */
+        loop_usec += last_usec - first_usec;
+        first_usec = -1;
+    }
+}
+
+static struct json *
+summarize(enum decision decision)
+{
+    const struct histogram *h = &nsecs[decision];
+    struct json *json = json_object_create();
+
+    json_object_put(json, "packets",
+                    json_integer_create(n_decisions[decision]));
+    if (h->n) {
+        json_object_put(json, "p50_ns",
+                        json_integer_create(histogram_permille(h, 500)));
+        json_object_put(json, "p99_ns",
+                        json_integer_create(histogram_permille(h, 990)));
+        json_object_put(json, "p99.9_ns",
+                        json_integer_create(histogram_permille(h, 999)));
+        json_object_put(json, "max_ns", json_integer_create(h->max));
+    }
+    return json;
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct pcap_reader *reader;
+    unsigned long long int n;
+    struct json *report;
+    long long int start;
+    double secs;
+    char *s;
+    int error;
+    int i;
+
+    set_program_name(argv[0]);
+    parse_options(argc, argv);
+    if (argc - optind != 1) {
+        ovs_fatal(0, "exactly one non-option argument required; "
+                  "use --help for usage");
+    }
+
+    error = pcap_reader_open(argv[optind], &reader);
+    if (error) {
+        ovs_fatal(error, "%s: open failed", argv[optind]);
+    }
+
+    report = json_object_create();
+    start = nsec_now();
+    if (output_netdev) {
+        struct netdev *netdev;
+
+        error = netdev_open(output_netdev, "system", &netdev);
+        if (error) {
+            ovs_fatal(error, "%s: open failed", output_netdev);
+        }
+        replay_to_netdev(reader, netdev);
+        netdev_close(netdev);
+
+        json_object_put(report, "sent", summarize(DECISION_OTHER));
+        json_object_put(report, "errors", summarize(DECISION_LOST));
+    } else {
+        struct ovs_dp_stats stats;
+        struct ofproto *ofproto;
+        struct dpif *dpif;
+        enum decision d;
+
+        dummy_enable();
+        error = ofproto_create("replay", "dummy", &ofproto);
+        if (error) {
+            ovs_fatal(error, "failed to create datapath");
+        }
+        for (i = 1; i <= n_ports; i++) {
+            struct netdev *netdev;
+            char name[16];
+
+            snprintf(name, sizeof name, "p%d", i);
+            error = netdev_open(name, "dummy", &netdev);
+            if (!error) {
+                error = ofproto_port_add(ofproto, netdev, NULL);
+            }
+            if (error) {
+                ovs_fatal(error, "%s: failed to add port", name);
+            }
+        }
+        add_flows(ofproto);
+
+        error = dpif_open("replay", "dummy", &dpif);
+        if (error) {
+            ovs_fatal(error, "failed to open datapath");
+        }
+        replay_to_bridge(reader, ofproto, dpif);
+        dpif_get_dp_stats(dpif, &stats);
+        dpif_close(dpif);
+
+        for (d = 0; d < N_DECISIONS; d++) {
+            json_object_put(report, decision_names[d], summarize(d));
+        }
+        json_object_put(report, "datapath_flows",
+                        json_integer_create(stats.n_flows));
+        ofproto_destroy(ofproto);
+        ofproto_delete("replay", "dummy");
+    }
+    secs = (nsec_now() - start) / 1e9;
+    pcap_reader_close(reader);
+
+    n = 0;
+    for (i = 0; i < N_DECISIONS; i++) {
+        n += n_decisions[i];
+    }
+    json_object_put(report, "packets", json_integer_create(n));
+    json_object_put(report, "seconds", json_real_create(secs));
+    json_object_put(report, "packets_per_sec",
+                    json_real_create(secs > 0 ? n / secs : 0.0));
+
+    s = json_to_string(report, JSSF_PRETTY | JSSF_SORT);
+    puts(s);
+    free(s);
+    json_destroy(report);
+
+    return 0;
+}
+
+static void
+parse_options(int argc, char *argv[])
+{
+    enum {
+        OPT_FLOWS = UCHAR_MAX + 1,
+        OPT_PORTS,
+        OPT_IN_PORT,
+        OPT_SPEED,
+        OPT_RATE,
+        OPT_LOOP,
+        OPT_OUTPUT
+    };
+    static struct option long_options[] = {
+        {"flows", required_argument, NULL, OPT_FLOWS},
+        {"ports", required_argument, NULL, OPT_PORTS},
+        {"in-port", required_argument, NULL, OPT_IN_PORT},
+        {"speed", required_argument, NULL, OPT_SPEED},
+        {"rate", required_argument, NULL, OPT_RATE},
+        {"loop", required_argument, NULL, OPT_LOOP},
+        {"output", required_argument, NULL, OPT_OUTPUT},
+        {"decisions", no_argument, NULL, 'd'},
+        {"verbose", optional_argument, NULL, 'v'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    char *short_options = long_options_to_short_options(long_options);
+
+    for (;;) {
+        int c = getopt_long(argc, argv, short_options, long_options, NULL);
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+        case OPT_FLOWS:
+            flows_file_name = optarg;
+            break;
+
+        case OPT_PORTS:
+            n_ports = atoi(optarg);
+            if (n_ports < 1) {
+                ovs_fatal(0, "--ports argument must be positive");
+            }
+            break;
+
+        case OPT_IN_PORT:
+            in_port = atoi(optarg);
+            break;
+
+        case OPT_SPEED:
+            speed = atof(optarg);
+            if (speed <= 0) {
+                ovs_fatal(0, "--speed argument must be positive");
+            }
+            break;
+
+        case OPT_RATE:
+            rate = atof(optarg);
+            if (rate <= 0) {
+                ovs_fatal(0, "--rate argument must be positive");
+            }
+            break;
+
+        case OPT_LOOP:
+            n_loops = atoi(optarg);
+            if (n_loops < 1) {
+                ovs_fatal(0, "--loop argument must be positive");
+            }
+            break;
+
+        case OPT_OUTPUT:
+            output_netdev = optarg;
+            break;
+
+        case 'd':
+            print_decisions = true;
+            break;
+
+        case 'v':
+            vlog_set_verbosity(optarg);
+            break;
+
+        case 'h':
+            usage();
+
+        case '?':
+            exit(EXIT_FAILURE);
+
+        default:
+            abort();
+        }
+    }
+    free(short_options);
+
+    if (in_port < 1 || in_port > n_ports) {
+        ovs_fatal(0, "--in-port must be between 1 and the number of ports");
+    }
+}
+
+static void
+usage(void)
+{
+    printf("%s: replays a pcap file into a bridge\n"
+           "usage: %s [OPTIONS] PCAP\n"
+           "\nBridge options:\n"
+           "  --flows=FILE            add OpenFlow flows in FILE "
+           "(default: actions=FLOOD)\n"
+           "  --ports=N               create N ports p1...pN (default: 2)\n"
+           "  --in-port=N             receive packets on port N "
+           "(default: 1)\n"
+           "  -d, --decisions         print the decision for each packet\n"
+           "\nReplay options:\n"
+           "  --speed=X               replay at X times captured speed\n"
+           "  --rate=PPS              replay at PPS packets per second\n"
+           "  --loop=N                replay the file N times\n"
+           "  --output=NETDEV         send on NETDEV instead of a bridge\n"
+           "\nOther options:\n"
+           "  -v, --verbose=MODULE[:FACILITY[:LEVEL]]  set logging levels\n"
+           "  -h, --help              display this help message\n",
+           program_name, program_name);
+    exit(EXIT_SUCCESS);
+}
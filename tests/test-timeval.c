@@ -23,6 +23,7 @@
 #include <stdlib.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "command-line.h"
@@ -81,11 +82,81 @@ do_test(void)
     }
 }
 
+/* Checks that, with the given time 'source', time advances without the
+ * periodic timer signal. */
+static void
+do_direct_test(const char *source)
+{
+    long long int start_time_msec, start_time_usec;
+    struct timespec delay;
+    struct timeval timeout;
+
+    if (!time_set_source(source)) {
+        /* Not supported on this platform: skip the test. */
+        exit(77);
+    }
+    assert(!strcmp(time_get_source(), source));
+
+    /* Sleep for 100 ms, without being interrupted by SIGALRM. */
+    start_time_msec = time_msec();
+    start_time_usec = time_usec();
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 100 * 1000;
+    assert(!select(0, NULL, NULL, NULL, &timeout));
+
+    /* The coarse clocks lag by up to a timer tick. */
+    assert(time_msec() - start_time_msec >= 90);
+    assert(time_usec() - start_time_usec >= 100 * 1000);
+
+    /* The time advances between calls, without time_refresh(). */
+    start_time_usec = time_usec();
+    start_time_msec = time_msec();
+    delay.tv_sec = 0;
+    delay.tv_nsec = 20 * 1000 * 1000;
+    nanosleep(&delay, NULL);
+    assert(time_msec() > start_time_msec);
+    assert(time_usec() > start_time_usec);
+}
+
+/* Prints the cost of time_msec() with each time source, and of time_usec(),
+ * averaged over 'n' calls. */
+static void
+do_benchmark(int n)
+{
+    static const char *sources[] = { "cached", "direct", "coarse" };
+    volatile long long int sink;
+    long long int start;
+    size_t i;
+    int j;
+
+    for (i = 0; i < ARRAY_SIZE(sources); i++) {
+        if (!time_set_source(sources[i])) {
+            printf("%s: not supported\n", sources[i]);
+            continue;
+        }
+
+        start = time_usec();
+        for (j = 0; j < n; j++) {
+            sink = time_msec();
+        }
+        printf("%s: time_msec() %.1f ns per call\n", sources[i],
+               (time_usec() - start) * 1000.0 / n);
+    }
+
+    start = time_usec();
+    for (j = 0; j < n; j++) {
+        sink = time_usec();
+    }
+    printf("time_usec() %.1f ns per call\n",
+           (time_usec() - start) * 1000.0 / n);
+    (void) sink;
+}
+
 static void
 usage(void)
 {
-    ovs_fatal(0, "usage: %s TEST, where TEST is \"plain\" or \"daemon\"",
-              program_name);
+    ovs_fatal(0, "usage: %s TEST, where TEST is \"plain\", \"daemon\", "
+              "\"direct\", \"coarse\", or \"benchmark N\"", program_name);
 }
 
 int
@@ -94,8 +165,12 @@ main(int argc, char *argv[])
     proctitle_init(argc, argv);
     set_program_name(argv[0]);
 
-    if (argc != 2) {
+    if (argc == 3 && !strcmp(argv[1], "benchmark")) {
+        do_benchmark(atoi(argv[2]));
+    } else if (argc != 2) {
         usage();
+    } else if (!strcmp(argv[1], "direct") || !strcmp(argv[1], "coarse")) {
+        do_direct_test(argv[1]);
     } else if (!strcmp(argv[1], "plain")) {
         do_test();
     } else if (!strcmp(argv[1], "daemon")) {
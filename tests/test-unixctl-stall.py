@@ -0,0 +1,57 @@
+# Copyright (c) 2011 Nicira Networks.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at:
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+import socket
+import subprocess
+import sys
+
+def main(argv):
+    if len(argv) != 5:
+        sys.stderr.write("usage: %s SOCKET COMMAND N_LINES SHELL-COMMAND\n"
+                         "Sends COMMAND to the unixctl server on SOCKET, "
+                         "reads the status\nline and N_LINES lines of the "
+                         "reply, then runs SHELL-COMMAND before\nreading "
+                         "the rest of the reply.  Copies the reply to "
+                         "stdout.\n" % argv[0])
+        sys.exit(1)
+    sock_name, command, n_lines, shell_command = argv[1:]
+
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    sock.connect(sock_name)
+    sock.sendall(command + "\n")
+
+    # Read unbuffered, so that the server sees the rest of the reply stall.
+    reply = sock.makefile("r", 0)
+    for i in range(int(n_lines) + 1):
+        sys.stdout.write(reply.readline())
+    sys.stdout.flush()
+
+    status = subprocess.call(shell_command, shell=True)
+    if status:
+        sys.stderr.write("%s: \"%s\" exited with status %d\n"
+                         % (argv[0], shell_command, status))
+        sys.exit(1)
+
+    # The reply ends with a line containing just ".", or at end of file if
+    # the server goes away first.
+    while True:
+        line = reply.readline()
+        if not line:
+            break
+        sys.stdout.write(line)
+        if line == ".\n":
+            break
+
+if __name__ == '__main__':
+    main(sys.argv)
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2011 Nicira Networks.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <config.h>
+
+#include "vlog.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dynamic-string.h"
+#include "histogram.h"
+#include "timeval.h"
+#include "util.h"
+
+VLOG_DEFINE_THIS_MODULE(test_vlog);
+
+static void
+usage(void)
+{
+    ovs_fatal(0, "usage: %s benchmark FILE N sync|async\n"
+              "       %s fatal FILE N", program_name, program_name);
+}
+
+/* Logs only to 'file_name'. */
+static void
+log_to_file(const char *file_name)
+{
+    int error;
+
+    vlog_set_levels(NULL, VLF_CONSOLE, VLL_OFF);
+    vlog_set_levels(NULL, VLF_SYSLOG, VLL_OFF);
+    vlog_set_levels(NULL, VLF_FILE, VLL_INFO);
+    error = vlog_set_log_file(file_name);
+    if (error) {
+        ovs_fatal(error, "%s: open failed", file_name);
+    }
+}
+
+static void
+enable_async(void)
+{
+    int error = vlog_set_async(true);
+    if (error == EOPNOTSUPP) {
+        /* Not supported in this build: skip the test. */
+        exit(77);
+    } else if (error) {
+        ovs_fatal(error, "failed to enable asynchronous logging");
+    }
+}
+
+/* Logs 'n' messages to 'file_name' and prints the latency of the logging
+ * calls. */
+static void
+do_benchmark(const char *file_name, int n, bool async)
+{
+    struct histogram latency;
+    struct ds s;
+    int i;
+
+    log_to_file(file_name);
+    if (async) {
+        enable_async();
+    }
+
+    histogram_clear(&latency);
+    for (i = 0; i < n; i++) {
+        long long int start = time_usec();
+        VLOG_INFO("benchmark message %d", i);
+        histogram_add(&latency, time_usec() - start);
+    }
+    vlog_set_async(false);
+
+    ds_init(&s);
+    ds_put_format(&s, "%d %s messages, usec per call: p50 %llu, p99 %llu, "
+                  "max %llu; %llu dropped\n", n, async ? "async" : "sync",
+                  histogram_percentile(&latency, 50),
+                  histogram_percentile(&latency, 99), latency.max,
+                  vlog_get_async_dropped());
+    fputs(ds_cstr(&s), stdout);
+    ds_destroy(&s);
+}
+
+/* Logs 'n' messages to 'file_name' asynchronously, then dies with a fatal
+ * error, to check that the queued messages are not lost. */
+static void
+do_fatal(const char *file_name, int n)
+{
+    int i;
+
+    log_to_file(file_name);
+    enable_async();
+    for (i = 0; i < n; i++) {
+        VLOG_INFO("queued message %d", i);
+    }
+    VLOG_FATAL("fatal message");
+}
+
+int
+main(int argc, char *argv[])
+{
+    set_program_name(argv[0]);
+    if (argc == 5 && !strcmp(argv[1], "benchmark")
+        && (!strcmp(argv[4], "sync") || !strcmp(argv[4], "async"))) {
+        do_benchmark(argv[2], atoi(argv[3]), !strcmp(argv[4], "async"));
+    } else if (argc == 4 && !strcmp(argv[1], "fatal")) {
+        do_fatal(argv[2], atoi(argv[3]));
+    } else {
+        usage();
+    }
+    return 0;
+}
@@ -19,14 +19,25 @@
 #include <errno.h>
 #include <getopt.h>
 #include <limits.h>
+#include <net/if.h>
 #include <poll.h>
 #include <stdlib.h>
+#include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <stddef.h>
+#include <time.h>
 #include <unistd.h>
+#ifdef __linux__
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#endif
 
+#include "byte-order.h"
 #include "command-line.h"
+#include "csum.h"
+#include "histogram.h"
+#include "packets.h"
 #include "poll-loop.h"
 #include "socket-util.h"
 #include "timeval.h"
@@ -49,6 +60,22 @@ static double max_rate;
 
 static double timeout;
 
+#define DEFAULT_PACKETS 10000
+static unsigned int n_flows = 1;
+static unsigned long long int n_packets;
+static unsigned int packet_size = 64;
+
+/* Identifies packets generated by ovs-benchmark. */
+#define BENCH_MAGIC 0x6f76732dU
+
+/* Header at the start of the UDP payload of each generated packet.  Always
+ * copied in and out with memcpy(), since it is often misaligned. */
+struct bench_header {
+    ovs_be32 magic;             /* BENCH_MAGIC. */
+    ovs_be32 seq;               /* Sequence number, starting from 0. */
+    ovs_be64 timestamp;         /* Time when sent, in nanoseconds. */
+};
+
 static const struct command all_commands[];
 
 static void parse_options(int argc, char *argv[]);
@@ -125,6 +152,9 @@ parse_options(int argc, char *argv[])
         {"sockets", required_argument, NULL, 's'},
         {"max-rate", required_argument, NULL, 'c'},
         {"timeout", required_argument, NULL, 'T'},
+        {"flows", required_argument, NULL, 'f'},
+        {"packets", required_argument, NULL, 'n'},
+        {"size", required_argument, NULL, 'S'},
         {"help", no_argument, NULL, 'h'},
         {"version", no_argument, NULL, 'V'},
         {NULL, 0, NULL, 0},
@@ -188,6 +218,27 @@ parse_options(int argc, char *argv[])
             }
             break;
 
+        case 'f':
+            n_flows = atoi(optarg);
+            if (!n_flows) {
+                ovs_fatal(0, "--flows or -f argument must be positive");
+            }
+            break;
+
+        case 'n':
+            n_packets = strtoull(optarg, NULL, 10);
+            break;
+
+        case 'S':
+            packet_size = atoi(optarg);
+            if (packet_size < sizeof(struct bench_header)
+                || packet_size > 65507) {
+                ovs_fatal(0, "--size or -S argument must be between %zu "
+                          "and 65507 (inclusive)",
+                          sizeof(struct bench_header));
+            }
+            break;
+
         case 'h':
             usage();
 
@@ -214,6 +265,9 @@ usage: %s [OPTIONS] COMMAND [ARG...]\n\
   latency                     connect many times all at once\n\
   rate                        measure sustained flow setup rate\n\
   listen                      accept TCP connections\n\
+  udp                         send UDP packets, measure latency and loss\n\
+  raw TXDEV [RXDEV]           send raw frames on TXDEV, receive on RXDEV\n\
+  echo                        echo UDP packets back to their senders\n\
   help                        display this help message\n\
 \n\
 Command options:\n\
@@ -223,11 +277,18 @@ Command options:\n\
   -b, --batches N             number of connection batches for \"latency\"\n\
   -c, --max-rate NPERSEC      connection rate limit for \"rate\"\n\
   -T, --timeout MAXSECS       max number of seconds to run for \"rate\"\n\
+                              or to send for \"udp\" and \"raw\"\n\
+\n\
+Traffic generator options (\"udp\" and \"raw\"):\n\
+  -f, --flows N               number of distinct 5-tuples (default: 1)\n\
+  -n, --packets N             number of packets to send (default: %d)\n\
+  -S, --size BYTES            UDP payload size (default: 64)\n\
+  -c, --max-rate NPERSEC      packet rate limit\n\
 \n\
 Other options:\n\
   -h, --help                  display this help message\n\
   -V, --version               display version information\n",
-           program_name, program_name);
+           program_name, program_name, DEFAULT_PACKETS);
     exit(EXIT_SUCCESS);
 }
 
@@ -604,6 +665,518 @@ cmd_latency(int argc OVS_UNUSED, char *argv[] OVS_UNUSED)
            min, max, total / (1ULL * n_sockets * n_batches));
 }
 
+/* Traffic generation, for the "udp", "raw", and "echo" commands. */
+
+/* Time to keep waiting for packets after sending the last one, in ms. */
+#define LINGER_MSEC 1000
+
+/* Maximum number of packets to send between checks for received packets. */
+#define SEND_BATCH 64
+
+/* Offsets of the headers in frames sent and received by "raw". */
+#define RAW_IP_OFS ETH_HEADER_LEN
+#define RAW_UDP_OFS (RAW_IP_OFS + IP_HEADER_LEN)
+#define RAW_PAYLOAD_OFS (RAW_UDP_OFS + UDP_HEADER_LEN)
+
+struct generator {
+    /* Sends 'packet' on the flow numbered 'flow'.  Returns 0 if successful,
+     * EAGAIN if the packet should be retried later, otherwise a positive
+     * errno value. */
+    int (*send)(struct generator *, unsigned int flow);
+
+    uint8_t *packet;            /* Packet to send. */
+    size_t size;                /* Number of bytes in 'packet'. */
+    size_t ofs;                 /* Offset of bench_header in packets. */
+    int tx_fd;                  /* Socket for sending, for "raw". */
+
+    struct pollfd *fds;         /* Sockets on which packets come back. */
+    int n_fds;
+
+    /* Statistics. */
+    unsigned long long int n_sent;
+    unsigned long long int n_received;
+    long long int send_nsec;    /* Time spent sending, in nanoseconds. */
+    unsigned long long int min_latency; /* Minimum latency, in usec. */
+    struct histogram latency;   /* Latencies, in microseconds. */
+};
+
+static long long int
+time_in_nsec(void)
+{
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0) {
+        ovs_fatal(errno, "clock_gettime");
+    }
+
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void
+gen_init(struct generator *gen, size_t ofs)
+{
+    memset(gen, 0, sizeof *gen);
+    gen->ofs = ofs;
+    gen->size = ofs + packet_size;
+    gen->packet = xzalloc(gen->size);
+    gen->tx_fd = -1;
+    gen->min_latency = ULLONG_MAX;
+    histogram_clear(&gen->latency);
+
+    if (!n_packets && !timeout) {
+        n_packets = DEFAULT_PACKETS;
+    }
+}
+
+static void
+gen_destroy(struct generator *gen)
+{
+    int i;
+
+    for (i = 0; i < gen->n_fds; i++) {
+        close(gen->fds[i].fd);
+    }
+    if (gen->tx_fd >= 0) {
+        close(gen->tx_fd);
+    }
+    free(gen->fds);
+    free(gen->packet);
+}
+
+/* Returns true if 'sa' says that a packet received on a packet socket was
+ * sent by this host, rather than received from the network. */
+static bool
+is_outgoing(const struct sockaddr_storage *ss OVS_UNUSED)
+{
+#ifdef __linux__
+    if (ss->ss_family == AF_PACKET) {
+        const struct sockaddr_ll *sll = (const struct sockaddr_ll *) ss;
+        return sll->sll_pkttype == PACKET_OUTGOING;
+    }
+#endif
+    return false;
+}
+
+/* Receives all of the packets waiting on 'fd' and records the latency of
+ * those that 'gen' sent. */
+static void
+gen_receive(struct generator *gen, int fd)
+{
+    static uint8_t buf[65536];
+
+    for (;;) {
+        struct sockaddr_storage ss;
+        socklen_t ss_len = sizeof ss;
+        struct bench_header hdr;
+        unsigned long long int latency;
+        ssize_t retval;
+
+        retval = recvfrom(fd, buf, sizeof buf, 0,
+                          (struct sockaddr *) &ss, &ss_len);
+        if (retval < 0) {
+            if (errno == EINTR || errno == ECONNREFUSED) {
+                continue;
+            } else if (errno == EAGAIN) {
+                return;
+            }
+            ovs_fatal(errno, "recv failed");
+        }
+
+        if (is_outgoing(&ss) || retval < gen->ofs + sizeof hdr) {
+            continue;
+        }
+        memcpy(&hdr, &buf[gen->ofs], sizeof hdr);
+        if (hdr.magic != htonl(BENCH_MAGIC)) {
+            continue;
+        }
+
+        latency = (time_in_nsec() - ntohll(hdr.timestamp)) / 1000;
+        histogram_add(&gen->latency, latency);
+        gen->min_latency = MIN(gen->min_latency, latency);
+        gen->n_received++;
+    }
+}
+
+/* Sends packets with 'gen', round-robin among 'n_flows' flows, until
+ * 'n_packets' have been sent or 'timeout' seconds have passed, while
+ * receiving any packets that come back.  Then waits up to LINGER_MSEC for the
+ * rest of the packets to come back. */
+static void
+run_generator(struct generator *gen)
+{
+    long long int start, deadline, linger_end;
+    bool sending = true;
+
+    start = time_in_nsec();
+    deadline = timeout ? start + timeout * 1000000000LL : LLONG_MAX;
+    linger_end = LLONG_MAX;
+    for (;;) {
+        long long int now = time_in_nsec();
+        int delay = 0;
+        int error;
+        int i;
+
+        if (sending) {
+            unsigned long long int limit = n_packets ? n_packets : ULLONG_MAX;
+            int n;
+
+            if (max_rate > 0) {
+                limit = MIN(limit, (now - start) / 1e9 * max_rate + 1);
+            }
+            for (n = 0; n < SEND_BATCH && gen->n_sent < limit; n++) {
+                struct bench_header hdr;
+
+                hdr.magic = htonl(BENCH_MAGIC);
+                hdr.seq = htonl(gen->n_sent);
+                hdr.timestamp = htonll(time_in_nsec());
+                memcpy(&gen->packet[gen->ofs], &hdr, sizeof hdr);
+
+                error = gen->send(gen, gen->n_sent % n_flows);
+                if (error == EAGAIN || error == ENOBUFS) {
+                    delay = 1;
+                    break;
+                } else if (error && error != ECONNREFUSED) {
+                    ovs_fatal(error, "send failed");
+                }
+                gen->n_sent++;
+            }
+
+            now = time_in_nsec();
+            if ((n_packets && gen->n_sent >= n_packets) || now >= deadline) {
+                sending = false;
+                gen->send_nsec = now - start;
+                linger_end = now + LINGER_MSEC * 1000000LL;
+            } else if (gen->n_sent >= limit) {
+                long long int next = start + (gen->n_sent / max_rate) * 1e9;
+                delay = MAX(0, (next - now) / 1000000);
+            }
+        }
+        if (!sending) {
+            if (!gen->n_fds || gen->n_received >= gen->n_sent
+                || now >= linger_end) {
+                break;
+            }
+            delay = (linger_end - now) / 1000000 + 1;
+        }
+
+        do {
+            error = poll(gen->fds, gen->n_fds, delay) < 0 ? errno : 0;
+        } while (error == EINTR);
+        if (error) {
+            ovs_fatal(error, "poll");
+        }
+        for (i = 0; i < gen->n_fds; i++) {
+            if (gen->fds[i].revents) {
+                gen_receive(gen, gen->fds[i].fd);
+            }
+        }
+    }
+}
+
+static void
+gen_report(const struct generator *gen)
+{
+    double secs = gen->send_nsec / 1e9;
+
+    printf("sent %llu packets on %u flows in %.3f s (%.1f packets/s)\n",
+           gen->n_sent, n_flows, secs, secs > 0 ? gen->n_sent / secs : 0.0);
+    if (gen->n_fds) {
+        unsigned long long int lost;
+        const struct histogram *h = &gen->latency;
+
+        lost = (gen->n_sent > gen->n_received
+                ? gen->n_sent - gen->n_received
+                : 0);
+        printf("received %llu packets, lost %llu (%.2f%%)\n",
+               gen->n_received, lost,
+               gen->n_sent ? 100.0 * lost / gen->n_sent : 0.0);
+        if (h->n) {
+            printf("latency: min %llu us, p50 %llu us, p90 %llu us, "
+                   "p99 %llu us, p99.9 %llu us, max %llu us\n",
+                   gen->min_latency,
+                   histogram_percentile(h, 50), histogram_percentile(h, 90),
+                   histogram_percentile(h, 99), histogram_permille(h, 999),
+                   h->max);
+        }
+    }
+}
+
+/* Opens and returns a nonblocking UDP socket bound to 'addr' and 'port'. */
+static int
+open_udp_socket(struct in_addr addr, unsigned short int port)
+{
+    struct sockaddr_in sin;
+    int bufsize = 1024 * 1024;
+    int error;
+    int fd;
+
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        ovs_fatal(errno, "failed to create socket");
+    }
+    error = set_nonblocking(fd);
+    if (error) {
+        ovs_fatal(error, "failed to set non-blocking mode");
+    }
+
+    /* Larger buffers make loss less likely at high rates.  Not fatal if it
+     * fails. */
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof bufsize);
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof bufsize);
+
+    memset(&sin, 0, sizeof sin);
+    sin.sin_family = AF_INET;
+    sin.sin_addr = addr;
+    sin.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr *) &sin, sizeof sin) < 0) {
+        ovs_fatal(errno, "bind failed");
+    }
+
+    return fd;
+}
+
+/* Flow 'flow' uses socket 'flow % n_fds' and the remote port that is
+ * 'flow / n_fds' past the minimum. */
+static int
+udp_send(struct generator *gen, unsigned int flow)
+{
+    struct sockaddr_in remote;
+    int fd = gen->fds[flow % gen->n_fds].fd;
+
+    memset(&remote, 0, sizeof remote);
+    remote.sin_family = AF_INET;
+    remote.sin_addr = remote_addr;
+    remote.sin_port = htons(remote_min_port + flow / gen->n_fds);
+    return (sendto(fd, gen->packet, gen->size, 0,
+                   (struct sockaddr *) &remote, sizeof remote) < 0
+            ? errno : 0);
+}
+
+static void
+cmd_udp(int argc OVS_UNUSED, char *argv[] OVS_UNUSED)
+{
+    struct generator gen;
+    unsigned int n_remote_ports;
+    int i;
+
+    if (!remote_addr.s_addr) {
+        ovs_fatal(0, "remote address must be specified with -r or --remote");
+    }
+
+    gen_init(&gen, 0);
+    gen.send = udp_send;
+    gen.n_fds = MIN(n_sockets, n_flows);
+
+    /* Each socket sends to enough remote ports to make 'n_flows' distinct
+     * 5-tuples. */
+    n_remote_ports = DIV_ROUND_UP(n_flows, gen.n_fds);
+    if (!remote_min_port && !remote_max_port) {
+        if (n_remote_ports > UINT16_MAX - DEFAULT_PORT + 1) {
+            ovs_fatal(0, "%u flows require too many remote ports; "
+                      "use more sockets", n_flows);
+        }
+        remote_min_port = DEFAULT_PORT;
+        remote_max_port = DEFAULT_PORT + n_remote_ports - 1;
+    } else if (remote_max_port - remote_min_port + 1 < n_remote_ports) {
+        ovs_fatal(0, "%u flows on %d sockets require %u remote ports",
+                  n_flows, gen.n_fds, n_remote_ports);
+    }
+    if ((local_min_port || local_max_port)
+        && local_max_port - local_min_port + 1 < gen.n_fds) {
+        ovs_fatal(0, "%d sockets require %d local ports",
+                  gen.n_fds, gen.n_fds);
+    }
+
+    gen.fds = xmalloc(gen.n_fds * sizeof *gen.fds);
+    for (i = 0; i < gen.n_fds; i++) {
+        unsigned short int port = local_min_port ? local_min_port + i : 0;
+
+        gen.fds[i].fd = open_udp_socket(local_addr, port);
+        gen.fds[i].events = POLLIN;
+        gen.fds[i].revents = 0;
+    }
+
+    run_generator(&gen);
+    gen_report(&gen);
+    gen_destroy(&gen);
+}
+
+#ifdef __linux__
+/* Opens a packet socket bound to 'netdev' that receives all protocols if
+ * 'rx' is true, otherwise none.  Stores the index of 'netdev' in '*ifindex'
+ * and its Ethernet address in 'mac'. */
+static int
+open_packet_socket(const char *netdev, bool rx, uint8_t mac[ETH_ADDR_LEN])
+{
+    ovs_be16 protocol = rx ? htons(ETH_P_ALL) : 0;
+    struct sockaddr_ll sll;
+    struct ifreq ifr;
+    int error;
+    int fd;
+
+    fd = socket(AF_PACKET, SOCK_RAW, protocol);
+    if (fd < 0) {
+        ovs_fatal(errno, "failed to create packet socket");
+    }
+    error = set_nonblocking(fd);
+    if (error) {
+        ovs_fatal(error, "failed to set non-blocking mode");
+    }
+
+    memset(&ifr, 0, sizeof ifr);
+    ovs_strzcpy(ifr.ifr_name, netdev, sizeof ifr.ifr_name);
+    if (ioctl(fd, SIOCGIFHWADDR, &ifr) < 0) {
+        ovs_fatal(errno, "%s: failed to get Ethernet address", netdev);
+    }
+    memcpy(mac, ifr.ifr_hwaddr.sa_data, ETH_ADDR_LEN);
+
+    memset(&sll, 0, sizeof sll);
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = protocol;
+    sll.sll_ifindex = if_nametoindex(netdev);
+    if (!sll.sll_ifindex) {
+        ovs_fatal(errno, "%s: no such network device", netdev);
+    }
+    if (bind(fd, (struct sockaddr *) &sll, sizeof sll) < 0) {
+        ovs_fatal(errno, "%s: bind failed", netdev);
+    }
+
+    return fd;
+}
+
+/* Flow 'flow' uses the UDP source port that is 'flow % 64512' past 1024 and
+ * the source IP address that is 'flow / 64512' past the local address. */
+static int
+raw_send(struct generator *gen, unsigned int flow)
+{
+    struct ip_header *ip = (struct ip_header *) &gen->packet[RAW_IP_OFS];
+    struct udp_header *udp = (struct udp_header *) &gen->packet[RAW_UDP_OFS];
+
+    ip->ip_src = htonl(ntohl(local_addr.s_addr) + flow / 64512);
+    ip->ip_csum = 0;
+    ip->ip_csum = csum(ip, sizeof *ip);
+    udp->udp_src = htons(1024 + flow % 64512);
+
+    return send(gen->tx_fd, gen->packet, gen->size, 0) < 0 ? errno : 0;
+}
+
+static void
+cmd_raw(int argc, char *argv[])
+{
+    uint8_t src_mac[ETH_ADDR_LEN], dst_mac[ETH_ADDR_LEN];
+    struct eth_header *eth;
+    struct ip_header *ip;
+    struct udp_header *udp;
+    struct generator gen;
+
+    if (!remote_addr.s_addr) {
+        ovs_fatal(0, "remote address must be specified with -r or --remote");
+    }
+    if (!remote_min_port && !remote_max_port) {
+        remote_min_port = DEFAULT_PORT;
+    }
+
+    gen_init(&gen, RAW_PAYLOAD_OFS);
+    gen.send = raw_send;
+    gen.tx_fd = open_packet_socket(argv[1], false, src_mac);
+    if (argc > 2) {
+        gen.n_fds = 1;
+        gen.fds = xmalloc(sizeof *gen.fds);
+        gen.fds[0].fd = open_packet_socket(argv[2], true, dst_mac);
+        gen.fds[0].events = POLLIN;
+        gen.fds[0].revents = 0;
+    } else {
+        memset(dst_mac, 0xff, ETH_ADDR_LEN);
+    }
+
+    eth = (struct eth_header *) gen.packet;
+    memcpy(eth->eth_dst, dst_mac, ETH_ADDR_LEN);
+    memcpy(eth->eth_src, src_mac, ETH_ADDR_LEN);
+    eth->eth_type = htons(ETH_TYPE_IP);
+
+    ip = (struct ip_header *) &gen.packet[RAW_IP_OFS];
+    ip->ip_ihl_ver = IP_IHL_VER(5, 4);
+    ip->ip_tot_len = htons(gen.size - RAW_IP_OFS);
+    ip->ip_frag_off = htons(IP_DONT_FRAGMENT);
+    ip->ip_ttl = 64;
+    ip->ip_proto = IPPROTO_UDP;
+    ip->ip_dst = remote_addr.s_addr;
+
+    udp = (struct udp_header *) &gen.packet[RAW_UDP_OFS];
+    udp->udp_dst = htons(remote_min_port);
+    udp->udp_len = htons(gen.size - RAW_UDP_OFS);
+
+    run_generator(&gen);
+    gen_report(&gen);
+    gen_destroy(&gen);
+}
+#else  /* !__linux__ */
+static void
+cmd_raw(int argc OVS_UNUSED, char *argv[] OVS_UNUSED)
+{
+    ovs_fatal(0, "the \"raw\" command is supported only on Linux");
+}
+#endif  /* !__linux__ */
+
+static void
+cmd_echo(int argc OVS_UNUSED, char *argv[] OVS_UNUSED)
+{
+    struct pollfd *fds;
+    int n_fds;
+    int port;
+    int i;
+
+    if (!local_min_port && !local_max_port) {
+        local_min_port = local_max_port = DEFAULT_PORT;
+    }
+    fds = xmalloc((1 + local_max_port - local_min_port) * sizeof *fds);
+    n_fds = 0;
+    for (port = local_min_port; port <= local_max_port; port++) {
+        fds[n_fds].fd = open_udp_socket(local_addr, port);
+        fds[n_fds].events = POLLIN;
+        n_fds++;
+    }
+
+    for (;;) {
+        int retval;
+
+        do {
+            retval = poll(fds, n_fds, -1);
+        } while (retval < 0 && errno == EINTR);
+        if (retval < 0) {
+            ovs_fatal(errno, "poll failed");
+        }
+
+        for (i = 0; i < n_fds; i++) {
+            static uint8_t buf[65536];
+
+            if (!(fds[i].revents & POLLIN)) {
+                continue;
+            }
+            for (;;) {
+                struct sockaddr_in sin;
+                socklen_t sin_len = sizeof sin;
+                ssize_t n;
+
+                n = recvfrom(fds[i].fd, buf, sizeof buf, 0,
+                             (struct sockaddr *) &sin, &sin_len);
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    } else if (errno != EAGAIN) {
+                        ovs_fatal(errno, "recv failed");
+                    }
+                    break;
+                }
+
+                /* Drop the reply if the send buffer is full. */
+                sendto(fds[i].fd, buf, n, 0, (struct sockaddr *) &sin,
+                       sin_len);
+            }
+        }
+    }
+}
+
 static void
 cmd_help(int argc OVS_UNUSED, char *argv[] OVS_UNUSED)
 {
@@ -614,6 +1187,9 @@ static const struct command all_commands[] = {
     { "listen", 0, 0, cmd_listen },
     { "rate", 0, 0, cmd_rate },
     { "latency", 0, 0, cmd_latency },
+    { "udp", 0, 0, cmd_udp },
+    { "raw", 1, 2, cmd_raw },
+    { "echo", 0, 0, cmd_echo },
     { "help", 0, 0, cmd_help },
     { NULL, 0, 0, NULL },
 };
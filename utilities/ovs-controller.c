@@ -19,14 +19,17 @@
 #include <errno.h>
 #include <getopt.h>
 #include <limits.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "command-line.h"
 #include "compiler.h"
 #include "daemon.h"
+#include "fatal-signal.h"
 #include "learning-switch.h"
 #include "ofp-parse.h"
 #include "ofpbuf.h"
@@ -34,6 +37,7 @@
 #include "poll-loop.h"
 #include "rconn.h"
 #include "shash.h"
+#include "socket-util.h"
 #include "stream-ssl.h"
 #include "timeval.h"
 #include "unixctl.h"
@@ -85,6 +89,20 @@ static struct list default_flows = LIST_INITIALIZER(&default_flows);
 /* --unixctl: Name of unixctl socket, or null to use the default. */
 static char *unixctl_path = NULL;
 
+/* --workers: Number of processes among which to divide the switches. */
+static int n_workers = 1;
+
+/* --batch: Maximum number of messages to process from a switch before sending
+ * the replies to them in a single transmission, or 0 to send each reply
+ * immediately. */
+static int batch_size = 0;
+
+/* In a worker process other than the first, the read end of a pipe whose
+ * write end is held by the first process, so that the worker can exit when
+ * the first process does.  Otherwise, -1. */
+static int parent_fd = -1;
+
+static int start_workers(void);
 static int do_switching(struct switch_ *);
 static void new_switch(struct switch_ *, struct vconn *);
 static void parse_options(int argc, char *argv[]);
@@ -96,7 +114,9 @@ main(int argc, char *argv[])
     struct unixctl_server *unixctl;
     struct switch_ switches[MAX_SWITCHES];
     struct pvconn *listeners[MAX_LISTENERS];
-    int n_switches, n_listeners;
+    struct vconn *vconns[MAX_SWITCHES];
+    int n_switches, n_listeners, n_vconns;
+    int worker;
     int retval;
     int i;
 
@@ -110,17 +130,17 @@ main(int argc, char *argv[])
                   "use --help for usage");
     }
 
-    n_switches = n_listeners = 0;
+    n_vconns = n_listeners = 0;
     for (i = optind; i < argc; i++) {
         const char *name = argv[i];
         struct vconn *vconn;
 
         retval = vconn_open(name, OFP_VERSION, &vconn);
         if (!retval) {
-            if (n_switches >= MAX_SWITCHES) {
-                ovs_fatal(0, "max %d switch connections", n_switches);
+            if (n_vconns >= MAX_SWITCHES) {
+                ovs_fatal(0, "max %d switch connections", n_vconns);
             }
-            new_switch(&switches[n_switches++], vconn);
+            vconns[n_vconns++] = vconn;
             continue;
         } else if (retval == EAFNOSUPPORT) {
             struct pvconn *pvconn;
@@ -136,22 +156,47 @@ main(int argc, char *argv[])
             VLOG_ERR("%s: connect: %s", name, strerror(retval));
         }
     }
-    if (n_switches == 0 && n_listeners == 0) {
+    if (n_vconns == 0 && n_listeners == 0) {
         ovs_fatal(0, "no active or passive switch connections");
     }
 
     daemonize_start();
 
-    retval = unixctl_server_create(unixctl_path, &unixctl);
-    if (retval) {
-        exit(EXIT_FAILURE);
+    /* Each worker handles every n_workers'th active connection and accepts
+     * connections on all of the listeners. */
+    worker = start_workers();
+    n_switches = 0;
+    for (i = 0; i < n_vconns; i++) {
+        if (i % n_workers == worker) {
+            new_switch(&switches[n_switches++], vconns[i]);
+        } else {
+            vconn_close(vconns[i]);
+        }
     }
 
-    daemonize_complete();
+    if (!worker) {
+        retval = unixctl_server_create(unixctl_path, &unixctl);
+        if (retval) {
+            exit(EXIT_FAILURE);
+        }
+
+        daemonize_complete();
+    } else {
+        unixctl = NULL;
+    }
 
     while (n_switches > 0 || n_listeners > 0) {
         int iteration;
 
+        if (parent_fd >= 0) {
+            char c;
+
+            if (read(parent_fd, &c, 1) == 0) {
+                /* The first process exited, so we should too. */
+                exit(0);
+            }
+        }
+
         /* Accept connections on listening vconns. */
         for (i = 0; i < n_listeners && n_switches < MAX_SWITCHES; ) {
             struct vconn *new_vconn;
@@ -196,7 +241,9 @@ main(int argc, char *argv[])
             lswitch_run(this->lswitch);
         }
 
-        unixctl_server_run(unixctl);
+        if (unixctl) {
+            unixctl_server_run(unixctl);
+        }
 
         /* Wait for something to happen. */
         if (n_switches < MAX_SWITCHES) {
@@ -210,13 +257,52 @@ main(int argc, char *argv[])
             rconn_recv_wait(sw->rconn);
             lswitch_wait(sw->lswitch);
         }
-        unixctl_server_wait(unixctl);
+        if (unixctl) {
+            unixctl_server_wait(unixctl);
+        }
+        if (parent_fd >= 0) {
+            poll_fd_wait(parent_fd, POLLIN);
+        }
         poll_block();
     }
 
     return 0;
 }
 
+/* Forks off 'n_workers - 1' worker processes.  Returns the calling process's
+ * worker number: 0 in the original process, 1 through 'n_workers - 1' in the
+ * new ones. */
+static int
+start_workers(void)
+{
+    int fds[2];
+    int i;
+
+    if (n_workers <= 1) {
+        return 0;
+    }
+
+    xpipe(fds);
+    for (i = 1; i < n_workers; i++) {
+        pid_t pid = fork();
+        if (!pid) {
+            /* Running in worker process.  Clear the fatal signal hooks, so
+             * that we don't delete files (e.g. the pidfile) that belong to the
+             * original process. */
+            fatal_signal_fork();
+            time_postfork();
+            close(fds[1]);
+            set_nonblocking(fds[0]);
+            parent_fd = fds[0];
+            return i;
+        } else if (pid < 0) {
+            ovs_fatal(errno, "fork failed");
+        }
+    }
+    close(fds[0]);
+    return 0;
+}
+
 static void
 new_switch(struct switch_ *sw, struct vconn *vconn)
 {
@@ -233,6 +319,7 @@ new_switch(struct switch_ *sw, struct vconn *vconn)
     cfg.default_flows = &default_flows;
     cfg.default_queue = default_queue;
     cfg.port_queues = &port_queues;
+    cfg.batch = batch_size > 0;
     sw->lswitch = lswitch_create(sw->rconn, &cfg);
 }
 
@@ -244,12 +331,28 @@ do_switching(struct switch_ *sw)
 
     packets_sent = rconn_packets_sent(sw->rconn);
 
-    msg = rconn_recv(sw->rconn);
-    if (msg) {
-        if (!mute) {
-            lswitch_process_packet(sw->lswitch, sw->rconn, msg);
+    if (!batch_size) {
+        msg = rconn_recv(sw->rconn);
+        if (msg) {
+            if (!mute) {
+                lswitch_process_packet(sw->lswitch, sw->rconn, msg);
+            }
+            ofpbuf_delete(msg);
         }
-        ofpbuf_delete(msg);
+    } else {
+        int i;
+
+        for (i = 0; i < batch_size; i++) {
+            msg = rconn_recv(sw->rconn);
+            if (!msg) {
+                break;
+            }
+            if (!mute) {
+                lswitch_process_packet(sw->lswitch, sw->rconn, msg);
+            }
+            ofpbuf_delete(msg);
+        }
+        lswitch_flush(sw->lswitch, sw->rconn);
     }
     rconn_run(sw->rconn);
 
@@ -311,6 +414,8 @@ parse_options(int argc, char *argv[])
         OPT_MUTE,
         OPT_WITH_FLOWS,
         OPT_UNIXCTL,
+        OPT_WORKERS,
+        OPT_BATCH,
         VLOG_OPTION_ENUMS,
         DAEMON_OPTION_ENUMS
     };
@@ -325,6 +430,8 @@ parse_options(int argc, char *argv[])
         {"port-queue",  required_argument, NULL, 'Q'},
         {"with-flows",  required_argument, NULL, OPT_WITH_FLOWS},
         {"unixctl",     required_argument, NULL, OPT_UNIXCTL},
+        {"workers",     required_argument, NULL, OPT_WORKERS},
+        {"batch",       required_argument, NULL, OPT_BATCH},
         {"help",        no_argument, NULL, 'h'},
         {"version",     no_argument, NULL, 'V'},
         DAEMON_LONG_OPTIONS,
@@ -393,6 +500,20 @@ parse_options(int argc, char *argv[])
             unixctl_path = optarg;
             break;
 
+        case OPT_WORKERS:
+            n_workers = atoi(optarg);
+            if (n_workers < 1 || n_workers > 64) {
+                ovs_fatal(0, "--workers argument must be between 1 and 64");
+            }
+            break;
+
+        case OPT_BATCH:
+            batch_size = atoi(optarg);
+            if (batch_size < 0) {
+                ovs_fatal(0, "--batch argument must be nonnegative");
+            }
+            break;
+
         case 'h':
             usage();
 
@@ -453,6 +574,8 @@ usage(void)
            "  -Q PORT-NAME:QUEUE-ID   use QUEUE-ID for frames from PORT-NAME\n"
            "  --with-flows FILE       use the flows from FILE\n"
            "  --unixctl=SOCKET        override default control socket name\n"
+           "  --workers=N             divide switches among N processes\n"
+           "  --batch=N               reply to up to N messages at once\n"
            "  -h, --help              display this help message\n"
            "  -V, --version           display version information\n");
     exit(EXIT_SUCCESS);
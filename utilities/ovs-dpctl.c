@@ -367,6 +367,7 @@ show_dpif(struct dpif *dpif)
     struct dpif_port_dump dump;
     struct dpif_port dpif_port;
     struct ovs_dp_stats stats;
+    struct ovs_dp_table_stats table_stats;
     struct netdev *netdev;
 
     printf("%s:\n", dpif_name(dpif));
@@ -378,7 +379,16 @@ show_dpif(struct dpif *dpif)
                (unsigned long long int) stats.n_lost);
         printf("\tflows: %llu\n", (unsigned long long int)stats.n_flows);
     }
+    if (!dpif_get_table_stats(dpif, &table_stats) && table_stats.n_buckets) {
+        printf("\ttable: buckets:%llu, expands:%llu, shrinks:%llu\n",
+               (unsigned long long int) table_stats.n_buckets,
+               (unsigned long long int) table_stats.n_expands,
+               (unsigned long long int) table_stats.n_shrinks);
+    }
     DPIF_PORT_FOR_EACH (&dpif_port, &dump, dpif) {
+        uint32_t upcall_rate, upcall_burst;
+        uint64_t upcall_drops;
+
         printf("\tport %u: %s", dpif_port.port_no, dpif_port.name);
 
         if (strcmp(dpif_port.type, "system")) {
@@ -417,6 +427,15 @@ show_dpif(struct dpif *dpif)
         }
         putchar('\n');
 
+        if (!dpif_port_get_upcall_limit(dpif, dpif_port.port_no,
+                                        &upcall_rate, &upcall_burst,
+                                        &upcall_drops)
+            && (upcall_rate || upcall_drops)) {
+            printf("\t\tupcall limit: rate:%"PRIu32", burst:%"PRIu32", "
+                   "dropped:%llu\n", upcall_rate, upcall_burst,
+                   (unsigned long long int) upcall_drops);
+        }
+
         if (print_statistics) {
             struct netdev_stats s;
             int error;
@@ -27,12 +27,14 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 
+#include "bitmap.h"
 #include "byte-order.h"
 #include "classifier.h"
 #include "command-line.h"
 #include "compiler.h"
 #include "dirs.h"
 #include "dynamic-string.h"
+#include "netdev.h"
 #include "netlink.h"
 #include "nx-match.h"
 #include "odp-util.h"
@@ -43,6 +45,8 @@
 #include "ofproto/ofproto.h"
 #include "openflow/nicira-ext.h"
 #include "openflow/openflow.h"
+#include "packets.h"
+#include "poll-loop.h"
 #include "random.h"
 #include "stream-ssl.h"
 #include "timeval.h"
@@ -188,6 +192,10 @@ usage(void)
            "  probe VCONN                 probe whether VCONN is up\n"
            "  ping VCONN [N]              latency of N-byte echos\n"
            "  benchmark VCONN N COUNT     bandwidth of COUNT N-byte echos\n"
+           "  benchmark-flow-mod SWITCH COUNT [BATCH]  flow_mod install rate\n"
+           "  benchmark-dump-flows SWITCH COUNT  flow stats dump throughput\n"
+           "  benchmark-packet-out SWITCH COUNT [BATCH [PORT]]  packet-out rate\n"
+           "  benchmark-packet-in SWITCH COUNT [NETDEV]  packet-in rate\n"
            "where each SWITCH is an active OpenFlow connection method.\n",
            program_name, program_name);
     vconn_usage(true, false, false);
@@ -349,11 +357,9 @@ dump_trivial_stats_transaction(const char *vconn_name, uint8_t stats_type)
     dump_stats_transaction(vconn_name, request);
 }
 
-/* Sends 'request', which should be a request that only has a reply if an error
- * occurs, and waits for it to succeed or fail.  If an error does occur, prints
- * it and exits with an error. */
 static void
-transact_multiple_noreply(struct vconn *vconn, struct list *requests)
+transact_multiple_noreply__(struct vconn *vconn, struct list *requests,
+                            bool batch)
 {
     struct ofpbuf *request, *reply;
 
@@ -361,7 +367,9 @@ transact_multiple_noreply(struct vconn *vconn, struct list *requests)
         update_openflow_length(request);
     }
 
-    run(vconn_transact_multiple_noreply(vconn, requests, &reply),
+    run((batch
+         ? vconn_transact_batch_noreply(vconn, requests, &reply)
+         : vconn_transact_multiple_noreply(vconn, requests, &reply)),
         "talking to %s", vconn_get_name(vconn));
     if (reply) {
         ofp_print(stderr, reply->data, reply->size, verbosity + 2);
@@ -370,6 +378,24 @@ transact_multiple_noreply(struct vconn *vconn, struct list *requests)
     ofpbuf_delete(reply);
 }
 
+/* Sends 'request', which should be a request that only has a reply if an error
+ * occurs, and waits for it to succeed or fail.  If an error does occur, prints
+ * it and exits with an error. */
+static void
+transact_multiple_noreply(struct vconn *vconn, struct list *requests)
+{
+    transact_multiple_noreply__(vconn, requests, false);
+}
+
+/* Like transact_multiple_noreply(), but sends all of 'requests' followed by a
+ * single barrier, so that an error does not stop the switch from processing
+ * the rest of them. */
+static void
+transact_batch_noreply(struct vconn *vconn, struct list *requests)
+{
+    transact_multiple_noreply__(vconn, requests, true);
+}
+
 /* Sends 'request', which should be a request that only has a reply if an error
  * occurs, and waits for it to succeed or fail.  If an error does occur, prints
  * it and exits with an error. */
@@ -896,6 +922,479 @@ do_benchmark(int argc OVS_UNUSED, char *argv[])
            count * message_size / (duration / 1000.0));
 }
 
+/* Latency samples collected by the benchmark-* commands. */
+struct bench_stats {
+    const char *unit;           /* Name of one operation, e.g. "flow_mod". */
+    unsigned int n_ops;         /* Number of operations completed. */
+    struct timeval start;       /* Start of the benchmark. */
+    long long int *samples;     /* Latencies, in microseconds. */
+    size_t n_samples, allocated_samples;
+};
+
+static long long int
+timeval_diff_usec(const struct timeval *a, const struct timeval *b)
+{
+    return ((long long int) (a->tv_sec - b->tv_sec) * 1000 * 1000
+            + (a->tv_usec - b->tv_usec));
+}
+
+static void
+bench_start(struct bench_stats *bs, const char *unit)
+{
+    bs->unit = unit;
+    bs->n_ops = 0;
+    bs->samples = NULL;
+    bs->n_samples = bs->allocated_samples = 0;
+    xgettimeofday(&bs->start);
+}
+
+/* Records that 'n_ops' operations have completed, the first of which was
+ * started at 'start'. */
+static void
+bench_record(struct bench_stats *bs, const struct timeval *start,
+             unsigned int n_ops)
+{
+    struct timeval now;
+
+    xgettimeofday(&now);
+    if (bs->n_samples >= bs->allocated_samples) {
+        bs->samples = x2nrealloc(bs->samples, &bs->allocated_samples,
+                                 sizeof *bs->samples);
+    }
+    bs->samples[bs->n_samples++] = timeval_diff_usec(&now, start);
+    bs->n_ops += n_ops;
+}
+
+static int
+compare_long_longs(const void *a_, const void *b_)
+{
+    const long long int *a = a_;
+    const long long int *b = b_;
+
+    return *a < *b ? -1 : *a > *b;
+}
+
+/* Returns the 'pct'th percentile of the 'n' sorted 'samples', in
+ * milliseconds. */
+static double
+percentile(const long long int *samples, size_t n, int pct)
+{
+    size_t idx = ((n * pct) + 99) / 100;
+    return samples[idx ? idx - 1 : 0] / 1000.0;
+}
+
+static void
+bench_report(struct bench_stats *bs, const char *sample_name)
+{
+    struct timeval end;
+    double duration;
+
+    xgettimeofday(&end);
+    duration = timeval_diff_usec(&end, &bs->start) / 1000.0;
+    printf("Finished %u %ss in %.1f ms (%.0f %ss/s)\n",
+           bs->n_ops, bs->unit, duration,
+           bs->n_ops / (MAX(duration, .001) / 1000.0), bs->unit);
+
+    if (bs->n_samples) {
+        long long int *s = bs->samples;
+        size_t n = bs->n_samples;
+
+        qsort(s, n, sizeof *s, compare_long_longs);
+        printf("Latency per %s (%zu samples): min %.3f ms, "
+               "50%% %.3f ms, 90%% %.3f ms, 99%% %.3f ms, max %.3f ms\n",
+               sample_name, n, s[0] / 1000.0, percentile(s, n, 50),
+               percentile(s, n, 90), percentile(s, n, 99), s[n - 1] / 1000.0);
+    }
+    free(bs->samples);
+}
+
+/* Parses the optional batch size argument 'arg' of a benchmark command. */
+static unsigned int
+parse_batch_size(const char *arg)
+{
+    int batch = arg ? atoi(arg) : 100;
+    if (batch <= 0) {
+        ovs_fatal(0, "batch size must be positive");
+    }
+    return batch;
+}
+
+static void
+do_benchmark_flow_mod(int argc, char *argv[])
+{
+    enum nx_flow_format flow_format;
+    struct bench_stats bs;
+    unsigned int batch;
+    struct vconn *vconn;
+    int count, i;
+
+    count = atoi(argv[2]);
+    batch = parse_batch_size(argc > 3 ? argv[3] : NULL);
+
+    open_vconn(argv[1], &vconn);
+    flow_format = (preferred_flow_format >= 0
+                   ? preferred_flow_format : NXFF_OPENFLOW10);
+    if (flow_format != NXFF_OPENFLOW10) {
+        set_flow_format(vconn, flow_format);
+    }
+
+    printf("Adding %d flows in batches of %u\n", count, batch);
+    bench_start(&bs, "flow_mod");
+    for (i = 0; i < count; ) {
+        struct timeval start;
+        struct list requests;
+        unsigned int j;
+
+        list_init(&requests);
+        for (j = 0; j < batch && i < count; j++, i++) {
+            struct ofputil_flow_mod fm;
+            struct ofpbuf *request;
+
+            memset(&fm, 0, sizeof fm);
+            cls_rule_init_catchall(&fm.cr, OFP_DEFAULT_PRIORITY);
+            cls_rule_set_dl_type(&fm.cr, htons(ETH_TYPE_IP));
+            cls_rule_set_nw_dst(&fm.cr, htonl(0x0a000000 | i));
+            fm.command = OFPFC_ADD;
+            fm.buffer_id = UINT32_MAX;
+            fm.out_port = OFPP_NONE;
+
+            request = ofputil_encode_flow_mod(&fm, flow_format, false);
+            list_push_back(&requests, &request->list_node);
+        }
+
+        xgettimeofday(&start);
+        transact_batch_noreply(vconn, &requests);
+        bench_record(&bs, &start, j);
+    }
+    vconn_close(vconn);
+
+    bench_report(&bs, "batch");
+}
+
+static void
+do_benchmark_dump_flows(int argc OVS_UNUSED, char *argv[])
+{
+    struct ofputil_flow_stats_request fsr;
+    enum nx_flow_format flow_format;
+    struct bench_stats bs;
+    struct vconn *vconn;
+    unsigned int n_flows;
+    int count, i;
+
+    count = atoi(argv[2]);
+
+    open_vconn(argv[1], &vconn);
+    flow_format = (preferred_flow_format >= 0
+                   ? preferred_flow_format : NXFF_OPENFLOW10);
+    if (flow_format != NXFF_OPENFLOW10) {
+        set_flow_format(vconn, flow_format);
+    }
+
+    fsr.aggregate = false;
+    cls_rule_init_catchall(&fsr.match, 0);
+    fsr.out_port = OFPP_NONE;
+    fsr.table_id = 0xff;
+
+    n_flows = 0;
+    bench_start(&bs, "flow");
+    for (i = 0; i < count; i++) {
+        struct timeval start;
+        struct ofpbuf *request;
+        ovs_be32 send_xid;
+        unsigned int n;
+        bool done;
+
+        request = ofputil_encode_flow_stats_request(&fsr, flow_format);
+        send_xid = ((struct ofp_header *) request->data)->xid;
+
+        xgettimeofday(&start);
+        send_openflow_buffer(vconn, request);
+        n = 0;
+        done = false;
+        while (!done) {
+            struct ofputil_flow_stats fs;
+            const struct ofp_stats_msg *osm;
+            struct ofpbuf *reply;
+
+            run(vconn_recv_block(vconn, &reply),
+                "OpenFlow packet receive failed");
+            osm = reply->data;
+            if (osm->header.xid != send_xid) {
+                ofpbuf_delete(reply);
+                continue;
+            } else if (osm->header.type != OFPT_STATS_REPLY) {
+                ovs_fatal(0, "received bad reply: %s",
+                          ofp_to_string(reply->data, reply->size,
+                                        verbosity + 1));
+            }
+
+            done = !(osm->flags & htons(OFPSF_REPLY_MORE));
+            while (!ofputil_decode_flow_stats_reply(&fs, reply)) {
+                n++;
+            }
+            ofpbuf_delete(reply);
+        }
+        bench_record(&bs, &start, n);
+        n_flows = n;
+    }
+    vconn_close(vconn);
+
+    printf("Dumped %d times a flow table of %u flows\n", count, n_flows);
+    bench_report(&bs, "dump");
+}
+
+/* Composes into 'b' a UDP packet that carries sequence number 'seq' in its
+ * IP source address, for the packet-out and packet-in benchmarks. */
+static void
+compose_benchmark_packet(struct ofpbuf *b, uint32_t seq)
+{
+    static const uint8_t eth_src[ETH_ADDR_LEN] = {
+        0x00, 0x23, 0x20, 0xb0, 0x00, 0x01
+    };
+    static const uint8_t eth_dst[ETH_ADDR_LEN] = {
+        0x00, 0x23, 0x20, 0xb0, 0x00, 0x02
+    };
+    struct flow flow;
+
+    memset(&flow, 0, sizeof flow);
+    memcpy(flow.dl_src, eth_src, ETH_ADDR_LEN);
+    memcpy(flow.dl_dst, eth_dst, ETH_ADDR_LEN);
+    flow.dl_type = htons(ETH_TYPE_IP);
+    flow.nw_proto = IPPROTO_UDP;
+    flow.nw_src = htonl(seq);
+    flow.nw_dst = htonl(0x0a000001);
+    flow.tp_src = htons(1234);
+    flow.tp_dst = htons(5678);
+
+    ofpbuf_clear(b);
+    flow_compose(b, &flow);
+}
+
+static void
+do_benchmark_packet_out(int argc, char *argv[])
+{
+    struct ofp_action_output oao;
+    struct bench_stats bs;
+    struct ofpbuf packet;
+    unsigned int batch;
+    struct vconn *vconn;
+    size_t n_actions;
+    int count, i;
+
+    count = atoi(argv[2]);
+    batch = parse_batch_size(argc > 3 ? argv[3] : NULL);
+
+    memset(&oao, 0, sizeof oao);
+    oao.type = htons(OFPAT_OUTPUT);
+    oao.len = htons(sizeof oao);
+    if (argc > 4) {
+        oao.port = htons(str_to_port_no(argv[1], argv[4]));
+        n_actions = 1;
+    } else {
+        n_actions = 0;
+    }
+
+    open_vconn(argv[1], &vconn);
+    ofpbuf_init(&packet, 0);
+
+    printf("Sending %d packets in batches of %u\n", count, batch);
+    bench_start(&bs, "packet_out");
+    for (i = 0; i < count; ) {
+        struct timeval start;
+        struct list requests;
+        unsigned int j;
+
+        list_init(&requests);
+        for (j = 0; j < batch && i < count; j++, i++) {
+            struct ofpbuf *request;
+
+            compose_benchmark_packet(&packet, i);
+            request = make_packet_out(&packet, UINT32_MAX, OFPP_NONE,
+                                      (struct ofp_action_header *) &oao,
+                                      n_actions);
+            list_push_back(&requests, &request->list_node);
+        }
+
+        xgettimeofday(&start);
+        transact_batch_noreply(vconn, &requests);
+        bench_record(&bs, &start, j);
+    }
+    ofpbuf_uninit(&packet);
+    vconn_close(vconn);
+
+    bench_report(&bs, "batch");
+}
+
+/* Maximum number of packets that benchmark-packet-in keeps in flight. */
+#define PACKET_IN_WINDOW 64
+
+/* How long benchmark-packet-in waits for a packet-in before it gives up on
+ * the packets still in flight, in milliseconds. */
+#define PACKET_IN_TIMEOUT 1000
+
+/* Sends a packet with sequence number 'seq' to the switch on 'vconn', by
+ * injecting it into 'netdev' if it is nonnull, otherwise by sending a
+ * packet-out that outputs it to the controller.  Returns 0 if successful,
+ * otherwise EAGAIN if the vconn's send queue is full or another errno
+ * value. */
+static int
+send_benchmark_packet(struct vconn *vconn, struct netdev *netdev,
+                      struct ofpbuf *packet, uint32_t seq)
+{
+    compose_benchmark_packet(packet, seq);
+    if (netdev) {
+        return netdev_send(netdev, packet);
+    } else {
+        struct ofp_action_output oao;
+        struct ofpbuf *request;
+        int retval;
+
+        memset(&oao, 0, sizeof oao);
+        oao.type = htons(OFPAT_OUTPUT);
+        oao.len = htons(sizeof oao);
+        oao.port = htons(OFPP_CONTROLLER);
+        oao.max_len = htons(UINT16_MAX);
+
+        request = make_packet_out(packet, UINT32_MAX, OFPP_NONE,
+                                  (struct ofp_action_header *) &oao, 1);
+        retval = vconn_send(vconn, request);
+        if (retval) {
+            ofpbuf_delete(request);
+        }
+        return retval;
+    }
+}
+
+/* Returns the sequence number of the benchmark packet in 'opi', or -1 if it
+ * is not a benchmark packet. */
+static int64_t
+parse_benchmark_packet_in(const struct ofp_packet_in *opi, size_t len)
+{
+    struct ofpbuf packet;
+    struct flow flow;
+
+    if (len < offsetof(struct ofp_packet_in, data)) {
+        return -1;
+    }
+    ofpbuf_use_const(&packet, opi->data,
+                     len - offsetof(struct ofp_packet_in, data));
+    flow_extract(&packet, 0, ntohs(opi->in_port), &flow);
+    return (flow.dl_type == htons(ETH_TYPE_IP)
+            && flow.nw_proto == IPPROTO_UDP
+            && flow.tp_src == htons(1234) && flow.tp_dst == htons(5678)
+            ? ntohl(flow.nw_src) : -1);
+}
+
+static void
+do_benchmark_packet_in(int argc, char *argv[])
+{
+    struct ofp_switch_config *osc;
+    struct timeval *sent_times;
+    struct netdev *netdev;
+    struct bench_stats bs;
+    struct ofpbuf packet;
+    struct ofpbuf *buf;
+    struct vconn *vconn;
+    int n_sent, n_received;
+    long long int deadline;
+    int count;
+
+    count = atoi(argv[2]);
+    if (count <= 0) {
+        ovs_fatal(0, "packet count must be positive");
+    }
+
+    netdev = NULL;
+    if (argc > 3) {
+        run(netdev_open(argv[3], "system", &netdev),
+            "%s: failed to open network device", argv[3]);
+    }
+
+    /* Ask for packet-ins with the whole packet on this connection. */
+    open_vconn(argv[1], &vconn);
+    osc = make_openflow(sizeof *osc, OFPT_SET_CONFIG, &buf);
+    osc->miss_send_len = htons(UINT16_MAX);
+    transact_noreply(vconn, buf);
+
+    printf("Sending %d packets %s%s\n", count,
+           netdev ? "on " : "via packet-out", netdev ? argv[3] : "");
+
+    sent_times = xcalloc(count, sizeof *sent_times);
+    ofpbuf_init(&packet, 0);
+    n_sent = n_received = 0;
+    bench_start(&bs, "packet_in");
+    deadline = time_msec() + PACKET_IN_TIMEOUT;
+    for (;;) {
+        bool progress = false;
+        struct ofpbuf *msg;
+
+        vconn_run(vconn);
+        while (n_sent < count && n_sent - n_received < PACKET_IN_WINDOW) {
+            int error;
+
+            xgettimeofday(&sent_times[n_sent]);
+            error = send_benchmark_packet(vconn, netdev, &packet, n_sent);
+            if (error == EAGAIN) {
+                break;
+            }
+            run(error, "sending packet");
+            n_sent++;
+            progress = true;
+        }
+
+        while (!vconn_recv(vconn, &msg)) {
+            const struct ofp_header *oh = msg->data;
+
+            if (oh->type == OFPT_PACKET_IN) {
+                int64_t seq = parse_benchmark_packet_in(msg->data, msg->size);
+                if (seq >= 0 && seq < n_sent) {
+                    bench_record(&bs, &sent_times[seq], 1);
+                    n_received++;
+                    progress = true;
+                }
+            } else if (oh->type == OFPT_ERROR) {
+                ofp_print(stderr, msg->data, msg->size, verbosity + 2);
+                exit(1);
+            } else if (oh->type == OFPT_ECHO_REQUEST) {
+                vconn_send(vconn, make_echo_reply(oh));
+            }
+            ofpbuf_delete(msg);
+        }
+
+        if (n_received >= count) {
+            break;
+        } else if (progress) {
+            deadline = time_msec() + PACKET_IN_TIMEOUT;
+        } else if (time_msec() >= deadline) {
+            if (n_sent < count) {
+                ovs_fatal(0, "timed out sending packets");
+            }
+            break;
+        }
+
+        vconn_run_wait(vconn);
+        vconn_recv_wait(vconn);
+        if (n_sent < count && n_sent - n_received < PACKET_IN_WINDOW) {
+            if (netdev) {
+                poll_immediate_wake();
+            } else {
+                vconn_send_wait(vconn);
+            }
+        }
+        poll_timer_wait_until(deadline);
+        poll_block();
+    }
+    ofpbuf_uninit(&packet);
+    free(sent_times);
+    netdev_close(netdev);
+    vconn_close(vconn);
+
+    bench_report(&bs, "packet");
+    if (n_received < count) {
+        printf("%d packets lost\n", count - n_received);
+    }
+}
+
 static void
 do_help(int argc OVS_UNUSED, char *argv[] OVS_UNUSED)
 {
@@ -1069,23 +1568,16 @@ read_flows_from_file(const char *filename, struct classifier *cls, int index)
     return min_flow_format;
 }
 
-/* Reads the OpenFlow flow table from 'vconn', which has currently active flow
- * format 'flow_format', and adds them as flow table entries in 'cls' for the
- * version with the specified 'index'. */
+/* Sends 'request', which must be a flow stats request or an NXST_FLOW_BUCKETS
+ * request, to 'vconn' and adds the flows in the reply as flow table entries in
+ * 'cls' for the version with the specified 'index'. */
 static void
-read_flows_from_switch(struct vconn *vconn, enum nx_flow_format flow_format,
-                       struct classifier *cls, int index)
+read_flows_from_stats_request(struct vconn *vconn, struct ofpbuf *request,
+                              struct classifier *cls, int index)
 {
-    struct ofputil_flow_stats_request fsr;
-    struct ofpbuf *request;
     ovs_be32 send_xid;
     bool done;
 
-    fsr.aggregate = false;
-    cls_rule_init_catchall(&fsr.match, 0);
-    fsr.out_port = OFPP_NONE;
-    fsr.table_id = 0xff;
-    request = ofputil_encode_flow_stats_request(&fsr, flow_format);
     send_xid = ((struct ofp_header *) request->data)->xid;
     send_openflow_buffer(vconn, request);
 
@@ -1104,7 +1596,8 @@ read_flows_from_switch(struct vconn *vconn, enum nx_flow_format flow_format,
             ofputil_decode_msg_type(reply->data, &type);
             code = ofputil_msg_type_code(type);
             if (code != OFPUTIL_OFPST_FLOW_REPLY &&
-                code != OFPUTIL_NXST_FLOW_REPLY) {
+                code != OFPUTIL_NXST_FLOW_REPLY &&
+                code != OFPUTIL_NXST_FLOW_BUCKETS_REPLY) {
                 ovs_fatal(0, "received bad reply: %s",
                           ofp_to_string(reply->data, reply->size,
                                         verbosity + 1));
@@ -1147,6 +1640,198 @@ read_flows_from_switch(struct vconn *vconn, enum nx_flow_format flow_format,
     }
 }
 
+/* Reads the OpenFlow flow table from 'vconn', which has currently active flow
+ * format 'flow_format', and adds them as flow table entries in 'cls' for the
+ * version with the specified 'index'. */
+static void
+read_flows_from_switch(struct vconn *vconn, enum nx_flow_format flow_format,
+                       struct classifier *cls, int index)
+{
+    struct ofputil_flow_stats_request fsr;
+
+    fsr.aggregate = false;
+    cls_rule_init_catchall(&fsr.match, 0);
+    fsr.out_port = OFPP_NONE;
+    fsr.table_id = 0xff;
+    read_flows_from_stats_request(
+        vconn, ofputil_encode_flow_stats_request(&fsr, flow_format),
+        cls, index);
+}
+
+/* Returns the NXST_FLOW_DIGEST digest of 'version' of 'fte', storing its
+ * bucket hash into '*hashp'. */
+static uint64_t
+fte_version_digest(const struct fte *fte, const struct fte_version *version,
+                   uint32_t *hashp)
+{
+    return ofputil_flow_digest(&fte->rule, version->cookie,
+                               version->idle_timeout, version->hard_timeout,
+                               version->actions, version->n_actions, hashp);
+}
+
+/* Computes per-bucket digests, as in an NXST_FLOW_DIGEST reply, over the
+ * versions of the FTEs in 'cls' with the given 'index'.  Stores the digests,
+ * which the caller must free, into 'fdr'. */
+static void
+digest_flows(const struct classifier *cls, int index, unsigned int n_buckets,
+             struct ofputil_flow_digest_reply *fdr)
+{
+    struct cls_cursor cursor;
+    struct fte *fte;
+
+    fdr->flow_count = 0;
+    fdr->n_buckets = n_buckets;
+    fdr->digests = xcalloc(n_buckets, sizeof *fdr->digests);
+
+    cls_cursor_init(&cursor, cls, NULL);
+    CLS_CURSOR_FOR_EACH (fte, rule, &cursor) {
+        const struct fte_version *version = fte->versions[index];
+
+        if (version) {
+            uint64_t digest;
+            uint32_t hash;
+
+            digest = fte_version_digest(fte, version, &hash);
+            fdr->digests[hash & (n_buckets - 1)] += digest;
+            fdr->flow_count++;
+        }
+    }
+}
+
+/* Sends an NXST_FLOW_DIGEST request for 'n_buckets' buckets across all of the
+ * flow tables in 'vconn' and stores the reply, whose digests the caller must
+ * free, into 'fdr'.  Returns true if successful, false if the switch does not
+ * support flow table digests. */
+static bool
+fetch_flow_digest(struct vconn *vconn, unsigned int n_buckets,
+                  struct ofputil_flow_digest_reply *fdr)
+{
+    struct ofputil_flow_digest_request request;
+    const struct ofputil_msg_type *type;
+    struct ofpbuf *msg, *reply;
+
+    request.table_id = 0xff;
+    request.n_buckets = n_buckets;
+    request.buckets = NULL;
+    msg = ofputil_encode_flow_digest_request(&request);
+    update_openflow_length(msg);
+    run(vconn_transact(vconn, msg, &reply),
+        "talking to %s", vconn_get_name(vconn));
+
+    ofputil_decode_msg_type(reply->data, &type);
+    if (ofputil_msg_type_code(type) != OFPUTIL_NXST_FLOW_DIGEST_REPLY
+        || ofputil_decode_flow_digest_reply(fdr, reply->data)
+        || fdr->n_buckets != n_buckets) {
+        char *s = ofp_to_string(reply->data, reply->size, 2);
+        VLOG_DBG("%s: flow table digests not supported, switch replied: %s",
+                 vconn_get_name(vconn), s);
+        free(s);
+        ofpbuf_delete(reply);
+        return false;
+    }
+    ofpbuf_delete(reply);
+    return true;
+}
+
+/* Returns the number of digest buckets to request for flow tables that
+ * contain about 'n_flows' flows: about one bucket per flow, so that a bucket
+ * that differs usually costs only a few flows to fetch. */
+static unsigned int
+choose_n_buckets(uint32_t n_flows)
+{
+    unsigned int n_buckets = 1;
+
+    while (n_buckets < n_flows && n_buckets < NX_FLOW_DIGEST_MAX_BUCKETS) {
+        n_buckets *= 2;
+    }
+    return n_buckets;
+}
+
+/* Uses flow table digests to read from 'vconn' only the flows that might
+ * differ from the versions with index 'file_idx' already in 'cls', adding
+ * them as flow table entries in 'cls' for the version with index 'sw_idx'.
+ *
+ * On success, returns true and stores into '*changedp' a bitmap of the
+ * '*n_bucketsp' buckets that differ.  FTEs in other buckets are the same in
+ * 'cls' and on the switch.  The caller must free '*changedp'.
+ *
+ * Returns false if the switch does not support flow table digests, in which
+ * case the caller must fall back to reading the whole flow table. */
+static bool
+read_changed_flows_from_switch(struct vconn *vconn, struct classifier *cls,
+                               int file_idx, int sw_idx,
+                               unsigned long **changedp,
+                               unsigned int *n_bucketsp)
+{
+    struct ofputil_flow_digest_reply file_digest, sw_digest;
+    struct ofputil_flow_digest_request request;
+    unsigned long *changed;
+    unsigned int n_buckets;
+    unsigned int n_changed;
+    uint32_t n_flows;
+    bool same;
+
+    /* A single bucket covers the entire flow table.  If it matches, then
+     * there is nothing to fetch. */
+    if (!fetch_flow_digest(vconn, 1, &sw_digest)) {
+        return false;
+    }
+    digest_flows(cls, file_idx, 1, &file_digest);
+    same = (file_digest.flow_count == sw_digest.flow_count
+            && file_digest.digests[0] == sw_digest.digests[0]);
+    n_flows = MAX(file_digest.flow_count, sw_digest.flow_count);
+    free(file_digest.digests);
+    free(sw_digest.digests);
+
+    if (same) {
+        VLOG_DBG("%s: flow table digest matches", vconn_get_name(vconn));
+        *changedp = bitmap_allocate(1);
+        *n_bucketsp = 1;
+        return true;
+    }
+
+    /* Narrow the differences down to individual buckets. */
+    n_buckets = choose_n_buckets(n_flows);
+    changed = bitmap_allocate(n_buckets);
+    n_changed = 0;
+    if (n_buckets == 1) {
+        bitmap_set1(changed, 0);
+        n_changed = 1;
+    } else {
+        unsigned int i;
+
+        if (!fetch_flow_digest(vconn, n_buckets, &sw_digest)) {
+            ovs_fatal(0, "%s: switch stopped supporting flow table digests",
+                      vconn_get_name(vconn));
+        }
+        digest_flows(cls, file_idx, n_buckets, &file_digest);
+        for (i = 0; i < n_buckets; i++) {
+            if (file_digest.digests[i] != sw_digest.digests[i]) {
+                bitmap_set1(changed, i);
+                n_changed++;
+            }
+        }
+        free(file_digest.digests);
+        free(sw_digest.digests);
+    }
+    VLOG_DBG("%s: %u of %u flow table digest buckets differ",
+             vconn_get_name(vconn), n_changed, n_buckets);
+
+    if (n_changed) {
+        struct ofpbuf *msg;
+
+        request.table_id = 0xff;
+        request.n_buckets = n_buckets;
+        request.buckets = changed;
+        msg = ofputil_encode_flow_digest_request(&request);
+        read_flows_from_stats_request(vconn, msg, cls, sw_idx);
+    }
+
+    *changedp = changed;
+    *n_bucketsp = n_buckets;
+    return true;
+}
+
 static void
 fte_make_flow_mod(const struct fte *fte, int index, uint16_t command,
                   enum nx_flow_format flow_format, struct list *packets)
@@ -1177,11 +1862,25 @@ fte_make_flow_mod(const struct fte *fte, int index, uint16_t command,
     list_push_back(packets, &ofm->list_node);
 }
 
+/* Returns true if 'fte' might differ between the file and the switch in
+ * replace-flows, that is, if 'changed' is null or if 'fte''s digest bucket
+ * among 'n_buckets' buckets is set in 'changed'. */
+static bool
+fte_maybe_changed(const struct fte *fte, const unsigned long *changed,
+                  unsigned int n_buckets)
+{
+    return (!changed
+            || bitmap_is_set(changed, (ofputil_flow_digest_hash(&fte->rule)
+                                       & (n_buckets - 1))));
+}
+
 static void
 do_replace_flows(int argc OVS_UNUSED, char *argv[])
 {
     enum { FILE_IDX = 0, SWITCH_IDX = 1 };
     enum nx_flow_format min_flow_format, flow_format;
+    unsigned long *changed;
+    unsigned int n_buckets;
     struct cls_cursor cursor;
     struct classifier cls;
     struct list requests;
@@ -1193,7 +1892,16 @@ do_replace_flows(int argc OVS_UNUSED, char *argv[])
 
     open_vconn(argv[1], &vconn);
     flow_format = negotiate_highest_flow_format(vconn, min_flow_format);
-    read_flows_from_switch(vconn, flow_format, &cls, SWITCH_IDX);
+
+    /* With --readd every flow in the file gets re-added anyway, so there is
+     * no point in narrowing down the differences. */
+    changed = NULL;
+    n_buckets = 0;
+    if (readd || flow_format != NXFF_NXM
+        || !read_changed_flows_from_switch(vconn, &cls, FILE_IDX, SWITCH_IDX,
+                                           &changed, &n_buckets)) {
+        read_flows_from_switch(vconn, flow_format, &cls, SWITCH_IDX);
+    }
 
     list_init(&requests);
 
@@ -1217,7 +1925,8 @@ do_replace_flows(int argc OVS_UNUSED, char *argv[])
         struct fte_version *sw_ver = fte->versions[SWITCH_IDX];
 
         if (file_ver
-            && (readd || !sw_ver || !fte_version_equals(sw_ver, file_ver))) {
+            && (readd || !sw_ver || !fte_version_equals(sw_ver, file_ver))
+            && fte_maybe_changed(fte, changed, n_buckets)) {
             fte_make_flow_mod(fte, FILE_IDX, OFPFC_ADD, flow_format,
                               &requests);
         }
@@ -1225,6 +1934,7 @@ do_replace_flows(int argc OVS_UNUSED, char *argv[])
     transact_multiple_noreply(vconn, &requests);
     vconn_close(vconn);
 
+    bitmap_free(changed);
     fte_free_all(&cls);
 }
 
@@ -1445,6 +2155,10 @@ static const struct command all_commands[] = {
     { "probe", 1, 1, do_probe },
     { "ping", 1, 2, do_ping },
     { "benchmark", 3, 3, do_benchmark },
+    { "benchmark-flow-mod", 2, 3, do_benchmark_flow_mod },
+    { "benchmark-dump-flows", 2, 2, do_benchmark_dump_flows },
+    { "benchmark-packet-out", 2, 4, do_benchmark_packet_out },
+    { "benchmark-packet-in", 2, 3, do_benchmark_packet_in },
     { "help", 0, INT_MAX, do_help },
 
     /* Undocumented commands for testing. */
@@ -35,6 +35,7 @@
 #include "ofp-print.h"
 #include "ofpbuf.h"
 #include "ofproto/ofproto.h"
+#include "phase.h"
 #include "poll-loop.h"
 #include "sha1.h"
 #include "shash.h"
@@ -53,6 +54,10 @@
 
 VLOG_DEFINE_THIS_MODULE(bridge);
 
+PHASE_DEFINE(ovsdb_idl_run);
+PHASE_DEFINE(ofproto_run);
+PHASE_DEFINE(bridge_reconfigure);
+
 COVERAGE_DEFINE(bridge_reconfigure);
 
 struct iface {
@@ -151,6 +156,7 @@ static void bridge_configure_datapath_id(struct bridge *);
 static void bridge_configure_flow_eviction_threshold(struct bridge *);
 static void bridge_configure_netflow(struct bridge *);
 static void bridge_configure_forward_bpdu(struct bridge *);
+static void bridge_configure_revalidate_delay(struct bridge *);
 static void bridge_configure_sflow(struct bridge *, int *sflow_bridge_number);
 static void bridge_configure_remotes(struct bridge *,
                                      const struct sockaddr_in *managers,
@@ -197,6 +203,7 @@ static void iface_set_mac(struct iface *);
 static void iface_set_ofport(const struct ovsrec_interface *, int64_t ofport);
 static void iface_configure_qos(struct iface *, const struct ovsrec_qos *);
 static void iface_configure_cfm(struct iface *);
+static void iface_configure_upcall_limit(struct iface *);
 static void iface_refresh_cfm_stats(struct iface *);
 static void iface_refresh_stats(struct iface *);
 static void iface_refresh_status(struct iface *);
@@ -411,6 +418,7 @@ bridge_reconfigure(const struct ovsrec_open_vswitch *ovs_cfg)
 
             LIST_FOR_EACH (iface, port_elem, &port->ifaces) {
                 iface_configure_cfm(iface);
+                iface_configure_upcall_limit(iface);
                 iface_configure_qos(iface, port->cfg->qos);
                 iface_set_mac(iface);
             }
@@ -419,6 +427,7 @@ bridge_reconfigure(const struct ovsrec_open_vswitch *ovs_cfg)
         bridge_configure_datapath_id(br);
         bridge_configure_flow_eviction_threshold(br);
         bridge_configure_forward_bpdu(br);
+        bridge_configure_revalidate_delay(br);
         bridge_configure_remotes(br, managers, n_managers);
         bridge_configure_netflow(br);
         bridge_configure_sflow(br, &sflow_bridge_number);
@@ -987,6 +996,18 @@ bridge_configure_flow_eviction_threshold(struct bridge *br)
     ofproto_set_flow_eviction_threshold(br->ofproto, threshold);
 }
 
+/* Set flow revalidation delay. */
+static void
+bridge_configure_revalidate_delay(struct bridge *br)
+{
+    const char *delay_str;
+    unsigned delay;
+
+    delay_str = bridge_get_other_config(br->cfg, "flow-revalidate-delay");
+    delay = delay_str ? strtoul(delay_str, NULL, 10) : 0;
+    ofproto_set_revalidate_delay(br->ofproto, delay);
+}
+
 /* Set forward BPDU option. */
 static void
 bridge_configure_forward_bpdu(struct bridge *br)
@@ -1466,7 +1487,9 @@ bridge_run(void)
     struct bridge *br;
 
     /* (Re)configure if necessary. */
+    phase_begin(&phase_ovsdb_idl_run);
     database_changed = ovsdb_idl_run(idl);
+    phase_end(&phase_ovsdb_idl_run);
     if (ovsdb_idl_is_lock_contended(idl)) {
         static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 1);
         struct bridge *br, *next_br;
@@ -1485,6 +1508,7 @@ bridge_run(void)
 
     /* Let each bridge do the work that it needs to do. */
     datapath_destroyed = false;
+    phase_begin(&phase_ofproto_run);
     HMAP_FOR_EACH (br, node, &all_bridges) {
         int error = ofproto_run(br->ofproto);
         if (error) {
@@ -1494,6 +1518,7 @@ bridge_run(void)
             datapath_destroyed = true;
         }
     }
+    phase_end(&phase_ofproto_run);
 
     /* Re-configure SSL.  We do this on every trip through the main loop,
      * instead of just when the database changes, because the contents of the
@@ -1509,6 +1534,7 @@ bridge_run(void)
     }
 
     if (database_changed || datapath_destroyed) {
+        phase_begin(&phase_bridge_reconfigure);
         if (cfg) {
             struct ovsdb_idl_txn *txn = ovsdb_idl_txn_create(idl);
 
@@ -1524,6 +1550,7 @@ bridge_run(void)
 
             bridge_reconfigure(&null_cfg);
         }
+        phase_end(&phase_bridge_reconfigure);
     }
 
     /* Refresh system and interface stats if necessary. */
@@ -1759,6 +1786,18 @@ bridge_lookup(const char *name)
     return NULL;
 }
 
+static bool
+bridge_dump_flows_next(struct ds *results, void *dump)
+{
+    return ofproto_flow_dump_next(dump, results);
+}
+
+static void
+bridge_dump_flows_destroy(void *dump)
+{
+    ofproto_flow_dump_destroy(dump);
+}
+
 /* Handle requests for a listing of all flows known by the OpenFlow
  * stack, including those normally hidden. */
 static void
@@ -1766,7 +1805,6 @@ bridge_unixctl_dump_flows(struct unixctl_conn *conn,
                           const char *args, void *aux OVS_UNUSED)
 {
     struct bridge *br;
-    struct ds results;
 
     br = bridge_lookup(args);
     if (!br) {
@@ -1774,11 +1812,10 @@ bridge_unixctl_dump_flows(struct unixctl_conn *conn,
         return;
     }
 
-    ds_init(&results);
-    ofproto_get_all_flows(br->ofproto, &results);
-
-    unixctl_command_reply(conn, 200, ds_cstr(&results));
-    ds_destroy(&results);
+    /* The flow table can be huge, so stream it out a few flows at a time. */
+    unixctl_command_reply_stream(conn, 200, bridge_dump_flows_next,
+                                 bridge_dump_flows_destroy,
+                                 ofproto_flow_dump_start(br->ofproto));
 }
 
 /* "bridge/reconnect [BRIDGE]": makes BRIDGE drop all of its controller
@@ -2644,6 +2681,20 @@ iface_configure_cfm(struct iface *iface)
     ofproto_port_set_cfm(iface->port->bridge->ofproto, iface->ofp_port, &s);
 }
 
+/* Configures the datapath's limit on the rate of flow setups for packets
+ * received on 'iface'. */
+static void
+iface_configure_upcall_limit(struct iface *iface)
+{
+    int rate, burst;
+
+    rate = atoi(get_interface_other_config(iface->cfg, "upcall-rate", "0"));
+    burst = atoi(get_interface_other_config(iface->cfg, "upcall-burst", "0"));
+    ofproto_port_set_upcall_limit(iface->port->bridge->ofproto,
+                                  iface->ofp_port, MAX(rate, 0),
+                                  MAX(burst, 0));
+}
+
 /* Read carrier or miimon status directly from 'iface''s netdev, according to
  * how 'iface''s port is configured.
  *
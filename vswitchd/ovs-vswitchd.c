@@ -33,10 +33,13 @@
 #include "dirs.h"
 #include "dummy.h"
 #include "leak-checker.h"
+#include "memory.h"
 #include "netdev.h"
 #include "ovsdb-idl.h"
+#include "phase.h"
 #include "poll-loop.h"
 #include "process.h"
+#include "profiler.h"
 #include "signals.h"
 #include "stream-ssl.h"
 #include "stream.h"
@@ -51,6 +54,10 @@
 
 VLOG_DEFINE_THIS_MODULE(vswitchd);
 
+PHASE_DEFINE(bridge_run);
+PHASE_DEFINE(unixctl);
+PHASE_DEFINE(netdev_run);
+
 static unixctl_cb_func ovs_vswitchd_exit;
 
 static char *parse_options(int argc, char *argv[]);
@@ -68,6 +75,8 @@ main(int argc, char *argv[])
     proctitle_init(argc, argv);
     set_program_name(argv[0]);
     stress_init_command();
+    profiler_init_command();
+    memory_init_command();
     remote = parse_options(argc, argv);
     signal(SIGPIPE, SIG_IGN);
     sighup = signal_register(SIGHUP);
@@ -90,9 +99,17 @@ main(int argc, char *argv[])
         if (signal_poll(sighup)) {
             vlog_reopen_log_file();
         }
+        phase_begin(&phase_bridge_run);
         bridge_run();
+        phase_end(&phase_bridge_run);
+
+        phase_begin(&phase_unixctl);
         unixctl_server_run(unixctl);
+        phase_end(&phase_unixctl);
+
+        phase_begin(&phase_netdev_run);
         netdev_run();
+        phase_end(&phase_netdev_run);
 
         signal_wait(sighup);
         bridge_wait();